@@ -65,9 +65,31 @@
 #define EXCEPTION_SIMD_FP           19
 
 // System Call Interface
-#define SYSCALL_VECTOR              0x80
+#define SYSCALL_VECTOR              0x80    // Legacy INT 0x80 entry; SYSCALL is preferred
 #define SYSCALL_MAX_ARGS            6
 
+// Segment Selectors (GDT order fixed by SYSCALL/SYSRET)
+#define GDT_KERNEL_CODE         0x08
+#define GDT_KERNEL_DATA         0x10
+#define GDT_USER_DATA           0x1B    // 0x18 | RPL 3
+#define GDT_USER_CODE           0x23    // 0x20 | RPL 3
+
+// Model Specific Registers
+#define MSR_EFER                0xC0000080  // Extended feature enables
+#define MSR_STAR                0xC0000081  // SYSCALL/SYSRET segment bases
+#define MSR_LSTAR               0xC0000082  // 64-bit SYSCALL entry point
+#define MSR_SFMASK              0xC0000084  // RFLAGS bits cleared by SYSCALL
+#define MSR_GS_BASE             0xC0000101  // Active GS base
+#define MSR_KERNEL_GS_BASE      0xC0000102  // GS base exchanged by SWAPGS
+#define EFER_SCE                (1UL << 0)  // SYSCALL/SYSRET enable
+
+// RFLAGS Bits
+#define RFLAGS_TF               (1UL << 8)   // Single step
+#define RFLAGS_IF               (1UL << 9)   // Interrupts enabled
+#define RFLAGS_DF               (1UL << 10)  // String direction
+#define RFLAGS_NT               (1UL << 14)  // Nested task
+#define RFLAGS_AC               (1UL << 18)  // Alignment check / SMAP override
+
 // CPU State Structure
 struct cpu_state {
     uint64_t rax, rbx, rcx, rdx;
@@ -78,6 +100,89 @@ struct cpu_state {
     uint16_t cs, ds, es, fs, gs, ss;
 } __attribute__((packed));
 
+// Control Register Bits
+#define CR0_MP                  (1UL << 1)   // Monitor coprocessor
+#define CR0_EM                  (1UL << 2)   // x87 emulation
+#define CR0_TS                  (1UL << 3)   // Task switched (lazy FPU trap)
+#define CR0_NE                  (1UL << 5)   // Native x87 error reporting
+#define CR4_OSFXSR              (1UL << 9)   // FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT          (1UL << 10)  // Unmasked SIMD exceptions
+#define CR4_OSXSAVE             (1UL << 18)  // XSAVE and XCR0 enabled
+
+// Low-level CPU Access
+static inline void cpuid_count(uint32_t leaf, uint32_t subleaf,
+                               uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ __volatile__("cpuid"
+                         : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                         : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t read_cr0(void) {
+    uint64_t value;
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint64_t value) {
+    __asm__ __volatile__("mov %0, %%cr0" :: "r"(value) : "memory");
+}
+
+static inline uint64_t read_cr4(void) {
+    uint64_t value;
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint64_t value) {
+    __asm__ __volatile__("mov %0, %%cr4" :: "r"(value) : "memory");
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    __asm__ __volatile__("xsetbv" :: "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr" :: "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+static inline void clts(void) {
+    __asm__ __volatile__("clts" ::: "memory");
+}
+
+static inline void stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+// SMP Support
+#ifdef CONFIG_SCHED_SIM
+// The hosted scheduler simulator (tools/schedsim) supplies the simulated CPU
+uint32_t smp_processor_id(void);
+#else
+// Only the BSP executes kernel code until SMP bring-up, so CPU 0 is returned
+static inline uint32_t smp_processor_id(void) {
+    return 0;
+}
+#endif
+
+// Context Switch (switch.S)
+void switch_to_asm(uint64_t *prev_rsp, uint64_t next_rsp);
+void thread_entry_trampoline(void);
+
+// System Call Entry (syscall_entry.S)
+void syscall_entry(void);
+
 // Architecture-specific Functions
 void arch_init(void);
 void arch_enable_interrupts(void);
@@ -0,0 +1,307 @@
+/*
+ * FG-OS x86_64 FPU/SIMD State Management
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Lazy FPU switching: CR0.TS is set when a thread that does not own the
+ * live register state is switched in, and the device-not-available trap
+ * saves the previous owner with XSAVEOPT and loads the new thread with
+ * XRSTOR. Threads that never execute an FPU instruction never trap and
+ * never have their state saved.
+ */
+
+#include <kernel.h>
+#include <types.h>
+#include <panic.h>
+#include "arch.h"
+#include "fpu.h"
+#include "../../mm/memory.h"
+#include "../../interrupt/idt.h"
+
+// CPUID Feature Bits
+#define CPUID_1_EDX_FXSR        (1U << 24)
+#define CPUID_1_EDX_SSE         (1U << 25)
+#define CPUID_1_ECX_XSAVE       (1U << 26)
+#define CPUID_D_1_EAX_XSAVEOPT  (1U << 0)
+
+// Initial Register Values
+#define FPU_DEFAULT_FCW         0x037F  // All x87 exceptions masked
+#define FPU_DEFAULT_MXCSR       0x1F80  // All SIMD exceptions masked
+#define FXSAVE_MXCSR_OFFSET     24
+
+// FPU configuration
+static fpu_save_mode_t save_mode = FPU_SAVE_FXSAVE;
+static uint32_t state_size = FPU_FXSAVE_SIZE;
+static uint64_t xfeatures = 0;
+static void *init_state = NULL;        // Template for a thread's first FPU use
+
+// Per-CPU FPU ownership
+static struct fpu *fpu_owner[MAX_CPUS];    // Whose state is live in the registers
+static struct fpu *fpu_current[MAX_CPUS];  // FPU context of the running thread
+static bool fpu_ts_set[MAX_CPUS];          // Cached CR0.TS
+
+// FPU statistics
+static struct fpu_stats stats = {0};
+
+// Forward declarations
+static void* fpu_alloc_area(void **allocation);
+static void fpu_save(void *area);
+static void fpu_restore(const void *area);
+static void fpu_trap_handler(uint8_t vector, uint64_t error_code, struct cpu_state *context);
+
+/**
+ * @brief Detect the save instruction set and enable FPU/SSE/AVX
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int fpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_1_EDX_FXSR) || !(edx & CPUID_1_EDX_SSE)) {
+        KERROR("FPU: FXSR/SSE not supported");
+        return KERN_ERROR;
+    }
+
+    // Native x87 error reporting, no emulation
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    if (ecx & CPUID_1_ECX_XSAVE) {
+        write_cr4(cr4 | CR4_OSXSAVE);
+
+        cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx);
+        xfeatures = eax & XFEATURE_SUPPORTED;
+        xsetbv(0, xfeatures);
+
+        // EBX reports the area size for the components just enabled in XCR0
+        cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx);
+        state_size = ebx;
+
+        cpuid_count(0xD, 1, &eax, &ebx, &ecx, &edx);
+        save_mode = (eax & CPUID_D_1_EAX_XSAVEOPT) ? FPU_SAVE_XSAVEOPT : FPU_SAVE_XSAVE;
+    } else {
+        write_cr4(cr4);
+    }
+
+    // Build the initial state template: default control words, and for
+    // XSAVE an all-zero header so XRSTOR puts every component in init state
+    void *allocation;
+    init_state = fpu_alloc_area(&allocation);
+    if (!init_state) {
+        KERROR("FPU: Failed to allocate initial state");
+        return KERN_NOMEM;
+    }
+    *(uint16_t*)init_state = FPU_DEFAULT_FCW;
+    *(uint32_t*)((uint8_t*)init_state + FXSAVE_MXCSR_OFFSET) = FPU_DEFAULT_MXCSR;
+
+    __asm__ __volatile__("fninit");
+
+    idt_register_handler(EXCEPTION_DEVICE_NOT_AVAIL, fpu_trap_handler);
+
+    // No thread owns the FPU yet: trap on first use
+    memset(fpu_owner, 0, sizeof(fpu_owner));
+    memset(fpu_current, 0, sizeof(fpu_current));
+    stts();
+    fpu_ts_set[smp_processor_id()] = true;
+
+    KINFO("FPU: %s, %u byte save area, XCR0=0x%llx",
+          save_mode == FPU_SAVE_XSAVEOPT ? "XSAVEOPT" :
+          save_mode == FPU_SAVE_XSAVE ? "XSAVE" : "FXSAVE",
+          state_size, xfeatures);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Initialize a thread's FPU context
+ *
+ * @param fpu FPU context to initialize
+ */
+void fpu_init_thread(struct fpu *fpu) {
+    fpu->state = NULL;
+    fpu->allocation = NULL;
+    fpu->used = false;
+}
+
+/**
+ * @brief Drop a thread's FPU context
+ *
+ * @param fpu FPU context to release
+ */
+void fpu_release(struct fpu *fpu) {
+    uint32_t cpu = smp_processor_id();
+
+    if (fpu_owner[cpu] == fpu) {
+        fpu_owner[cpu] = NULL;
+    }
+    if (fpu_current[cpu] == fpu) {
+        fpu_current[cpu] = NULL;
+    }
+
+    if (fpu->allocation) {
+        kfree(fpu->allocation);
+    }
+    fpu_init_thread(fpu);
+}
+
+/**
+ * @brief Switch FPU context between threads
+ *
+ * No state is saved or restored here. CR0.TS is cleared only when the
+ * incoming thread still owns the live registers; otherwise its first FPU
+ * instruction traps and the state is swapped then.
+ *
+ * @param prev FPU context of the outgoing thread (may be NULL)
+ * @param next FPU context of the incoming thread (may be NULL)
+ */
+void fpu_switch(struct fpu *prev, struct fpu *next) {
+    uint32_t cpu = smp_processor_id();
+    (void)prev;
+
+    fpu_current[cpu] = next;
+
+    bool need_ts = !next || fpu_owner[cpu] != next;
+    if (need_ts == fpu_ts_set[cpu]) {
+        stats.switches_skipped++;
+        return;
+    }
+
+    if (need_ts) {
+        stts();
+    } else {
+        clts();
+    }
+    fpu_ts_set[cpu] = need_ts;
+}
+
+/**
+ * @brief Get the size of a thread's FPU save area
+ *
+ * @return Save area size in bytes
+ */
+uint32_t fpu_state_size(void) {
+    return state_size;
+}
+
+/**
+ * @brief Get the save instruction in use
+ *
+ * @return Save mode
+ */
+fpu_save_mode_t fpu_get_save_mode(void) {
+    return save_mode;
+}
+
+/**
+ * @brief Get FPU statistics
+ *
+ * @return Pointer to FPU statistics
+ */
+const struct fpu_stats* fpu_get_stats(void) {
+    return &stats;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Allocate a save area with XSAVE alignment
+ *
+ * @param allocation Receives the pointer to pass to kfree()
+ * @return Aligned, zeroed save area, NULL on allocation failure
+ */
+static void* fpu_alloc_area(void **allocation) {
+    *allocation = kmalloc(state_size + FPU_STATE_ALIGN - 1);
+    if (!*allocation) {
+        return NULL;
+    }
+
+    void *area = (void*)(((uint64_t)*allocation + FPU_STATE_ALIGN - 1) & ~(uint64_t)(FPU_STATE_ALIGN - 1));
+    memset(area, 0, state_size);
+    return area;
+}
+
+/**
+ * @brief Save the live register state
+ *
+ * @param area Save area
+ */
+static void fpu_save(void *area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    switch (save_mode) {
+        case FPU_SAVE_XSAVEOPT:
+            __asm__ __volatile__("xsaveopt64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        case FPU_SAVE_XSAVE:
+            __asm__ __volatile__("xsave64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        default:
+            __asm__ __volatile__("fxsave64 (%0)" :: "r"(area) : "memory");
+            break;
+    }
+
+    stats.saves++;
+}
+
+/**
+ * @brief Load register state from a save area
+ *
+ * @param area Save area
+ */
+static void fpu_restore(const void *area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    if (save_mode == FPU_SAVE_FXSAVE) {
+        __asm__ __volatile__("fxrstor64 (%0)" :: "r"(area) : "memory");
+    } else {
+        __asm__ __volatile__("xrstor64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+    }
+
+    stats.restores++;
+}
+
+/**
+ * @brief Device-not-available (#NM) handler
+ *
+ * Hands the FPU to the running thread, saving the previous owner's state.
+ */
+static void fpu_trap_handler(uint8_t vector, uint64_t error_code, struct cpu_state *context) {
+    (void)vector; (void)error_code; (void)context;
+
+    uint32_t cpu = smp_processor_id();
+    struct fpu *fpu = fpu_current[cpu];
+
+    clts();
+    fpu_ts_set[cpu] = false;
+    stats.traps++;
+
+    // The kernel is built without SSE, so only threads may trap here
+    if (!fpu) {
+        panic("FPU: Device-not-available trap outside thread context");
+    }
+
+    if (fpu_owner[cpu] == fpu) {
+        return;
+    }
+
+    if (fpu_owner[cpu]) {
+        fpu_save(fpu_owner[cpu]->state);
+    }
+
+    if (!fpu->state) {
+        fpu->state = fpu_alloc_area(&fpu->allocation);
+        if (!fpu->state) {
+            panic_memory("FPU: Failed to allocate %u byte save area", state_size);
+        }
+        memcpy(fpu->state, init_state, state_size);
+    }
+
+    fpu_restore(fpu->state);
+    fpu->used = true;
+    fpu_owner[cpu] = fpu;
+}
@@ -0,0 +1,59 @@
+/*
+ * FG-OS x86_64 FPU/SIMD State Management Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Lazy save and restore of x87/SSE/AVX state using XSAVE.
+ */
+
+#ifndef ARCH_X86_64_FPU_H
+#define ARCH_X86_64_FPU_H
+
+#include <types.h>
+
+// XSAVE State Components (XCR0 bits)
+#define XFEATURE_X87            (1ULL << 0)
+#define XFEATURE_SSE            (1ULL << 1)
+#define XFEATURE_AVX            (1ULL << 2)
+#define XFEATURE_SUPPORTED      (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX)
+
+// Save Area Geometry
+#define FPU_STATE_ALIGN         64      // XSAVE requires 64-byte alignment
+#define FPU_FXSAVE_SIZE         512     // Legacy FXSAVE area size
+
+// Save Instruction in Use
+typedef enum {
+    FPU_SAVE_FXSAVE = 0,        // SSE only, no XSAVE support
+    FPU_SAVE_XSAVE,             // XSAVE/XRSTOR
+    FPU_SAVE_XSAVEOPT           // XSAVEOPT/XRSTOR (skips unmodified components)
+} fpu_save_mode_t;
+
+// Per-thread Extended State
+// The save area is allocated on the first FPU instruction the thread
+// executes, so threads that never use the FPU carry no state at all.
+struct fpu {
+    void *state;                // Aligned save area, NULL until first use
+    void *allocation;           // Unaligned allocation backing the save area
+    bool used;                  // Thread has executed an FPU instruction
+};
+
+// FPU Statistics
+struct fpu_stats {
+    uint64_t traps;             // Device-not-available exceptions taken
+    uint64_t saves;             // State saves into a save area
+    uint64_t restores;          // State restores from a save area
+    uint64_t switches_skipped;  // Switches that needed no FPU work
+};
+
+// FPU Interface
+int fpu_init(void);
+void fpu_init_thread(struct fpu *fpu);
+void fpu_release(struct fpu *fpu);
+void fpu_switch(struct fpu *prev, struct fpu *next);
+uint32_t fpu_state_size(void);
+fpu_save_mode_t fpu_get_save_mode(void);
+const struct fpu_stats* fpu_get_stats(void);
+
+#endif // ARCH_X86_64_FPU_H
@@ -15,6 +15,8 @@
 
 #include "pci.h"
 #include "../../include/kernel.h"
+#include "../../include/rcu.h"
+#include "../../sched/scheduler.h"
 #include "../../arch/x86_64/io.h"
 #include "../../mm/kmalloc.h"
 #include "../../src/string_stubs.h"
@@ -85,6 +87,7 @@ static pci_device_t* pci_create_device(pci_location_t location);
 static void pci_init_device_info(pci_device_t* pci_dev);
 static void pci_probe_bars(pci_device_t* pci_dev);
 static device_type_t pci_class_to_device_type(uint8_t class_code);
+static uint8_t pci_walk_capabilities(pci_device_t* pci_dev, uint8_t pos, uint8_t cap_id);
 
 /**
  * @brief Initialize the PCI bus driver
@@ -113,10 +116,14 @@ void pci_shutdown(void)
         return;
     }
 
-    // Free all PCI devices
+    // Unpublish the list and free it once lookups are done with it
     pci_device_t* device = pci_manager.device_list;
+    rcu_assign_pointer(pci_manager.device_list, NULL);
+    synchronize_rcu();
+
     while (device) {
         pci_device_t* next = device->next;
+        pci_free_irq_vectors(device);
         kfree(device);
         device = next;
     }
@@ -174,6 +181,9 @@ uint32_t pci_enumerate_devices(void)
                 }
             }
         }
+
+        // A full scan takes thousands of config cycles; let waiting threads run
+        cond_resched();
     }
 
     uint32_t enumeration_time = get_system_time_ms() - start_time;
@@ -313,15 +323,16 @@ pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id)
         return NULL;
     }
 
-    pci_device_t* device = pci_manager.device_list;
+    // The caller's read-side section keeps the device from being freed
+    pci_device_t* device = rcu_dereference(pci_manager.device_list);
     while (device) {
         if (device->config.vendor_id == vendor_id && device->config.device_id == device_id) {
-            return device;
+            break;
         }
-        device = device->next;
+        device = rcu_dereference(device->next);
     }
 
-    return NULL;
+    return device;
 }
 
 /**
@@ -334,13 +345,13 @@ uint32_t pci_find_devices_by_class(uint8_t class_code, pci_device_t** devices, u
     }
 
     uint32_t count = 0;
-    pci_device_t* device = pci_manager.device_list;
+    pci_device_t* device = rcu_dereference(pci_manager.device_list);
     
     while (device && count < max_devices) {
         if (device->config.class_code == class_code) {
             devices[count++] = device;
         }
-        device = device->next;
+        device = rcu_dereference(device->next);
     }
 
     return count;
@@ -576,6 +587,11 @@ void pci_dump_device_info(pci_device_t* device)
         kprintf("  Command: 0x%04X\n", device->config.command);
         kprintf("  Status: 0x%04X\n", device->config.status);
         kprintf("  IRQ Line: %u\n", device->config.interrupt_line);
+        if (device->msi_cap || device->msix_cap) {
+            kprintf("  MSI: %s, MSI-X: %s, %u vector(s) in use\n",
+                    device->msi_cap ? "yes" : "no", device->msix_cap ? "yes" : "no",
+                    device->irq_count);
+        }
         
         // Dump BARs
         for (int i = 0; i < 6; i++) {
@@ -605,6 +621,35 @@ void pci_dump_device_info(pci_device_t* device)
     }
 }
 
+/**
+ * @brief Find a capability in the device's capability list
+ */
+uint8_t pci_find_capability(pci_device_t* device, uint8_t cap_id)
+{
+    if (!device || !(device->config.status & PCI_STATUS_CAP_LIST)) {
+        return 0;
+    }
+
+    // CardBus bridges keep the pointer elsewhere and are not walked
+    if ((device->config.header_type & ~PCI_HEADER_TYPE_MULTIFUNCTION) == PCI_HEADER_TYPE_CARDBUS) {
+        return 0;
+    }
+
+    return pci_walk_capabilities(device, pci_config_read8(device->location, PCI_CONFIG_CAPABILITIES), cap_id);
+}
+
+/**
+ * @brief Find the next capability with the same ID
+ */
+uint8_t pci_find_next_capability(pci_device_t* device, uint8_t pos, uint8_t cap_id)
+{
+    if (!device || pos < 0x40) {
+        return 0;
+    }
+
+    return pci_walk_capabilities(device, pci_config_read8(device->location, pos + PCI_CAP_LIST_NEXT), cap_id);
+}
+
 /**
  * @brief Enumerate PCI devices with callback
  */
@@ -658,9 +703,14 @@ static int pci_probe_device(pci_location_t location)
     // Probe BARs
     pci_probe_bars(pci_dev);
 
-    // Add to device list
+    // Interrupt and link capabilities used by drivers
+    pci_dev->msi_cap = pci_find_capability(pci_dev, PCI_CAP_ID_MSI);
+    pci_dev->msix_cap = pci_find_capability(pci_dev, PCI_CAP_ID_MSIX);
+    pci_dev->pcie_cap = pci_find_capability(pci_dev, PCI_CAP_ID_PCIE);
+
+    // Publish on the device list (only enumeration adds entries)
     pci_dev->next = pci_manager.device_list;
-    pci_manager.device_list = pci_dev;
+    rcu_assign_pointer(pci_manager.device_list, pci_dev);
 
     // Update statistics
     pci_manager.stats.total_devices++;
@@ -809,6 +859,23 @@ static void pci_probe_bars(pci_device_t* pci_dev)
     }
 }
 
+/**
+ * @brief Follow the capability list from pos to the first cap_id entry
+ */
+static uint8_t pci_walk_capabilities(pci_device_t* pci_dev, uint8_t pos, uint8_t cap_id)
+{
+    // Capabilities live above the standard header; the walk is bounded against cycles
+    for (int ttl = PCI_CAP_MAX_WALK; ttl > 0 && pos >= 0x40; ttl--) {
+        pos &= ~0x3;
+        if (pci_config_read8(pci_dev->location, pos + PCI_CAP_LIST_ID) == cap_id) {
+            return pos;
+        }
+        pos = pci_config_read8(pci_dev->location, pos + PCI_CAP_LIST_NEXT);
+    }
+
+    return 0;
+}
+
 /**
  * @brief Convert PCI class code to device type
  */
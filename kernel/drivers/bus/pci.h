@@ -18,6 +18,7 @@
 
 #include <types.h>
 #include "../device.h"
+#include "../../interrupt/irq.h"
 
 /**
  * @brief PCI Configuration Space Registers
@@ -127,6 +128,105 @@
 #define PCI_BAR_MEMORY_TYPE_64      0x04    /**< 64-bit memory */
 #define PCI_BAR_MEMORY_PREFETCHABLE 0x08    /**< Prefetchable memory */
 
+/**
+ * @brief PCI Capability IDs
+ */
+#define PCI_CAP_ID_PM               0x01    /**< Power Management */
+#define PCI_CAP_ID_MSI              0x05    /**< Message Signaled Interrupts */
+#define PCI_CAP_ID_VNDR             0x09    /**< Vendor specific */
+#define PCI_CAP_ID_PCIE             0x10    /**< PCI Express */
+#define PCI_CAP_ID_MSIX             0x11    /**< MSI-X */
+#define PCI_CAP_LIST_ID             0x00    /**< Capability ID (offset in capability) */
+#define PCI_CAP_LIST_NEXT           0x01    /**< Next capability pointer */
+#define PCI_CAP_MAX_WALK            48      /**< Bound on list length (loops in broken devices) */
+
+/**
+ * @brief MSI capability registers (offsets from the capability)
+ */
+#define PCI_MSI_FLAGS               0x02    /**< Message control */
+#define PCI_MSI_ADDRESS_LO          0x04    /**< Message address, low 32 bits */
+#define PCI_MSI_ADDRESS_HI          0x08    /**< Message address, high 32 bits (64-bit only) */
+#define PCI_MSI_DATA_32             0x08    /**< Message data, 32-bit capability */
+#define PCI_MSI_DATA_64             0x0C    /**< Message data, 64-bit capability */
+#define PCI_MSI_MASK_32             0x0C    /**< Mask bits, 32-bit capability */
+#define PCI_MSI_MASK_64             0x10    /**< Mask bits, 64-bit capability */
+#define PCI_MSI_FLAGS_ENABLE        (1 << 0)    /**< MSI enable */
+#define PCI_MSI_FLAGS_QMASK         0x000E      /**< Multiple messages capable */
+#define PCI_MSI_FLAGS_QSIZE         0x0070      /**< Multiple messages enabled */
+#define PCI_MSI_FLAGS_64BIT         (1 << 7)    /**< 64-bit addresses */
+#define PCI_MSI_FLAGS_MASKBIT       (1 << 8)    /**< Per-vector masking */
+
+/**
+ * @brief MSI-X capability registers (offsets from the capability)
+ */
+#define PCI_MSIX_FLAGS              0x02    /**< Message control */
+#define PCI_MSIX_TABLE              0x04    /**< Table offset and BAR indicator */
+#define PCI_MSIX_PBA                0x08    /**< Pending bit array offset and BAR indicator */
+#define PCI_MSIX_FLAGS_QSIZE        0x07FF      /**< Table size - 1 */
+#define PCI_MSIX_FLAGS_MASKALL      (1 << 14)   /**< Function mask */
+#define PCI_MSIX_FLAGS_ENABLE       (1 << 15)   /**< MSI-X enable */
+#define PCI_MSIX_BIR_MASK           0x7         /**< BAR indicator */
+#define PCI_MSIX_ENTRY_SIZE         16          /**< Bytes per table entry */
+#define PCI_MSIX_ENTRY_ADDR_LO      0x00
+#define PCI_MSIX_ENTRY_ADDR_HI      0x04
+#define PCI_MSIX_ENTRY_DATA         0x08
+#define PCI_MSIX_ENTRY_CTRL         0x0C
+#define PCI_MSIX_ENTRY_CTRL_MASKBIT (1 << 0)
+
+/**
+ * @brief x86 MSI message format
+ */
+#define PCI_MSI_ADDRESS_BASE        0xFEE00000U /**< Local APIC interrupt window */
+#define PCI_MSI_ADDRESS_DEST_SHIFT  12          /**< Destination APIC ID field */
+#define PCI_MSI_MAX_DEST_ID         0xFF        /**< 8-bit IDs without interrupt remapping */
+
+/**
+ * @brief pci_alloc_irq_vectors() flags
+ */
+#define PCI_IRQ_LEGACY              (1 << 0)    /**< Allow the INTx line */
+#define PCI_IRQ_MSI                 (1 << 1)    /**< Allow MSI */
+#define PCI_IRQ_MSIX                (1 << 2)    /**< Allow MSI-X */
+#define PCI_IRQ_ALL_TYPES           (PCI_IRQ_LEGACY | PCI_IRQ_MSI | PCI_IRQ_MSIX)
+
+/**
+ * @brief Interrupt delivery mode of a device
+ */
+typedef enum {
+    PCI_IRQ_MODE_NONE = 0,          /**< No vectors allocated */
+    PCI_IRQ_MODE_LEGACY,            /**< INTx through the PIC or I/O APIC */
+    PCI_IRQ_MODE_MSI,               /**< Single MSI message */
+    PCI_IRQ_MODE_MSIX               /**< One MSI-X table entry per vector */
+} pci_irq_mode_t;
+
+struct pci_device;
+
+/**
+ * @brief Per-vector device interrupt handler
+ * 
+ * @param device Device that raised the interrupt
+ * @param index Vector index (e.g. the queue number)
+ * @param data Argument given to pci_request_irq()
+ * @return IRQ_NONE if the device did not interrupt (shared INTx),
+ *         IRQ_HANDLED, or IRQ_WAKE_THREAD to run the thread function
+ */
+typedef irqreturn_t (*pci_irq_handler_t)(struct pci_device* device, uint32_t index, void* data);
+
+/**
+ * @brief Per-vector interrupt state
+ */
+typedef struct {
+    uint8_t             vector;         /**< IDT vector */
+    uint32_t            cpu;            /**< Target CPU */
+    struct pci_device*  device;         /**< Owning device */
+    uint32_t            index;          /**< Index within the device */
+    pci_irq_handler_t   handler;        /**< Primary handler, NULL if only threaded */
+    pci_irq_handler_t   thread_fn;      /**< Thread function, NULL if none */
+    void*               data;           /**< Handler argument */
+    bool                requested;      /**< Handlers attached */
+    bool                masked;         /**< Masked at the device */
+    uint64_t            count;          /**< Interrupts delivered */
+} pci_irq_vector_t;
+
 /**
  * @brief PCI device location structure
  */
@@ -174,6 +274,13 @@ typedef struct pci_device {
     uint32_t            bar_sizes[6];   /**< BAR sizes */
     bool                bar_is_io[6];   /**< BAR type (I/O or memory) */
     bool                bar_is_64bit[6]; /**< 64-bit BAR flag */
+    uint8_t             msi_cap;        /**< MSI capability offset, 0 if absent */
+    uint8_t             msix_cap;       /**< MSI-X capability offset, 0 if absent */
+    uint8_t             pcie_cap;       /**< PCI Express capability offset, 0 if absent */
+    pci_irq_mode_t      irq_mode;       /**< Interrupt delivery in use */
+    uint32_t            irq_count;      /**< Vectors allocated */
+    pci_irq_vector_t*   irq_vectors;    /**< Per-vector state */
+    volatile uint8_t*   msix_table;     /**< Mapped MSI-X table */
     struct pci_device*  next;           /**< Next PCI device */
 } pci_device_t;
 
@@ -290,6 +397,9 @@ void pci_config_write32(pci_location_t location, uint8_t offset, uint32_t value)
 /**
  * @brief Find PCI device by vendor and device ID
  * 
+ * The caller must hold rcu_read_lock() from the call until it is done
+ * with the device; removal frees it once readers are gone.
+ * 
  * @param vendor_id Vendor ID
  * @param device_id Device ID
  * @return Pointer to PCI device structure, NULL if not found
@@ -299,6 +409,9 @@ pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id);
 /**
  * @brief Find PCI devices by class code
  * 
+ * The caller must hold rcu_read_lock() while it uses the returned
+ * pointers, as for pci_find_device().
+ * 
  * @param class_code Class code to search for
  * @param devices Array to store device pointers
  * @param max_devices Maximum number of devices to return
@@ -417,6 +530,105 @@ const char* pci_get_vendor_name(uint16_t vendor_id);
  */
 void pci_dump_device_info(pci_device_t* device);
 
+/**
+ * @brief Find a capability in the device's capability list
+ * 
+ * @param device Pointer to PCI device
+ * @param cap_id Capability ID (PCI_CAP_ID_*)
+ * @return Configuration space offset of the capability, 0 if absent
+ */
+uint8_t pci_find_capability(pci_device_t* device, uint8_t cap_id);
+
+/**
+ * @brief Find the next capability with the same ID
+ * 
+ * @param device Pointer to PCI device
+ * @param pos Offset of the previous match
+ * @param cap_id Capability ID (PCI_CAP_ID_*)
+ * @return Configuration space offset of the capability, 0 if none follows
+ */
+uint8_t pci_find_next_capability(pci_device_t* device, uint8_t pos, uint8_t cap_id);
+
+/**
+ * @brief Allocate interrupt vectors for a device
+ * 
+ * Tries MSI-X, then MSI, then the INTx line, as allowed by flags. MSI-X
+ * gets one IDT vector per table entry, spread round-robin over the online
+ * CPUs; MSI and INTx get a single vector. Vectors are masked until a
+ * handler is attached with pci_request_irq().
+ * 
+ * @param device Pointer to PCI device
+ * @param min_vecs Fewest vectors acceptable
+ * @param max_vecs Most vectors wanted
+ * @param flags PCI_IRQ_* delivery types allowed
+ * @return Number of vectors allocated, negative error code on failure
+ */
+int pci_alloc_irq_vectors(pci_device_t* device, uint32_t min_vecs, uint32_t max_vecs, uint32_t flags);
+
+/**
+ * @brief Release all interrupt vectors of a device
+ * 
+ * @param device Pointer to PCI device
+ */
+void pci_free_irq_vectors(pci_device_t* device);
+
+/**
+ * @brief Get the IDT vector behind a vector index
+ * 
+ * @param device Pointer to PCI device
+ * @param index Vector index
+ * @return IDT vector, negative error code if not allocated
+ */
+int pci_irq_vector(pci_device_t* device, uint32_t index);
+
+/**
+ * @brief Attach a handler to a vector and unmask it
+ * 
+ * @param device Pointer to PCI device
+ * @param index Vector index
+ * @param handler Handler function
+ * @param data Handler argument
+ * @return 0 on success, negative error code on failure
+ */
+int pci_request_irq(pci_device_t* device, uint32_t index, pci_irq_handler_t handler, void* data);
+
+/**
+ * @brief Attach a primary handler and a thread function to a vector
+ * 
+ * See request_threaded_irq(). An INTx line is requested shared, so the
+ * primary handler must return IRQ_NONE when its device did not interrupt.
+ * 
+ * @param device Pointer to PCI device
+ * @param index Vector index
+ * @param handler Primary handler, NULL to only run thread_fn (line masked meanwhile)
+ * @param thread_fn Thread function, NULL for none
+ * @param data Handler argument
+ * @return 0 on success, negative error code on failure
+ */
+int pci_request_threaded_irq(pci_device_t* device, uint32_t index, pci_irq_handler_t handler,
+                             pci_irq_handler_t thread_fn, void* data);
+
+/**
+ * @brief Mask a vector and detach its handler
+ * 
+ * @param device Pointer to PCI device
+ * @param index Vector index
+ */
+void pci_free_irq(pci_device_t* device, uint32_t index);
+
+/**
+ * @brief Deliver a vector to another CPU
+ * 
+ * Rewrites the message address of an MSI or MSI-X vector and pins it
+ * there; the INTx line stays where the I/O APIC routes it.
+ * 
+ * @param device Pointer to PCI device
+ * @param index Vector index
+ * @param cpu Target CPU (must be online)
+ * @return 0 on success, negative error code on failure
+ */
+int pci_irq_set_affinity(pci_device_t* device, uint32_t index, uint32_t cpu);
+
 /**
  * @brief Enumerate PCI devices with callback
  * 
@@ -0,0 +1,590 @@
+/**
+ * @file pci_msi.c
+ * @brief PCI MSI/MSI-X interrupt support for FG-OS
+ *
+ * Gives devices their own IDT vectors instead of a shared INTx line. With
+ * MSI-X every table entry (typically one per queue) gets a vector and its
+ * own destination CPU, so completions can be taken on the CPU that
+ * submitted the work without demultiplexing a shared line. Plain MSI is
+ * limited to a single message here: multiple MSI messages must share one
+ * destination and an aligned vector block, which defeats per-queue
+ * affinity.
+ *
+ * Vectors are requested through the IRQ layer with the pci_irq_vector_t
+ * as the cookie, so INTx lines can be shared and handlers threaded. A
+ * message vector's chip masks it at the device and acknowledges the local
+ * APIC. Destinations use 8-bit physical APIC IDs as the I/O APIC does.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "pci.h"
+#include "../../include/kernel.h"
+#include "../../interrupt/apic.h"
+#include "../../interrupt/idt.h"
+#include "../../interrupt/interrupt.h"
+#include "../../mm/memory.h"
+#include "../../sched/topology.h"
+
+// Internal function declarations
+static int pci_msix_enable(pci_device_t* device, uint32_t nvec);
+static int pci_msi_enable(pci_device_t* device);
+static int pci_legacy_enable(pci_device_t* device);
+static int pci_irq_alloc_state(pci_device_t* device, uint32_t nvec);
+static int pci_msi_compose(uint32_t cpu, uint8_t vector, uint64_t* address, uint32_t* data);
+static void pci_msi_write_msg(pci_device_t* device, uint32_t index, uint64_t address, uint32_t data);
+static void pci_msi_set_masked(pci_device_t* device, uint32_t index, bool masked);
+static uint32_t pci_msi_spread_cpu(uint32_t index);
+static int pci_msi_retarget(pci_irq_vector_t* vec, uint32_t cpu);
+static irqreturn_t pci_irq_primary(uint32_t irq, void* dev_id);
+static irqreturn_t pci_irq_thread(uint32_t irq, void* dev_id);
+static void pci_msi_chip_mask(uint32_t irq, void* chip_data);
+static void pci_msi_chip_unmask(uint32_t irq, void* chip_data);
+static void pci_msi_chip_eoi(uint32_t irq, void* chip_data);
+static int pci_msi_chip_set_affinity(uint32_t irq, void* chip_data, uint32_t cpu);
+
+/**
+ * @brief Message vectors: masked at the device, acknowledged at the local APIC
+ */
+static const irq_chip_t pci_msi_chip = {
+    .name = "PCI-MSI",
+    .mask = pci_msi_chip_mask,
+    .unmask = pci_msi_chip_unmask,
+    .eoi = pci_msi_chip_eoi,
+    .set_affinity = pci_msi_chip_set_affinity,
+};
+
+/**
+ * @brief Allocate interrupt vectors for a device
+ */
+int pci_alloc_irq_vectors(pci_device_t* device, uint32_t min_vecs, uint32_t max_vecs, uint32_t flags)
+{
+    if (!device || min_vecs == 0 || max_vecs < min_vecs) {
+        return KERN_INVALID;
+    }
+    if (device->irq_mode != PCI_IRQ_MODE_NONE) {
+        return KERN_BUSY;
+    }
+
+    // Message signaled interrupts target local APICs directly
+    if (apic_is_enabled()) {
+        if ((flags & PCI_IRQ_MSIX) && device->msix_cap) {
+            uint16_t control = pci_config_read16(device->location, device->msix_cap + PCI_MSIX_FLAGS);
+            uint32_t table_size = (control & PCI_MSIX_FLAGS_QSIZE) + 1;
+            uint32_t nvec = max_vecs < table_size ? max_vecs : table_size;
+
+            if (nvec >= min_vecs && pci_msix_enable(device, nvec) == 0) {
+                return (int)device->irq_count;
+            }
+        }
+
+        if ((flags & PCI_IRQ_MSI) && device->msi_cap && min_vecs == 1 && pci_msi_enable(device) == 0) {
+            return 1;
+        }
+    }
+
+    if ((flags & PCI_IRQ_LEGACY) && min_vecs == 1 && pci_legacy_enable(device) == 0) {
+        return 1;
+    }
+
+    return KERN_NOTFOUND;
+}
+
+/**
+ * @brief Release all interrupt vectors of a device
+ */
+void pci_free_irq_vectors(pci_device_t* device)
+{
+    if (!device || device->irq_mode == PCI_IRQ_MODE_NONE) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < device->irq_count; i++) {
+        pci_free_irq(device, i);
+    }
+
+    switch (device->irq_mode) {
+        case PCI_IRQ_MODE_MSIX: {
+            uint16_t control = pci_config_read16(device->location, device->msix_cap + PCI_MSIX_FLAGS);
+            control &= ~(PCI_MSIX_FLAGS_ENABLE | PCI_MSIX_FLAGS_MASKALL);
+            pci_config_write16(device->location, device->msix_cap + PCI_MSIX_FLAGS, control);
+            break;
+        }
+        case PCI_IRQ_MODE_MSI: {
+            uint16_t control = pci_config_read16(device->location, device->msi_cap + PCI_MSI_FLAGS);
+            control &= ~PCI_MSI_FLAGS_ENABLE;
+            pci_config_write16(device->location, device->msi_cap + PCI_MSI_FLAGS, control);
+            break;
+        }
+        default:
+            break;
+    }
+
+    // INTx was disabled while messages were in use
+    uint16_t command = pci_config_read16(device->location, PCI_CONFIG_COMMAND);
+    command &= ~PCI_COMMAND_INTX_DISABLE;
+    pci_config_write16(device->location, PCI_CONFIG_COMMAND, command);
+    device->config.command = command;
+
+    // The INTx line may still serve other devices; its IDT slot went with
+    // the last free_irq()
+    for (uint32_t i = 0; i < device->irq_count && device->irq_mode != PCI_IRQ_MODE_LEGACY; i++) {
+        uint8_t vector = device->irq_vectors[i].vector;
+        irq_set_chip(vector, NULL, NULL);
+        idt_free_vector(vector);
+    }
+
+    kfree(device->irq_vectors);
+    device->irq_vectors = NULL;
+    device->irq_count = 0;
+    device->msix_table = NULL;
+    device->irq_mode = PCI_IRQ_MODE_NONE;
+}
+
+/**
+ * @brief Get the IDT vector behind a vector index
+ */
+int pci_irq_vector(pci_device_t* device, uint32_t index)
+{
+    if (!device || index >= device->irq_count) {
+        return KERN_INVALID;
+    }
+
+    return device->irq_vectors[index].vector;
+}
+
+/**
+ * @brief Attach a handler to a vector and unmask it
+ */
+int pci_request_irq(pci_device_t* device, uint32_t index, pci_irq_handler_t handler, void* data)
+{
+    if (!handler) {
+        return KERN_INVALID;
+    }
+
+    return pci_request_threaded_irq(device, index, handler, NULL, data);
+}
+
+/**
+ * @brief Attach a primary handler and a thread function to a vector
+ */
+int pci_request_threaded_irq(pci_device_t* device, uint32_t index, pci_irq_handler_t handler,
+                             pci_irq_handler_t thread_fn, void* data)
+{
+    if (!device || (!handler && !thread_fn) || index >= device->irq_count) {
+        return KERN_INVALID;
+    }
+
+    pci_irq_vector_t* vec = &device->irq_vectors[index];
+    if (vec->requested) {
+        return KERN_BUSY;
+    }
+
+    vec->handler = handler;
+    vec->thread_fn = thread_fn;
+    vec->data = data;
+
+    uint32_t flags = handler ? 0 : IRQF_ONESHOT;
+    if (device->irq_mode == PCI_IRQ_MODE_LEGACY) {
+        flags |= IRQF_SHARED;
+    }
+
+    // The IRQ layer unmasks the vector through its chip once attached
+    int result = request_threaded_irq(vec->vector, pci_irq_primary, thread_fn ? pci_irq_thread : NULL,
+                                      flags, device->device.info.name, vec);
+    if (result != 0) {
+        vec->handler = NULL;
+        vec->thread_fn = NULL;
+        vec->data = NULL;
+        return result;
+    }
+
+    vec->requested = true;
+    return 0;
+}
+
+/**
+ * @brief Mask a vector and detach its handler
+ */
+void pci_free_irq(pci_device_t* device, uint32_t index)
+{
+    if (!device || index >= device->irq_count || !device->irq_vectors[index].requested) {
+        return;
+    }
+
+    pci_irq_vector_t* vec = &device->irq_vectors[index];
+
+    // Waits for running handlers; masks the vector unless the line is shared
+    free_irq(vec->vector, vec);
+
+    vec->requested = false;
+    vec->handler = NULL;
+    vec->thread_fn = NULL;
+    vec->data = NULL;
+}
+
+/**
+ * @brief Deliver a vector to another CPU
+ */
+int pci_irq_set_affinity(pci_device_t* device, uint32_t index, uint32_t cpu)
+{
+    if (!device || index >= device->irq_count) {
+        return KERN_INVALID;
+    }
+    if (device->irq_mode != PCI_IRQ_MODE_MSI && device->irq_mode != PCI_IRQ_MODE_MSIX) {
+        return KERN_INVALID;
+    }
+
+    // Pinning it also keeps the balancer from moving it again
+    return irq_set_affinity(device->irq_vectors[index].vector, CPU_MASK_CPU(cpu));
+}
+
+// Internal functions
+
+/**
+ * @brief Switch a device to MSI-X with nvec table entries
+ */
+static int pci_msix_enable(pci_device_t* device, uint32_t nvec)
+{
+    pci_location_t loc = device->location;
+    uint8_t cap = device->msix_cap;
+
+    uint32_t table = pci_config_read32(loc, cap + PCI_MSIX_TABLE);
+    uint8_t bir = table & PCI_MSIX_BIR_MASK;
+    if (bir >= 6 || device->bar_is_io[bir]) {
+        return KERN_NOTFOUND;
+    }
+
+    uint64_t bar = pci_get_bar_address(device, bir);
+    uint64_t table_phys = bar + (table & ~PCI_MSIX_BIR_MASK);
+    if (bar == 0) {
+        return KERN_NOTFOUND;
+    }
+
+    // The table is device MMIO: map every page it spans uncached
+    uint64_t first = table_phys & ~(PAGE_SIZE - 1);
+    uint64_t last = (table_phys + nvec * PCI_MSIX_ENTRY_SIZE - 1) & ~(PAGE_SIZE - 1);
+    for (uint64_t page = first; page <= last; page += PAGE_SIZE) {
+        if (vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE | PTE_WRITE_THROUGH) != 0) {
+            return KERN_NOMEM;
+        }
+    }
+
+    int result = pci_irq_alloc_state(device, nvec);
+    if (result != 0) {
+        return result;
+    }
+    device->msix_table = (volatile uint8_t*)(uintptr_t)table_phys;
+    device->irq_mode = PCI_IRQ_MODE_MSIX;
+
+    // Entries are programmed with the whole function masked, then each stays masked until requested
+    uint16_t control = pci_config_read16(loc, cap + PCI_MSIX_FLAGS);
+    pci_config_write16(loc, cap + PCI_MSIX_FLAGS, control | PCI_MSIX_FLAGS_ENABLE | PCI_MSIX_FLAGS_MASKALL);
+
+    for (uint32_t i = 0; i < nvec; i++) {
+        pci_irq_vector_t* vec = &device->irq_vectors[i];
+        uint64_t address;
+        uint32_t data;
+
+        pci_msi_set_masked(device, i, true);
+        pci_msi_compose(vec->cpu, vec->vector, &address, &data);
+        pci_msi_write_msg(device, i, address, data);
+    }
+
+    pci_config_write16(loc, cap + PCI_MSIX_FLAGS, (control | PCI_MSIX_FLAGS_ENABLE) & ~PCI_MSIX_FLAGS_MASKALL);
+
+    // Messages replace the INTx line entirely
+    uint16_t command = pci_config_read16(loc, PCI_CONFIG_COMMAND) | PCI_COMMAND_INTX_DISABLE;
+    pci_config_write16(loc, PCI_CONFIG_COMMAND, command);
+    device->config.command = command;
+
+    printf("[INFO] PCI device %02x:%02x.%x: MSI-X with %u vector(s)\n",
+            loc.bus, loc.device, loc.function, nvec);
+    return 0;
+}
+
+/**
+ * @brief Switch a device to a single MSI message
+ */
+static int pci_msi_enable(pci_device_t* device)
+{
+    pci_location_t loc = device->location;
+    uint8_t cap = device->msi_cap;
+
+    int result = pci_irq_alloc_state(device, 1);
+    if (result != 0) {
+        return result;
+    }
+    device->irq_mode = PCI_IRQ_MODE_MSI;
+
+    uint16_t control = pci_config_read16(loc, cap + PCI_MSI_FLAGS);
+    control &= ~(PCI_MSI_FLAGS_QSIZE | PCI_MSI_FLAGS_ENABLE);   // One message
+
+    uint64_t address;
+    uint32_t data;
+    pci_msi_compose(device->irq_vectors[0].cpu, device->irq_vectors[0].vector, &address, &data);
+    pci_msi_set_masked(device, 0, true);
+    pci_msi_write_msg(device, 0, address, data);
+
+    pci_config_write16(loc, cap + PCI_MSI_FLAGS, control | PCI_MSI_FLAGS_ENABLE);
+
+    uint16_t command = pci_config_read16(loc, PCI_CONFIG_COMMAND) | PCI_COMMAND_INTX_DISABLE;
+    pci_config_write16(loc, PCI_CONFIG_COMMAND, command);
+    device->config.command = command;
+
+    printf("[INFO] PCI device %02x:%02x.%x: MSI on vector 0x%02X\n",
+            loc.bus, loc.device, loc.function, device->irq_vectors[0].vector);
+    return 0;
+}
+
+/**
+ * @brief Use the device's INTx line as its only vector
+ */
+static int pci_legacy_enable(pci_device_t* device)
+{
+    uint8_t line = device->config.interrupt_line;
+    if (device->config.interrupt_pin == 0 || line >= 16) {
+        return KERN_NOTFOUND;
+    }
+
+    uint8_t vector = ISA_IRQ_VECTOR(line);
+
+    device->irq_vectors = kmalloc(sizeof(pci_irq_vector_t));
+    if (!device->irq_vectors) {
+        return KERN_NOMEM;
+    }
+    memset(device->irq_vectors, 0, sizeof(pci_irq_vector_t));
+    device->irq_vectors[0].vector = vector;
+    device->irq_vectors[0].device = device;
+    device->irq_count = 1;
+    device->irq_mode = PCI_IRQ_MODE_LEGACY;
+
+    // Other devices on the line are found through the shared IRQ chain
+    return 0;
+}
+
+/**
+ * @brief Allocate per-vector state and IDT vectors for message interrupts
+ */
+static int pci_irq_alloc_state(pci_device_t* device, uint32_t nvec)
+{
+    pci_irq_vector_t* vectors = kmalloc(nvec * sizeof(pci_irq_vector_t));
+    if (!vectors) {
+        return KERN_NOMEM;
+    }
+    memset(vectors, 0, nvec * sizeof(pci_irq_vector_t));
+
+    for (uint32_t i = 0; i < nvec; i++) {
+        int vector = idt_alloc_vector();
+        if (vector < 0) {
+            while (i-- > 0) {
+                idt_free_vector(vectors[i].vector);
+            }
+            kfree(vectors);
+            return KERN_NOMEM;
+        }
+        vectors[i].vector = (uint8_t)vector;
+        vectors[i].cpu = pci_msi_spread_cpu(i);
+        vectors[i].device = device;
+        vectors[i].index = i;
+        vectors[i].masked = true;
+        irq_set_chip(vectors[i].vector, &pci_msi_chip, &vectors[i]);
+
+        // Queues of a multi-vector device stay on the CPU they were spread
+        // to, so each queue's completions are handled where it is used
+        cpumask_t affinity = nvec > 1 ? CPU_MASK_CPU(vectors[i].cpu) : CPU_MASK_ALL;
+        irq_set_effective_affinity(vectors[i].vector, affinity, vectors[i].cpu);
+    }
+
+    device->irq_vectors = vectors;
+    device->irq_count = nvec;
+    return 0;
+}
+
+/**
+ * @brief Build the x86 MSI message for a vector on a CPU
+ */
+static int pci_msi_compose(uint32_t cpu, uint8_t vector, uint64_t* address, uint32_t* data)
+{
+    if (!cpumask_test_cpu(cpu, cpu_online_mask)) {
+        return KERN_INVALID;
+    }
+
+    uint32_t apic_id = cpu_get_topology(cpu)->apic_id;
+    if (apic_id > PCI_MSI_MAX_DEST_ID) {
+        return KERN_INVALID;
+    }
+
+    // Physical destination, fixed delivery, edge triggered
+    *address = PCI_MSI_ADDRESS_BASE | (apic_id << PCI_MSI_ADDRESS_DEST_SHIFT);
+    *data = vector;
+    return 0;
+}
+
+/**
+ * @brief Write a message to an MSI capability or MSI-X table entry
+ */
+static void pci_msi_write_msg(pci_device_t* device, uint32_t index, uint64_t address, uint32_t data)
+{
+    if (device->irq_mode == PCI_IRQ_MODE_MSIX) {
+        volatile uint32_t* entry = (volatile uint32_t*)(device->msix_table + index * PCI_MSIX_ENTRY_SIZE);
+        entry[PCI_MSIX_ENTRY_ADDR_LO / 4] = (uint32_t)address;
+        entry[PCI_MSIX_ENTRY_ADDR_HI / 4] = (uint32_t)(address >> 32);
+        entry[PCI_MSIX_ENTRY_DATA / 4] = data;
+        return;
+    }
+
+    pci_location_t loc = device->location;
+    uint8_t cap = device->msi_cap;
+    uint16_t control = pci_config_read16(loc, cap + PCI_MSI_FLAGS);
+
+    pci_config_write32(loc, cap + PCI_MSI_ADDRESS_LO, (uint32_t)address);
+    if (control & PCI_MSI_FLAGS_64BIT) {
+        pci_config_write32(loc, cap + PCI_MSI_ADDRESS_HI, (uint32_t)(address >> 32));
+        pci_config_write16(loc, cap + PCI_MSI_DATA_64, (uint16_t)data);
+    } else {
+        pci_config_write16(loc, cap + PCI_MSI_DATA_32, (uint16_t)data);
+    }
+}
+
+/**
+ * @brief Mask or unmask one message vector
+ *
+ * MSI without per-vector masking cannot be masked at the device; its
+ * handler is simply not attached until requested.
+ */
+static void pci_msi_set_masked(pci_device_t* device, uint32_t index, bool masked)
+{
+    if (device->irq_mode == PCI_IRQ_MODE_MSIX) {
+        volatile uint32_t* ctrl = (volatile uint32_t*)(device->msix_table + index * PCI_MSIX_ENTRY_SIZE +
+                                                        PCI_MSIX_ENTRY_CTRL);
+        uint32_t value = *ctrl;
+        *ctrl = masked ? (value | PCI_MSIX_ENTRY_CTRL_MASKBIT) : (value & ~PCI_MSIX_ENTRY_CTRL_MASKBIT);
+        (void)*ctrl;    // Flush the posted write before returning
+        return;
+    }
+
+    pci_location_t loc = device->location;
+    uint8_t cap = device->msi_cap;
+    uint16_t control = pci_config_read16(loc, cap + PCI_MSI_FLAGS);
+    if (!(control & PCI_MSI_FLAGS_MASKBIT)) {
+        return;
+    }
+
+    uint8_t mask_reg = cap + ((control & PCI_MSI_FLAGS_64BIT) ? PCI_MSI_MASK_64 : PCI_MSI_MASK_32);
+    uint32_t mask = pci_config_read32(loc, mask_reg);
+    mask = masked ? (mask | (1U << index)) : (mask & ~(1U << index));
+    pci_config_write32(loc, mask_reg, mask);
+}
+
+/**
+ * @brief Default CPU for a vector index: round-robin over online CPUs
+ */
+static uint32_t pci_msi_spread_cpu(uint32_t index)
+{
+    cpumask_t online = cpu_online_mask;
+    uint32_t weight = cpumask_weight(online);
+    if (weight == 0) {
+        return 0;
+    }
+
+    uint32_t skip = index % weight;
+    uint32_t cpu = cpumask_first(online);
+    while (skip-- > 0) {
+        online &= ~CPU_MASK_CPU(cpu);
+        cpu = cpumask_first(online);
+    }
+    return cpu;
+}
+
+/**
+ * @brief Rewrite a vector's message for another CPU
+ */
+static int pci_msi_retarget(pci_irq_vector_t* vec, uint32_t cpu)
+{
+    uint64_t address;
+    uint32_t data;
+    int result = pci_msi_compose(cpu, vec->vector, &address, &data);
+    if (result != 0) {
+        return result;
+    }
+
+    // The message must not be sent while half of it is rewritten
+    pci_msi_set_masked(vec->device, vec->index, true);
+    pci_msi_write_msg(vec->device, vec->index, address, data);
+    vec->cpu = cpu;
+    if (!vec->masked) {
+        pci_msi_set_masked(vec->device, vec->index, false);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Primary handler of every requested PCI vector
+ */
+static irqreturn_t pci_irq_primary(uint32_t irq, void* dev_id)
+{
+    (void)irq;
+    pci_irq_vector_t* vec = (pci_irq_vector_t*)dev_id;
+
+    irqreturn_t ret = vec->handler ? vec->handler(vec->device, vec->index, vec->data) : IRQ_WAKE_THREAD;
+    if (ret != IRQ_NONE) {
+        vec->count++;
+    }
+    return ret;
+}
+
+/**
+ * @brief Thread function of a threaded PCI vector
+ */
+static irqreturn_t pci_irq_thread(uint32_t irq, void* dev_id)
+{
+    (void)irq;
+    pci_irq_vector_t* vec = (pci_irq_vector_t*)dev_id;
+    return vec->thread_fn(vec->device, vec->index, vec->data);
+}
+
+/**
+ * @brief Mask a message vector at the device
+ */
+static void pci_msi_chip_mask(uint32_t irq, void* chip_data)
+{
+    (void)irq;
+    pci_irq_vector_t* vec = (pci_irq_vector_t*)chip_data;
+    vec->masked = true;
+    pci_msi_set_masked(vec->device, vec->index, true);
+}
+
+/**
+ * @brief Unmask a message vector at the device
+ */
+static void pci_msi_chip_unmask(uint32_t irq, void* chip_data)
+{
+    (void)irq;
+    pci_irq_vector_t* vec = (pci_irq_vector_t*)chip_data;
+    vec->masked = false;
+    pci_msi_set_masked(vec->device, vec->index, false);
+}
+
+/**
+ * @brief Acknowledge a message vector
+ */
+static void pci_msi_chip_eoi(uint32_t irq, void* chip_data)
+{
+    (void)irq; (void)chip_data;
+    apic_eoi();
+}
+
+/**
+ * @brief Move a message vector to another CPU
+ */
+static int pci_msi_chip_set_affinity(uint32_t irq, void* chip_data, uint32_t cpu)
+{
+    (void)irq;
+    return pci_msi_retarget((pci_irq_vector_t*)chip_data, cpu);
+}
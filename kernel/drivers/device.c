@@ -15,13 +15,16 @@
 
 #include "device.h"
 #include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
 #include "../interrupt/interrupt.h"
 #include "../mm/kmalloc.h"
 #include "../src/string_stubs.h"
 
 // Global device framework state
 static struct {
-    device_t*               device_list;           /**< Global device list */
+    device_t*               device_list;           /**< Global device list (RCU) */
+    spinlock_t              device_list_lock;      /**< Serializes device list updates */
     device_driver_t*        driver_list;           /**< Global driver list */
     device_manager_stats_t  stats;                 /**< Manager statistics */
     uint32_t                next_device_id;        /**< Next device ID */
@@ -46,6 +49,7 @@ static void update_device_stats(device_t* device, device_io_request_t* request);
 static void complete_request(device_io_request_t* request, device_io_status_t status);
 static int validate_device(device_t* device);
 static int validate_driver(device_driver_t* driver);
+static void device_irq_tasklet(unsigned long data);
 
 /**
  * @brief Initialize the device driver framework
@@ -58,6 +62,7 @@ int device_init(void)
 
     // Initialize manager state
     memset(&device_manager, 0, sizeof(device_manager));
+    spin_lock_init(&device_manager.device_list_lock);
     device_manager.next_device_id = 1;
     device_manager.next_request_id = 1;
     device_manager.initialized = true;
@@ -201,11 +206,14 @@ int device_register(device_t* device)
 
     // Reset statistics
     memset(&device->stats, 0, sizeof(device_stats_t));
+    tasklet_init(&device->irq_tasklet, device_irq_tasklet, (unsigned long)device);
 
-    // Add to device list
+    // Publish on the device list; lookups walk it without locking
+    uint64_t flags = spin_lock_irqsave(&device_manager.device_list_lock);
     device->next = device_manager.device_list;
-    device_manager.device_list = device;
+    rcu_assign_pointer(device_manager.device_list, device);
     device->registered = true;
+    spin_unlock_irqrestore(&device_manager.device_list_lock, flags);
 
     // Update manager statistics
     device_manager.stats.total_devices++;
@@ -249,11 +257,12 @@ int device_unregister(device_t* device)
         device->driver->reference_count--;
     }
 
-    // Remove from device list
+    // Remove from device list; device->next stays valid for concurrent readers
+    uint64_t flags = spin_lock_irqsave(&device_manager.device_list_lock);
     device_t** current = &device_manager.device_list;
     while (*current) {
         if (*current == device) {
-            *current = device->next;
+            rcu_assign_pointer(*current, device->next);
             device->registered = false;
             device->state = DEVICE_STATE_REMOVED;
             
@@ -266,11 +275,18 @@ int device_unregister(device_t* device)
                 device_manager.stats.failed_devices--;
             }
             
+            spin_unlock_irqrestore(&device_manager.device_list_lock, flags);
+
+            // The caller may free the device once no lookup can still see it
+            synchronize_rcu();
+            tasklet_kill(&device->irq_tasklet);
+
             kprintf(KERN_INFO "Device %u unregistered\n", device->device_id);
             return 0;
         }
         current = &(*current)->next;
     }
+    spin_unlock_irqrestore(&device_manager.device_list_lock, flags);
 
     return -ENOENT;
 }
@@ -284,15 +300,13 @@ device_t* device_find_by_id(uint32_t device_id)
         return NULL;
     }
 
-    device_t* device = device_manager.device_list;
-    while (device) {
-        if (device->device_id == device_id) {
-            return device;
-        }
-        device = device->next;
+    // The caller's read-side section keeps the device from being freed
+    device_t* device = rcu_dereference(device_manager.device_list);
+    while (device && device->device_id != device_id) {
+        device = rcu_dereference(device->next);
     }
 
-    return NULL;
+    return device;
 }
 
 /**
@@ -305,13 +319,13 @@ uint32_t device_find_by_type(device_type_t type, device_t** devices, uint32_t ma
     }
 
     uint32_t count = 0;
-    device_t* device = device_manager.device_list;
+    device_t* device = rcu_dereference(device_manager.device_list);
     
     while (device && count < max_devices) {
         if (device->type == type) {
             devices[count++] = device;
         }
-        device = device->next;
+        device = rcu_dereference(device->next);
     }
 
     return count;
@@ -769,7 +783,8 @@ void device_free_request(device_io_request_t* request)
  */
 void device_process_requests(void)
 {
-    device_t* device = device_manager.device_list;
+    rcu_read_lock();
+    device_t* device = rcu_dereference(device_manager.device_list);
     
     while (device) {
         device_io_request_t** current = &device->request_queue;
@@ -788,8 +803,9 @@ void device_process_requests(void)
             current = &request->next;
         }
         
-        device = device->next;
+        device = rcu_dereference(device->next);
     }
+    rcu_read_unlock();
 }
 
 /**
@@ -804,13 +820,22 @@ void device_handle_interrupt(device_t* device, uint32_t vector)
     device->stats.interrupts_received++;
     device->last_access_time = get_system_time_ms();
 
-    if (device->driver && device->driver->ops.interrupt_handler) {
-        device->driver->ops.interrupt_handler(device, vector);
+    if (!device->driver || !device->driver->ops.interrupt_handler) {
+        return;
     }
+
+    // Defer the driver handler; interrupts before it runs share one call
+    device->irq_vector = vector;
+    if (device->irq_tasklet.state & TASKLET_STATE_SCHED) {
+        device->stats.interrupts_coalesced++;
+    }
+    tasklet_schedule(&device->irq_tasklet);
 }
 
 /**
  * @brief Enumerate all devices
+ *
+ * The callback runs inside an RCU read-side section and must not sleep.
  */
 void device_enumerate(void (*callback)(device_t* device, void* user_data), void* user_data)
 {
@@ -818,11 +843,13 @@ void device_enumerate(void (*callback)(device_t* device, void* user_data), void*
         return;
     }
 
-    device_t* device = device_manager.device_list;
+    rcu_read_lock();
+    device_t* device = rcu_dereference(device_manager.device_list);
     while (device) {
         callback(device, user_data);
-        device = device->next;
+        device = rcu_dereference(device->next);
     }
+    rcu_read_unlock();
 }
 
 /**
@@ -853,11 +880,13 @@ void device_dump_info(device_t* device)
         kprintf("  Total drivers: %u\n", device_manager.stats.total_drivers);
         kprintf("  Total requests: %llu\n", device_manager.stats.total_requests);
         
-        device_t* dev = device_manager.device_list;
+        rcu_read_lock();
+        device_t* dev = rcu_dereference(device_manager.device_list);
         while (dev) {
             device_dump_info(dev);
-            dev = dev->next;
+            dev = rcu_dereference(dev->next);
         }
+        rcu_read_unlock();
     }
 }
 
@@ -1023,4 +1052,16 @@ static int validate_driver(device_driver_t* driver)
     }
 
     return 0;
-} 
\ No newline at end of file
+} 
+
+/**
+ * @brief Device interrupt bottom half
+ */
+static void device_irq_tasklet(unsigned long data)
+{
+    device_t* device = (device_t*)data;
+
+    if (device->registered && device->driver && device->driver->ops.interrupt_handler) {
+        device->driver->ops.interrupt_handler(device, device->irq_vector);
+    }
+}
@@ -18,6 +18,7 @@
 
 #include <types.h>
 #include "../interrupt/interrupt.h"
+#include "../interrupt/softirq.h"
 
 /**
  * @brief Device types
@@ -133,6 +134,7 @@ typedef struct {
     uint64_t    bytes_read;             /**< Total bytes read */
     uint64_t    bytes_written;          /**< Total bytes written */
     uint64_t    interrupts_received;    /**< Interrupts received */
+    uint64_t    interrupts_coalesced;   /**< Interrupts folded into a pending bottom half */
     uint64_t    errors_total;           /**< Total errors */
     uint64_t    uptime_ms;              /**< Device uptime in milliseconds */
     uint32_t    avg_request_time_us;    /**< Average request time (microseconds) */
@@ -226,6 +228,8 @@ typedef struct device {
     void*                   driver_data;        /**< Driver-specific data */
     uint64_t                created_time;       /**< Device creation timestamp */
     uint64_t                last_access_time;   /**< Last access timestamp */
+    tasklet_struct_t        irq_tasklet;        /**< Runs the driver interrupt handler */
+    volatile uint32_t       irq_vector;         /**< Vector of the latest interrupt */
     bool                    registered;         /**< Device registration status */
 } device_t;
 
@@ -303,6 +307,9 @@ int device_unregister(device_t* device);
 /**
  * @brief Find a device by ID
  * 
+ * The caller must hold rcu_read_lock() from the call until it is done
+ * with the device; device_unregister() frees it once readers are gone.
+ * 
  * @param device_id Device ID
  * @return Pointer to device structure, NULL if not found
  */
@@ -311,6 +318,9 @@ device_t* device_find_by_id(uint32_t device_id);
 /**
  * @brief Find devices by type
  * 
+ * The caller must hold rcu_read_lock() while it uses the returned
+ * pointers, as for device_find_by_id().
+ * 
  * @param type Device type
  * @param devices Array to store device pointers
  * @param max_devices Maximum number of devices to return
@@ -485,6 +495,10 @@ void device_process_requests(void);
 /**
  * @brief Handle device interrupt
  * 
+ * Called in hard interrupt context. Only statistics are updated here; the
+ * driver's interrupt handler runs from the device's tasklet, once for all
+ * interrupts that arrived before it got to run.
+ * 
  * @param device Pointer to device structure
  * @param vector Interrupt vector
  */
@@ -17,7 +17,11 @@
 #include "fgfs.h"
 #include "fat32.h"
 #include "ext4.h"
+#include "procfs.h"
+#include "io_uring.h"
 #include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
 #include "../mm/heap.h"
 #include "../hal/hal.h"
 #include <stdint.h>
@@ -30,6 +34,12 @@ fs_manager_t fs_manager = {0};
 // Registered file systems
 static fs_operations_t *registered_fs[FS_TYPE_DEVFS + 1] = {0};
 
+// Serializes mount list updates; path lookups walk the list under RCU
+static spinlock_t mount_lock = {0};
+
+// Protects fs_manager.open_files, next_fd and the ref_count of installed files
+static spinlock_t fd_lock = {0};
+
 /**
  * @brief Initialize the file system subsystem
  * 
@@ -72,14 +82,22 @@ int fs_init(void) {
     fs_manager.next_fd = 3; // Reserve 0, 1, 2 for stdin, stdout, stderr
     fs_manager.mounted_count = 0;
     fs_manager.mount_points = NULL;
+    spin_lock_init(&mount_lock);
+    spin_lock_init(&fd_lock);
     
     // Register built-in file systems
     fgfs_init();
     fat32_init();
     ext4_init();
+    procfs_init();
     
     fs_manager.initialized = true;
     
+    // Kernel status files are always available
+    fs_mount("proc", PROC_MOUNT_POINT, FS_TYPE_PROCFS, MOUNT_READ_ONLY);
+    
+    io_uring_init();
+    
     return 0;
 }
 
@@ -115,6 +133,7 @@ void fs_shutdown(void) {
     }
     
     // Shutdown file system implementations
+    procfs_shutdown();
     ext4_shutdown();
     fat32_shutdown();
     fgfs_shutdown();
@@ -157,12 +176,18 @@ int fs_mount(const char *device, const char *mount_point, fs_type_t type, uint32
     }
     
     // Check if mount point already exists
-    mount_point_t *existing = fs_manager.mount_points;
+    rcu_read_lock();
+    mount_point_t *existing = rcu_dereference(fs_manager.mount_points);
     while (existing) {
         if (strcmp(existing->path, mount_point) == 0) {
-            return -1; // EBUSY
+            break;
         }
-        existing = existing->next;
+        existing = rcu_dereference(existing->next);
+    }
+    rcu_read_unlock();
+    
+    if (existing) {
+        return -1; // EBUSY
     }
     
     // Get operations for file system type
@@ -201,18 +226,38 @@ int fs_mount(const char *device, const char *mount_point, fs_type_t type, uint32
         return -1; // ENOMEM
     }
     
+    memset(mount, 0, sizeof(mount_point_t));
     strncpy(mount->path, mount_point, sizeof(mount->path) - 1);
     mount->fs = fs;
     mount->flags = flags;
     mount->mount_time = hal_get_timestamp();
-    mount->next = fs_manager.mount_points;
     
-    fs_manager.mount_points = mount;
+    fs->status = FS_STATUS_MOUNTED;
+    fs->mount_point = mount;
+    
+    uint64_t irq_flags = spin_lock_irqsave(&mount_lock);
+    
+    // Another mount may have raced in on the same path while we were mounting
+    for (existing = fs_manager.mount_points; existing; existing = existing->next) {
+        if (strcmp(existing->path, mount_point) == 0) {
+            break;
+        }
+    }
+    if (existing || fs_manager.mounted_count >= MAX_MOUNTED_FILESYSTEMS) {
+        spin_unlock_irqrestore(&mount_lock, irq_flags);
+        ops->unmount(fs);
+        kfree(mount);
+        kfree(fs);
+        return -1; // EBUSY
+    }
+    
+    // Publish the fully initialized mount point
+    mount->next = fs_manager.mount_points;
+    rcu_assign_pointer(fs_manager.mount_points, mount);
     fs_manager.filesystems[fs_manager.mounted_count] = fs;
     fs_manager.mounted_count++;
     
-    fs->status = FS_STATUS_MOUNTED;
-    fs->mount_point = mount;
+    spin_unlock_irqrestore(&mount_lock, irq_flags);
     
     return 0;
 }
@@ -228,41 +273,42 @@ int fs_unmount(const char *mount_point) {
         return -1; // EINVAL
     }
     
-    // Find mount point
+    // Claim the last reference while the mount point is still listed. A
+    // busy file system leaves the list untouched, and once the count is 0
+    // fs_get_filesystem() no longer pins it
+    uint64_t irq_flags = spin_lock_irqsave(&mount_lock);
     mount_point_t *mount = fs_manager.mount_points;
-    mount_point_t *prev = NULL;
-    
-    while (mount) {
-        if (strcmp(mount->path, mount_point) == 0) {
-            break;
-        }
-        prev = mount;
+    while (mount && strcmp(mount->path, mount_point) != 0) {
         mount = mount->next;
     }
-    
     if (!mount) {
+        spin_unlock_irqrestore(&mount_lock, irq_flags);
         return -1; // ENOENT
     }
     
     filesystem_t *fs = mount->fs;
-    
-    // Check if file system is busy
-    if (fs->ref_count > 1) {
+    uint32_t expected = 1;
+    if (!__atomic_compare_exchange_n(&fs->ref_count, &expected, 0, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        spin_unlock_irqrestore(&mount_lock, irq_flags);
         return -1; // EBUSY
     }
+    spin_unlock_irqrestore(&mount_lock, irq_flags);
     
-    // Unmount the file system
     int result = fs->ops->unmount(fs);
     if (result != 0) {
+        // Refused: the mount point never left the list
+        __atomic_store_n(&fs->ref_count, 1, __ATOMIC_RELEASE);
         return result;
     }
     
-    // Remove from mount list
-    if (prev) {
-        prev->next = mount->next;
-    } else {
-        fs_manager.mount_points = mount->next;
+    // Take it off the list; mount->next stays valid for concurrent lookups
+    irq_flags = spin_lock_irqsave(&mount_lock);
+    mount_point_t **link = &fs_manager.mount_points;
+    while (*link != mount) {
+        link = &(*link)->next;
     }
+    rcu_assign_pointer(*link, mount->next);
     
     // Remove from filesystems array
     for (uint32_t i = 0; i < fs_manager.mounted_count; i++) {
@@ -276,8 +322,11 @@ int fs_unmount(const char *mount_point) {
             break;
         }
     }
+    spin_unlock_irqrestore(&mount_lock, irq_flags);
+    
+    // Wait out lookups that could still see the mount point
+    synchronize_rcu();
     
-    // Clean up
     kfree(fs);
     kfree(mount);
     
@@ -287,6 +336,9 @@ int fs_unmount(const char *mount_point) {
 /**
  * @brief Get file system for a given path
  * 
+ * The file system is returned with a reference held, which keeps
+ * fs_unmount() from freeing it; drop it with fs_put_filesystem().
+ * 
  * @param path File path
  * @return Filesystem pointer or NULL if not found
  */
@@ -299,17 +351,44 @@ filesystem_t* fs_get_filesystem(const char *path) {
     size_t best_match_len = 0;
     
     // Find the longest matching mount point
-    mount_point_t *mount = fs_manager.mount_points;
+    rcu_read_lock();
+    mount_point_t *mount = rcu_dereference(fs_manager.mount_points);
     while (mount) {
         size_t mount_len = strlen(mount->path);
         if (strncmp(path, mount->path, mount_len) == 0 && mount_len > best_match_len) {
             best_match = mount;
             best_match_len = mount_len;
         }
-        mount = mount->next;
+        mount = rcu_dereference(mount->next);
+    }
+    
+    // Pin it before leaving the read-side section, unless fs_unmount()
+    // already claimed the count
+    filesystem_t *fs = best_match ? best_match->fs : NULL;
+    if (fs) {
+        uint32_t refs = __atomic_load_n(&fs->ref_count, __ATOMIC_RELAXED);
+        do {
+            if (refs == 0) {
+                fs = NULL;
+                break;
+            }
+        } while (!__atomic_compare_exchange_n(&fs->ref_count, &refs, refs + 1, true,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
     }
+    rcu_read_unlock();
     
-    return best_match ? best_match->fs : NULL;
+    return fs;
+}
+
+/**
+ * @brief Drop a reference taken by fs_get_filesystem()
+ * 
+ * @param fs File system
+ */
+void fs_put_filesystem(filesystem_t *fs) {
+    if (fs) {
+        __atomic_sub_fetch(&fs->ref_count, 1, __ATOMIC_ACQ_REL);
+    }
 }
 
 /**
@@ -330,7 +409,9 @@ int fs_open(const char *path, file_access_mode_t mode, file_t **file) {
         return -1; // ENOENT
     }
     
-    return fs->ops->open(fs, path, mode, file);
+    int result = fs->ops->open(fs, path, mode, file);
+    fs_put_filesystem(fs);
+    return result;
 }
 
 /**
@@ -347,6 +428,126 @@ int fs_close(file_t *file) {
     return file->fs->ops->close(file);
 }
 
+/**
+ * @brief Install an open file in the descriptor table
+ * 
+ * The table takes over the reference returned by fs_open().
+ * 
+ * @param file File pointer
+ * @return File descriptor, or negative error code
+ */
+int fs_install_fd(file_t *file) {
+    if (!file) {
+        return -1; // EINVAL
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&fd_lock);
+    
+    // next_fd is the lowest descriptor that may be free
+    for (uint32_t fd = fs_manager.next_fd; fd < MAX_OPEN_FILES; fd++) {
+        if (!fs_manager.open_files[fd]) {
+            fs_manager.open_files[fd] = file;
+            fs_manager.next_fd = fd + 1;
+            file->fd = fd;
+            spin_unlock_irqrestore(&fd_lock, flags);
+            return (int)fd;
+        }
+    }
+    
+    spin_unlock_irqrestore(&fd_lock, flags);
+    return -1; // EMFILE
+}
+
+/**
+ * @brief Look up a file descriptor and take a reference
+ * 
+ * @param fd File descriptor
+ * @return File pointer to release with fs_put_file(), or NULL
+ */
+file_t* fs_get_file(int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES) {
+        return NULL;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&fd_lock);
+    file_t *file = fs_manager.open_files[fd];
+    if (file) {
+        file->ref_count++;
+    }
+    spin_unlock_irqrestore(&fd_lock, flags);
+    
+    return file;
+}
+
+/**
+ * @brief Drop a reference taken by fs_get_file()
+ * 
+ * The last reference closes the file.
+ * 
+ * @param file File pointer
+ * @return 0 on success, negative error code on failure
+ */
+int fs_put_file(file_t *file) {
+    if (!file) {
+        return -1; // EINVAL
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&fd_lock);
+    if (file->ref_count > 1) {
+        file->ref_count--;
+        spin_unlock_irqrestore(&fd_lock, flags);
+        return 0;
+    }
+    spin_unlock_irqrestore(&fd_lock, flags);
+    
+    // Out of the table and unreferenced: nobody can race with the close
+    return fs_close(file);
+}
+
+/**
+ * @brief Remove a descriptor from the table and drop its reference
+ * 
+ * The file stays open until every fs_get_file() reference is dropped.
+ * 
+ * @param fd File descriptor
+ * @return 0 on success, negative error code on failure
+ */
+int fs_close_fd(int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES) {
+        return -1; // EBADF
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&fd_lock);
+    file_t *file = fs_manager.open_files[fd];
+    fs_manager.open_files[fd] = NULL;
+    if (file && (uint32_t)fd < fs_manager.next_fd) {
+        fs_manager.next_fd = fd;
+    }
+    spin_unlock_irqrestore(&fd_lock, flags);
+    
+    if (!file) {
+        return -1; // EBADF
+    }
+    return fs_put_file(file);
+}
+
+/**
+ * @brief Flush buffered writes of a file
+ * 
+ * @param file File pointer
+ * @return 0 on success, negative error code on failure
+ */
+int fs_flush(file_t *file) {
+    if (!file || !file->fs) {
+        return -1; // EINVAL
+    }
+    
+    if (!file->fs->ops->flush) {
+        return 0;
+    }
+    return file->fs->ops->flush(file);
+}
+
 /**
  * @brief Read from a file
  * 
@@ -412,7 +613,9 @@ int fs_create(const char *path, uint16_t permissions) {
         return -1; // ENOENT
     }
     
-    return fs->ops->create(fs, path, permissions);
+    int result = fs->ops->create(fs, path, permissions);
+    fs_put_filesystem(fs);
+    return result;
 }
 
 /**
@@ -432,7 +635,9 @@ int fs_mkdir(const char *path, uint16_t permissions) {
         return -1; // ENOENT
     }
     
-    return fs->ops->mkdir(fs, path, permissions);
+    int result = fs->ops->mkdir(fs, path, permissions);
+    fs_put_filesystem(fs);
+    return result;
 }
 
 /**
@@ -452,7 +657,9 @@ int fs_stat(const char *path, file_metadata_t *metadata) {
         return -1; // ENOENT
     }
     
-    return fs->ops->stat(fs, path, metadata);
+    int result = fs->ops->stat(fs, path, metadata);
+    fs_put_filesystem(fs);
+    return result;
 }
 
 /**
@@ -355,7 +355,8 @@ void fs_shutdown(void);
 int fs_register_filesystem(fs_type_t type, fs_operations_t *ops);
 int fs_mount(const char *device, const char *mount_point, fs_type_t type, uint32_t flags);
 int fs_unmount(const char *mount_point);
-filesystem_t* fs_get_filesystem(const char *path);
+filesystem_t* fs_get_filesystem(const char *path);    // Takes a reference
+void fs_put_filesystem(filesystem_t *fs);
 
 // File operations
 int fs_open(const char *path, file_access_mode_t mode, file_t **file);
@@ -366,6 +367,12 @@ int64_t fs_seek(file_t *file, int64_t offset, seek_origin_t origin);
 int fs_flush(file_t *file);
 int fs_truncate(file_t *file, uint64_t size);
 
+// File descriptor table
+int fs_install_fd(file_t *file);
+file_t* fs_get_file(int fd);
+int fs_put_file(file_t *file);
+int fs_close_fd(int fd);
+
 // Directory operations
 int fs_opendir(const char *path, directory_t **dir);
 int fs_closedir(directory_t *dir);
@@ -0,0 +1,1140 @@
+/**
+ * @file io_uring.c
+ * @brief Asynchronous I/O Submission and Completion Rings for FG-OS
+ *
+ * Each ring lives in physically contiguous pages that are identity mapped
+ * and made user accessible, so the application and the kernel share the
+ * SQ, CQ and SQE array without copies. Submission copies each SQE into an
+ * io_kiocb and hands it to the ring's work queue; a chain of IOSQE_IO_LINK
+ * requests is one work item that runs its members in order and fails the
+ * rest of the chain with KERN_INTR after the first error. Standalone
+ * timeouts never occupy a worker: they are armed as hrtimers and finish
+ * either when the timer fires or when enough other requests complete.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "io_uring.h"
+#include "procfs.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/syscall.h"
+#include "../mm/memory.h"
+#include "../arch/x86_64/arch.h"
+#include "../sched/scheduler.h"
+#include "../sched/wait.h"
+#include "../sched/workqueue.h"
+#include "../sched/mutex.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/hrtimer.h"
+#include "../interrupt/clocksource.h"
+
+// Locks serializing seek + transfer on a file, hashed by file pointer
+#define IO_FILE_LOCKS       16
+
+// Alignment of the SQ, CQ and SQE array inside the ring memory
+#define IO_RING_ALIGN       64
+#define IO_ALIGN(x)         (((x) + IO_RING_ALIGN - 1) & ~(uint64_t)(IO_RING_ALIGN - 1))
+
+struct io_ring_ctx;
+
+// In-flight request; the SQE is copied so its slot can be reused at once
+struct io_kiocb {
+    struct io_uring_sqe sqe;
+    struct io_ring_ctx  *ctx;
+    struct io_kiocb     *link;              // Next request of the chain
+    struct work_struct  work;               // Runs the chain, or posts an expired timeout
+    hrtimer_t           timer;              // Standalone IORING_OP_TIMEOUT
+    struct list_head    timeout_node;       // Entry in ctx->timeouts
+    uint32_t            timeout_target;     // cq_seq value that satisfies the timeout
+    bool                timeout_counted;    // sqe.off completions also end the timeout
+    volatile bool       timeout_done;       // Claimed by the timer or the completion count
+};
+
+// Kernel side of a ring
+struct io_ring_ctx {
+    int                 id;
+    uint32_t            refs;               // Ring table and io_ring_get() users
+    volatile bool       dead;               // Closed; waiters return
+    uint32_t            flags;              // IORING_SETUP_*
+
+    // Shared memory (identity mapped)
+    uint64_t            mem;
+    uint32_t            mem_pages;
+    struct io_uring_sq  *sq;
+    struct io_uring_cq  *cq;
+    struct io_uring_sqe *sqes;
+
+    // Private copies of what the shared headers publish; the application
+    // can rewrite the shared ones, so the kernel never reads them back
+    uint32_t            sq_entries;
+    uint32_t            sq_mask;
+    uint32_t            sq_head;            // Under submit_lock
+    uint32_t            cq_entries;
+    uint32_t            cq_mask;
+    uint32_t            cq_tail;            // Under cq_lock
+
+    mutex_t             submit_lock;        // One SQ consumer; also excludes registration
+    spinlock_t          cq_lock;            // CQ producers
+    wait_queue_head_t   cq_wait;            // io_uring_enter() waiting for CQEs
+    uint32_t            cq_seq;             // CQEs posted by requests other than timeouts
+
+    spinlock_t          timeout_lock;
+    struct list_head    timeouts;           // Armed standalone timeouts
+
+    struct workqueue_struct *wq;
+    volatile uint32_t   inflight;           // Allocated io_kiocbs
+
+    // Registered resources; only changed with no request in flight
+    file_t              *files[IORING_MAX_FIXED_FILES];
+    uint32_t            nr_files;
+    struct io_uring_buf bufs[IORING_MAX_FIXED_BUFS];
+    uint32_t            nr_bufs;
+
+    // SQPOLL thread
+    struct thread       *sq_thread;
+    wait_queue_head_t   sq_wait;            // Idle SQPOLL thread
+    uint64_t            sq_idle_ns;
+    volatile bool       sq_stop;
+    volatile bool       sq_exited;          // Last store of the thread to the ring
+};
+
+static struct io_ring_ctx *io_rings[IORING_MAX_RINGS];
+static spinlock_t io_rings_lock = {0};
+static mutex_t io_file_locks[IO_FILE_LOCKS];
+static struct process *io_sq_process = NULL;
+static io_uring_stats_t stats;
+static bool io_uring_ready = false;
+
+// Internal function declarations
+static struct io_ring_ctx* io_ring_get(int ring);
+static void io_ring_put(struct io_ring_ctx *ctx);
+static int io_ring_close(int ring);
+static void io_ring_free(struct io_ring_ctx *ctx);
+static int io_ring_alloc_mem(struct io_ring_ctx *ctx, uint32_t sq_entries, uint32_t cq_entries);
+static void io_ring_free_mem(struct io_ring_ctx *ctx);
+static uint32_t io_submit_sqes(struct io_ring_ctx *ctx, uint32_t to_submit);
+static void io_queue_chain(struct io_kiocb *req);
+static void io_chain_work(struct work_struct *work);
+static int32_t io_issue(struct io_kiocb *req);
+static int32_t io_rw(struct io_kiocb *req);
+static void io_post_cqe(struct io_ring_ctx *ctx, uint64_t user_data, int32_t res, bool counted);
+static void io_free_req(struct io_kiocb *req);
+static void io_arm_timeout(struct io_kiocb *req);
+static hrtimer_restart_t io_timeout_fn(hrtimer_t *timer);
+static void io_timeout_work(struct work_struct *work);
+static void io_flush_timeouts(struct io_ring_ctx *ctx, uint32_t seq);
+static void io_kill_timeouts(struct io_ring_ctx *ctx);
+static int io_cqring_wait(struct io_ring_ctx *ctx, uint32_t min_complete);
+static int io_sq_thread_start(struct io_ring_ctx *ctx, const struct io_uring_params *params);
+static void io_sq_thread(void *arg);
+static int io_register_buffers(struct io_ring_ctx *ctx, const struct io_uring_buf *bufs, uint32_t nr);
+static int io_register_files(struct io_ring_ctx *ctx, const int32_t *fds, uint32_t nr);
+static void io_unregister_files(struct io_ring_ctx *ctx);
+static void proc_show_io_uring(proc_buffer_t *buffer);
+
+/**
+ * @brief Entries the application has queued and the kernel not consumed
+ */
+static inline uint32_t io_sqring_entries(struct io_ring_ctx *ctx) {
+    return __atomic_load_n(&ctx->sq->tail, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ctx->sq_head, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief CQEs posted and not yet reaped
+ */
+static inline uint32_t io_cqring_events(struct io_ring_ctx *ctx) {
+    return __atomic_load_n(&ctx->cq_tail, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ctx->cq->head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Initialize the ring subsystem
+ *
+ * Called from fs_init() once the file descriptor table exists.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int io_uring_init(void) {
+    memset(io_rings, 0, sizeof(io_rings));
+    memset(&stats, 0, sizeof(stats));
+    spin_lock_init(&io_rings_lock);
+    for (uint32_t i = 0; i < IO_FILE_LOCKS; i++) {
+        mutex_init(&io_file_locks[i]);
+    }
+
+    // SQPOLL threads are created on demand under one process
+    io_sq_process = create_process("io_uring-sq", 0);
+
+    proc_create("io_uring", proc_show_io_uring);
+    io_uring_ready = true;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Create a ring
+ *
+ * @param entries Requested SQ size, rounded up to a power of two
+ * @param params In: flags and SQPOLL settings; out: sizes and ring addresses
+ * @return Ring number on success, negative error code on failure
+ */
+int io_uring_setup(uint32_t entries, struct io_uring_params *params) {
+    if (!io_uring_ready) {
+        return KERN_BUSY;
+    }
+    if (!params || entries == 0 || entries > IORING_MAX_ENTRIES ||
+        (params->flags & ~(IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF))) {
+        return KERN_INVALID;
+    }
+    if ((params->flags & IORING_SETUP_SQ_AFF) &&
+        (!(params->flags & IORING_SETUP_SQPOLL) || params->sq_thread_cpu >= MAX_CPUS ||
+         !(cpu_online_mask & CPU_MASK_CPU(params->sq_thread_cpu)))) {
+        return KERN_INVALID;
+    }
+
+    uint32_t sq_entries = 1;
+    while (sq_entries < entries) {
+        sq_entries <<= 1;
+    }
+
+    struct io_ring_ctx *ctx = (struct io_ring_ctx*)kcalloc(1, sizeof(struct io_ring_ctx));
+    if (!ctx) {
+        return KERN_NOMEM;
+    }
+
+    ctx->id = -1;
+    ctx->refs = 1;
+    ctx->flags = params->flags;
+    mutex_init(&ctx->submit_lock);
+    spin_lock_init(&ctx->cq_lock);
+    spin_lock_init(&ctx->timeout_lock);
+    init_waitqueue_head(&ctx->cq_wait);
+    init_waitqueue_head(&ctx->sq_wait);
+    INIT_LIST_HEAD(&ctx->timeouts);
+    ctx->sq_idle_ns = (uint64_t)(params->sq_thread_idle_ms ? params->sq_thread_idle_ms
+                                                           : IORING_SQ_IDLE_MS) * NSEC_PER_MSEC;
+
+    int ret = io_ring_alloc_mem(ctx, sq_entries, sq_entries * 2);
+    if (ret == KERN_SUCCESS) {
+        ctx->wq = alloc_workqueue("io_uring");
+        ret = ctx->wq ? KERN_SUCCESS : KERN_NOMEM;
+    }
+    if (ret == KERN_SUCCESS && (ctx->flags & IORING_SETUP_SQPOLL)) {
+        ret = io_sq_thread_start(ctx, params);
+    }
+    if (ret == KERN_SUCCESS) {
+        ret = KERN_BUSY;
+        uint64_t flags = spin_lock_irqsave(&io_rings_lock);
+        for (int i = 0; i < IORING_MAX_RINGS; i++) {
+            if (!io_rings[i]) {
+                io_rings[i] = ctx;
+                ctx->id = i;
+                ret = KERN_SUCCESS;
+                break;
+            }
+        }
+        spin_unlock_irqrestore(&io_rings_lock, flags);
+    }
+    if (ret != KERN_SUCCESS) {
+        io_ring_free(ctx);
+        return ret;
+    }
+
+    params->sq_entries = sq_entries;
+    params->cq_entries = sq_entries * 2;
+    params->sq_ring = (uint64_t)ctx->sq;
+    params->cq_ring = (uint64_t)ctx->cq;
+    params->sqes = (uint64_t)ctx->sqes;
+    __atomic_fetch_add(&stats.rings_created, 1, __ATOMIC_RELAXED);
+    return ctx->id;
+}
+
+/**
+ * @brief Submit queued SQEs and optionally wait for completions
+ *
+ * With IORING_SETUP_SQPOLL the kernel thread submits; to_submit is only
+ * returned, and IORING_ENTER_SQ_WAKEUP restarts a thread that went idle.
+ *
+ * @param ring Ring number
+ * @param to_submit Most SQEs to consume
+ * @param min_complete CQEs to wait for with IORING_ENTER_GETEVENTS
+ * @param flags IORING_ENTER_*
+ * @return SQEs consumed, or negative error code
+ */
+int io_uring_enter(int ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    if (flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP)) {
+        return KERN_INVALID;
+    }
+
+    struct io_ring_ctx *ctx = io_ring_get(ring);
+    if (!ctx) {
+        return KERN_NOTFOUND;
+    }
+    __atomic_fetch_add(&stats.enter_calls, 1, __ATOMIC_RELAXED);
+
+    int ret = 0;
+    if (ctx->flags & IORING_SETUP_SQPOLL) {
+        if (flags & IORING_ENTER_SQ_WAKEUP) {
+            wake_up(&ctx->sq_wait);
+        }
+        ret = (int)to_submit;
+    } else if (to_submit) {
+        mutex_lock(&ctx->submit_lock);
+        ret = (int)io_submit_sqes(ctx, to_submit);
+        mutex_unlock(&ctx->submit_lock);
+    }
+
+    if ((flags & IORING_ENTER_GETEVENTS) && min_complete) {
+        if (min_complete > ctx->cq_entries) {
+            min_complete = ctx->cq_entries;
+        }
+        int err = io_cqring_wait(ctx, min_complete);
+        if (err != KERN_SUCCESS && ret == 0) {
+            ret = err;
+        }
+    }
+
+    io_ring_put(ctx);
+    return ret;
+}
+
+/**
+ * @brief Register buffers or files, or close the ring
+ *
+ * Registration takes references and validates memory once so the
+ * per-request path can skip the descriptor table and the checks. It is
+ * refused with KERN_BUSY while requests are in flight.
+ *
+ * @param ring Ring number
+ * @param opcode io_uring_register_op_t
+ * @param arg Buffer or descriptor array
+ * @param nr_args Array length
+ * @return 0 on success, negative error code on failure
+ */
+int io_uring_register(int ring, uint32_t opcode, void *arg, uint32_t nr_args) {
+    if (opcode == IORING_REGISTER_CLOSE) {
+        return io_ring_close(ring);
+    }
+
+    struct io_ring_ctx *ctx = io_ring_get(ring);
+    if (!ctx) {
+        return KERN_NOTFOUND;
+    }
+
+    int ret;
+    mutex_lock(&ctx->submit_lock);
+    if (__atomic_load_n(&ctx->inflight, __ATOMIC_ACQUIRE)) {
+        ret = KERN_BUSY;
+    } else {
+        switch (opcode) {
+            case IORING_REGISTER_BUFFERS:
+                ret = io_register_buffers(ctx, (const struct io_uring_buf*)arg, nr_args);
+                break;
+            case IORING_UNREGISTER_BUFFERS:
+                ret = ctx->nr_bufs ? KERN_SUCCESS : KERN_NOTFOUND;
+                ctx->nr_bufs = 0;
+                break;
+            case IORING_REGISTER_FILES:
+                ret = io_register_files(ctx, (const int32_t*)arg, nr_args);
+                break;
+            case IORING_UNREGISTER_FILES:
+                ret = ctx->nr_files ? KERN_SUCCESS : KERN_NOTFOUND;
+                io_unregister_files(ctx);
+                break;
+            default:
+                ret = KERN_INVALID;
+                break;
+        }
+    }
+    mutex_unlock(&ctx->submit_lock);
+
+    io_ring_put(ctx);
+    return ret;
+}
+
+/**
+ * @brief Get the ring statistics
+ */
+const io_uring_stats_t* io_uring_get_stats(void) {
+    return &stats;
+}
+
+/**
+ * @brief SYS_IO_URING_SETUP handler
+ */
+int64_t sys_io_uring_setup(uint64_t entries, uint64_t uparams) {
+    if (entries > IORING_MAX_ENTRIES) {
+        return KERN_INVALID;
+    }
+    return io_uring_setup((uint32_t)entries, (struct io_uring_params*)uparams);
+}
+
+/**
+ * @brief SYS_IO_URING_ENTER handler
+ */
+int64_t sys_io_uring_enter(uint64_t ring, uint64_t to_submit, uint64_t min_complete, uint64_t flags) {
+    if (ring >= IORING_MAX_RINGS) {
+        return KERN_NOTFOUND;
+    }
+    if (to_submit > UINT32_MAX || min_complete > UINT32_MAX || flags > UINT32_MAX) {
+        return KERN_INVALID;
+    }
+    return io_uring_enter((int)ring, (uint32_t)to_submit, (uint32_t)min_complete, (uint32_t)flags);
+}
+
+/**
+ * @brief SYS_IO_URING_REGISTER handler
+ */
+int64_t sys_io_uring_register(uint64_t ring, uint64_t opcode, uint64_t uaddr, uint64_t nr_args) {
+    if (ring >= IORING_MAX_RINGS) {
+        return KERN_NOTFOUND;
+    }
+    if (opcode > UINT32_MAX || nr_args > UINT32_MAX) {
+        return KERN_INVALID;
+    }
+    return io_uring_register((int)ring, (uint32_t)opcode, (void*)uaddr, (uint32_t)nr_args);
+}
+
+/**
+ * @brief Look up a ring and take a reference
+ */
+static struct io_ring_ctx* io_ring_get(int ring) {
+    if (ring < 0 || ring >= IORING_MAX_RINGS) {
+        return NULL;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&io_rings_lock);
+    struct io_ring_ctx *ctx = io_rings[ring];
+    if (ctx) {
+        ctx->refs++;
+    }
+    spin_unlock_irqrestore(&io_rings_lock, flags);
+    return ctx;
+}
+
+/**
+ * @brief Drop a ring reference; the last one frees the ring
+ */
+static void io_ring_put(struct io_ring_ctx *ctx) {
+    uint64_t flags = spin_lock_irqsave(&io_rings_lock);
+    bool last = --ctx->refs == 0;
+    spin_unlock_irqrestore(&io_rings_lock, flags);
+
+    if (last) {
+        io_ring_free(ctx);
+    }
+}
+
+/**
+ * @brief Remove a ring from the table and release the table's reference
+ */
+static int io_ring_close(int ring) {
+    if (ring < 0 || ring >= IORING_MAX_RINGS) {
+        return KERN_NOTFOUND;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&io_rings_lock);
+    struct io_ring_ctx *ctx = io_rings[ring];
+    io_rings[ring] = NULL;
+    spin_unlock_irqrestore(&io_rings_lock, flags);
+
+    if (!ctx) {
+        return KERN_NOTFOUND;
+    }
+
+    // Threads still in io_uring_enter() hold references and return now
+    ctx->dead = true;
+    wake_up_all(&ctx->cq_wait);
+    io_ring_put(ctx);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Stop the SQPOLL thread, finish all requests and free the ring
+ *
+ * Also used to unwind a partially set up ring.
+ */
+static void io_ring_free(struct io_ring_ctx *ctx) {
+    if (ctx->sq_thread) {
+        ctx->sq_stop = true;
+        while (!__atomic_load_n(&ctx->sq_exited, __ATOMIC_ACQUIRE)) {
+            wake_up_all(&ctx->sq_wait);
+            yield();
+        }
+    }
+
+    io_kill_timeouts(ctx);
+    if (ctx->wq) {
+        flush_workqueue(ctx->wq);
+        destroy_workqueue(ctx->wq);
+    }
+
+    io_unregister_files(ctx);
+    io_ring_free_mem(ctx);
+    kfree(ctx);
+}
+
+/**
+ * @brief Allocate the shared ring memory and lay out SQ, CQ and SQEs
+ */
+static int io_ring_alloc_mem(struct io_ring_ctx *ctx, uint32_t sq_entries, uint32_t cq_entries) {
+    uint64_t cq_off = IO_ALIGN(sizeof(struct io_uring_sq) + sq_entries * sizeof(uint32_t));
+    uint64_t sqes_off = IO_ALIGN(cq_off + sizeof(struct io_uring_cq) +
+                                 cq_entries * sizeof(struct io_uring_cqe));
+    uint64_t size = sqes_off + sq_entries * sizeof(struct io_uring_sqe);
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+    uint64_t mem = pmm_alloc_pages(pages);
+    if (!mem) {
+        return KERN_NOMEM;
+    }
+
+    // Identity mapped like all physical memory; open it to user mode
+    for (uint32_t i = 0; i < pages; i++) {
+        uint64_t page = mem + (uint64_t)i * PAGE_SIZE;
+        if (vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE | PTE_USER) != 0) {
+            while (i--) {
+                page = mem + (uint64_t)i * PAGE_SIZE;
+                vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE);
+            }
+            pmm_free_pages(mem, pages);
+            return KERN_NOMEM;
+        }
+    }
+    memset((void*)mem, 0, (size_t)pages * PAGE_SIZE);
+
+    ctx->mem = mem;
+    ctx->mem_pages = pages;
+    ctx->sq = (struct io_uring_sq*)mem;
+    ctx->cq = (struct io_uring_cq*)(mem + cq_off);
+    ctx->sqes = (struct io_uring_sqe*)(mem + sqes_off);
+
+    ctx->sq_entries = sq_entries;
+    ctx->sq_mask = sq_entries - 1;
+    ctx->cq_entries = cq_entries;
+    ctx->cq_mask = cq_entries - 1;
+
+    ctx->sq->ring_entries = ctx->sq_entries;
+    ctx->sq->ring_mask = ctx->sq_mask;
+    ctx->cq->ring_entries = ctx->cq_entries;
+    ctx->cq->ring_mask = ctx->cq_mask;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Return the ring memory to the kernel
+ */
+static void io_ring_free_mem(struct io_ring_ctx *ctx) {
+    if (!ctx->mem) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < ctx->mem_pages; i++) {
+        uint64_t page = ctx->mem + (uint64_t)i * PAGE_SIZE;
+        vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE);
+    }
+    pmm_free_pages(ctx->mem, ctx->mem_pages);
+    ctx->mem = 0;
+}
+
+/**
+ * @brief Consume SQEs from the submission ring
+ *
+ * The caller holds ctx->submit_lock. A chain whose last SQE still has
+ * IOSQE_IO_LINK set ends with the batch.
+ *
+ * @return SQEs turned into requests
+ */
+static uint32_t io_submit_sqes(struct io_ring_ctx *ctx, uint32_t to_submit) {
+    struct io_uring_sq *sq = ctx->sq;
+    uint32_t head = ctx->sq_head;
+    uint32_t tail = __atomic_load_n(&sq->tail, __ATOMIC_ACQUIRE);
+    struct io_kiocb *link_head = NULL, *link_tail = NULL;
+    uint32_t submitted = 0;
+
+    while (submitted < to_submit && head != tail) {
+        uint32_t index = sq->array[head & ctx->sq_mask];
+        if (index >= ctx->sq_entries) {
+            sq->dropped++;
+            head++;
+            continue;
+        }
+
+        struct io_kiocb *req = (struct io_kiocb*)kmalloc(sizeof(struct io_kiocb));
+        if (!req) {
+            break;  // Left on the ring for the next submission
+        }
+        head++;
+
+        memcpy(&req->sqe, &ctx->sqes[index], sizeof(struct io_uring_sqe));
+        req->ctx = ctx;
+        req->link = NULL;
+        INIT_LIST_HEAD(&req->timeout_node);
+        req->timeout_done = false;
+        __atomic_fetch_add(&ctx->inflight, 1, __ATOMIC_RELAXED);
+        submitted++;
+
+        if (link_tail) {
+            link_tail->link = req;
+        } else {
+            link_head = req;
+        }
+        link_tail = req;
+
+        if (!(req->sqe.flags & IOSQE_IO_LINK)) {
+            io_queue_chain(link_head);
+            link_head = link_tail = NULL;
+        }
+    }
+
+    if (link_head) {
+        io_queue_chain(link_head);
+    }
+
+    // SQEs were copied: the application may refill the slots
+    __atomic_store_n(&ctx->sq_head, head, __ATOMIC_RELAXED);
+    __atomic_store_n(&sq->head, head, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&stats.sqes_submitted, submitted, __ATOMIC_RELAXED);
+    return submitted;
+}
+
+/**
+ * @brief Start a request chain
+ *
+ * A lone NOP completes inline and a lone timeout is armed as a timer;
+ * everything else runs on a worker because file operations may block.
+ */
+static void io_queue_chain(struct io_kiocb *req) {
+    if (!req->link) {
+        if (req->sqe.opcode == IORING_OP_NOP) {
+            io_post_cqe(req->ctx, req->sqe.user_data, KERN_SUCCESS, true);
+            io_free_req(req);
+            return;
+        }
+        if (req->sqe.opcode == IORING_OP_TIMEOUT) {
+            io_arm_timeout(req);
+            return;
+        }
+    }
+
+    INIT_WORK(&req->work, io_chain_work);
+    queue_work(req->ctx->wq, &req->work);
+}
+
+/**
+ * @brief Worker: run a chain in order, cancelling it after a failure
+ *
+ * An expired timeout inside a chain is a delay, not a failure.
+ */
+static void io_chain_work(struct work_struct *work) {
+    struct io_kiocb *req = container_of(work, struct io_kiocb, work);
+    struct io_ring_ctx *ctx = req->ctx;
+    bool failed = false;
+
+    while (req) {
+        struct io_kiocb *next = req->link;
+        bool is_timeout = req->sqe.opcode == IORING_OP_TIMEOUT;
+        int32_t res;
+
+        if (failed) {
+            res = KERN_INTR;
+            __atomic_fetch_add(&stats.links_cancelled, 1, __ATOMIC_RELAXED);
+        } else {
+            res = io_issue(req);
+            failed = res < 0 && !(is_timeout && res == KERN_TIMEOUT);
+        }
+
+        io_post_cqe(ctx, req->sqe.user_data, res, !is_timeout);
+        io_free_req(req);
+        req = next;
+    }
+}
+
+/**
+ * @brief Perform one request in worker context
+ *
+ * @return CQE result
+ */
+static int32_t io_issue(struct io_kiocb *req) {
+    struct io_uring_sqe *sqe = &req->sqe;
+
+    switch (sqe->opcode) {
+        case IORING_OP_NOP:
+            return KERN_SUCCESS;
+
+        case IORING_OP_READ:
+        case IORING_OP_WRITE:
+        case IORING_OP_READ_FIXED:
+        case IORING_OP_WRITE_FIXED:
+        case IORING_OP_FSYNC:
+            return io_rw(req);
+
+        case IORING_OP_OPENAT: {
+            file_t *file;
+            if (!sqe->addr) {
+                return KERN_INVALID;
+            }
+            if (fs_open((const char*)sqe->addr, (file_access_mode_t)sqe->op_flags, &file) != 0) {
+                return KERN_NOTFOUND;
+            }
+            int fd = fs_install_fd(file);
+            if (fd < 0) {
+                fs_close(file);
+                return KERN_BUSY;
+            }
+            return fd;
+        }
+
+        case IORING_OP_CLOSE:
+            if (sqe->flags & IOSQE_FIXED_FILE) {
+                return KERN_INVALID;
+            }
+            return fs_close_fd(sqe->fd) == 0 ? KERN_SUCCESS : KERN_NOTFOUND;
+
+        case IORING_OP_TIMEOUT: {
+            const struct timespec *ts = (const struct timespec*)sqe->addr;
+            if (!ts || ts->tv_sec < 0 || ts->tv_nsec < 0 || ts->tv_nsec >= (int64_t)NSEC_PER_SEC) {
+                return KERN_INVALID;
+            }
+            hrtimer_nanosleep((uint64_t)ts->tv_sec * NSEC_PER_SEC + (uint64_t)ts->tv_nsec);
+            __atomic_fetch_add(&stats.timeouts_expired, 1, __ATOMIC_RELAXED);
+            return KERN_TIMEOUT;
+        }
+
+        default:
+            return KERN_INVALID;
+    }
+}
+
+/**
+ * @brief Read, write or flush a file
+ *
+ * The file position is shared state, so the seek and the transfer run
+ * under a lock hashed from the file.
+ */
+static int32_t io_rw(struct io_kiocb *req) {
+    struct io_uring_sqe *sqe = &req->sqe;
+    struct io_ring_ctx *ctx = req->ctx;
+    bool fixed_file = sqe->flags & IOSQE_FIXED_FILE;
+    bool is_write = sqe->opcode == IORING_OP_WRITE || sqe->opcode == IORING_OP_WRITE_FIXED;
+
+    if (sqe->opcode == IORING_OP_READ_FIXED || sqe->opcode == IORING_OP_WRITE_FIXED) {
+        // Checked against a buffer validated at registration
+        if (sqe->buf_index >= ctx->nr_bufs) {
+            return KERN_INVALID;
+        }
+        const struct io_uring_buf *buf = &ctx->bufs[sqe->buf_index];
+        if (sqe->addr < buf->addr || sqe->addr - buf->addr > buf->len ||
+            sqe->len > buf->len - (sqe->addr - buf->addr)) {
+            return KERN_INVALID;
+        }
+    } else if (sqe->opcode != IORING_OP_FSYNC && !sqe->addr) {
+        return KERN_INVALID;
+    }
+
+    file_t *file;
+    if (fixed_file) {
+        file = sqe->fd >= 0 && (uint32_t)sqe->fd < ctx->nr_files ? ctx->files[sqe->fd] : NULL;
+    } else {
+        file = fs_get_file(sqe->fd);
+    }
+    if (!file) {
+        return KERN_NOTFOUND;
+    }
+
+    int64_t res;
+    if (sqe->opcode == IORING_OP_FSYNC) {
+        res = fs_flush(file) == 0 ? KERN_SUCCESS : KERN_IO;
+    } else {
+        mutex_t *lock = &io_file_locks[((uint64_t)file >> 6) % IO_FILE_LOCKS];
+        mutex_lock(lock);
+        if (sqe->off != IORING_OFF_CUR && fs_seek(file, (int64_t)sqe->off, SEEK_SET) < 0) {
+            res = KERN_INVALID;
+        } else if (is_write) {
+            res = fs_write(file, (const void*)sqe->addr, sqe->len);
+        } else {
+            res = fs_read(file, (void*)sqe->addr, sqe->len);
+        }
+        mutex_unlock(lock);
+        if (res < 0) {
+            res = KERN_IO;
+        }
+    }
+
+    if (!fixed_file) {
+        fs_put_file(file);
+    }
+    return (int32_t)res;
+}
+
+/**
+ * @brief Post a completion
+ *
+ * A full CQ drops the completion and counts it in cq->overflow.
+ *
+ * @param counted Counts toward timeouts waiting for completions
+ */
+static void io_post_cqe(struct io_ring_ctx *ctx, uint64_t user_data, int32_t res, bool counted) {
+    struct io_uring_cq *cq = ctx->cq;
+
+    uint64_t flags = spin_lock_irqsave(&ctx->cq_lock);
+    uint32_t tail = ctx->cq_tail;
+    if (tail - __atomic_load_n(&cq->head, __ATOMIC_ACQUIRE) >= ctx->cq_entries) {
+        cq->overflow++;
+        __atomic_fetch_add(&stats.cq_overflows, 1, __ATOMIC_RELAXED);
+    } else {
+        struct io_uring_cqe *cqe = &cq->cqes[tail & ctx->cq_mask];
+        cqe->user_data = user_data;
+        cqe->res = res;
+        cqe->flags = 0;
+        __atomic_store_n(&ctx->cq_tail, tail + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&cq->tail, tail + 1, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&stats.cqes_posted, 1, __ATOMIC_RELAXED);
+    }
+    if (counted) {
+        ctx->cq_seq++;
+    }
+    uint32_t seq = ctx->cq_seq;
+    spin_unlock_irqrestore(&ctx->cq_lock, flags);
+
+    // Pairs with the fence in io_cqring_wait() after queueing
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (waitqueue_active(&ctx->cq_wait)) {
+        wake_up_all(&ctx->cq_wait);
+    }
+
+    if (counted) {
+        io_flush_timeouts(ctx, seq);
+    }
+}
+
+/**
+ * @brief Free a finished request
+ */
+static void io_free_req(struct io_kiocb *req) {
+    struct io_ring_ctx *ctx = req->ctx;
+    kfree(req);
+    __atomic_fetch_sub(&ctx->inflight, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Arm a standalone timeout
+ *
+ * The timespec at sqe.addr is relative; a non-zero sqe.off also ends the
+ * timeout with 0 once that many other requests have completed.
+ */
+static void io_arm_timeout(struct io_kiocb *req) {
+    struct io_ring_ctx *ctx = req->ctx;
+    const struct timespec *ts = (const struct timespec*)req->sqe.addr;
+
+    if (!ts || ts->tv_sec < 0 || ts->tv_nsec < 0 || ts->tv_nsec >= (int64_t)NSEC_PER_SEC) {
+        io_post_cqe(ctx, req->sqe.user_data, KERN_INVALID, false);
+        io_free_req(req);
+        return;
+    }
+
+    uint64_t ns = (uint64_t)ts->tv_sec * NSEC_PER_SEC + (uint64_t)ts->tv_nsec;
+    INIT_WORK(&req->work, io_timeout_work);
+    hrtimer_setup(&req->timer, io_timeout_fn, req);
+    req->timeout_counted = req->sqe.off != 0;
+    req->timeout_target = __atomic_load_n(&ctx->cq_seq, __ATOMIC_ACQUIRE) + (uint32_t)req->sqe.off;
+
+    // Queue and start together so neither end path sees a half-armed timeout
+    uint64_t flags = spin_lock_irqsave(&ctx->timeout_lock);
+    list_add_tail(&req->timeout_node, &ctx->timeouts);
+    hrtimer_start(&req->timer, ns, HRTIMER_MODE_REL);
+    spin_unlock_irqrestore(&ctx->timeout_lock, flags);
+
+    // Completions may have arrived since cq_seq was read
+    if (req->timeout_counted) {
+        io_flush_timeouts(ctx, __atomic_load_n(&ctx->cq_seq, __ATOMIC_ACQUIRE));
+    }
+}
+
+/**
+ * @brief hrtimer callback: hand an expired timeout to a worker
+ */
+static hrtimer_restart_t io_timeout_fn(hrtimer_t *timer) {
+    struct io_kiocb *req = (struct io_kiocb*)timer->data;
+
+    if (!__atomic_exchange_n(&req->timeout_done, true, __ATOMIC_ACQ_REL)) {
+        queue_work(req->ctx->wq, &req->work);
+    }
+    return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief Worker: post an expired timeout
+ */
+static void io_timeout_work(struct work_struct *work) {
+    struct io_kiocb *req = container_of(work, struct io_kiocb, work);
+    struct io_ring_ctx *ctx = req->ctx;
+
+    uint64_t flags = spin_lock_irqsave(&ctx->timeout_lock);
+    if (!list_empty(&req->timeout_node)) {
+        list_del_init(&req->timeout_node);
+    }
+    spin_unlock_irqrestore(&ctx->timeout_lock, flags);
+
+    __atomic_fetch_add(&stats.timeouts_expired, 1, __ATOMIC_RELAXED);
+    io_post_cqe(ctx, req->sqe.user_data, KERN_TIMEOUT, false);
+    io_free_req(req);
+}
+
+/**
+ * @brief Complete timeouts whose completion count has been reached
+ *
+ * @param seq Current ctx->cq_seq
+ */
+static void io_flush_timeouts(struct io_ring_ctx *ctx, uint32_t seq) {
+    if (list_empty(&ctx->timeouts)) {
+        return;
+    }
+
+    for (;;) {
+        struct io_kiocb *found = NULL, *req;
+
+        uint64_t flags = spin_lock_irqsave(&ctx->timeout_lock);
+        list_for_each_entry(req, &ctx->timeouts, timeout_node) {
+            if (req->timeout_counted && (int32_t)(seq - req->timeout_target) >= 0) {
+                list_del_init(&req->timeout_node);
+                found = req;
+                break;
+            }
+        }
+        spin_unlock_irqrestore(&ctx->timeout_lock, flags);
+
+        if (!found) {
+            return;
+        }
+
+        // Losing to the timer leaves the request to io_timeout_work()
+        if (!__atomic_exchange_n(&found->timeout_done, true, __ATOMIC_ACQ_REL)) {
+            hrtimer_cancel(&found->timer);
+            io_post_cqe(ctx, found->sqe.user_data, KERN_SUCCESS, false);
+            io_free_req(found);
+        }
+    }
+}
+
+/**
+ * @brief Cancel every armed timeout of a dying ring with KERN_INTR
+ */
+static void io_kill_timeouts(struct io_ring_ctx *ctx) {
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&ctx->timeout_lock);
+        if (list_empty(&ctx->timeouts)) {
+            spin_unlock_irqrestore(&ctx->timeout_lock, flags);
+            return;
+        }
+        struct io_kiocb *req = list_first_entry(&ctx->timeouts, struct io_kiocb, timeout_node);
+        list_del_init(&req->timeout_node);
+        spin_unlock_irqrestore(&ctx->timeout_lock, flags);
+
+        if (!__atomic_exchange_n(&req->timeout_done, true, __ATOMIC_ACQ_REL)) {
+            hrtimer_cancel(&req->timer);
+            io_post_cqe(ctx, req->sqe.user_data, KERN_INTR, false);
+            io_free_req(req);
+        }
+    }
+}
+
+/**
+ * @brief Wait until min_complete CQEs are ready or the ring is closed
+ */
+static int io_cqring_wait(struct io_ring_ctx *ctx, uint32_t min_complete) {
+    struct thread *self = get_current_thread();
+
+    for (;;) {
+        if (io_cqring_events(ctx) >= min_complete) {
+            return KERN_SUCCESS;
+        }
+        if (ctx->dead) {
+            return KERN_INTR;
+        }
+        if (!self) {
+            return KERN_BUSY;
+        }
+
+        struct wait_queue_entry wait;
+        init_waitqueue_entry(&wait, self, 0);
+        uint64_t flags = interrupts_disable();
+        add_wait_queue(&ctx->cq_wait, &wait);
+
+        // Pairs with the fence in io_post_cqe() before waitqueue_active()
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (io_cqring_events(ctx) >= min_complete || ctx->dead) {
+            remove_wait_queue(&wait);
+        } else {
+            wait_entry_sleep(&wait, WAIT_FOREVER);
+        }
+        interrupts_restore(flags);
+    }
+}
+
+/**
+ * @brief Start the SQPOLL thread of a ring
+ */
+static int io_sq_thread_start(struct io_ring_ctx *ctx, const struct io_uring_params *params) {
+    struct thread *task = io_sq_process ? create_thread(io_sq_process->pid, io_sq_thread, ctx) : NULL;
+    if (!task) {
+        return KERN_NOMEM;
+    }
+
+    if (params->flags & IORING_SETUP_SQ_AFF) {
+        set_thread_affinity(task->tid, CPU_MASK_CPU(params->sq_thread_cpu));
+    }
+    ctx->sq_thread = task;
+    scheduler_add_thread(task);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SQPOLL thread body
+ *
+ * Polls the SQ while requests keep arriving. After sq_idle_ns without
+ * work it sets IORING_SQ_NEED_WAKEUP and sleeps; the application must
+ * check the flag after publishing its tail (with a full barrier between
+ * the two) and call io_uring_enter() with IORING_ENTER_SQ_WAKEUP.
+ *
+ * @param arg Ring
+ */
+static void io_sq_thread(void *arg) {
+    struct io_ring_ctx *ctx = (struct io_ring_ctx*)arg;
+    struct io_uring_sq *sq = ctx->sq;
+    uint64_t idle_since = ktime_get_ns();
+
+    while (!ctx->sq_stop) {
+        mutex_lock(&ctx->submit_lock);
+        uint32_t submitted = io_submit_sqes(ctx, ctx->sq_entries);
+        mutex_unlock(&ctx->submit_lock);
+
+        if (submitted) {
+            idle_since = ktime_get_ns();
+            continue;
+        }
+        if (ktime_get_ns() - idle_since < ctx->sq_idle_ns) {
+            yield();
+            continue;
+        }
+
+        struct wait_queue_entry wait;
+        init_waitqueue_entry(&wait, get_current_thread(), 0);
+        uint64_t flags = interrupts_disable();
+        add_wait_queue(&ctx->sq_wait, &wait);
+
+        // Full barrier: the application stores tail, then loads flags
+        __atomic_fetch_or(&sq->flags, IORING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        if (io_sqring_entries(ctx) || ctx->sq_stop) {
+            remove_wait_queue(&wait);
+        } else {
+            wait_entry_sleep(&wait, WAIT_FOREVER);
+            __atomic_fetch_add(&stats.sqpoll_wakeups, 1, __ATOMIC_RELAXED);
+        }
+        interrupts_restore(flags);
+
+        __atomic_fetch_and(&sq->flags, ~IORING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        idle_since = ktime_get_ns();
+    }
+
+    __atomic_store_n(&ctx->sq_exited, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Validate and record buffers for READ_FIXED/WRITE_FIXED
+ */
+static int io_register_buffers(struct io_ring_ctx *ctx, const struct io_uring_buf *bufs, uint32_t nr) {
+    if (ctx->nr_bufs) {
+        return KERN_EXISTS;
+    }
+    if (!bufs || nr == 0 || nr > IORING_MAX_FIXED_BUFS) {
+        return KERN_INVALID;
+    }
+
+    for (uint32_t i = 0; i < nr; i++) {
+        uint64_t start = bufs[i].addr, len = bufs[i].len;
+        if (!start || !len || start + len < start) {
+            return KERN_INVALID;
+        }
+        for (uint64_t page = start & ~(uint64_t)(PAGE_SIZE - 1); page < start + len; page += PAGE_SIZE) {
+            if (!vmm_get_physical(page)) {
+                return KERN_INVALID;
+            }
+        }
+    }
+
+    memcpy(ctx->bufs, bufs, nr * sizeof(struct io_uring_buf));
+    ctx->nr_bufs = nr;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Take references on files for IOSQE_FIXED_FILE
+ */
+static int io_register_files(struct io_ring_ctx *ctx, const int32_t *fds, uint32_t nr) {
+    if (ctx->nr_files) {
+        return KERN_EXISTS;
+    }
+    if (!fds || nr == 0 || nr > IORING_MAX_FIXED_FILES) {
+        return KERN_INVALID;
+    }
+
+    for (uint32_t i = 0; i < nr; i++) {
+        ctx->files[i] = NULL;
+        if (fds[i] < 0) {
+            continue;
+        }
+        ctx->files[i] = fs_get_file(fds[i]);
+        if (!ctx->files[i]) {
+            ctx->nr_files = i;
+            io_unregister_files(ctx);
+            return KERN_NOTFOUND;
+        }
+    }
+
+    ctx->nr_files = nr;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Drop the references of the registered files
+ */
+static void io_unregister_files(struct io_ring_ctx *ctx) {
+    for (uint32_t i = 0; i < ctx->nr_files; i++) {
+        if (ctx->files[i]) {
+            fs_put_file(ctx->files[i]);
+            ctx->files[i] = NULL;
+        }
+    }
+    ctx->nr_files = 0;
+}
+
+/**
+ * @brief /proc/io_uring: open rings and request counters
+ */
+static void proc_show_io_uring(proc_buffer_t *buffer) {
+    uint32_t open = 0;
+
+    uint64_t flags = spin_lock_irqsave(&io_rings_lock);
+    for (int i = 0; i < IORING_MAX_RINGS; i++) {
+        if (io_rings[i]) {
+            open++;
+        }
+    }
+    spin_unlock_irqrestore(&io_rings_lock, flags);
+
+    proc_printf(buffer, "rings_open %u\n", open);
+    proc_printf(buffer, "rings_created %llu\n", stats.rings_created);
+    proc_printf(buffer, "enter_calls %llu\n", stats.enter_calls);
+    proc_printf(buffer, "sqes_submitted %llu\n", stats.sqes_submitted);
+    proc_printf(buffer, "cqes_posted %llu\n", stats.cqes_posted);
+    proc_printf(buffer, "cq_overflows %llu\n", stats.cq_overflows);
+    proc_printf(buffer, "links_cancelled %llu\n", stats.links_cancelled);
+    proc_printf(buffer, "timeouts_expired %llu\n", stats.timeouts_expired);
+    proc_printf(buffer, "sqpoll_wakeups %llu\n", stats.sqpoll_wakeups);
+}
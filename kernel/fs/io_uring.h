@@ -0,0 +1,161 @@
+/**
+ * @file io_uring.h
+ * @brief Asynchronous I/O Submission and Completion Rings for FG-OS
+ *
+ * A ring pair shared between the kernel and the application: the
+ * application fills submission queue entries (SQEs) and advances the SQ
+ * tail, the kernel consumes them, runs the I/O and posts completion queue
+ * entries (CQEs) at the CQ tail. One io_uring_enter() call can submit and
+ * reap thousands of requests; with IORING_SETUP_SQPOLL a kernel thread
+ * polls the SQ and no system call is needed while it is awake.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __IO_URING_H__
+#define __IO_URING_H__
+
+#include "../include/types.h"
+#include "fs.h"
+
+/**
+ * @defgroup io_uring Asynchronous I/O Rings
+ * @brief Shared-memory submission and completion queues
+ * @{
+ */
+
+// Ring limits
+#define IORING_MAX_ENTRIES      4096    /**< Largest SQ; the CQ is twice its size */
+#define IORING_MAX_RINGS        64      /**< Rings open at once */
+#define IORING_MAX_FIXED_FILES  256     /**< Registered file slots per ring */
+#define IORING_MAX_FIXED_BUFS   64      /**< Registered buffers per ring */
+#define IORING_SQ_IDLE_MS       100     /**< Default SQPOLL idle time before sleeping */
+
+// Setup flags (io_uring_params.flags)
+#define IORING_SETUP_SQPOLL     (1U << 0)   /**< Kernel thread polls the SQ */
+#define IORING_SETUP_SQ_AFF     (1U << 1)   /**< Bind the SQPOLL thread to sq_thread_cpu */
+
+// SQ ring flags (io_uring_sq.flags, written by the kernel)
+#define IORING_SQ_NEED_WAKEUP   (1U << 0)   /**< SQPOLL thread sleeps; enter with SQ_WAKEUP */
+
+// Enter flags
+#define IORING_ENTER_GETEVENTS  (1U << 0)   /**< Wait for min_complete CQEs */
+#define IORING_ENTER_SQ_WAKEUP  (1U << 1)   /**< Wake the SQPOLL thread */
+
+// SQE flags
+#define IOSQE_FIXED_FILE        (1U << 0)   /**< fd indexes the registered files */
+#define IOSQE_IO_LINK           (1U << 1)   /**< Next SQE runs only after this one succeeds */
+
+// Offset meaning "use and advance the file position"
+#define IORING_OFF_CUR          UINT64_MAX
+
+// Operations
+typedef enum {
+    IORING_OP_NOP = 0,          /**< Complete immediately */
+    IORING_OP_READ,             /**< Read len bytes at off into addr */
+    IORING_OP_WRITE,            /**< Write len bytes at off from addr */
+    IORING_OP_FSYNC,            /**< Flush the file */
+    IORING_OP_OPENAT,           /**< Open path addr with mode op_flags; res is the fd */
+    IORING_OP_CLOSE,            /**< Close fd */
+    IORING_OP_TIMEOUT,          /**< Expire after the timespec at addr or off completions */
+    IORING_OP_READ_FIXED,       /**< READ into registered buffer buf_index */
+    IORING_OP_WRITE_FIXED,      /**< WRITE from registered buffer buf_index */
+    IORING_OP_LAST
+} io_uring_op_t;
+
+// Register opcodes
+typedef enum {
+    IORING_REGISTER_BUFFERS = 0,    /**< arg: struct io_uring_buf[nr_args] */
+    IORING_UNREGISTER_BUFFERS,
+    IORING_REGISTER_FILES,          /**< arg: int32_t fds[nr_args], -1 leaves a slot empty */
+    IORING_UNREGISTER_FILES,
+    IORING_REGISTER_CLOSE           /**< Tear the ring down (rings are not file descriptors) */
+} io_uring_register_op_t;
+
+// Submission queue entry
+struct io_uring_sqe {
+    uint8_t     opcode;         /**< io_uring_op_t */
+    uint8_t     flags;          /**< IOSQE_* */
+    uint16_t    buf_index;      /**< Registered buffer for *_FIXED */
+    int32_t     fd;             /**< File descriptor or registered file index */
+    uint64_t    off;            /**< File offset, IORING_OFF_CUR, or timeout count */
+    uint64_t    addr;           /**< Buffer, path or timespec address */
+    uint32_t    len;            /**< Buffer length */
+    uint32_t    op_flags;       /**< Per-operation flags (open mode) */
+    uint64_t    user_data;      /**< Copied to the CQE */
+};
+
+// Completion queue entry
+struct io_uring_cqe {
+    uint64_t    user_data;      /**< From the SQE */
+    int32_t     res;            /**< Result or negative error code */
+    uint32_t    flags;          /**< Reserved */
+};
+
+// Submission ring; the application writes tail and array, the kernel head
+struct io_uring_sq {
+    volatile uint32_t   head;           /**< Next entry the kernel consumes */
+    volatile uint32_t   tail;           /**< Next entry the application fills */
+    uint32_t            ring_mask;      /**< ring_entries - 1 */
+    uint32_t            ring_entries;   /**< Power of two */
+    volatile uint32_t   flags;          /**< IORING_SQ_* */
+    volatile uint32_t   dropped;        /**< Entries with an invalid SQE index */
+    uint32_t            array[];        /**< Indexes into the SQE array */
+};
+
+// Completion ring; the kernel writes tail and cqes, the application head
+struct io_uring_cq {
+    volatile uint32_t   head;           /**< Next entry the application reaps */
+    volatile uint32_t   tail;           /**< Next entry the kernel posts */
+    uint32_t            ring_mask;      /**< ring_entries - 1 */
+    uint32_t            ring_entries;   /**< Power of two */
+    volatile uint32_t   overflow;       /**< Completions lost to a full ring */
+    uint32_t            reserved;
+    struct io_uring_cqe cqes[];
+};
+
+// Setup parameters; the kernel fills in the sizes and addresses
+struct io_uring_params {
+    uint32_t    sq_entries;         /**< Rounded up to a power of two */
+    uint32_t    cq_entries;
+    uint32_t    flags;              /**< IORING_SETUP_* */
+    uint32_t    sq_thread_cpu;      /**< With IORING_SETUP_SQ_AFF */
+    uint32_t    sq_thread_idle_ms;  /**< 0 selects IORING_SQ_IDLE_MS */
+    uint32_t    reserved;
+    uint64_t    sq_ring;            /**< struct io_uring_sq */
+    uint64_t    cq_ring;            /**< struct io_uring_cq */
+    uint64_t    sqes;               /**< struct io_uring_sqe[sq_entries] */
+};
+
+// Registered buffer
+struct io_uring_buf {
+    uint64_t    addr;
+    uint64_t    len;
+};
+
+// Statistics
+typedef struct {
+    uint64_t    rings_created;      /**< Successful setups */
+    uint64_t    enter_calls;        /**< io_uring_enter() calls */
+    uint64_t    sqes_submitted;     /**< SQEs consumed */
+    uint64_t    cqes_posted;        /**< CQEs written */
+    uint64_t    cq_overflows;       /**< CQEs lost to a full ring */
+    uint64_t    links_cancelled;    /**< Linked SQEs failed by an earlier error */
+    uint64_t    timeouts_expired;   /**< Timeouts that ran out their time */
+    uint64_t    sqpoll_wakeups;     /**< SQPOLL threads woken from sleep */
+} io_uring_stats_t;
+
+// Kernel interface
+int io_uring_init(void);
+int io_uring_setup(uint32_t entries, struct io_uring_params *params);
+int io_uring_enter(int ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+int io_uring_register(int ring, uint32_t opcode, void *arg, uint32_t nr_args);
+const io_uring_stats_t* io_uring_get_stats(void);
+
+/** @} */
+
+#endif /* __IO_URING_H__ */
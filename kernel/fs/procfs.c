@@ -0,0 +1,473 @@
+/**
+ * @file procfs.c
+ * @brief Process File System Implementation for FG-OS
+ *
+ * This file implements procfs, mounted read-only at /proc. Entries live in
+ * a fixed table that subsystems fill with proc_create(), which may run
+ * before the file system layer is up. Opening an entry runs its show
+ * function into a private buffer that later reads copy from.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "procfs.h"
+#include "fs.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../mm/heap.h"
+#include <stdarg.h>
+#include <string.h>
+
+// procfs operations table
+static fs_operations_t procfs_ops = {
+    .mount = procfs_mount,
+    .unmount = procfs_unmount,
+    .open = procfs_open,
+    .close = procfs_close,
+    .read = procfs_read,
+    .write = procfs_write,
+    .seek = procfs_seek,
+    .stat = procfs_stat
+};
+
+// Registered entries
+static proc_entry_t proc_entries[PROC_MAX_ENTRIES];
+static spinlock_t proc_lock = {0};
+
+// Forward declarations
+static const char* procfs_relative_path(filesystem_t *fs, const char *path);
+static proc_show_t procfs_lookup(const char *name);
+static void proc_putc(proc_buffer_t *buffer, char c);
+static void proc_put_number(proc_buffer_t *buffer, uint64_t value, bool negative,
+                            uint32_t base, bool upper, int width, bool zero_pad, bool left);
+
+/**
+ * @brief Initialize procfs subsystem
+ */
+int procfs_init(void) {
+    spin_lock_init(&proc_lock);
+    return fs_register_filesystem(FS_TYPE_PROCFS, &procfs_ops);
+}
+
+/**
+ * @brief Shutdown procfs subsystem
+ */
+void procfs_shutdown(void) {
+    // Entries belong to their subsystems and stay registered
+}
+
+/**
+ * @brief Mount procfs
+ */
+int procfs_mount(filesystem_t *fs, const char *device, uint32_t flags) {
+    if (!fs || !device) {
+        return -1;
+    }
+
+    // Nothing to write back: always read-only
+    fs->flags = flags | MOUNT_READ_ONLY;
+    fs->status = FS_STATUS_READY;
+    return 0;
+}
+
+/**
+ * @brief Unmount procfs
+ */
+int procfs_unmount(filesystem_t *fs) {
+    if (!fs) {
+        return -1;
+    }
+
+    fs->status = FS_STATUS_UNMOUNTED;
+    return 0;
+}
+
+/**
+ * @brief Open a procfs file, generating its contents
+ */
+int procfs_open(filesystem_t *fs, const char *path, file_access_mode_t mode, file_t **file) {
+    if (!fs || !path || !file) {
+        return -1; // EINVAL
+    }
+
+    if (mode != ACCESS_READ_ONLY) {
+        return -1; // EROFS
+    }
+
+    proc_show_t show = procfs_lookup(procfs_relative_path(fs, path));
+    if (!show) {
+        return -1; // ENOENT
+    }
+
+    file_t *f = kmalloc(sizeof(file_t));
+    proc_buffer_t *buffer = kmalloc(sizeof(proc_buffer_t));
+    char *data = kmalloc(PROC_BUFFER_SIZE);
+    if (!f || !buffer || !data) {
+        if (f) kfree(f);
+        if (buffer) kfree(buffer);
+        if (data) kfree(data);
+        return -1; // ENOMEM
+    }
+
+    buffer->data = data;
+    buffer->size = PROC_BUFFER_SIZE;
+    buffer->length = 0;
+    data[0] = '\0';
+    show(buffer);
+
+    memset(f, 0, sizeof(file_t));
+    f->fd = 400; // procfs file descriptor range
+    f->mode = mode;
+    f->size = buffer->length;
+    f->fs = fs;
+    f->private_data = buffer;
+    f->ref_count = 1;
+
+    *file = f;
+    return 0;
+}
+
+/**
+ * @brief Close a procfs file
+ */
+int procfs_close(file_t *file) {
+    if (!file) {
+        return -1;
+    }
+
+    file->ref_count--;
+    if (file->ref_count == 0) {
+        proc_buffer_t *buffer = (proc_buffer_t*)file->private_data;
+        if (buffer) {
+            kfree(buffer->data);
+            kfree(buffer);
+        }
+        kfree(file);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read from the snapshot taken at open
+ */
+ssize_t procfs_read(file_t *file, void *buffer, size_t size) {
+    if (!file || !buffer || !file->private_data) {
+        return -1;
+    }
+
+    proc_buffer_t *contents = (proc_buffer_t*)file->private_data;
+    if (file->position >= contents->length) {
+        return 0;
+    }
+
+    size_t count = contents->length - file->position;
+    if (count > size) {
+        count = size;
+    }
+
+    memcpy(buffer, contents->data + file->position, count);
+    file->position += count;
+    return count;
+}
+
+/**
+ * @brief procfs files cannot be written
+ */
+ssize_t procfs_write(file_t *file, const void *buffer, size_t size) {
+    (void)file;
+    (void)buffer;
+    (void)size;
+    return -1; // EROFS
+}
+
+/**
+ * @brief Seek in a procfs file
+ */
+int64_t procfs_seek(file_t *file, int64_t offset, seek_origin_t origin) {
+    if (!file) {
+        return -1;
+    }
+
+    int64_t new_pos;
+
+    switch (origin) {
+        case SEEK_SET:
+            new_pos = offset;
+            break;
+        case SEEK_CUR:
+            new_pos = file->position + offset;
+            break;
+        case SEEK_END:
+            new_pos = file->size + offset;
+            break;
+        default:
+            return -1;
+    }
+
+    if (new_pos < 0) {
+        return -1;
+    }
+
+    file->position = new_pos;
+    return new_pos;
+}
+
+/**
+ * @brief Get metadata of a procfs file
+ *
+ * Sizes and times are reported as 0 because contents are generated on open.
+ */
+int procfs_stat(filesystem_t *fs, const char *path, file_metadata_t *metadata) {
+    if (!fs || !path || !metadata) {
+        return -1; // EINVAL
+    }
+
+    const char *name = procfs_relative_path(fs, path);
+    bool is_root = name[0] == '\0';
+    if (!is_root && !procfs_lookup(name)) {
+        return -1; // ENOENT
+    }
+
+    memset(metadata, 0, sizeof(file_metadata_t));
+    metadata->type = is_root ? FILE_TYPE_DIRECTORY : FILE_TYPE_REGULAR;
+    metadata->permissions = is_root ? 0555 : 0444;
+    metadata->hard_links = 1;
+    strncpy(metadata->name, path, MAX_FILENAME_LENGTH - 1);
+
+    return 0;
+}
+
+/**
+ * @brief Register a procfs file
+ *
+ * @param name Path below /proc, e.g. "loadavg" or "pressure/cpu"
+ * @param show Function generating the file contents
+ * @return 0 on success, negative error code on failure
+ */
+int proc_create(const char *name, proc_show_t show) {
+    if (!name || !show || name[0] == '\0' || strlen(name) >= PROC_NAME_LENGTH) {
+        return -1; // EINVAL
+    }
+
+    proc_entry_t *free_entry = NULL;
+    uint64_t flags = spin_lock_irqsave(&proc_lock);
+
+    for (uint32_t i = 0; i < PROC_MAX_ENTRIES; i++) {
+        if (!proc_entries[i].show) {
+            if (!free_entry) {
+                free_entry = &proc_entries[i];
+            }
+        } else if (strcmp(proc_entries[i].name, name) == 0) {
+            spin_unlock_irqrestore(&proc_lock, flags);
+            return -1; // EEXIST
+        }
+    }
+
+    if (free_entry) {
+        strncpy(free_entry->name, name, PROC_NAME_LENGTH - 1);
+        free_entry->name[PROC_NAME_LENGTH - 1] = '\0';
+        free_entry->show = show;
+    }
+
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return free_entry ? 0 : -1; // ENOSPC
+}
+
+/**
+ * @brief Remove a procfs file
+ *
+ * Files already open keep their snapshot.
+ *
+ * @param name Path below /proc
+ */
+void proc_remove(const char *name) {
+    if (!name) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&proc_lock);
+    for (uint32_t i = 0; i < PROC_MAX_ENTRIES; i++) {
+        if (proc_entries[i].show && strcmp(proc_entries[i].name, name) == 0) {
+            proc_entries[i].show = NULL;
+            proc_entries[i].name[0] = '\0';
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+}
+
+/**
+ * @brief Append formatted text to a procfs buffer
+ *
+ * Supports %d %i %u %x %X %s %c and %% with optional '-' and '0' flags,
+ * a field width and the l, ll and z length modifiers. Output beyond the
+ * buffer is dropped.
+ *
+ * @param buffer Output buffer
+ * @param fmt Format string
+ * @return Number of characters appended
+ */
+int proc_printf(proc_buffer_t *buffer, const char *fmt, ...) {
+    if (!buffer || !fmt) {
+        return 0;
+    }
+
+    size_t start = buffer->length;
+    va_list args;
+    va_start(args, fmt);
+
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            proc_putc(buffer, *p);
+            continue;
+        }
+
+        bool left = false;
+        bool zero_pad = false;
+        for (p++; *p == '-' || *p == '0'; p++) {
+            if (*p == '-') {
+                left = true;
+            } else {
+                zero_pad = true;
+            }
+        }
+
+        int width = 0;
+        while (*p >= '0' && *p <= '9') {
+            width = width * 10 + (*p++ - '0');
+        }
+
+        int length = 0;
+        while (*p == 'l' || *p == 'z') {
+            length = *p == 'z' ? 2 : length + 1;
+            p++;
+        }
+
+        switch (*p) {
+            case 'd':
+            case 'i': {
+                int64_t value = length ? va_arg(args, long long) : va_arg(args, int);
+                uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+                proc_put_number(buffer, magnitude, value < 0, 10, false, width, zero_pad, left);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X': {
+                uint64_t value = length ? va_arg(args, unsigned long long) : va_arg(args, unsigned int);
+                proc_put_number(buffer, value, false, *p == 'u' ? 10 : 16, *p == 'X',
+                                width, zero_pad, left);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(args, const char*);
+                s = s ? s : "(null)";
+                int pad = width - (int)strlen(s);
+                while (!left && pad-- > 0) proc_putc(buffer, ' ');
+                while (*s) proc_putc(buffer, *s++);
+                while (left && pad-- > 0) proc_putc(buffer, ' ');
+                break;
+            }
+            case 'c':
+                proc_putc(buffer, (char)va_arg(args, int));
+                break;
+            case '%':
+                proc_putc(buffer, '%');
+                break;
+            case '\0':
+                p--;
+                break;
+            default:
+                proc_putc(buffer, '%');
+                proc_putc(buffer, *p);
+                break;
+        }
+    }
+
+    va_end(args);
+    return (int)(buffer->length - start);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Strip the mount point and leading slashes from a path
+ */
+static const char* procfs_relative_path(filesystem_t *fs, const char *path) {
+    if (fs->mount_point) {
+        size_t mount_len = strlen(fs->mount_point->path);
+        if (strncmp(path, fs->mount_point->path, mount_len) == 0) {
+            path += mount_len;
+        }
+    }
+
+    while (*path == '/') {
+        path++;
+    }
+    return path;
+}
+
+/**
+ * @brief Find the show function of an entry
+ */
+static proc_show_t procfs_lookup(const char *name) {
+    proc_show_t show = NULL;
+    uint64_t flags = spin_lock_irqsave(&proc_lock);
+
+    for (uint32_t i = 0; i < PROC_MAX_ENTRIES; i++) {
+        if (proc_entries[i].show && strcmp(proc_entries[i].name, name) == 0) {
+            show = proc_entries[i].show;
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return show;
+}
+
+/**
+ * @brief Append one character, keeping the buffer terminated
+ */
+static void proc_putc(proc_buffer_t *buffer, char c) {
+    if (buffer->length + 1 < buffer->size) {
+        buffer->data[buffer->length++] = c;
+        buffer->data[buffer->length] = '\0';
+    }
+}
+
+/**
+ * @brief Append a number in the given base
+ */
+static void proc_put_number(proc_buffer_t *buffer, uint64_t value, bool negative,
+                            uint32_t base, bool upper, int width, bool zero_pad, bool left) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char text[24];
+    int len = 0;
+
+    do {
+        text[len++] = digits[value % base];
+        value /= base;
+    } while (value);
+
+    int pad = width - len - (negative ? 1 : 0);
+    if (!left && !zero_pad) {
+        while (pad-- > 0) proc_putc(buffer, ' ');
+    }
+    if (negative) {
+        proc_putc(buffer, '-');
+    }
+    if (!left && zero_pad) {
+        while (pad-- > 0) proc_putc(buffer, '0');
+    }
+    while (len) {
+        proc_putc(buffer, text[--len]);
+    }
+    while (left && pad-- > 0) {
+        proc_putc(buffer, ' ');
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file procfs.h
+ * @brief Process File System for FG-OS
+ *
+ * This file defines procfs, a read-only file system of generated files
+ * that export kernel state as text. Subsystems register a show function
+ * per file; its output is produced when the file is opened, so every
+ * reader sees one consistent snapshot.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __PROCFS_H__
+#define __PROCFS_H__
+
+#include "fs.h"
+
+/**
+ * @defgroup procfs Process File System
+ * @brief Generated kernel status files
+ * @{
+ */
+
+// procfs Constants
+#define PROC_MOUNT_POINT        "/proc"
+#define PROC_MAX_ENTRIES        32
+#define PROC_NAME_LENGTH        32
+#define PROC_BUFFER_SIZE        4096
+
+// Output buffer handed to show functions
+typedef struct proc_buffer {
+    char        *data;          /**< Output text */
+    size_t      size;           /**< Buffer capacity */
+    size_t      length;         /**< Bytes written, excluding the terminator */
+} proc_buffer_t;
+
+// Generates the contents of a file
+typedef void (*proc_show_t)(proc_buffer_t *buffer);
+
+// procfs entry
+typedef struct proc_entry {
+    char        name[PROC_NAME_LENGTH]; /**< Path below /proc, e.g. "pressure/cpu" */
+    proc_show_t show;                   /**< Content generator, NULL if unused */
+} proc_entry_t;
+
+// procfs Function Declarations
+int procfs_init(void);
+void procfs_shutdown(void);
+int procfs_mount(filesystem_t *fs, const char *device, uint32_t flags);
+int procfs_unmount(filesystem_t *fs);
+
+// File operations
+int procfs_open(filesystem_t *fs, const char *path, file_access_mode_t mode, file_t **file);
+int procfs_close(file_t *file);
+ssize_t procfs_read(file_t *file, void *buffer, size_t size);
+ssize_t procfs_write(file_t *file, const void *buffer, size_t size);
+int64_t procfs_seek(file_t *file, int64_t offset, seek_origin_t origin);
+int procfs_stat(filesystem_t *fs, const char *path, file_metadata_t *metadata);
+
+// Entry registration (usable before the file system is mounted)
+int proc_create(const char *name, proc_show_t show);
+void proc_remove(const char *name);
+
+// Output helpers for show functions
+int proc_printf(proc_buffer_t *buffer, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/** @} */
+
+#endif /* __PROCFS_H__ */
@@ -15,6 +15,7 @@
 
 #include "hal.h"
 #include "../include/kernel.h"
+#include "../interrupt/clocksource.h"
 
 // Global HAL state variables
 hal_status_t hal_status = HAL_STATUS_UNINITIALIZED;
@@ -36,7 +37,6 @@ static int hal_detect_memory_info(void);
 static int hal_detect_timer_info(void);
 static int hal_detect_interrupt_info(void);
 static void hal_update_uptime(void);
-static uint64_t hal_get_timestamp_us(void);
 
 /**
  * @brief Initialize the Hardware Abstraction Layer
@@ -46,8 +46,8 @@ int hal_initialize(void) {
     int result;
     
     // Record initialization start time
-    hal_init_start_time = 0;
-    hal_uptime_start = hal_init_start_time;
+    hal_init_start_time = hal_get_timestamp_us();
+    hal_uptime_start = 0;
     
     printf("[HAL] Initializing Hardware Abstraction Layer v%s\n", HAL_VERSION_STRING);
     hal_status = HAL_STATUS_INITIALIZING;
@@ -399,7 +399,7 @@ int hal_run_hardware_test(void) {
 int hal_run_performance_test(void) {
     KINFO("Running performance test...");
     
-    uint64_t start_time = hal_get_timestamp_us();
+    uint64_t start_time = hal_get_timestamp_ns();
     
     // Perform a series of HAL operations to measure performance
     for (int i = 0; i < 1000; i++) {
@@ -408,11 +408,12 @@ int hal_run_performance_test(void) {
         hal_get_features();
     }
     
-    uint64_t end_time = hal_get_timestamp_us();
+    uint64_t end_time = hal_get_timestamp_ns();
     uint64_t duration = end_time - start_time;
     
-    KINFO("Performance test completed in %llu microseconds", duration);
-    KINFO("Average operation time: %llu nanoseconds", (duration * 1000) / 3000);
+    KINFO("Performance test completed in %llu nanoseconds (%s clock)",
+          duration, clocksource_get()->name);
+    KINFO("Average operation time: %llu nanoseconds", duration / 3000);
     
     return 0;
 }
@@ -445,7 +446,8 @@ int hal_run_stress_test(uint32_t duration_seconds) {
     
     KINFO("Stress test completed");
     KINFO("Operations performed: %llu", operations);
-    KINFO("Operations per second: %llu", operations * 1000000 / actual_duration);
+    KINFO("Operations per second: %llu",
+          actual_duration ? operations * 1000000 / actual_duration : 0);
     
     return 0;
 }
@@ -670,10 +672,13 @@ static int hal_detect_memory_info(void) {
 static int hal_detect_timer_info(void) {
     hal_timer_info_t* timer = &hal_system_info.timer;
     
-    timer->frequency_hz = 1000000000ULL;  // 1 GHz
-    timer->resolution_ns = 1;
+    const clocksource_t* clock = clocksource_get();
+    
+    // Report the counter behind the monotonic clock, not a nominal rate
+    timer->frequency_hz = clock->frequency_hz;
+    timer->resolution_ns = clock->frequency_hz ? (NSEC_PER_SEC + clock->frequency_hz - 1) / clock->frequency_hz : 0;
     timer->capabilities = 0x0F;
-    timer->high_precision = true;
+    timer->high_precision = clocksource_is_highres();
     timer->monotonic = true;
     timer->real_time = true;
     
@@ -708,12 +713,24 @@ static void hal_update_uptime(void) {
 
 /**
  * @brief Get timestamp in microseconds
- * @return Current timestamp in microseconds
- */
-static uint64_t hal_get_timestamp_us(void) {
-    // For demonstration purposes, return a simulated timestamp
-    // In a real implementation, this would read hardware timers
-    static uint64_t simulated_time = 0;
-    simulated_time += 1000;  // Increment by 1ms each call
-    return simulated_time;
-} 
\ No newline at end of file
+ * @return Microseconds since boot
+ */
+uint64_t hal_get_timestamp(void) {
+    return ktime_get_us();
+}
+
+/**
+ * @brief Get timestamp in microseconds
+ * @return Microseconds since boot
+ */
+uint64_t hal_get_timestamp_us(void) {
+    return ktime_get_us();
+}
+
+/**
+ * @brief Get timestamp in nanoseconds
+ * @return Nanoseconds since boot
+ */
+uint64_t hal_get_timestamp_ns(void) {
+    return ktime_get_ns();
+}
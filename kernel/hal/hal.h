@@ -247,6 +247,11 @@ int hal_get_statistics(hal_statistics_t* stats);
 void hal_reset_statistics(void);
 void hal_reset_performance_counters(void);
 
+// Time (monotonic, from the kernel clock source)
+uint64_t hal_get_timestamp(void);       /**< Microseconds since boot */
+uint64_t hal_get_timestamp_us(void);
+uint64_t hal_get_timestamp_ns(void);
+
 // Hardware detection
 int hal_detect_hardware(void);
 int hal_enumerate_devices(void);
@@ -0,0 +1,133 @@
+/**
+ * @file futex.h
+ * @brief Futex interface and user-space mutex fast path for FG-OS
+ *
+ * A futex is a 32-bit word in user memory. Threads contend on it with
+ * atomic instructions entirely in user space and only enter the kernel
+ * (SYS_FUTEX, SYS_MUTEX_LOCK/UNLOCK) to sleep or to wake sleepers.
+ *
+ * A mutex created with UMUTEX_ATTR_PI stores its owner's TID instead, so
+ * the kernel can boost the owner while higher priority threads wait.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include "types.h"
+#include "syscall.h"
+
+// Futex operations
+#define FUTEX_WAIT              0       /**< Sleep if *uaddr == val */
+#define FUTEX_WAKE              1       /**< Wake up to val waiters */
+#define FUTEX_OP_MASK           0x7F    /**< Operation bits */
+#define FUTEX_PRIVATE_FLAG      0x80    /**< Word is not shared between processes */
+
+#define FUTEX_WAIT_PRIVATE      (FUTEX_WAIT | FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAKE_PRIVATE      (FUTEX_WAKE | FUTEX_PRIVATE_FLAG)
+
+// User mutex word states
+#define UMUTEX_UNLOCKED         0   /**< Free */
+#define UMUTEX_LOCKED           1   /**< Held, no waiters */
+#define UMUTEX_CONTENDED        2   /**< Held, waiters may be sleeping */
+
+// Mutex attributes (SYS_MUTEX_INIT)
+#define UMUTEX_ATTR_PI          0x1         /**< Priority inheritance */
+
+// PI mutex word layout
+#define UMUTEX_PI_WAITERS       0x80000000U /**< Waiters are blocked in the kernel */
+#define UMUTEX_PI_TID_MASK      0x3FFFFFFFU /**< Owner TID, 0 if unlocked */
+
+/**
+ * @brief User-space mutex
+ */
+typedef struct {
+    volatile uint32_t state;        /**< UMUTEX_* lock word */
+} umutex_t;
+
+/**
+ * @brief Initialize a user-space mutex
+ */
+static inline void umutex_init(umutex_t *mutex) {
+    mutex->state = UMUTEX_UNLOCKED;
+}
+
+/**
+ * @brief Lock a user-space mutex; no syscall when uncontended
+ */
+static inline void umutex_lock(umutex_t *mutex) {
+    uint32_t expected = UMUTEX_UNLOCKED;
+
+    if (__atomic_compare_exchange_n(&mutex->state, &expected, UMUTEX_LOCKED, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    SYSCALL1(SYS_MUTEX_LOCK, (uint64_t)&mutex->state);
+}
+
+/**
+ * @brief Try to lock a user-space mutex without blocking
+ */
+static inline bool umutex_trylock(umutex_t *mutex) {
+    uint32_t expected = UMUTEX_UNLOCKED;
+
+    return __atomic_compare_exchange_n(&mutex->state, &expected, UMUTEX_LOCKED, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Unlock a user-space mutex; no syscall unless there are waiters
+ */
+static inline void umutex_unlock(umutex_t *mutex) {
+    if (__atomic_fetch_sub(&mutex->state, 1, __ATOMIC_RELEASE) != UMUTEX_LOCKED) {
+        SYSCALL1(SYS_MUTEX_UNLOCK, (uint64_t)&mutex->state);
+    }
+}
+
+/**
+ * @brief Initialize a priority inheritance user-space mutex
+ *
+ * @return 0 on success, negative error code on failure
+ */
+static inline int64_t umutex_pi_init(umutex_t *mutex) {
+    return SYSCALL2(SYS_MUTEX_INIT, (uint64_t)&mutex->state, UMUTEX_ATTR_PI);
+}
+
+/**
+ * @brief Lock a PI user-space mutex; no syscall when uncontended
+ *
+ * @param tid Caller's thread ID
+ * @return 0 once held, KERN_DEADLK if the lock chain would deadlock
+ */
+static inline int64_t umutex_pi_lock(umutex_t *mutex, uint32_t tid) {
+    uint32_t expected = 0;
+
+    if (__atomic_compare_exchange_n(&mutex->state, &expected, tid, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    return SYSCALL1(SYS_MUTEX_LOCK, (uint64_t)&mutex->state);
+}
+
+/**
+ * @brief Unlock a PI user-space mutex; no syscall unless there are waiters
+ *
+ * @param tid Caller's thread ID
+ */
+static inline void umutex_pi_unlock(umutex_t *mutex, uint32_t tid) {
+    uint32_t expected = tid;
+
+    if (!__atomic_compare_exchange_n(&mutex->state, &expected, 0, false,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        SYSCALL1(SYS_MUTEX_UNLOCK, (uint64_t)&mutex->state);
+    }
+}
+
+#endif /* __FUTEX_H__ */
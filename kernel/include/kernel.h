@@ -34,6 +34,7 @@
 #define USER_STACK_SIZE     0x100000        // 1MB user stack
 #define HEAP_START          0x1000000       // 16MB heap start
 #define HEAP_SIZE           0x10000000      // 256MB heap size
+#define MAX_CPUS            64              // Maximum supported CPUs
 
 // Memory layout constants
 #define KERNEL_VIRTUAL_BASE 0xFFFFFFFF80000000UL
@@ -133,6 +134,7 @@ void print_phase_info(void);
 #define mb()    __asm__ __volatile__("mfence" ::: "memory")
 #define rmb()   __asm__ __volatile__("lfence" ::: "memory")
 #define wmb()   __asm__ __volatile__("sfence" ::: "memory")
+#define barrier() __asm__ __volatile__("" ::: "memory")
 
 // Kernel section attributes
 #define __init      __attribute__((section(".init.text")))
@@ -154,6 +156,7 @@ void print_phase_info(void);
 #define cli()       __asm__ __volatile__("cli" ::: "memory")
 #define sti()       __asm__ __volatile__("sti" ::: "memory")
 #define halt()      __asm__ __volatile__("hlt")
+#define safe_halt() __asm__ __volatile__("sti; hlt" ::: "memory")
 
 // Save and restore interrupt state
 static inline uint64_t save_flags(void) {
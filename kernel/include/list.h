@@ -0,0 +1,89 @@
+/**
+ * @file list.h
+ * @brief Intrusive doubly linked list helpers for FG-OS kernel
+ *
+ * Circular lists built on struct list_head from types.h. An empty list is
+ * a head whose next and prev point to itself.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __LIST_H__
+#define __LIST_H__
+
+#include "types.h"
+
+// Static initializer for a list head
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+
+/**
+ * @brief Initialize an empty list
+ */
+static inline void INIT_LIST_HEAD(struct list_head *list) {
+    list->next = list;
+    list->prev = list;
+}
+
+/**
+ * @brief Insert an entry between two known consecutive entries
+ */
+static inline void __list_add(struct list_head *entry, struct list_head *prev, struct list_head *next) {
+    next->prev = entry;
+    entry->next = next;
+    entry->prev = prev;
+    prev->next = entry;
+}
+
+/**
+ * @brief Insert an entry at the head of a list
+ */
+static inline void list_add(struct list_head *entry, struct list_head *head) {
+    __list_add(entry, head, head->next);
+}
+
+/**
+ * @brief Insert an entry at the tail of a list
+ */
+static inline void list_add_tail(struct list_head *entry, struct list_head *head) {
+    __list_add(entry, head->prev, head);
+}
+
+/**
+ * @brief Remove an entry and leave it self-linked
+ */
+static inline void list_del_init(struct list_head *entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    INIT_LIST_HEAD(entry);
+}
+
+/**
+ * @brief Check whether a list is empty
+ */
+static inline bool list_empty(const struct list_head *head) {
+    return head->next == head;
+}
+
+// Entry access and iteration
+#define list_entry(ptr, type, member) \
+    container_of(ptr, type, member)
+
+#define list_first_entry(head, type, member) \
+    list_entry((head)->next, type, member)
+
+#define list_for_each_entry(pos, head, member) \
+    for (pos = list_entry((head)->next, typeof(*pos), member); \
+         &pos->member != (head); \
+         pos = list_entry(pos->member.next, typeof(*pos), member))
+
+#define list_for_each_entry_safe(pos, n, head, member) \
+    for (pos = list_entry((head)->next, typeof(*pos), member), \
+         n = list_entry(pos->member.next, typeof(*pos), member); \
+         &pos->member != (head); \
+         pos = n, n = list_entry(n->member.next, typeof(*n), member))
+
+#endif /* __LIST_H__ */
@@ -0,0 +1,94 @@
+/**
+ * @file rcu.h
+ * @brief Read-copy-update for read-mostly kernel data in FG-OS
+ *
+ * Readers traverse RCU-protected lists without locks or atomics, bracketed
+ * by rcu_read_lock()/rcu_read_unlock(). Writers serialize among themselves
+ * with a spinlock, publish with rcu_assign_pointer() and free removed
+ * objects only after a grace period, once every CPU has passed through a
+ * quiescent state (context switch, idle, or a tick outside any reader).
+ *
+ * Readers must not sleep. Tick preemption is deferred while a reader runs,
+ * so a read-side section never migrates and its cost is a per-CPU counter.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include "types.h"
+#include "kernel.h"
+#include "../arch/x86_64/arch.h"
+
+typedef void (*rcu_callback_t)(struct rcu_head *head);
+
+/**
+ * @brief RCU statistics
+ */
+struct rcu_stats {
+    uint64_t gp_started;        /**< Grace periods started */
+    uint64_t gp_completed;      /**< Grace periods completed */
+    uint64_t callbacks_queued;  /**< call_rcu() invocations */
+    uint64_t callbacks_invoked; /**< Callbacks run after their grace period */
+    uint64_t max_batch;         /**< Most callbacks retired by one grace period */
+    uint64_t sync_fast;         /**< synchronize_rcu() calls with no other CPU online */
+};
+
+// Read-side nesting depth of each CPU
+extern volatile uint32_t rcu_read_nesting[MAX_CPUS];
+
+/**
+ * @brief Enter an RCU read-side critical section
+ */
+static inline void rcu_read_lock(void) {
+    rcu_read_nesting[smp_processor_id()]++;
+    barrier();
+}
+
+/**
+ * @brief Leave an RCU read-side critical section
+ */
+static inline void rcu_read_unlock(void) {
+    barrier();
+    rcu_read_nesting[smp_processor_id()]--;
+}
+
+/**
+ * @brief Check whether the current CPU is inside a read-side section
+ */
+static inline bool rcu_read_lock_held(void) {
+    return rcu_read_nesting[smp_processor_id()] != 0;
+}
+
+// Pointer publication and traversal
+#define rcu_dereference(p)          __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_assign_pointer(p, v)    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v)      ((p) = (v))
+
+// Free an object embedding a struct rcu_head once readers are done with it
+#define kfree_rcu(ptr, field) \
+    call_rcu(&(ptr)->field, (rcu_callback_t)(uintptr_t)offsetof(__typeof__(*(ptr)), field))
+
+// RCU interface
+void rcu_init(void);
+void call_rcu(struct rcu_head *head, rcu_callback_t func);
+void synchronize_rcu(void);
+
+// Scheduler and tick hooks
+void rcu_note_context_switch(void);
+void rcu_check_callbacks(void);
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+bool rcu_needs_cpu(void);
+void rcu_cpu_online(uint32_t cpu);
+
+// Status
+const struct rcu_stats* rcu_get_stats(void);
+void rcu_dump_status(void);
+
+#endif /* __RCU_H__ */
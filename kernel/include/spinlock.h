@@ -0,0 +1,103 @@
+/**
+ * @file spinlock.h
+ * @brief Ticket and MCS spinlocks for FG-OS kernel
+ *
+ * spinlock_t is a fair ticket lock for short critical sections: waiters
+ * are served in arrival order and the uncontended path is a single xadd.
+ * mcs_lock_t is a queued lock for heavily contended locks: every waiter
+ * spins on its own node instead of the shared lock word, so a release
+ * touches only the next waiter's cache line.
+ *
+ * Building with CONFIG_LOCKSTAT records acquisitions, contentions, wait
+ * and hold time for every lock class. A class is the spin_lock_init() or
+ * mcs_lock_init() call site, so all locks initialized there share stats.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+#include "types.h"
+
+/**
+ * @brief Lock class statistics (CONFIG_LOCKSTAT)
+ */
+struct lock_class {
+    const char         *name;           /**< Lock name from the init site */
+    uint64_t            acquisitions;   /**< Successful acquisitions */
+    uint64_t            contentions;    /**< Acquisitions that had to wait */
+    uint64_t            wait_cycles;    /**< Total TSC cycles spent waiting */
+    uint64_t            max_wait_cycles;/**< Longest single wait */
+    uint64_t            hold_cycles;    /**< Total TSC cycles held */
+    uint64_t            max_hold_cycles;/**< Longest single hold */
+    struct lock_class  *next;           /**< Registered classes list */
+    bool                registered;     /**< Linked into the class list */
+};
+
+/**
+ * @brief MCS queue node; one per waiter, usually on the waiter's stack
+ */
+struct mcs_node {
+    struct mcs_node    *next;           /**< Next waiter in the queue */
+    volatile uint32_t   locked;         /**< Set by the predecessor on handoff */
+};
+
+/**
+ * @brief MCS queued spinlock
+ */
+typedef struct {
+    struct mcs_node    *tail;           /**< Last queued waiter, NULL if free */
+#ifdef CONFIG_LOCKSTAT
+    struct lock_class  *lock_class;     /**< Statistics class */
+    uint64_t            acquired_at;    /**< TSC at acquisition */
+#endif
+} mcs_lock_t;
+
+// Lock initialization; each call site is its own lock class under lockstat
+#ifdef CONFIG_LOCKSTAT
+    #define spin_lock_init(lock) \
+        do { \
+            static struct lock_class __lock_class = { .name = #lock }; \
+            __spin_lock_init((lock), &__lock_class); \
+        } while (0)
+
+    #define mcs_lock_init(lock) \
+        do { \
+            static struct lock_class __lock_class = { .name = #lock }; \
+            __mcs_lock_init((lock), &__lock_class); \
+        } while (0)
+#else
+    #define spin_lock_init(lock)    __spin_lock_init((lock), NULL)
+    #define mcs_lock_init(lock)     __mcs_lock_init((lock), NULL)
+#endif
+
+// Ticket spinlock interface
+void     __spin_lock_init(spinlock_t *lock, struct lock_class *lock_class);
+void     spin_lock(spinlock_t *lock);
+bool     spin_trylock(spinlock_t *lock);
+void     spin_unlock(spinlock_t *lock);
+bool     spin_is_locked(const spinlock_t *lock);
+bool     spin_is_contended(const spinlock_t *lock);
+uint64_t spin_lock_irqsave(spinlock_t *lock);
+void     spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags);
+
+// MCS spinlock interface
+void     __mcs_lock_init(mcs_lock_t *lock, struct lock_class *lock_class);
+void     mcs_spin_lock(mcs_lock_t *lock, struct mcs_node *node);
+bool     mcs_spin_trylock(mcs_lock_t *lock, struct mcs_node *node);
+void     mcs_spin_unlock(mcs_lock_t *lock, struct mcs_node *node);
+bool     mcs_is_locked(const mcs_lock_t *lock);
+uint64_t mcs_spin_lock_irqsave(mcs_lock_t *lock, struct mcs_node *node);
+void     mcs_spin_unlock_irqrestore(mcs_lock_t *lock, struct mcs_node *node, uint64_t flags);
+
+// Lock statistics interface (no-ops without CONFIG_LOCKSTAT)
+void lockstat_reset(void);
+void lockstat_dump(void);
+const struct lock_class* lockstat_first_class(void);
+
+#endif /* __SPINLOCK_H__ */
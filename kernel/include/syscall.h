@@ -54,6 +54,10 @@
 #define SYS_PAUSE           43  // Wait for signal
 #define SYS_SETPRIORITY     44  // Set process priority
 #define SYS_GETPRIORITY     45  // Get process priority
+#define SYS_SCHED_SETAFFINITY 46 // Set thread CPU affinity
+#define SYS_SCHED_GETAFFINITY 47 // Get thread CPU affinity
+#define SYS_SCHED_SETISOLATED 48 // Set CPUs isolated from balancing
+#define SYS_IRQ_SETAFFINITY 49  // Set the CPUs a device interrupt may target
 
 // Thread Management System Calls
 #define SYS_THREAD_CREATE   50  // Create thread
@@ -64,6 +68,7 @@
 #define SYS_MUTEX_LOCK      55  // Lock mutex
 #define SYS_MUTEX_UNLOCK    56  // Unlock mutex
 #define SYS_MUTEX_DESTROY   57  // Destroy mutex
+#define SYS_FUTEX           58  // Wait/wake on a user address
 
 // Inter-Process Communication
 #define SYS_PIPE            60  // Create pipe
@@ -84,6 +89,13 @@
 #define SYS_SETUID          74  // Set user ID
 #define SYS_GETGID          75  // Get group ID
 #define SYS_SETGID          76  // Set group ID
+#define SYS_GETRUSAGE       77  // Get thread, process or CPU time usage
+#define SYS_GETLOADSTATS    78  // Get load averages, CPU utilisation and pressure
+
+// Asynchronous I/O
+#define SYS_IO_URING_SETUP    80 // Create submission/completion rings
+#define SYS_IO_URING_ENTER    81 // Submit SQEs and wait for CQEs
+#define SYS_IO_URING_REGISTER 82 // Register buffers or files, close a ring
 
 // FG-OS Specific System Calls
 #define SYS_FG_INFO         100 // Get FG-OS system information
@@ -92,6 +104,7 @@
 #define SYS_FG_COMPAT       103 // Compatibility layer control
 
 #define SYSCALL_MAX         103 // Maximum system call number
+#define SYSCALL_TABLE_SIZE  (SYSCALL_MAX + 1)
 
 // System Call Return Codes
 #define SYSCALL_SUCCESS     0
@@ -100,6 +113,16 @@
 #define SYSCALL_DENIED     -3
 #define SYSCALL_TIMEOUT    -4
 
+// Clock IDs (SYS_GETTIME, SYS_SETTIME)
+#define CLOCK_REALTIME      0   // Wall clock, settable
+#define CLOCK_MONOTONIC     1   // Time since boot
+#define CLOCK_BOOTTIME      7   // Time since boot (no suspend, same as monotonic)
+
+struct timespec {
+    int64_t tv_sec;             // Seconds
+    int64_t tv_nsec;            // Nanoseconds (0-999999999)
+};
+
 // System Call Handler Function Type
 typedef int64_t (*syscall_handler_t)(uint64_t arg1, uint64_t arg2, 
                                     uint64_t arg3, uint64_t arg4,
@@ -118,13 +141,43 @@ struct syscall_entry {
 #define SYSCALL_FLAG_RESTARTABLE    (1 << 1)  // Can be restarted
 #define SYSCALL_FLAG_PRIVILEGED     (1 << 2)  // Requires privilege
 
+// Saved State at System Call Entry (built by syscall_entry.S, lowest address first)
+struct syscall_frame {
+    uint64_t r9, r8, r10;       // Arguments 6, 5, 4
+    uint64_t rdx, rsi, rdi;     // Arguments 3, 2, 1
+    uint64_t rax;               // System call number in, result out
+    uint64_t rip;               // Return address (rcx at SYSCALL)
+    uint64_t rflags;            // Caller RFLAGS (r11 at SYSCALL)
+    uint64_t rsp;               // Caller stack pointer
+};
+
+// Per-CPU SYSCALL State (GS base while in the kernel)
+struct syscall_cpu {
+    uint64_t kernel_rsp;        // Kernel stack top of the current thread
+    uint64_t user_rsp;          // Scratch: user stack pointer during entry
+    uint32_t cpu;               // CPU number
+};
+
+// Null System Call Benchmark Result
+struct syscall_bench_result {
+    uint32_t iterations;        // Calls measured per method
+    uint64_t syscall_cycles;    // Cycles per SYSCALL round trip
+    uint64_t dispatch_cycles;   // Cycles per direct table dispatch
+    uint64_t syscall_ns;        // Nanoseconds per SYSCALL round trip
+};
+
 // System Call Interface Functions
 int syscall_init(void);
+void syscall_cpu_init(uint32_t cpu);
+void syscall_set_kernel_stack(uint64_t stack_top);
+void syscall_handler(struct syscall_frame *frame, bool from_user);
+int syscall_bench_null(uint32_t iterations, struct syscall_bench_result *result);
 int64_t syscall_dispatch(uint64_t syscall_num, uint64_t arg1, uint64_t arg2,
                         uint64_t arg3, uint64_t arg4, uint64_t arg5, uint64_t arg6);
 int register_syscall(uint64_t num, syscall_handler_t handler, 
                      const char *name, uint8_t arg_count, uint8_t flags);
 void unregister_syscall(uint64_t num);
+const char* syscall_name(uint64_t num);
 
 // System Call Handler Prototypes
 int64_t sys_exit(uint64_t status);
@@ -137,6 +190,30 @@ int64_t sys_getpid(void);
 int64_t sys_sleep(uint64_t milliseconds);
 int64_t sys_yield(void);
 
+// Scheduling Handlers
+int64_t sys_sched_setaffinity(uint64_t tid, uint64_t size, uint64_t uaddr);
+int64_t sys_sched_getaffinity(uint64_t tid, uint64_t size, uint64_t uaddr);
+int64_t sys_sched_setisolated(uint64_t size, uint64_t uaddr);
+int64_t sys_irq_setaffinity(uint64_t irq, uint64_t size, uint64_t uaddr);
+
+// Synchronization Handlers
+int64_t sys_futex(uint64_t uaddr, uint64_t op, uint64_t val, uint64_t timeout_ms);
+int64_t sys_mutex_init(uint64_t uaddr, uint64_t attr);
+int64_t sys_mutex_lock(uint64_t uaddr);
+int64_t sys_mutex_unlock(uint64_t uaddr);
+int64_t sys_mutex_destroy(uint64_t uaddr);
+
+// System Information Handlers
+int64_t sys_gettime(uint64_t clock_id, uint64_t uaddr);
+int64_t sys_settime(uint64_t clock_id, uint64_t uaddr);
+int64_t sys_getrusage(uint64_t who, uint64_t id, uint64_t uaddr);
+int64_t sys_getloadstats(uint64_t uaddr, uint64_t size);
+
+// Asynchronous I/O Handlers
+int64_t sys_io_uring_setup(uint64_t entries, uint64_t uparams);
+int64_t sys_io_uring_enter(uint64_t ring, uint64_t to_submit, uint64_t min_complete, uint64_t flags);
+int64_t sys_io_uring_register(uint64_t ring, uint64_t opcode, uint64_t uaddr, uint64_t nr_args);
+
 // Memory Management Handlers
 int64_t sys_mmap(uint64_t addr, uint64_t length, uint64_t prot, 
                 uint64_t flags, uint64_t fd, uint64_t offset);
@@ -146,6 +223,7 @@ int64_t sys_mprotect(uint64_t addr, uint64_t length, uint64_t prot);
 // FG-OS Specific Handlers
 int64_t sys_fg_info(uint64_t info_type, uint64_t buffer, uint64_t size);
 int64_t sys_fg_debug(uint64_t debug_type, uint64_t param1, uint64_t param2);
+int64_t sys_fg_perf(uint64_t op, uint64_t arg1, uint64_t arg2);
 
 // System Call Macros for User Programs
 #define SYSCALL0(num) \
@@ -0,0 +1,76 @@
+/*
+ * FG-OS System Call Tracing
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Per-CPU call, error and latency counters for every system call, and an
+ * strace-like event stream for selected processes. Both are read through
+ * SYS_FG_PERF or the /proc/syscalls files.
+ */
+
+#ifndef SYSCALL_TRACE_H
+#define SYSCALL_TRACE_H
+
+#include <types.h>
+#include "syscall.h"
+
+// Latency Histogram: bucket i counts calls of [2^i, 2^(i+1)) ns; the
+// last bucket also takes everything longer
+#define SYSCALL_HIST_BUCKETS    32
+
+// Event Ring Size (power of two); the oldest events are overwritten
+#define SYSCALL_TRACE_EVENTS    4096
+
+// Global Tracing State (syscall_trace_flags)
+#define SYSCALL_TRACE_STATS     (1U << 0)   // Per-syscall counters
+#define SYSCALL_TRACE_EVENTS_ON (1U << 1)   // At least one process is traced
+
+// Per-Process Flags (struct process trace_flags)
+#define PROC_TRACE_SYSCALLS     (1U << 0)   // Stream this process's calls
+
+// SYS_FG_PERF Operations (the call is privileged)
+#define FG_PERF_SYSCALL_STATS   0   // (num, uaddr): struct syscall_stats summed over CPUs
+#define FG_PERF_SYSCALL_RESET   1   // Clear all counters
+#define FG_PERF_SYSCALL_ENABLE  2   // (on): counters on or off
+#define FG_PERF_TRACE_PROCESS   3   // (pid, on): stream a process's calls into the ring
+#define FG_PERF_TRACE_READ      4   // (uaddr, max): consume events, returns the count
+
+// Counters of One System Call
+struct syscall_stats {
+    uint64_t calls;                         // Completed calls
+    uint64_t errors;                        // Calls returning a negative value
+    uint64_t total_ns;                      // Time spent in the call
+    uint64_t max_ns;                        // Longest call
+    uint64_t hist[SYSCALL_HIST_BUCKETS];    // log2(ns) latency histogram
+};
+
+// Traced Call
+struct syscall_event {
+    uint64_t seq;               // Position in the stream; gaps mean overwritten events
+    uint64_t timestamp_ns;      // Entry time (ktime_get_ns)
+    uint64_t duration_ns;       // Time in the call
+    uint32_t pid;               // Calling process
+    uint32_t tid;               // Calling thread
+    uint16_t num;               // System call number
+    uint16_t cpu;               // CPU at return
+    uint32_t reserved;
+    uint64_t args[6];           // rdi, rsi, rdx, r10, r8, r9
+    int64_t ret;                // Result
+};
+
+// Tracing State Checked on Every Call
+extern volatile uint32_t syscall_trace_flags;
+
+// Tracing Interface
+void syscall_trace_init(void);
+void syscall_trace_cpu_init(uint32_t cpu);
+void syscall_trace_exit(uint64_t num, const uint64_t *args, int64_t ret, uint64_t start_ns);
+int syscall_trace_enable(bool on);
+int syscall_trace_process(uint32_t pid, bool on);
+int syscall_get_stats(uint64_t num, struct syscall_stats *stats);
+void syscall_trace_reset(void);
+uint32_t syscall_trace_read(struct syscall_event *events, uint32_t max);
+
+#endif // SYSCALL_TRACE_H
@@ -166,7 +166,8 @@ typedef enum {
     KERN_TIMEOUT    = -7,       /**< Operation timed out */
     KERN_IO         = -8,       /**< I/O error */
     KERN_PERM       = -9,       /**< Permission denied */
-    KERN_INTR       = -10       /**< Operation interrupted */
+    KERN_INTR       = -10,      /**< Operation interrupted */
+    KERN_DEADLK     = -11       /**< Operation would deadlock */
 } kern_result_t;
 
 // Generic linked list structure
@@ -195,17 +196,38 @@ typedef struct {
     volatile int64_t counter;   /**< Atomic 64-bit counter value */
 } atomic64_t;
 
-// Spinlock structure
+// Spinlock structure: fair ticket lock (operations in include/spinlock.h)
 typedef struct {
-    volatile uint32_t lock;     /**< Lock value */
+    union {
+        volatile uint32_t lock;         /**< Both tickets; 0 is unlocked */
+        struct {
+            volatile uint16_t owner;    /**< Ticket being served */
+            volatile uint16_t next;     /**< Next ticket to hand out */
+        } tickets;
+    };
     uint32_t          cpu;      /**< CPU holding the lock */
+#ifdef CONFIG_LOCKSTAT
+    struct lock_class *lock_class;  /**< Statistics class */
+    uint64_t          acquired_at;  /**< TSC at acquisition */
+#endif
 } spinlock_t;
 
-// Mutex structure
+// RCU callback head (operations in include/rcu.h)
+struct rcu_head {
+    struct rcu_head  *next;                     /**< Next queued callback */
+    void            (*func)(struct rcu_head *); /**< Invoked after a grace period */
+};
+
+// Wait queue head (operations in sched/wait.h)
+typedef struct wait_queue_head {
+    struct list_head  head;     /**< Waiting entries, non-exclusive first */
+} wait_queue_head_t;
+
+// Mutex structure (operations in sched/mutex.h)
 typedef struct {
-    volatile uint32_t lock;     /**< Lock value */
-    pid_t             owner;    /**< Process owning the mutex */
-    struct list_head  waiters; /**< List of waiting processes */
+    volatile uint32_t  lock;    /**< 0 unlocked, 1 locked, 2 locked with waiters */
+    struct thread     *owner;   /**< Thread owning the mutex */
+    wait_queue_head_t  waiters; /**< Threads waiting for the mutex */
 } mutex_t;
 
 // Memory region structure
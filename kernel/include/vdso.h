@@ -0,0 +1,71 @@
+/*
+ * FG-OS Virtual Dynamic Shared Object
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * The vDSO lets user code read the clock and its CPU number without
+ * entering the kernel. It is one data page (vvar) followed by a small ELF
+ * image whose dynamic symbol table exports the entry points. Both are
+ * mapped read-only at VDSO_BASE; the kernel publishes clock parameters in
+ * the vvar page under a sequence count.
+ */
+
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <types.h>
+#include "syscall.h"
+
+// User Address of the vvar Page; the ELF image follows one page later
+#define VDSO_BASE               0x00007FFFFFE00000ULL
+#define VDSO_IMAGE_OFFSET       PAGE_SIZE
+
+// Clock Modes (how user space may read the clock)
+#define VDSO_CLOCKMODE_NONE     0   // Fall back to SYS_GETTIME
+#define VDSO_CLOCKMODE_TSC      1   // Scale RDTSC with mult/shift
+
+// CPU Number Instructions
+#define VDSO_GETCPU_NONE        0   // Not available without a system call
+#define VDSO_GETCPU_RDTSCP      1   // TSC_AUX via RDTSCP
+#define VDSO_GETCPU_RDPID       2   // TSC_AUX via RDPID
+
+// TSC_AUX Encoding: CPU number in the low bits, NUMA node above
+#define MSR_TSC_AUX             0xC0000103
+#define VDSO_CPU_BITS           12
+#define VDSO_CPU_MASK           ((1U << VDSO_CPU_BITS) - 1)
+
+// Clock Data Published to User Space (the vvar page)
+struct vdso_data {
+    uint32_t seq;               // Odd while the kernel is updating
+    uint32_t clock_mode;        // VDSO_CLOCKMODE_*
+    uint64_t cycle_last;        // TSC value at base_ns
+    uint64_t base_ns;           // Monotonic time at cycle_last
+    uint64_t mult;              // ns = cycles * mult >> shift
+    uint32_t shift;             // Fixed-point shift
+    uint32_t getcpu_mode;       // VDSO_GETCPU_*
+    int64_t realtime_offset_ns; // CLOCK_REALTIME minus CLOCK_MONOTONIC
+};
+
+// vDSO Statistics
+struct vdso_stats {
+    uint64_t clock_updates;     // Writer sections on the vvar page
+    uint32_t image_size;        // Bytes of the ELF image
+    uint32_t symbols;           // Exported symbols
+};
+
+// Kernel Interface
+int vdso_init(void);
+void vdso_cpu_init(uint32_t cpu);
+void vdso_update_clock(void);
+uint64_t vdso_base(void);
+const struct vdso_stats* vdso_get_stats(void);
+void vdso_dump_status(void);
+
+// Entry Points Exported by the Image (called from user space)
+int __vdso_clock_gettime(uint32_t clock_id, struct timespec *ts);
+int __vdso_getcpu(uint32_t *cpu, uint32_t *node);
+int64_t __vdso_time(int64_t *t);
+
+#endif // VDSO_H
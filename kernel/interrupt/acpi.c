@@ -0,0 +1,343 @@
+/**
+ * @file acpi.c
+ * @brief ACPI table discovery and MADT parsing for FG-OS
+ *
+ * The RSDP is searched for in the first kilobyte of the EBDA and in the
+ * BIOS read-only area 0xE0000-0xFFFFF, as on legacy BIOS boots (QEMU q35
+ * with SeaBIOS). ACPI 2.0+ firmware is walked through the XSDT, older
+ * firmware through the RSDT. Only tables below 4GB are reachable.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "acpi.h"
+#include "../include/kernel.h"
+
+/**
+ * @brief RSDP search areas
+ */
+#define ACPI_EBDA_POINTER       0x40E       /**< BDA word holding the EBDA segment */
+#define ACPI_EBDA_SEARCH_SIZE   1024        /**< Bytes of the EBDA searched */
+#define ACPI_BIOS_AREA_START    0xE0000     /**< BIOS read-only area */
+#define ACPI_BIOS_AREA_END      0x100000
+#define ACPI_IDENTITY_LIMIT     0x100000000ULL  /**< End of the identity mapping */
+
+/**
+ * @brief MADT entry types
+ */
+#define MADT_TYPE_LOCAL_APIC        0
+#define MADT_TYPE_IOAPIC            1
+#define MADT_TYPE_OVERRIDE          2
+#define MADT_TYPE_LOCAL_APIC_NMI    4
+#define MADT_TYPE_LAPIC_OVERRIDE    5
+#define MADT_TYPE_LOCAL_X2APIC      9
+#define MADT_TYPE_LOCAL_X2APIC_NMI  10
+
+/**
+ * @brief Root System Description Pointer
+ */
+typedef struct __attribute__((packed)) {
+    char        signature[8];       /**< "RSD PTR " */
+    uint8_t     checksum;           /**< First 20 bytes sum to zero */
+    char        oem_id[6];
+    uint8_t     revision;           /**< 0 for ACPI 1.0, 2 for ACPI 2.0+ */
+    uint32_t    rsdt_address;
+    uint32_t    length;             /**< ACPI 2.0+: size of this structure */
+    uint64_t    xsdt_address;       /**< ACPI 2.0+: XSDT physical address */
+    uint8_t     extended_checksum;  /**< ACPI 2.0+: whole structure sums to zero */
+    uint8_t     reserved[3];
+} acpi_rsdp_t;
+
+/**
+ * @brief MADT layout
+ */
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t header;
+    uint32_t    lapic_address;
+    uint32_t    flags;
+    uint8_t     entries[];
+} acpi_madt_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t     type;
+    uint8_t     length;
+} madt_entry_header_t;
+
+// Root table state
+static const acpi_sdt_header_t* g_root_table = NULL;
+static uint32_t g_root_entry_size = 0;      // 4 for the RSDT, 8 for the XSDT
+static acpi_madt_info_t g_madt;
+static bool g_madt_valid = false;
+static bool g_acpi_initialized = false;
+
+// Forward declarations
+static bool acpi_checksum_ok(const void* table, size_t length);
+static const acpi_rsdp_t* acpi_find_rsdp(void);
+static const acpi_rsdp_t* acpi_scan_rsdp(uint64_t start, uint64_t end);
+static void acpi_parse_madt(const acpi_madt_t* madt);
+
+/**
+ * @brief Locate the ACPI root tables and decode the MADT
+ */
+int acpi_init(void) {
+    if (g_acpi_initialized) {
+        return g_root_table ? 0 : -1;
+    }
+    g_acpi_initialized = true;
+
+    const acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        printf("[WARN] ACPI: RSDP not found\n");
+        return -1;
+    }
+
+    if (rsdp->revision >= 2 && rsdp->xsdt_address &&
+        rsdp->xsdt_address < ACPI_IDENTITY_LIMIT &&
+        acpi_checksum_ok(rsdp, rsdp->length)) {
+        g_root_table = (const acpi_sdt_header_t*)(uintptr_t)rsdp->xsdt_address;
+        g_root_entry_size = 8;
+    } else {
+        g_root_table = (const acpi_sdt_header_t*)(uintptr_t)rsdp->rsdt_address;
+        g_root_entry_size = 4;
+    }
+
+    if (!acpi_checksum_ok(g_root_table, g_root_table->length)) {
+        printf("[WARN] ACPI: %s checksum mismatch\n", g_root_entry_size == 8 ? "XSDT" : "RSDT");
+        g_root_table = NULL;
+        return -1;
+    }
+
+    printf("[INFO] ACPI: revision %u, %s at 0x%08llX\n", rsdp->revision,
+           g_root_entry_size == 8 ? "XSDT" : "RSDT", (uint64_t)(uintptr_t)g_root_table);
+
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (madt) {
+        acpi_parse_madt(madt);
+    } else {
+        printf("[WARN] ACPI: no MADT, interrupt routing stays on the 8259\n");
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find a system description table by signature
+ */
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!g_root_table) {
+        return NULL;
+    }
+
+    uint32_t count = (g_root_table->length - sizeof(acpi_sdt_header_t)) / g_root_entry_size;
+    const uint8_t* entries = (const uint8_t*)g_root_table + sizeof(acpi_sdt_header_t);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t address;
+        if (g_root_entry_size == 8) {
+            memcpy(&address, entries + i * 8, sizeof(address));
+        } else {
+            uint32_t address32;
+            memcpy(&address32, entries + i * 4, sizeof(address32));
+            address = address32;
+        }
+
+        if (address == 0 || address >= ACPI_IDENTITY_LIMIT) {
+            continue;
+        }
+
+        const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)(uintptr_t)address;
+        if (memcmp(table->signature, signature, 4) == 0 &&
+            acpi_checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get the decoded MADT
+ */
+const acpi_madt_info_t* acpi_get_madt(void) {
+    return g_madt_valid ? &g_madt : NULL;
+}
+
+/**
+ * @brief Translate an ISA IRQ to its global system interrupt
+ */
+uint32_t acpi_isa_irq_to_gsi(uint8_t irq, uint16_t* flags) {
+    if (flags) {
+        *flags = 0;
+    }
+
+    if (g_madt_valid) {
+        for (uint32_t i = 0; i < g_madt.override_count; i++) {
+            if (g_madt.overrides[i].source == irq) {
+                if (flags) {
+                    *flags = g_madt.overrides[i].flags;
+                }
+                return g_madt.overrides[i].gsi;
+            }
+        }
+    }
+
+    return irq;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Check that a table's bytes sum to zero
+ */
+static bool acpi_checksum_ok(const void* table, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)table;
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/**
+ * @brief Search the EBDA and the BIOS area for the RSDP
+ */
+static const acpi_rsdp_t* acpi_find_rsdp(void) {
+    // Hide the constant address so GCC does not flag the low-memory read
+    uintptr_t ebda_pointer = ACPI_EBDA_POINTER;
+    __asm__("" : "+r"(ebda_pointer));
+    uint16_t ebda_segment = *(volatile uint16_t*)ebda_pointer;
+    uint64_t ebda = (uint64_t)ebda_segment << 4;
+
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        const acpi_rsdp_t* rsdp = acpi_scan_rsdp(ebda, ebda + ACPI_EBDA_SEARCH_SIZE);
+        if (rsdp) {
+            return rsdp;
+        }
+    }
+
+    return acpi_scan_rsdp(ACPI_BIOS_AREA_START, ACPI_BIOS_AREA_END);
+}
+
+/**
+ * @brief Scan a physical range on 16-byte boundaries for the RSDP signature
+ */
+static const acpi_rsdp_t* acpi_scan_rsdp(uint64_t start, uint64_t end) {
+    for (uint64_t address = start; address + 20 <= end; address += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)(uintptr_t)address;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Decode the MADT entries into g_madt
+ */
+static void acpi_parse_madt(const acpi_madt_t* madt) {
+    memset(&g_madt, 0, sizeof(g_madt));
+    g_madt.lapic_address = madt->lapic_address;
+    g_madt.flags = madt->flags;
+
+    const uint8_t* entry = madt->entries;
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+
+    while (entry + sizeof(madt_entry_header_t) <= end) {
+        const madt_entry_header_t* header = (const madt_entry_header_t*)entry;
+        if (header->length < sizeof(madt_entry_header_t) || entry + header->length > end) {
+            printf("[WARN] ACPI: malformed MADT entry (type %u)\n", header->type);
+            break;
+        }
+
+        switch (header->type) {
+            case MADT_TYPE_LOCAL_APIC: {
+                // processor UID, APIC ID, flags (32-bit)
+                uint32_t flags;
+                memcpy(&flags, entry + 4, sizeof(flags));
+                if ((flags & (ACPI_MADT_CPU_ENABLED | ACPI_MADT_CPU_ONLINE_CAPABLE)) &&
+                    g_madt.cpu_count < MAX_CPUS) {
+                    acpi_cpu_t* cpu = &g_madt.cpus[g_madt.cpu_count++];
+                    cpu->processor_uid = entry[2];
+                    cpu->apic_id = entry[3];
+                    cpu->flags = flags;
+                }
+                break;
+            }
+
+            case MADT_TYPE_LOCAL_X2APIC: {
+                // reserved (2), x2APIC ID, flags, processor UID
+                uint32_t apic_id, flags, uid;
+                memcpy(&apic_id, entry + 4, sizeof(apic_id));
+                memcpy(&flags, entry + 8, sizeof(flags));
+                memcpy(&uid, entry + 12, sizeof(uid));
+                if ((flags & (ACPI_MADT_CPU_ENABLED | ACPI_MADT_CPU_ONLINE_CAPABLE)) &&
+                    g_madt.cpu_count < MAX_CPUS) {
+                    acpi_cpu_t* cpu = &g_madt.cpus[g_madt.cpu_count++];
+                    cpu->processor_uid = uid;
+                    cpu->apic_id = apic_id;
+                    cpu->flags = flags;
+                }
+                break;
+            }
+
+            case MADT_TYPE_IOAPIC: {
+                // I/O APIC ID, reserved, address, GSI base
+                if (g_madt.ioapic_count < ACPI_MAX_IOAPICS) {
+                    acpi_ioapic_t* ioapic = &g_madt.ioapics[g_madt.ioapic_count++];
+                    ioapic->id = entry[2];
+                    memcpy(&ioapic->address, entry + 4, sizeof(ioapic->address));
+                    memcpy(&ioapic->gsi_base, entry + 8, sizeof(ioapic->gsi_base));
+                }
+                break;
+            }
+
+            case MADT_TYPE_OVERRIDE: {
+                // bus (0 = ISA), source IRQ, GSI, flags
+                if (entry[2] == 0 && g_madt.override_count < ACPI_MAX_OVERRIDES) {
+                    acpi_override_t* override = &g_madt.overrides[g_madt.override_count++];
+                    override->source = entry[3];
+                    memcpy(&override->gsi, entry + 4, sizeof(override->gsi));
+                    memcpy(&override->flags, entry + 8, sizeof(override->flags));
+                }
+                break;
+            }
+
+            case MADT_TYPE_LOCAL_APIC_NMI: {
+                // processor UID (0xFF = all), flags, LINT pin
+                memcpy(&g_madt.nmi_flags, entry + 3, sizeof(g_madt.nmi_flags));
+                g_madt.nmi_lint = entry[5] & 1;
+                g_madt.nmi_valid = true;
+                break;
+            }
+
+            case MADT_TYPE_LOCAL_X2APIC_NMI: {
+                // flags, processor UID (0xFFFFFFFF = all), LINT pin
+                memcpy(&g_madt.nmi_flags, entry + 2, sizeof(g_madt.nmi_flags));
+                g_madt.nmi_lint = entry[8] & 1;
+                g_madt.nmi_valid = true;
+                break;
+            }
+
+            case MADT_TYPE_LAPIC_OVERRIDE: {
+                // reserved (2), 64-bit local APIC address
+                memcpy(&g_madt.lapic_address, entry + 4, sizeof(g_madt.lapic_address));
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        entry += header->length;
+    }
+
+    g_madt_valid = true;
+
+    printf("[INFO] ACPI: MADT lists %u CPUs, %u I/O APICs, %u overrides (LAPIC 0x%08llX)\n",
+           g_madt.cpu_count, g_madt.ioapic_count, g_madt.override_count, g_madt.lapic_address);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file acpi.h
+ * @brief ACPI table discovery and MADT parsing for FG-OS
+ *
+ * Locates the RSDP in the BIOS areas, walks the RSDT or XSDT and decodes
+ * the Multiple APIC Description Table: local APICs, I/O APICs, ISA
+ * interrupt source overrides and local APIC NMI lines. Tables are read
+ * through the identity mapping of the low 4GB set up by vmm_init().
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __ACPI_H__
+#define __ACPI_H__
+
+#include <types.h>
+#include "../include/kernel.h"
+
+/**
+ * @brief ACPI limits
+ */
+#define ACPI_MAX_IOAPICS        8       /**< I/O APICs tracked from the MADT */
+#define ACPI_MAX_OVERRIDES      16      /**< Interrupt source overrides tracked */
+#define ACPI_ISA_IRQS           16      /**< Legacy ISA interrupt lines */
+
+/**
+ * @brief MADT flags and interrupt source override (MPS INTI) flags
+ */
+#define ACPI_MADT_PCAT_COMPAT       0x01    /**< Dual 8259 PICs are present */
+#define ACPI_MADT_CPU_ENABLED       0x01    /**< Processor is usable */
+#define ACPI_MADT_CPU_ONLINE_CAPABLE 0x02   /**< Processor can be enabled later */
+#define ACPI_MPS_POLARITY_MASK      0x03    /**< Polarity field */
+#define ACPI_MPS_POLARITY_HIGH      0x01    /**< Active high */
+#define ACPI_MPS_POLARITY_LOW       0x03    /**< Active low */
+#define ACPI_MPS_TRIGGER_MASK       0x0C    /**< Trigger mode field */
+#define ACPI_MPS_TRIGGER_EDGE       0x04    /**< Edge triggered */
+#define ACPI_MPS_TRIGGER_LEVEL      0x0C    /**< Level triggered */
+
+/**
+ * @brief Common header of every system description table
+ */
+typedef struct __attribute__((packed)) {
+    char        signature[4];       /**< Table signature, e.g. "APIC" */
+    uint32_t    length;             /**< Length including this header */
+    uint8_t     revision;           /**< Table revision */
+    uint8_t     checksum;           /**< All bytes sum to zero */
+    char        oem_id[6];          /**< OEM identifier */
+    char        oem_table_id[8];    /**< OEM table identifier */
+    uint32_t    oem_revision;       /**< OEM revision */
+    uint32_t    creator_id;         /**< Table compiler vendor */
+    uint32_t    creator_revision;   /**< Table compiler revision */
+} acpi_sdt_header_t;
+
+/**
+ * @brief Processor local APIC from the MADT
+ */
+typedef struct {
+    uint32_t    apic_id;            /**< Local APIC (or x2APIC) ID */
+    uint32_t    processor_uid;      /**< ACPI processor UID */
+    uint32_t    flags;              /**< ACPI_MADT_CPU_* */
+} acpi_cpu_t;
+
+/**
+ * @brief I/O APIC from the MADT
+ */
+typedef struct {
+    uint8_t     id;                 /**< I/O APIC ID */
+    uint32_t    address;            /**< MMIO base address */
+    uint32_t    gsi_base;           /**< First global system interrupt served */
+} acpi_ioapic_t;
+
+/**
+ * @brief ISA interrupt source override
+ */
+typedef struct {
+    uint8_t     source;             /**< ISA IRQ */
+    uint32_t    gsi;                /**< Global system interrupt it is wired to */
+    uint16_t    flags;              /**< ACPI_MPS_* polarity and trigger */
+} acpi_override_t;
+
+/**
+ * @brief Decoded MADT
+ */
+typedef struct {
+    uint64_t        lapic_address;                      /**< Local APIC MMIO base */
+    uint32_t        flags;                              /**< ACPI_MADT_PCAT_COMPAT */
+    uint32_t        cpu_count;                          /**< Entries in cpus */
+    acpi_cpu_t      cpus[MAX_CPUS];                     /**< Processors, BSP usually first */
+    uint32_t        ioapic_count;                       /**< Entries in ioapics */
+    acpi_ioapic_t   ioapics[ACPI_MAX_IOAPICS];          /**< I/O APICs */
+    uint32_t        override_count;                     /**< Entries in overrides */
+    acpi_override_t overrides[ACPI_MAX_OVERRIDES];      /**< ISA interrupt source overrides */
+    bool            nmi_valid;                          /**< A local APIC NMI entry was found */
+    uint8_t         nmi_lint;                           /**< LINT pin (0 or 1) wired to NMI */
+    uint16_t        nmi_flags;                          /**< ACPI_MPS_* of the NMI line */
+} acpi_madt_info_t;
+
+/**
+ * @brief Locate the ACPI root tables and decode the MADT
+ *
+ * Safe to call more than once; later calls return the first result.
+ *
+ * @return 0 on success, negative error code if no valid RSDP was found
+ */
+int acpi_init(void);
+
+/**
+ * @brief Find a system description table by signature
+ *
+ * @param signature Four-character table signature
+ * @return Table header, NULL if absent or its checksum is bad
+ */
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+/**
+ * @brief Get the decoded MADT
+ *
+ * @return MADT information, NULL if the firmware provided none
+ */
+const acpi_madt_info_t* acpi_get_madt(void);
+
+/**
+ * @brief Translate an ISA IRQ to its global system interrupt
+ *
+ * @param irq ISA IRQ (0-15)
+ * @param flags Receives the ACPI_MPS_* flags of the line (may be NULL)
+ * @return Global system interrupt, identity-mapped without an override
+ */
+uint32_t acpi_isa_irq_to_gsi(uint8_t irq, uint16_t* flags);
+
+#endif /* __ACPI_H__ */
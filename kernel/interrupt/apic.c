@@ -0,0 +1,698 @@
+/**
+ * @file apic.c
+ * @brief Local APIC and I/O APIC interrupt delivery for FG-OS
+ *
+ * The 8259 is still remapped by pic_init() so that anything it raises
+ * before being masked lands on IRQ vectors rather than exceptions, then
+ * every 8259 line is masked for good. In x2APIC mode local APIC registers
+ * are MSRs: EOI is one WRMSR and needs no MMIO mapping. In xAPIC mode the
+ * register page and the I/O APIC windows are remapped uncached.
+ *
+ * Redirection entries use physical destination mode with 8-bit APIC IDs;
+ * x2APIC IDs above 255 would need interrupt remapping and are not routed.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "apic.h"
+#include "acpi.h"
+#include "clocksource.h"
+#include "hrtimer.h"
+#include "interrupt.h"
+#include "tick.h"
+#include "../include/kernel.h"
+#include "../include/rcu.h"
+#include "../include/spinlock.h"
+#include "../include/syscall.h"
+#include "../include/vdso.h"
+#include "../arch/x86_64/arch.h"
+#include "../mm/memory.h"
+#include "../sched/topology.h"
+
+/**
+ * @brief CPUID leaf 1 feature bits
+ */
+#define CPUID_EDX_APIC          (1U << 9)
+#define CPUID_ECX_X2APIC        (1U << 21)
+#define CPUID_ECX_TSC_DEADLINE  (1U << 24)
+
+// Upper bound on PIT polls while calibrating, in case the PIT never counts
+#define APIC_CALIBRATE_MAX_SPINS    10000000U
+
+/**
+ * @brief I/O APIC state
+ */
+typedef struct {
+    volatile uint32_t*  base;           /**< Register window */
+    uint8_t             id;             /**< I/O APIC ID */
+    uint32_t            gsi_base;       /**< First GSI served */
+    uint32_t            entries;        /**< Redirection entries */
+} ioapic_t;
+
+// APIC state
+static bool g_apic_enabled = false;
+static bool g_x2apic = false;
+static bool g_tsc_deadline = false;
+static volatile uint32_t* g_lapic_mmio = NULL;
+static uint32_t g_bsp_apic_id = 0;
+static uint64_t g_timer_hz = 0;
+static ioapic_t g_ioapics[ACPI_MAX_IOAPICS];
+static uint32_t g_ioapic_count = 0;
+static spinlock_t g_ioapic_lock;
+static apic_stats_t g_apic_stats;
+
+// Last timer LVT written per CPU, so re-arming in the same mode skips the write
+static uint32_t g_lvt_timer[MAX_CPUS];
+
+// Forward declarations
+static uint32_t lapic_read(uint32_t reg);
+static void lapic_write(uint32_t reg, uint32_t value);
+static volatile uint32_t* apic_map_mmio(uint64_t phys);
+static bool lapic_set_timer_mode(uint32_t mode);
+static uint32_t ioapic_read(const ioapic_t* ioapic, uint8_t reg);
+static void ioapic_write(const ioapic_t* ioapic, uint8_t reg, uint32_t value);
+static uint64_t ioapic_read_rte(const ioapic_t* ioapic, uint32_t pin);
+static void ioapic_write_rte(const ioapic_t* ioapic, uint32_t pin, uint64_t rte);
+static ioapic_t* ioapic_for_gsi(uint32_t gsi, uint32_t* pin);
+static void apic_timer_interrupt_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context);
+static void apic_error_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context);
+static void apic_spurious_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context);
+
+/**
+ * @brief Take over interrupt delivery from the 8259
+ */
+int apic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    printf("[INFO] Initializing APIC...\n");
+    memset(&g_apic_stats, 0, sizeof(g_apic_stats));
+    spin_lock_init(&g_ioapic_lock);
+
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_APIC)) {
+        printf("[WARN] APIC: not supported by the CPU, keeping the 8259 PIC\n");
+        return -1;
+    }
+
+    const acpi_madt_info_t* madt = (acpi_init() == 0) ? acpi_get_madt() : NULL;
+    if (!madt || madt->ioapic_count == 0) {
+        printf("[WARN] APIC: no I/O APIC described by ACPI, keeping the 8259 PIC\n");
+        return -2;
+    }
+
+    // Local APIC: MSRs in x2APIC mode, otherwise the uncached register page
+    g_x2apic = (ecx & CPUID_ECX_X2APIC) != 0;
+    g_tsc_deadline = (ecx & CPUID_ECX_TSC_DEADLINE) != 0;
+    if (!g_x2apic) {
+        uint64_t lapic_phys = madt->lapic_address;
+        if (lapic_phys == 0) {
+            lapic_phys = rdmsr(MSR_APIC_BASE) & APIC_BASE_ADDR_MASK;
+        }
+        g_lapic_mmio = apic_map_mmio(lapic_phys);
+        if (!g_lapic_mmio) {
+            printf("[ERROR] APIC: cannot map local APIC at 0x%08llX\n", lapic_phys);
+            return -3;
+        }
+    }
+
+    // I/O APICs, every redirection entry masked until a driver enables its line
+    g_ioapic_count = 0;
+    for (uint32_t i = 0; i < madt->ioapic_count; i++) {
+        ioapic_t* ioapic = &g_ioapics[g_ioapic_count];
+        ioapic->base = apic_map_mmio(madt->ioapics[i].address);
+        if (!ioapic->base) {
+            printf("[WARN] APIC: cannot map I/O APIC %u\n", madt->ioapics[i].id);
+            continue;
+        }
+        ioapic->id = madt->ioapics[i].id;
+        ioapic->gsi_base = madt->ioapics[i].gsi_base;
+        ioapic->entries = ((ioapic_read(ioapic, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+
+        for (uint32_t pin = 0; pin < ioapic->entries; pin++) {
+            ioapic_write_rte(ioapic, pin, IOAPIC_RTE_MASKED);
+        }
+        g_ioapic_count++;
+    }
+    if (g_ioapic_count == 0) {
+        return -4;
+    }
+
+    apic_local_init();
+    g_bsp_apic_id = apic_get_id();
+
+    // ISA IRQs keep their vectors; IRQ 2 is the cascade and the usual home of IRQ 0's override
+    for (uint8_t irq = 0; irq < ACPI_ISA_IRQS; irq++) {
+        if (irq == 2) {
+            continue;
+        }
+        uint16_t flags;
+        uint32_t gsi = acpi_isa_irq_to_gsi(irq, &flags);
+        ioapic_route_gsi(gsi, (uint8_t)(IRQ_TIMER + irq), g_bsp_apic_id, flags, true);
+    }
+
+    // From here on the 8259 stays masked; nothing is delivered through LINT0
+    pic_set_irq_mask(0xFFFF);
+
+    idt_register_handler(APIC_TIMER_VECTOR, apic_timer_interrupt_handler);
+    idt_register_handler(APIC_ERROR_VECTOR, apic_error_handler);
+    idt_register_handler(APIC_SPURIOUS_VECTOR, apic_spurious_handler);
+
+    g_apic_enabled = true;
+
+    printf("[INFO] APIC enabled: %s mode, BSP APIC ID %u, %u I/O APIC(s)\n",
+           g_x2apic ? "x2APIC" : "xAPIC", g_bsp_apic_id, g_ioapic_count);
+    return 0;
+}
+
+/**
+ * @brief Enable and configure the calling CPU's local APIC
+ */
+void apic_local_init(void) {
+    uint64_t base = rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE;
+    if (g_x2apic) {
+        base |= APIC_BASE_X2APIC;
+    }
+    wrmsr(MSR_APIC_BASE, base);
+
+    if (!g_x2apic) {
+        lapic_write(LAPIC_DFR, 0xFFFFFFFF);     // Flat model
+    }
+    lapic_write(LAPIC_TPR, 0);                  // Accept every priority class
+
+    // LINT0 carried the 8259 in virtual wire mode; the NMI pin comes from the MADT
+    const acpi_madt_info_t* madt = acpi_get_madt();
+    uint32_t nmi_lint = (madt && madt->nmi_valid) ? madt->nmi_lint : 1;
+    uint32_t nmi = LAPIC_LVT_NMI;
+    if (madt && madt->nmi_valid) {
+        if ((madt->nmi_flags & ACPI_MPS_POLARITY_MASK) == ACPI_MPS_POLARITY_LOW) {
+            nmi |= LAPIC_LVT_ACTIVE_LOW;
+        }
+        if ((madt->nmi_flags & ACPI_MPS_TRIGGER_MASK) == ACPI_MPS_TRIGGER_LEVEL) {
+            nmi |= LAPIC_LVT_LEVEL;
+        }
+    }
+    lapic_write(LAPIC_LVT_LINT0, nmi_lint == 0 ? nmi : LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, nmi_lint == 1 ? nmi : LAPIC_LVT_MASKED);
+
+    lapic_set_timer_mode(LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_ERROR, APIC_ERROR_VECTOR);
+
+    // The error status register latches on write; clear it twice (back-to-back errors)
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    // Retire anything the firmware left in service
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/**
+ * @brief Bring the calling CPU online
+ */
+void apic_cpu_online(uint32_t cpu) {
+    if (cpu >= MAX_CPUS || !g_apic_enabled) {
+        return;
+    }
+
+    apic_local_init();
+    timer_set_periodic(timer_get_manager()->frequency);
+
+    syscall_cpu_init(cpu);
+    vdso_cpu_init(cpu);
+    topology_cpu_online(cpu);
+    rcu_cpu_online(cpu);
+}
+
+/**
+ * @brief Check whether the APIC has replaced the 8259
+ */
+bool apic_is_enabled(void) {
+    return g_apic_enabled;
+}
+
+/**
+ * @brief Check whether the local APIC runs in x2APIC mode
+ */
+bool apic_x2apic_mode(void) {
+    return g_apic_enabled && g_x2apic;
+}
+
+/**
+ * @brief Get the calling CPU's local APIC ID
+ */
+uint32_t apic_get_id(void) {
+    if (g_x2apic) {
+        return lapic_read(LAPIC_ID);            // Full 32-bit x2APIC ID
+    }
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/**
+ * @brief Signal end of interrupt to the local APIC
+ */
+void apic_eoi(void) {
+    if (g_x2apic) {
+        wrmsr(X2APIC_MSR_BASE + (LAPIC_EOI >> 4), 0);
+    } else {
+        g_lapic_mmio[LAPIC_EOI / 4] = 0;
+    }
+}
+
+/**
+ * @brief Send a fixed interrupt to another CPU
+ */
+void apic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    if (!g_apic_enabled) {
+        return;
+    }
+
+    uint32_t command = LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector;
+
+    if (g_x2apic) {
+        // One 64-bit write with the destination in the upper half; no delivery status
+        wrmsr(X2APIC_MSR_BASE + (LAPIC_ICR_LOW >> 4), ((uint64_t)apic_id << 32) | command);
+    } else {
+        uint64_t flags = interrupts_disable();
+        while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+            __asm__ volatile ("pause");
+        }
+        lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+        lapic_write(LAPIC_ICR_LOW, command);
+        interrupts_restore(flags);
+    }
+
+    g_apic_stats.ipis_sent++;
+}
+
+/**
+ * @brief Mask or unmask an ISA IRQ at the I/O APIC
+ */
+void ioapic_set_irq_masked(uint8_t irq, bool masked) {
+    if (!g_apic_enabled || irq >= ACPI_ISA_IRQS) {
+        return;
+    }
+
+    uint32_t pin;
+    ioapic_t* ioapic = ioapic_for_gsi(acpi_isa_irq_to_gsi(irq, NULL), &pin);
+    if (!ioapic) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&g_ioapic_lock);
+    uint64_t rte = ioapic_read_rte(ioapic, pin);
+    rte = masked ? (rte | IOAPIC_RTE_MASKED) : (rte & ~IOAPIC_RTE_MASKED);
+    ioapic_write_rte(ioapic, pin, rte);
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+}
+
+/**
+ * @brief Deliver an ISA IRQ to another CPU
+ */
+int ioapic_set_irq_dest(uint8_t irq, uint32_t apic_id) {
+    if (!g_apic_enabled || irq >= ACPI_ISA_IRQS || apic_id > 0xFF) {
+        return -1;
+    }
+
+    uint32_t pin;
+    ioapic_t* ioapic = ioapic_for_gsi(acpi_isa_irq_to_gsi(irq, NULL), &pin);
+    if (!ioapic) {
+        return -1;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&g_ioapic_lock);
+    uint64_t rte = ioapic_read_rte(ioapic, pin);
+    rte &= ~(0xFFULL << IOAPIC_RTE_DEST_SHIFT);
+    rte |= (uint64_t)apic_id << IOAPIC_RTE_DEST_SHIFT;
+    ioapic_write_rte(ioapic, pin, rte);
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+    return 0;
+}
+
+/**
+ * @brief Route a global system interrupt to a vector on one CPU
+ */
+int ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, uint16_t flags, bool masked) {
+    uint32_t pin;
+    ioapic_t* ioapic = ioapic_for_gsi(gsi, &pin);
+    if (!ioapic || apic_id > 0xFF) {
+        return -1;
+    }
+
+    uint64_t rte = vector | ((uint64_t)apic_id << IOAPIC_RTE_DEST_SHIFT);
+    if ((flags & ACPI_MPS_POLARITY_MASK) == ACPI_MPS_POLARITY_LOW) {
+        rte |= IOAPIC_RTE_ACTIVE_LOW;
+    }
+    if ((flags & ACPI_MPS_TRIGGER_MASK) == ACPI_MPS_TRIGGER_LEVEL) {
+        rte |= IOAPIC_RTE_LEVEL;
+    }
+    if (masked) {
+        rte |= IOAPIC_RTE_MASKED;
+    }
+
+    uint64_t lock_flags = spin_lock_irqsave(&g_ioapic_lock);
+    ioapic_write_rte(ioapic, pin, rte);
+    spin_unlock_irqrestore(&g_ioapic_lock, lock_flags);
+    return 0;
+}
+
+/**
+ * @brief Calibrate the local APIC timer
+ */
+void apic_timer_calibrate(void) {
+    uint64_t flags = interrupts_disable();
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_set_timer_mode(LAPIC_LVT_MASKED | LAPIC_TIMER_ONESHOT);
+
+    uint64_t reference_hz;
+    uint64_t elapsed_ref = 0;
+    uint64_t target;
+
+    if (clocksource_is_highres()) {
+        // The clock source is already calibrated and far finer than the PIT
+        reference_hz = NSEC_PER_SEC;
+        target = APIC_CALIBRATE_MS * NSEC_PER_MSEC;
+
+        uint64_t start = ktime_get_ns();
+        lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+        for (uint32_t spins = 0; spins < APIC_CALIBRATE_MAX_SPINS; spins++) {
+            elapsed_ref = ktime_get_ns() - start;
+            if (elapsed_ref >= target) {
+                break;
+            }
+            __asm__ volatile ("pause");
+        }
+    } else {
+        // IRQ 0 is masked at the I/O APIC; the PIT only serves as a reference here
+        reference_hz = TIMER_DIVISOR;
+        target = (uint64_t)TIMER_DIVISOR * APIC_CALIBRATE_MS / 1000;
+
+        pit_set_oneshot(PIT_MAX_COUNTS);
+        uint16_t start = pit_read_counter();
+        lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+        for (uint32_t spins = 0; spins < APIC_CALIBRATE_MAX_SPINS; spins++) {
+            uint16_t now = pit_read_counter();
+            elapsed_ref = (now <= start) ? (uint32_t)(start - now) : 0;
+            if (elapsed_ref >= target) {
+                break;
+            }
+            __asm__ volatile ("pause");
+        }
+    }
+
+    uint32_t elapsed_apic = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+
+    interrupts_restore(flags);
+
+    if (elapsed_ref < target / 2 || elapsed_apic == 0) {
+        g_timer_hz = APIC_TIMER_DEFAULT_HZ;
+        printf("[WARN] APIC timer calibration failed, assuming %llu Hz\n", g_timer_hz);
+        return;
+    }
+
+    g_timer_hz = (uint64_t)elapsed_apic * reference_hz / elapsed_ref;
+    printf("[INFO] APIC timer: %llu Hz after divide-by-16 (measured against the %s)\n",
+           g_timer_hz, clocksource_is_highres() ? "clock source" : "PIT");
+}
+
+/**
+ * @brief Get the local APIC timer count rate
+ */
+uint64_t apic_timer_frequency(void) {
+    return g_timer_hz;
+}
+
+/**
+ * @brief Run the calling CPU's local APIC timer periodically
+ */
+void apic_timer_set_periodic(uint32_t frequency) {
+    if (frequency == 0) {
+        return;
+    }
+
+    uint64_t counts = g_timer_hz / frequency;
+    if (counts == 0) {
+        counts = 1;
+    } else if (counts > 0xFFFFFFFF) {
+        counts = 0xFFFFFFFF;
+    }
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_set_timer_mode(LAPIC_TIMER_PERIODIC);
+    lapic_write(LAPIC_TIMER_INITIAL, (uint32_t)counts);
+}
+
+/**
+ * @brief Arm the calling CPU's local APIC timer once
+ */
+void apic_timer_set_oneshot(uint32_t counts) {
+    lapic_set_timer_mode(LAPIC_TIMER_ONESHOT);
+    lapic_write(LAPIC_TIMER_INITIAL, counts);
+}
+
+/**
+ * @brief Check whether the local APIC timer supports TSC-deadline mode
+ */
+bool apic_timer_tsc_deadline(void) {
+    return g_apic_enabled && g_tsc_deadline;
+}
+
+/**
+ * @brief Arm the calling CPU's local APIC timer for a TSC value
+ */
+void apic_timer_set_deadline(uint64_t tsc) {
+    if (lapic_set_timer_mode(LAPIC_TIMER_TSC_DEADLINE)) {
+        // The mode switch must be visible before the deadline MSR is written
+        __asm__ volatile ("mfence" ::: "memory");
+    }
+    wrmsr(MSR_TSC_DEADLINE, tsc);
+}
+
+/**
+ * @brief Read the calling CPU's local APIC timer
+ */
+uint32_t apic_timer_read_counter(void) {
+    return lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+/**
+ * @brief Mask all I/O APIC entries and stop the local APIC timer
+ */
+void apic_shutdown(void) {
+    if (!g_apic_enabled) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&g_ioapic_lock);
+    for (uint32_t i = 0; i < g_ioapic_count; i++) {
+        for (uint32_t pin = 0; pin < g_ioapics[i].entries; pin++) {
+            ioapic_write_rte(&g_ioapics[i], pin, ioapic_read_rte(&g_ioapics[i], pin) | IOAPIC_RTE_MASKED);
+        }
+    }
+    spin_unlock_irqrestore(&g_ioapic_lock, flags);
+
+    lapic_set_timer_mode(LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+}
+
+/**
+ * @brief Get APIC statistics
+ */
+const apic_stats_t* apic_get_stats(void) {
+    return &g_apic_stats;
+}
+
+/**
+ * @brief Dump APIC configuration and statistics for debugging
+ */
+void apic_dump_status(void) {
+    printf("\n=== APIC ===\n");
+    if (!g_apic_enabled) {
+        printf("Not in use (8259 PIC delivers interrupts)\n");
+        return;
+    }
+
+    printf("Mode: %s, BSP APIC ID %u, timer %llu Hz\n",
+           g_x2apic ? "x2APIC" : "xAPIC", g_bsp_apic_id, g_timer_hz);
+
+    for (uint32_t i = 0; i < g_ioapic_count; i++) {
+        printf("I/O APIC %u: GSI %u-%u\n", g_ioapics[i].id, g_ioapics[i].gsi_base,
+               g_ioapics[i].gsi_base + g_ioapics[i].entries - 1);
+    }
+
+    for (uint8_t irq = 0; irq < ACPI_ISA_IRQS; irq++) {
+        uint32_t pin;
+        uint32_t gsi = acpi_isa_irq_to_gsi(irq, NULL);
+        ioapic_t* ioapic = ioapic_for_gsi(gsi, &pin);
+        if (irq == 2 || !ioapic) {
+            continue;
+        }
+        uint64_t rte = ioapic_read_rte(ioapic, pin);
+        if (!(rte & IOAPIC_RTE_MASKED)) {
+            printf("IRQ %2u -> GSI %2u, vector 0x%02llX, %s/%s, APIC ID %llu\n", irq, gsi,
+                   rte & 0xFF, (rte & IOAPIC_RTE_LEVEL) ? "level" : "edge",
+                   (rte & IOAPIC_RTE_ACTIVE_LOW) ? "low" : "high", rte >> IOAPIC_RTE_DEST_SHIFT);
+        }
+    }
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (g_apic_stats.timer_interrupts[cpu]) {
+            printf("CPU %u: %llu timer interrupts\n", cpu, g_apic_stats.timer_interrupts[cpu]);
+        }
+    }
+    printf("Spurious: %llu, errors: %llu (last ESR 0x%02X), IPIs sent: %llu\n",
+           g_apic_stats.spurious, g_apic_stats.errors, g_apic_stats.last_esr,
+           g_apic_stats.ipis_sent);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Read a local APIC register
+ */
+static uint32_t lapic_read(uint32_t reg) {
+    if (g_x2apic) {
+        return (uint32_t)rdmsr(X2APIC_MSR_BASE + (reg >> 4));
+    }
+    return g_lapic_mmio[reg / 4];
+}
+
+/**
+ * @brief Write a local APIC register
+ */
+static void lapic_write(uint32_t reg, uint32_t value) {
+    if (g_x2apic) {
+        wrmsr(X2APIC_MSR_BASE + (reg >> 4), value);
+    } else {
+        g_lapic_mmio[reg / 4] = value;
+    }
+}
+
+/**
+ * @brief Set the calling CPU's timer LVT mode bits, skipping redundant writes
+ *
+ * @return true if the LVT was written
+ */
+static bool lapic_set_timer_mode(uint32_t mode) {
+    uint32_t cpu = smp_processor_id();
+    uint32_t lvt = mode | APIC_TIMER_VECTOR;
+
+    // Masking is always written: apic_local_init() runs before the cache is valid
+    if (g_lvt_timer[cpu] == lvt && !(mode & LAPIC_LVT_MASKED)) {
+        return false;
+    }
+    lapic_write(LAPIC_LVT_TIMER, lvt);
+    g_lvt_timer[cpu] = lvt;
+    return true;
+}
+
+/**
+ * @brief Remap an MMIO page of the identity mapping uncached
+ */
+static volatile uint32_t* apic_map_mmio(uint64_t phys) {
+    uint64_t page = phys & ~(PAGE_SIZE - 1);
+
+    if (vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE | PTE_WRITE_THROUGH) != 0) {
+        return NULL;
+    }
+    return (volatile uint32_t*)(uintptr_t)phys;
+}
+
+/**
+ * @brief Read an I/O APIC register through the select/window pair
+ */
+static uint32_t ioapic_read(const ioapic_t* ioapic, uint8_t reg) {
+    ioapic->base[IOAPIC_REGSEL / 4] = reg;
+    return ioapic->base[IOAPIC_WINDOW / 4];
+}
+
+/**
+ * @brief Write an I/O APIC register through the select/window pair
+ */
+static void ioapic_write(const ioapic_t* ioapic, uint8_t reg, uint32_t value) {
+    ioapic->base[IOAPIC_REGSEL / 4] = reg;
+    ioapic->base[IOAPIC_WINDOW / 4] = value;
+}
+
+/**
+ * @brief Read a redirection table entry
+ */
+static uint64_t ioapic_read_rte(const ioapic_t* ioapic, uint32_t pin) {
+    uint32_t low = ioapic_read(ioapic, (uint8_t)(IOAPIC_REG_REDTBL + pin * 2));
+    uint32_t high = ioapic_read(ioapic, (uint8_t)(IOAPIC_REG_REDTBL + pin * 2 + 1));
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * @brief Write a redirection table entry
+ *
+ * The entry is masked while the destination half changes so a half-written
+ * entry is never live.
+ */
+static void ioapic_write_rte(const ioapic_t* ioapic, uint32_t pin, uint64_t rte) {
+    uint8_t reg = (uint8_t)(IOAPIC_REG_REDTBL + pin * 2);
+
+    ioapic_write(ioapic, reg, (uint32_t)IOAPIC_RTE_MASKED);
+    ioapic_write(ioapic, reg + 1, (uint32_t)(rte >> 32));
+    ioapic_write(ioapic, reg, (uint32_t)rte);
+}
+
+/**
+ * @brief Find the I/O APIC and pin serving a global system interrupt
+ */
+static ioapic_t* ioapic_for_gsi(uint32_t gsi, uint32_t* pin) {
+    for (uint32_t i = 0; i < g_ioapic_count; i++) {
+        ioapic_t* ioapic = &g_ioapics[i];
+        if (gsi >= ioapic->gsi_base && gsi < ioapic->gsi_base + ioapic->entries) {
+            *pin = gsi - ioapic->gsi_base;
+            return ioapic;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Local APIC timer interrupt: the per-CPU scheduler tick or hrtimer event
+ */
+static void apic_timer_interrupt_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
+    (void)vector; (void)error_code; (void)context;
+
+    g_apic_stats.timer_interrupts[smp_processor_id()]++;
+    apic_eoi();
+
+    if (hrtimer_hres_active()) {
+        hrtimer_interrupt();
+    } else {
+        tick_handle_interrupt();
+    }
+}
+
+/**
+ * @brief Local APIC error interrupt
+ */
+static void apic_error_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
+    (void)vector; (void)error_code; (void)context;
+
+    lapic_write(LAPIC_ESR, 0);
+    g_apic_stats.last_esr = lapic_read(LAPIC_ESR);
+    g_apic_stats.errors++;
+    apic_eoi();
+
+    printf("[WARN] APIC error on CPU %u: ESR 0x%02X\n", smp_processor_id(), g_apic_stats.last_esr);
+}
+
+/**
+ * @brief Spurious interrupt: nothing is in service, so no EOI
+ */
+static void apic_spurious_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
+    (void)vector; (void)error_code; (void)context;
+
+    g_apic_stats.spurious++;
+}
@@ -0,0 +1,280 @@
+/**
+ * @file apic.h
+ * @brief Local APIC and I/O APIC interrupt delivery for FG-OS
+ *
+ * Replaces the 8259 PIC when the firmware describes an I/O APIC in the
+ * MADT. ISA IRQs keep their vectors (IRQ_TIMER + irq) but are routed
+ * through I/O APIC redirection entries, honouring interrupt source
+ * overrides. The local APIC runs in x2APIC mode when the CPU supports it,
+ * where EOI and IPIs are single MSR writes, and in xAPIC (MMIO) mode
+ * otherwise. Each CPU gets its own local APIC timer, calibrated once,
+ * which takes over the scheduler tick from IRQ 0 and serves as the
+ * hrtimer clock event device.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __APIC_H__
+#define __APIC_H__
+
+#include <types.h>
+#include "../include/kernel.h"
+
+/**
+ * @brief APIC interrupt vectors
+ */
+#define APIC_TIMER_VECTOR       0xEF    /**< Local APIC timer */
+#define APIC_ERROR_VECTOR       0xFE    /**< Local APIC error */
+#define APIC_SPURIOUS_VECTOR    0xFF    /**< Spurious interrupt (no EOI) */
+
+/**
+ * @brief IA32_APIC_BASE MSR
+ */
+#define MSR_APIC_BASE           0x1B
+#define APIC_BASE_BSP           (1ULL << 8)     /**< Processor is the BSP */
+#define APIC_BASE_X2APIC        (1ULL << 10)    /**< x2APIC mode enable */
+#define APIC_BASE_ENABLE        (1ULL << 11)    /**< APIC global enable */
+#define APIC_BASE_ADDR_MASK     0xFFFFFFFFFF000ULL
+
+#define MSR_TSC_DEADLINE        0x6E0   /**< Local APIC timer fires when the TSC reaches it */
+
+/**
+ * @brief Local APIC register offsets (xAPIC MMIO; x2APIC MSR = 0x800 + offset / 16)
+ */
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080   /**< Task priority */
+#define LAPIC_EOI               0x0B0
+#define LAPIC_LDR               0x0D0   /**< Logical destination */
+#define LAPIC_DFR               0x0E0   /**< Destination format (xAPIC only) */
+#define LAPIC_SVR               0x0F0   /**< Spurious interrupt vector */
+#define LAPIC_ESR               0x280   /**< Error status */
+#define LAPIC_ICR_LOW           0x300   /**< Interrupt command (x2APIC: full 64 bits) */
+#define LAPIC_ICR_HIGH          0x310   /**< Interrupt command destination (xAPIC only) */
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define X2APIC_MSR_BASE         0x800
+
+/**
+ * @brief Local APIC register bits
+ */
+#define LAPIC_SVR_ENABLE        (1U << 8)   /**< Software enable */
+#define LAPIC_LVT_MASKED        (1U << 16)
+#define LAPIC_LVT_LEVEL         (1U << 15)
+#define LAPIC_LVT_ACTIVE_LOW    (1U << 13)
+#define LAPIC_LVT_NMI           (4U << 8)   /**< NMI delivery mode */
+#define LAPIC_TIMER_ONESHOT     (0U << 17)
+#define LAPIC_TIMER_PERIODIC    (1U << 17)
+#define LAPIC_TIMER_TSC_DEADLINE (2U << 17)
+#define LAPIC_TIMER_DIVIDE_16   0x3         /**< Divide configuration for /16 */
+#define LAPIC_ICR_FIXED         (0U << 8)
+#define LAPIC_ICR_INIT          (5U << 8)
+#define LAPIC_ICR_STARTUP       (6U << 8)
+#define LAPIC_ICR_PENDING       (1U << 12)  /**< Delivery status (xAPIC only) */
+#define LAPIC_ICR_ASSERT        (1U << 14)
+
+/**
+ * @brief I/O APIC registers
+ */
+#define IOAPIC_REGSEL           0x00    /**< Register select (MMIO offset) */
+#define IOAPIC_WINDOW           0x10    /**< Data window (MMIO offset) */
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01    /**< Bits 16-23: highest redirection entry */
+#define IOAPIC_REG_REDTBL       0x10    /**< Entry n at 0x10 + 2n (low), + 1 (high) */
+
+/**
+ * @brief I/O APIC redirection entry bits
+ */
+#define IOAPIC_RTE_ACTIVE_LOW   (1ULL << 13)
+#define IOAPIC_RTE_LEVEL        (1ULL << 15)
+#define IOAPIC_RTE_MASKED       (1ULL << 16)
+#define IOAPIC_RTE_DEST_SHIFT   56
+
+/**
+ * @brief Calibration
+ */
+#define APIC_CALIBRATE_MS       10      /**< Interval the timer is measured over */
+#define APIC_TIMER_DEFAULT_HZ   100000000ULL /**< Timer input assumed if calibration fails */
+
+/**
+ * @brief APIC statistics
+ */
+typedef struct {
+    uint64_t    timer_interrupts[MAX_CPUS]; /**< Local APIC timer interrupts per CPU */
+    uint64_t    spurious;                   /**< Spurious vector hits */
+    uint64_t    errors;                     /**< Error interrupts */
+    uint64_t    ipis_sent;                  /**< IPIs sent */
+    uint32_t    last_esr;                   /**< Last error status read */
+} apic_stats_t;
+
+/**
+ * @brief Take over interrupt delivery from the 8259
+ *
+ * Parses the MADT, enables the boot CPU's local APIC, routes the ISA IRQs
+ * through the I/O APIC (masked) and masks the 8259. Must be called after
+ * pic_init() so stray 8259 interrupts land on the remapped vectors.
+ *
+ * @return 0 on success, negative error code if the PIC must stay in use
+ */
+int apic_init(void);
+
+/**
+ * @brief Enable and configure the calling CPU's local APIC
+ */
+void apic_local_init(void);
+
+/**
+ * @brief Bring the calling CPU online
+ *
+ * Enables its local APIC and timer and marks it online for the topology
+ * and RCU code. Must run on the CPU being brought online.
+ *
+ * @param cpu CPU number
+ */
+void apic_cpu_online(uint32_t cpu);
+
+/**
+ * @brief Check whether the APIC has replaced the 8259
+ *
+ * @return true if interrupts are delivered through the I/O APIC
+ */
+bool apic_is_enabled(void);
+
+/**
+ * @brief Check whether the local APIC runs in x2APIC mode
+ *
+ * @return true in x2APIC mode, false in xAPIC mode or if disabled
+ */
+bool apic_x2apic_mode(void);
+
+/**
+ * @brief Get the calling CPU's local APIC ID
+ *
+ * @return Local APIC ID
+ */
+uint32_t apic_get_id(void);
+
+/**
+ * @brief Signal end of interrupt to the local APIC
+ */
+void apic_eoi(void);
+
+/**
+ * @brief Send a fixed interrupt to another CPU
+ *
+ * @param apic_id Destination local APIC ID
+ * @param vector Interrupt vector
+ */
+void apic_send_ipi(uint32_t apic_id, uint8_t vector);
+
+/**
+ * @brief Mask or unmask an ISA IRQ at the I/O APIC
+ *
+ * @param irq ISA IRQ (0-15)
+ * @param masked true to mask
+ */
+void ioapic_set_irq_masked(uint8_t irq, bool masked);
+
+/**
+ * @brief Deliver an ISA IRQ to another CPU
+ *
+ * Rewrites only the destination of the redirection entry, so the vector,
+ * trigger mode and mask state are kept.
+ *
+ * @param irq ISA IRQ (0-15)
+ * @param apic_id Destination local APIC ID
+ * @return 0 on success, negative error code if the IRQ is not routed
+ */
+int ioapic_set_irq_dest(uint8_t irq, uint32_t apic_id);
+
+/**
+ * @brief Route a global system interrupt to a vector on one CPU
+ *
+ * @param gsi Global system interrupt
+ * @param vector Interrupt vector
+ * @param apic_id Destination local APIC ID
+ * @param flags ACPI_MPS_* polarity and trigger, 0 for edge/active high
+ * @param masked Leave the entry masked
+ * @return 0 on success, negative error code if no I/O APIC serves gsi
+ */
+int ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, uint16_t flags, bool masked);
+
+/**
+ * @brief Calibrate the local APIC timer
+ *
+ * Measured against the clock source when it has sub-tick resolution, else
+ * against the PIT. Called once on the boot CPU; the result applies to all
+ * CPUs.
+ */
+void apic_timer_calibrate(void);
+
+/**
+ * @brief Get the local APIC timer count rate
+ *
+ * @return Timer counts per second (after the divider)
+ */
+uint64_t apic_timer_frequency(void);
+
+/**
+ * @brief Run the calling CPU's local APIC timer periodically
+ *
+ * @param frequency Interrupts per second
+ */
+void apic_timer_set_periodic(uint32_t frequency);
+
+/**
+ * @brief Arm the calling CPU's local APIC timer once
+ *
+ * @param counts Timer counts until the interrupt (0 stops the timer)
+ */
+void apic_timer_set_oneshot(uint32_t counts);
+
+/**
+ * @brief Check whether the local APIC timer supports TSC-deadline mode
+ *
+ * @return true if CPUID reports TSC-deadline support
+ */
+bool apic_timer_tsc_deadline(void);
+
+/**
+ * @brief Arm the calling CPU's local APIC timer for a TSC value
+ *
+ * @param tsc TSC value at which the timer fires (0 stops the timer)
+ */
+void apic_timer_set_deadline(uint64_t tsc);
+
+/**
+ * @brief Read the calling CPU's local APIC timer
+ *
+ * @return Counts remaining in the current period or one-shot
+ */
+uint32_t apic_timer_read_counter(void);
+
+/**
+ * @brief Mask all I/O APIC entries and stop the local APIC timer
+ */
+void apic_shutdown(void);
+
+/**
+ * @brief Get APIC statistics
+ *
+ * @return Pointer to APIC statistics
+ */
+const apic_stats_t* apic_get_stats(void);
+
+/**
+ * @brief Dump APIC configuration and statistics for debugging
+ */
+void apic_dump_status(void);
+
+#endif /* __APIC_H__ */
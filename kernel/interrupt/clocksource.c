@@ -0,0 +1,406 @@
+/**
+ * @file clocksource.c
+ * @brief Monotonic nanosecond clock for FG-OS
+ *
+ * The clock is defined as base_ns plus the counter cycles elapsed since
+ * base_cycles, scaled by a 32.32 fixed-point factor. The product is taken
+ * in 128 bits so the clock never wraps in practice without having to
+ * re-base it from the tick; no 128-bit division is ever needed.
+ *
+ * The TSC is preferred only when it is invariant. A TSC that stops in deep
+ * C-states or follows P-state changes would make the clock run slow, so
+ * the HPET is used instead when the firmware describes one.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "clocksource.h"
+#include "acpi.h"
+#include "interrupt.h"
+#include "../include/kernel.h"
+#include "../arch/x86_64/arch.h"
+#include "../mm/memory.h"
+
+/**
+ * @brief CPUID leaves and bits
+ */
+#define CPUID_ECX_HYPERVISOR        (1U << 31)  /**< Leaf 1: running under a hypervisor */
+#define CPUID_LEAF_TSC              0x15        /**< TSC/crystal clock ratio */
+#define CPUID_LEAF_HYPERVISOR       0x40000000  /**< Highest hypervisor leaf in EAX */
+#define CPUID_LEAF_HV_TIMING        0x40000010  /**< EAX: TSC frequency in kHz */
+#define CPUID_LEAF_EXT_MAX          0x80000000  /**< Highest extended leaf in EAX */
+#define CPUID_LEAF_POWER            0x80000007
+#define CPUID_EDX_INVARIANT_TSC     (1U << 8)
+
+// Upper bound on reference counter polls while calibrating
+#define CLOCKSOURCE_CALIBRATE_MAX_SPINS 10000000U
+
+/**
+ * @brief ACPI HPET description table
+ */
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t   header;
+    uint32_t            event_timer_block_id;
+    uint8_t             address_space_id;   /**< 0: system memory */
+    uint8_t             register_bit_width;
+    uint8_t             register_bit_offset;
+    uint8_t             access_size;
+    uint64_t            address;            /**< Register block base */
+    uint8_t             hpet_number;
+    uint16_t            minimum_tick;
+    uint8_t             page_protection;
+} acpi_hpet_t;
+
+// Clock state; follows the timer tick until clocksource_init() picks a counter
+static clocksource_t g_clock = {
+    .type = CLOCKSOURCE_TICK,
+    .name = "tick",
+    .frequency_hz = TIMER_FREQUENCY,
+    .shift = CLOCKSOURCE_SHIFT,
+    .tsc_calibration = "none",
+};
+static volatile uint8_t* g_hpet = NULL;
+static uint64_t g_hpet_hz = 0;
+
+// Forward declarations
+static bool hpet_init(void);
+static uint64_t hpet_read(void);
+static uint64_t tsc_calibrate_khz(void);
+static uint64_t tsc_measure_hpet(void);
+static uint64_t tsc_measure_pit(void);
+static void clocksource_select(clocksource_type_t type, const char* name, uint64_t hz, uint64_t cycles);
+
+/**
+ * @brief Scale a counter delta by a fixed-point factor
+ */
+static inline uint64_t clocksource_scale(uint64_t delta, uint64_t mult) {
+    return (uint64_t)(((unsigned __int128)delta * mult) >> CLOCKSOURCE_SHIFT);
+}
+
+/**
+ * @brief Select and calibrate the clock source
+ */
+int clocksource_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    printf("[INFO] Initializing clock source...\n");
+
+    cpuid_count(CPUID_LEAF_EXT_MAX, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= CPUID_LEAF_POWER) {
+        cpuid_count(CPUID_LEAF_POWER, 0, &eax, &ebx, &ecx, &edx);
+        g_clock.tsc_invariant = (edx & CPUID_EDX_INVARIANT_TSC) != 0;
+    }
+
+    // The HPET table is optional; acpi_init() returns early if already done
+    if (acpi_init() == 0) {
+        hpet_init();
+    }
+
+    uint64_t flags = interrupts_disable();
+
+    g_clock.tsc_khz = tsc_calibrate_khz();
+    if (g_clock.tsc_khz) {
+        g_clock.tsc_ns_mult = (g_clock.tsc_khz << CLOCKSOURCE_SHIFT) / 1000000ULL;
+    }
+
+    if (g_clock.tsc_khz && g_clock.tsc_invariant) {
+        clocksource_select(CLOCKSOURCE_TSC, "tsc", g_clock.tsc_khz * 1000, rdtsc());
+    } else if (g_hpet) {
+        clocksource_select(CLOCKSOURCE_HPET, "hpet", g_hpet_hz, hpet_read());
+    } else if (g_clock.tsc_khz) {
+        printf("[WARN] Clock source: TSC is not invariant and there is no HPET\n");
+        clocksource_select(CLOCKSOURCE_TSC, "tsc", g_clock.tsc_khz * 1000, rdtsc());
+    }
+
+    interrupts_restore(flags);
+
+    if (g_clock.type == CLOCKSOURCE_TICK) {
+        printf("[WARN] Clock source: no usable counter, using the %u Hz tick\n", TIMER_FREQUENCY);
+        return -1;
+    }
+
+    printf("[INFO] Clock source: %s at %llu Hz (TSC %llu kHz from %s%s)\n",
+           g_clock.name, g_clock.frequency_hz, g_clock.tsc_khz, g_clock.tsc_calibration,
+           g_clock.tsc_invariant ? ", invariant" : "");
+    return 0;
+}
+
+/**
+ * @brief Get monotonic time since boot in nanoseconds
+ */
+uint64_t ktime_get_ns(void) {
+    switch (g_clock.type) {
+        case CLOCKSOURCE_TSC:
+            return g_clock.base_ns + clocksource_scale(rdtsc() - g_clock.base_cycles, g_clock.mult);
+        case CLOCKSOURCE_HPET:
+            return g_clock.base_ns + clocksource_scale(hpet_read() - g_clock.base_cycles, g_clock.mult);
+        default:
+            return timer_get_uptime_ms() * NSEC_PER_MSEC;
+    }
+}
+
+/**
+ * @brief Get monotonic time since boot in microseconds
+ */
+uint64_t ktime_get_us(void) {
+    return ktime_get_ns() / NSEC_PER_USEC;
+}
+
+/**
+ * @brief Get the TSC frequency
+ */
+uint64_t clocksource_tsc_khz(void) {
+    return g_clock.tsc_khz;
+}
+
+/**
+ * @brief Convert a clock value to the TSC value at that instant
+ */
+uint64_t clocksource_ns_to_tsc(uint64_t ns) {
+    if (g_clock.type != CLOCKSOURCE_TSC) {
+        return 0;
+    }
+    if (ns <= g_clock.base_ns) {
+        return g_clock.base_cycles;
+    }
+    return g_clock.base_cycles + clocksource_scale(ns - g_clock.base_ns, g_clock.tsc_ns_mult);
+}
+
+/**
+ * @brief Check whether the clock has sub-tick resolution
+ */
+bool clocksource_is_highres(void) {
+    return g_clock.type != CLOCKSOURCE_TICK;
+}
+
+/**
+ * @brief Spin for at least a number of nanoseconds
+ */
+void ndelay(uint64_t ns) {
+    uint64_t khz = g_clock.tsc_khz;
+    if (khz) {
+        // Round up: a delay may run long but never short
+        uint64_t cycles = (ns * khz + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+        uint64_t start = rdtsc();
+        while (rdtsc() - start < cycles) {
+            __asm__ volatile ("pause");
+        }
+        return;
+    }
+
+    if (clocksource_is_highres()) {
+        uint64_t expires = ktime_get_ns() + ns;
+        while (ktime_get_ns() < expires) {
+            __asm__ volatile ("pause");
+        }
+        return;
+    }
+
+    // Nothing calibrated yet: an ISA bus write takes about a microsecond
+    for (uint64_t us = (ns + NSEC_PER_USEC - 1) / NSEC_PER_USEC; us > 0; us--) {
+        __asm__ volatile ("outb %%al, $0x80" : : "a"(0));
+    }
+}
+
+/**
+ * @brief Spin for at least a number of microseconds
+ */
+void udelay(uint64_t us) {
+    ndelay(us * NSEC_PER_USEC);
+}
+
+/**
+ * @brief Spin for at least a number of milliseconds
+ */
+void mdelay(uint64_t ms) {
+    while (ms-- > 0) {
+        ndelay(NSEC_PER_MSEC);
+    }
+}
+
+/**
+ * @brief Get the clock state
+ */
+const clocksource_t* clocksource_get(void) {
+    return &g_clock;
+}
+
+/**
+ * @brief Dump clock source information for debugging
+ */
+void clocksource_dump_status(void) {
+    printf("\n=== Clock Source ===\n");
+    printf("Current: %s, %llu Hz, mult %llu >> %u\n",
+           g_clock.name, g_clock.frequency_hz, g_clock.mult, g_clock.shift);
+    printf("TSC: %llu kHz (%s), %s\n", g_clock.tsc_khz, g_clock.tsc_calibration,
+           g_clock.tsc_invariant ? "invariant" : "not invariant");
+    if (g_hpet) {
+        printf("HPET: %llu Hz at %p\n", g_hpet_hz, (void*)g_hpet);
+    }
+    printf("Monotonic clock: %llu ns\n", ktime_get_ns());
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Map and start the HPET described by ACPI
+ *
+ * @return true if its main counter can be used
+ */
+static bool hpet_init(void) {
+    const acpi_hpet_t* table = (const acpi_hpet_t*)acpi_find_table("HPET");
+    if (!table || table->address_space_id != 0 || table->address == 0) {
+        return false;
+    }
+
+    // The register block is 1KB and 1KB aligned, so one page covers it
+    uint64_t page = table->address & ~(PAGE_SIZE - 1);
+    if (vmm_map_page(page, page, PTE_PRESENT | PTE_WRITABLE | PTE_CACHE_DISABLE | PTE_WRITE_THROUGH) != 0) {
+        return false;
+    }
+    volatile uint8_t* base = (volatile uint8_t*)(uintptr_t)table->address;
+
+    uint64_t caps = *(volatile uint64_t*)(base + HPET_REG_CAPABILITIES);
+    uint64_t period_fs = caps >> 32;
+    if (!(caps & HPET_CAP_COUNTER_64BIT) || period_fs == 0 || period_fs > HPET_FS_PER_SEC / 1000) {
+        printf("[WARN] HPET: unusable (capabilities 0x%016llX)\n", caps);
+        return false;
+    }
+
+    volatile uint64_t* config = (volatile uint64_t*)(base + HPET_REG_CONFIG);
+    *config |= HPET_CONFIG_ENABLE;
+
+    g_hpet = base;
+    g_hpet_hz = HPET_FS_PER_SEC / period_fs;
+    return true;
+}
+
+/**
+ * @brief Read the HPET main counter
+ */
+static uint64_t hpet_read(void) {
+    return *(volatile uint64_t*)(g_hpet + HPET_REG_MAIN_COUNTER);
+}
+
+/**
+ * @brief Determine the TSC frequency
+ *
+ * CPUID is exact when it reports the frequency. Measuring is the fallback,
+ * against the HPET when there is one since it is far finer than the PIT.
+ *
+ * @return TSC frequency in kHz, 0 if it could not be determined
+ */
+static uint64_t tsc_calibrate_khz(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t max_leaf = eax;
+
+    // Leaf 0x15: TSC = crystal * ebx / eax
+    if (max_leaf >= CPUID_LEAF_TSC) {
+        cpuid_count(CPUID_LEAF_TSC, 0, &eax, &ebx, &ecx, &edx);
+        if (eax && ebx && ecx) {
+            g_clock.tsc_calibration = "CPUID";
+            return (uint64_t)ecx * ebx / eax / 1000;
+        }
+    }
+
+    // Hypervisor timing leaf reports the TSC frequency directly
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    if (ecx & CPUID_ECX_HYPERVISOR) {
+        cpuid_count(CPUID_LEAF_HYPERVISOR, 0, &eax, &ebx, &ecx, &edx);
+        if (eax >= CPUID_LEAF_HV_TIMING) {
+            cpuid_count(CPUID_LEAF_HV_TIMING, 0, &eax, &ebx, &ecx, &edx);
+            if (eax) {
+                g_clock.tsc_calibration = "hypervisor";
+                return eax;
+            }
+        }
+    }
+
+    uint64_t khz = 0;
+    if (g_hpet && (khz = tsc_measure_hpet()) != 0) {
+        g_clock.tsc_calibration = "HPET";
+    } else if ((khz = tsc_measure_pit()) != 0) {
+        g_clock.tsc_calibration = "PIT";
+    }
+    return khz;
+}
+
+/**
+ * @brief Measure the TSC over CLOCKSOURCE_CALIBRATE_MS of HPET time
+ */
+static uint64_t tsc_measure_hpet(void) {
+    const uint64_t target = g_hpet_hz * CLOCKSOURCE_CALIBRATE_MS / 1000;
+
+    uint64_t hpet_start = hpet_read();
+    uint64_t tsc_start = rdtsc();
+    uint64_t elapsed = 0;
+
+    for (uint32_t spins = 0; spins < CLOCKSOURCE_CALIBRATE_MAX_SPINS; spins++) {
+        elapsed = hpet_read() - hpet_start;
+        if (elapsed >= target) {
+            break;
+        }
+        __asm__ volatile ("pause");
+    }
+    uint64_t tsc_elapsed = rdtsc() - tsc_start;
+
+    if (elapsed < target) {
+        return 0;
+    }
+    return tsc_elapsed * (g_hpet_hz / 1000) / elapsed;
+}
+
+/**
+ * @brief Measure the TSC over CLOCKSOURCE_CALIBRATE_MS of PIT time
+ *
+ * IRQ 0 is masked (or interrupts are off); the PIT only counts here and
+ * timer_init() reprograms it afterwards.
+ */
+static uint64_t tsc_measure_pit(void) {
+    const uint32_t target = (uint32_t)((uint64_t)TIMER_DIVISOR * CLOCKSOURCE_CALIBRATE_MS / 1000);
+
+    pit_set_oneshot(PIT_MAX_COUNTS);
+    uint16_t start = pit_read_counter();
+    uint64_t tsc_start = rdtsc();
+    uint32_t elapsed = 0;
+
+    for (uint32_t spins = 0; spins < CLOCKSOURCE_CALIBRATE_MAX_SPINS; spins++) {
+        uint16_t now = pit_read_counter();
+        elapsed = (now <= start) ? (uint32_t)(start - now) : 0;
+        if (elapsed >= target) {
+            break;
+        }
+        __asm__ volatile ("pause");
+    }
+    uint64_t tsc_elapsed = rdtsc() - tsc_start;
+
+    if (elapsed < target / 2) {
+        return 0;
+    }
+    return tsc_elapsed * TIMER_DIVISOR / elapsed / 1000;
+}
+
+/**
+ * @brief Switch the clock to a counter without a backward step
+ *
+ * @param type Counter type
+ * @param name Counter name
+ * @param hz Counter frequency
+ * @param cycles Counter value now
+ */
+static void clocksource_select(clocksource_type_t type, const char* name, uint64_t hz, uint64_t cycles) {
+    g_clock.base_ns = ktime_get_ns();
+    g_clock.base_cycles = cycles;
+    g_clock.mult = (NSEC_PER_SEC << CLOCKSOURCE_SHIFT) / hz;
+    g_clock.frequency_hz = hz;
+    g_clock.name = name;
+
+    // Readers on other CPUs must see the new base before the new type
+    __atomic_store_n(&g_clock.type, type, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,163 @@
+/**
+ * @file clocksource.h
+ * @brief Monotonic nanosecond clock for FG-OS
+ *
+ * Selects the best free-running counter at boot: the invariant TSC when
+ * the CPU has one, else the HPET main counter, else the TSC anyway, and
+ * the timer tick as a last resort. The TSC frequency is read from CPUID
+ * when reported and measured against the HPET or the PIT otherwise.
+ * ktime_get_ns() converts counter values with a fixed-point multiply, so
+ * reading the clock costs one counter read and no division.
+ *
+ * ndelay(), udelay() and mdelay() spin for short hardware waits against
+ * the calibrated TSC, needing neither interrupts nor the scheduler.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __CLOCKSOURCE_H__
+#define __CLOCKSOURCE_H__
+
+#include <types.h>
+
+/**
+ * @brief Time unit conversions
+ */
+#define NSEC_PER_SEC            1000000000ULL
+#define NSEC_PER_MSEC           1000000ULL
+#define NSEC_PER_USEC           1000ULL
+
+/**
+ * @brief Calibration
+ */
+#define CLOCKSOURCE_CALIBRATE_MS    20      /**< Reference interval for measuring the TSC */
+#define CLOCKSOURCE_SHIFT           32      /**< Fixed-point shift of cycle-to-ns factors */
+
+/**
+ * @brief HPET registers
+ */
+#define HPET_REG_CAPABILITIES   0x000   /**< Bits 63-32: counter period in femtoseconds */
+#define HPET_REG_CONFIG         0x010
+#define HPET_REG_MAIN_COUNTER   0x0F0
+#define HPET_CAP_COUNTER_64BIT  (1ULL << 13)
+#define HPET_CONFIG_ENABLE      (1ULL << 0)
+#define HPET_FS_PER_SEC         1000000000000000ULL
+
+/**
+ * @brief Counter backing the clock
+ */
+typedef enum {
+    CLOCKSOURCE_TICK = 0,           /**< Timer tick (millisecond resolution) */
+    CLOCKSOURCE_HPET,               /**< HPET main counter */
+    CLOCKSOURCE_TSC                 /**< Time stamp counter */
+} clocksource_type_t;
+
+/**
+ * @brief Clock state
+ */
+typedef struct {
+    clocksource_type_t  type;           /**< Selected counter */
+    const char*         name;           /**< Counter name */
+    uint64_t            frequency_hz;   /**< Counter frequency */
+    uint64_t            mult;           /**< ns = cycles * mult >> shift */
+    uint32_t            shift;          /**< Fixed-point shift */
+    uint64_t            base_cycles;    /**< Counter value at base_ns */
+    uint64_t            base_ns;        /**< Clock value when the counter was selected */
+    uint64_t            tsc_khz;        /**< TSC frequency, 0 if unknown */
+    uint64_t            tsc_ns_mult;    /**< cycles = ns * tsc_ns_mult >> shift */
+    bool                tsc_invariant;  /**< TSC runs at a constant rate in all C/P-states */
+    const char*         tsc_calibration; /**< How the TSC frequency was obtained */
+} clocksource_t;
+
+/**
+ * @brief Select and calibrate the clock source
+ *
+ * Runs once on the boot CPU after the PIT is usable and before the tick
+ * timer starts. Until then ktime_get_ns() follows the timer tick.
+ *
+ * @return 0 on success, negative error code if only the tick is available
+ */
+int clocksource_init(void);
+
+/**
+ * @brief Get monotonic time since boot
+ *
+ * @return Nanoseconds since boot
+ */
+uint64_t ktime_get_ns(void);
+
+/**
+ * @brief Get monotonic time since boot
+ *
+ * @return Microseconds since boot
+ */
+uint64_t ktime_get_us(void);
+
+/**
+ * @brief Get the TSC frequency
+ *
+ * @return TSC frequency in kHz, 0 while not calibrated
+ */
+uint64_t clocksource_tsc_khz(void);
+
+/**
+ * @brief Convert a clock value to the TSC value at that instant
+ *
+ * Used to program TSC-deadline timers.
+ *
+ * @param ns Absolute time in ktime_get_ns() nanoseconds
+ * @return TSC value, 0 if the TSC does not back the clock
+ */
+uint64_t clocksource_ns_to_tsc(uint64_t ns);
+
+/**
+ * @brief Check whether the clock has sub-tick resolution
+ *
+ * @return true for the TSC or the HPET
+ */
+bool clocksource_is_highres(void);
+
+/**
+ * @brief Spin for at least a number of nanoseconds
+ *
+ * For device timing that is too short to sleep for. Before the TSC is
+ * calibrated, falls back on the HPET or on ~1 us port 0x80 writes.
+ *
+ * @param ns Nanoseconds to wait
+ */
+void ndelay(uint64_t ns);
+
+/**
+ * @brief Spin for at least a number of microseconds
+ *
+ * @param us Microseconds to wait
+ */
+void udelay(uint64_t us);
+
+/**
+ * @brief Spin for at least a number of milliseconds
+ *
+ * Only for early boot and contexts that cannot sleep; threads should use
+ * timer_sleep_ms().
+ *
+ * @param ms Milliseconds to wait
+ */
+void mdelay(uint64_t ms);
+
+/**
+ * @brief Get the clock state
+ *
+ * @return Pointer to the clock state
+ */
+const clocksource_t* clocksource_get(void);
+
+/**
+ * @brief Dump clock source information for debugging
+ */
+void clocksource_dump_status(void);
+
+#endif /* __CLOCKSOURCE_H__ */
@@ -0,0 +1,522 @@
+/**
+ * @file hrtimer.c
+ * @brief High-resolution timers for FG-OS
+ *
+ * Each CPU keeps its pending hrtimers in a list ordered by expiry; only
+ * the head matters for programming the hardware, and it is only
+ * reprogrammed when the head changes. Timers are always queued on the CPU
+ * that starts them, so the local APIC written is always the local one.
+ *
+ * In TSC-deadline mode the expiry is converted to a TSC value once and no
+ * count conversion or 32-bit range limit applies. In one-shot mode the
+ * delay is converted to APIC timer counts and long delays are split; an
+ * interrupt with nothing expired simply programs the remainder.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "hrtimer.h"
+#include "apic.h"
+#include "clocksource.h"
+#include "interrupt.h"
+#include "tick.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../arch/x86_64/arch.h"
+#include "../sched/scheduler.h"
+
+/**
+ * @brief Per-CPU hrtimer queue
+ */
+typedef struct {
+    spinlock_t          lock;
+    struct list_head    active;         /**< Pending timers, earliest first */
+    hrtimer_t*          running;        /**< Timer whose callback is executing */
+    uint64_t            next_event;     /**< Expiry the device is programmed for */
+    bool                in_interrupt;   /**< Inside hrtimer_interrupt(); defer reprogramming */
+    hrtimer_t           tick_timer;     /**< Emulated scheduler tick */
+    uint64_t            tick_period_ns; /**< Tick period, 0 while in one-shot mode */
+    hrtimer_stats_t     stats;
+} hrtimer_cpu_base_t;
+
+/**
+ * @brief Sleeping thread waiting for its timer
+ */
+typedef struct {
+    hrtimer_t               timer;
+    struct thread* volatile task;       /**< Cleared by the callback */
+} hrtimer_sleeper_t;
+
+static hrtimer_cpu_base_t g_hrtimer_bases[MAX_CPUS];
+static bool g_hres_active = false;
+static bool g_tsc_deadline = false;
+static uint64_t g_apic_hz = 0;
+static uint64_t g_max_delta_ns = 0;
+
+// Forward declarations
+static bool hrtimer_enqueue(hrtimer_cpu_base_t* base, hrtimer_t* timer);
+static int hrtimer_try_to_cancel(hrtimer_t* timer);
+static void hrtimer_expire(hrtimer_cpu_base_t* base, uint64_t now);
+static void hrtimer_reprogram(hrtimer_cpu_base_t* base);
+static void hrtimer_program_device(uint64_t expires);
+static hrtimer_restart_t hrtimer_tick_fn(hrtimer_t* timer);
+static hrtimer_restart_t hrtimer_wakeup(hrtimer_t* timer);
+
+/**
+ * @brief Initialize the hrtimer queues and choose the expiry mode
+ */
+void hrtimers_init(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        hrtimer_cpu_base_t* base = &g_hrtimer_bases[cpu];
+        memset(base, 0, sizeof(*base));
+        spin_lock_init(&base->lock);
+        INIT_LIST_HEAD(&base->active);
+        base->next_event = HRTIMER_NO_EVENT;
+        hrtimer_setup(&base->tick_timer, hrtimer_tick_fn, NULL);
+    }
+
+    if (!apic_is_enabled() || !clocksource_is_highres()) {
+        printf("[INFO] hrtimers: low resolution, expired from the %u Hz tick\n", TIMER_FREQUENCY);
+        return;
+    }
+
+    // Deadlines are TSC values, so they only line up with the clock when it is the TSC
+    g_tsc_deadline = apic_timer_tsc_deadline() && clocksource_get()->type == CLOCKSOURCE_TSC;
+    if (!g_tsc_deadline) {
+        g_apic_hz = apic_timer_frequency();
+        if (g_apic_hz == 0) {
+            printf("[WARN] hrtimers: local APIC timer not calibrated, staying in low resolution\n");
+            return;
+        }
+        g_max_delta_ns = 0xFFFFFFFFULL * NSEC_PER_SEC / g_apic_hz;
+    }
+
+    g_hres_active = true;
+    printf("[INFO] hrtimers: high resolution, local APIC timer in %s mode\n",
+           g_tsc_deadline ? "TSC-deadline" : "one-shot");
+}
+
+/**
+ * @brief Check whether hrtimers are programmed into the clock event device
+ */
+bool hrtimer_hres_active(void) {
+    return g_hres_active;
+}
+
+/**
+ * @brief Prepare a timer for use
+ */
+void hrtimer_setup(hrtimer_t* timer, hrtimer_function_t function, void* data) {
+    INIT_LIST_HEAD(&timer->node);
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+    timer->cpu = smp_processor_id();
+    timer->queued = false;
+}
+
+/**
+ * @brief Start or restart a timer on the calling CPU
+ */
+void hrtimer_start(hrtimer_t* timer, uint64_t time, hrtimer_mode_t mode) {
+    uint64_t flags = interrupts_disable();
+
+    // A pending timer is moved to this CPU
+    hrtimer_try_to_cancel(timer);
+
+    uint32_t cpu = smp_processor_id();
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[cpu];
+
+    spin_lock(&base->lock);
+    timer->expires = (mode == HRTIMER_MODE_REL) ? ktime_get_ns() + time : time;
+    timer->cpu = cpu;
+    base->stats.started++;
+    if (hrtimer_enqueue(base, timer)) {
+        hrtimer_reprogram(base);
+    }
+    spin_unlock(&base->lock);
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Cancel a timer
+ */
+int hrtimer_cancel(hrtimer_t* timer) {
+    for (;;) {
+        uint64_t flags = interrupts_disable();
+        int ret = hrtimer_try_to_cancel(timer);
+        interrupts_restore(flags);
+
+        if (ret >= 0) {
+            return ret;
+        }
+        __asm__ volatile ("pause");
+    }
+}
+
+/**
+ * @brief Check whether a timer is pending
+ */
+bool hrtimer_active(const hrtimer_t* timer) {
+    return timer->queued;
+}
+
+/**
+ * @brief Move a timer's expiry past the current time
+ */
+uint64_t hrtimer_forward_now(hrtimer_t* timer, uint64_t interval) {
+    uint64_t now = ktime_get_ns();
+
+    if (interval == 0 || timer->expires > now) {
+        return 0;
+    }
+
+    uint64_t overruns = (now - timer->expires) / interval + 1;
+    timer->expires += overruns * interval;
+    return overruns;
+}
+
+/**
+ * @brief Get the calling CPU's earliest pending expiry
+ */
+uint64_t hrtimer_get_next_event(void) {
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[smp_processor_id()];
+    uint64_t expires = HRTIMER_NO_EVENT;
+
+    uint64_t flags = spin_lock_irqsave(&base->lock);
+    if (!list_empty(&base->active)) {
+        expires = list_first_entry(&base->active, hrtimer_t, node)->expires;
+    }
+    spin_unlock_irqrestore(&base->lock, flags);
+
+    return expires;
+}
+
+/**
+ * @brief Clock event interrupt in high-resolution mode
+ */
+void hrtimer_interrupt(void) {
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[smp_processor_id()];
+
+    spin_lock(&base->lock);
+    base->stats.interrupts++;
+    base->next_event = HRTIMER_NO_EVENT;
+
+    base->in_interrupt = true;
+    hrtimer_expire(base, ktime_get_ns());
+    base->in_interrupt = false;
+
+    hrtimer_reprogram(base);
+    spin_unlock(&base->lock);
+}
+
+/**
+ * @brief Run expired timers from the tick in low-resolution mode
+ */
+void hrtimer_run_queues(void) {
+    if (g_hres_active) {
+        return;
+    }
+
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[smp_processor_id()];
+
+    uint64_t flags = spin_lock_irqsave(&base->lock);
+    hrtimer_expire(base, ktime_get_ns());
+    spin_unlock_irqrestore(&base->lock, flags);
+}
+
+/**
+ * @brief Sleep the calling thread with nanosecond precision
+ */
+int hrtimer_nanosleep(uint64_t ns) {
+    struct thread* self = get_current_thread();
+    uint64_t expires = ktime_get_ns() + ns;
+
+    if (!self) {
+        while (ktime_get_ns() < expires) {
+            __asm__ volatile ("pause");
+        }
+        return 0;
+    }
+
+    hrtimer_sleeper_t sleeper;
+    hrtimer_setup(&sleeper.timer, hrtimer_wakeup, NULL);
+    sleeper.task = self;
+
+    uint64_t flags = interrupts_disable();
+
+    hrtimer_start(&sleeper.timer, expires, HRTIMER_MODE_ABS);
+    while (sleeper.task) {
+        self->state = THREAD_STATE_BLOCKED;
+        schedule();
+    }
+    hrtimer_cancel(&sleeper.timer);
+
+    interrupts_restore(flags);
+    return 0;
+}
+
+/**
+ * @brief Run the calling CPU's tick hrtimer periodically
+ */
+void hrtimer_tick_set_periodic(uint64_t period_ns) {
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[smp_processor_id()];
+
+    base->tick_period_ns = period_ns;
+    hrtimer_start(&base->tick_timer, period_ns, HRTIMER_MODE_REL);
+}
+
+/**
+ * @brief Fire the calling CPU's tick hrtimer once
+ */
+void hrtimer_tick_set_oneshot(uint64_t delay_ns) {
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[smp_processor_id()];
+
+    base->tick_period_ns = 0;
+    if (delay_ns == 0) {
+        hrtimer_cancel(&base->tick_timer);
+    } else {
+        hrtimer_start(&base->tick_timer, delay_ns, HRTIMER_MODE_REL);
+    }
+}
+
+/**
+ * @brief Get the time left until the calling CPU's next tick
+ */
+uint64_t hrtimer_tick_remaining_ns(void) {
+    hrtimer_t* timer = &g_hrtimer_bases[smp_processor_id()].tick_timer;
+    uint64_t now = ktime_get_ns();
+
+    if (!timer->queued || timer->expires <= now) {
+        return 0;
+    }
+    return timer->expires - now;
+}
+
+/**
+ * @brief Get hrtimer statistics for a CPU
+ */
+const hrtimer_stats_t* hrtimer_get_stats(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return NULL;
+    }
+    return &g_hrtimer_bases[cpu].stats;
+}
+
+/**
+ * @brief Dump hrtimer state and statistics for debugging
+ */
+void hrtimer_dump_status(void) {
+    printf("\n=== hrtimers ===\n");
+    printf("Mode: %s\n", !g_hres_active ? "low resolution (tick)" :
+           g_tsc_deadline ? "high resolution (TSC-deadline)" : "high resolution (APIC one-shot)");
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const hrtimer_stats_t* stats = &g_hrtimer_bases[cpu].stats;
+        if (stats->started == 0 && stats->interrupts == 0) {
+            continue;
+        }
+        printf("CPU %u: started %llu, cancelled %llu, expired %llu, interrupts %llu, reprograms %llu\n",
+               cpu, stats->started, stats->cancelled, stats->expired, stats->interrupts,
+               stats->reprograms);
+        printf("       latency avg %llu ns, max %llu ns\n",
+               stats->expired ? stats->total_latency_ns / stats->expired : 0,
+               stats->max_latency_ns);
+    }
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Insert a timer in expiry order
+ *
+ * Called with the base lock held.
+ *
+ * @return true if the timer became the earliest
+ */
+static bool hrtimer_enqueue(hrtimer_cpu_base_t* base, hrtimer_t* timer) {
+    struct list_head* pos = &base->active;
+    hrtimer_t* entry;
+
+    list_for_each_entry(entry, &base->active, node) {
+        if (entry->expires > timer->expires) {
+            pos = &entry->node;
+            break;
+        }
+    }
+
+    // Insert before the first later timer (or at the tail)
+    list_add_tail(&timer->node, pos);
+    timer->queued = true;
+
+    return base->active.next == &timer->node;
+}
+
+/**
+ * @brief Dequeue a timer unless its callback runs on another CPU
+ *
+ * Called with interrupts disabled.
+ *
+ * @return 1 if dequeued, 0 if it was not pending, -1 if the callback is running elsewhere
+ */
+static int hrtimer_try_to_cancel(hrtimer_t* timer) {
+    uint32_t cpu = timer->cpu;
+    if (cpu >= MAX_CPUS) {
+        return 0;
+    }
+
+    hrtimer_cpu_base_t* base = &g_hrtimer_bases[cpu];
+    int ret = 0;
+
+    spin_lock(&base->lock);
+    if (base->running == timer && cpu != smp_processor_id()) {
+        ret = -1;
+    } else if (timer->queued) {
+        bool was_first = base->active.next == &timer->node;
+
+        list_del_init(&timer->node);
+        timer->queued = false;
+        base->stats.cancelled++;
+        ret = 1;
+
+        // A remote device is left alone; it takes one harmless early interrupt
+        if (was_first && cpu == smp_processor_id()) {
+            hrtimer_reprogram(base);
+        }
+    }
+    spin_unlock(&base->lock);
+
+    return ret;
+}
+
+/**
+ * @brief Run every timer that has expired
+ *
+ * Called with the base lock held; it is dropped around each callback.
+ */
+static void hrtimer_expire(hrtimer_cpu_base_t* base, uint64_t now) {
+    while (!list_empty(&base->active)) {
+        hrtimer_t* timer = list_first_entry(&base->active, hrtimer_t, node);
+        if (timer->expires > now) {
+            break;
+        }
+
+        list_del_init(&timer->node);
+        timer->queued = false;
+
+        uint64_t latency = now - timer->expires;
+        base->stats.expired++;
+        base->stats.total_latency_ns += latency;
+        if (latency > base->stats.max_latency_ns) {
+            base->stats.max_latency_ns = latency;
+        }
+
+        base->running = timer;
+        spin_unlock(&base->lock);
+
+        hrtimer_restart_t restart = timer->function(timer);
+
+        spin_lock(&base->lock);
+        base->running = NULL;
+
+        // The callback may have restarted the timer itself
+        if (restart == HRTIMER_RESTART && !timer->queued) {
+            hrtimer_enqueue(base, timer);
+        }
+
+        now = ktime_get_ns();
+    }
+}
+
+/**
+ * @brief Program the local clock event device for the earliest timer
+ *
+ * Called with the local base lock held.
+ */
+static void hrtimer_reprogram(hrtimer_cpu_base_t* base) {
+    if (!g_hres_active || base->in_interrupt) {
+        return;
+    }
+
+    uint64_t expires = HRTIMER_NO_EVENT;
+    if (!list_empty(&base->active)) {
+        expires = list_first_entry(&base->active, hrtimer_t, node)->expires;
+    }
+
+    if (expires == base->next_event) {
+        return;
+    }
+    base->next_event = expires;
+    base->stats.reprograms++;
+
+    if (expires == HRTIMER_NO_EVENT) {
+        if (g_tsc_deadline) {
+            apic_timer_set_deadline(0);
+        } else {
+            apic_timer_set_oneshot(0);
+        }
+        return;
+    }
+
+    hrtimer_program_device(expires);
+}
+
+/**
+ * @brief Write an expiry to the local APIC timer
+ */
+static void hrtimer_program_device(uint64_t expires) {
+    uint64_t now = ktime_get_ns();
+    uint64_t delta = (expires > now) ? expires - now : 0;
+
+    if (delta < HRTIMER_MIN_DELTA_NS) {
+        delta = HRTIMER_MIN_DELTA_NS;
+    }
+
+    if (g_tsc_deadline) {
+        apic_timer_set_deadline(clocksource_ns_to_tsc(now + delta));
+        return;
+    }
+
+    // Beyond the 32-bit count range the interrupt comes early and reprograms the rest
+    if (delta > g_max_delta_ns) {
+        delta = g_max_delta_ns;
+    }
+    uint64_t counts = delta * g_apic_hz / NSEC_PER_SEC;
+    apic_timer_set_oneshot(counts ? (uint32_t)counts : 1);
+}
+
+/**
+ * @brief Emulated scheduler tick
+ */
+static hrtimer_restart_t hrtimer_tick_fn(hrtimer_t* timer) {
+    hrtimer_cpu_base_t* base = container_of(timer, hrtimer_cpu_base_t, tick_timer);
+
+    tick_handle_interrupt();
+
+    // The tick code may have switched to one-shot or restarted the tick itself
+    if (timer->queued || base->tick_period_ns == 0) {
+        return HRTIMER_NORESTART;
+    }
+
+    hrtimer_forward_now(timer, base->tick_period_ns);
+    return HRTIMER_RESTART;
+}
+
+/**
+ * @brief Wake a thread sleeping in hrtimer_nanosleep()
+ */
+static hrtimer_restart_t hrtimer_wakeup(hrtimer_t* timer) {
+    hrtimer_sleeper_t* sleeper = container_of(timer, hrtimer_sleeper_t, timer);
+    struct thread* task = sleeper->task;
+
+    sleeper->task = NULL;
+    if (task) {
+        wake_up_thread(task);
+    }
+    return HRTIMER_NORESTART;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file hrtimer.h
+ * @brief High-resolution timers for FG-OS
+ *
+ * hrtimers expire at absolute ktime_get_ns() times instead of on tick
+ * boundaries. When the APIC is in use and the clock source is the TSC or
+ * the HPET, each CPU's local APIC timer is owned by its hrtimer queue and
+ * is programmed in TSC-deadline mode (or one-shot mode on CPUs without
+ * it) for the earliest expiry; the scheduler tick becomes one more
+ * hrtimer. Otherwise hrtimers are expired from the tick and get tick
+ * resolution.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __HRTIMER_H__
+#define __HRTIMER_H__
+
+#include <types.h>
+#include "../include/kernel.h"
+#include "../include/list.h"
+
+/**
+ * @brief hrtimer configuration
+ */
+#define HRTIMER_MIN_DELTA_NS    1000ULL     /**< Closest event the hardware is programmed for */
+#define HRTIMER_NO_EVENT        UINT64_MAX  /**< No expiry pending */
+
+/**
+ * @brief Callback return value
+ */
+typedef enum {
+    HRTIMER_NORESTART = 0,          /**< Timer is done */
+    HRTIMER_RESTART                 /**< Requeue at the (forwarded) expiry */
+} hrtimer_restart_t;
+
+/**
+ * @brief Interpretation of the time passed to hrtimer_start()
+ */
+typedef enum {
+    HRTIMER_MODE_ABS = 0,           /**< Absolute ktime_get_ns() value */
+    HRTIMER_MODE_REL                /**< Nanoseconds from now */
+} hrtimer_mode_t;
+
+struct hrtimer;
+typedef hrtimer_restart_t (*hrtimer_function_t)(struct hrtimer* timer);
+
+/**
+ * @brief High-resolution timer
+ *
+ * Callbacks run in interrupt context with the queue lock released, so
+ * they may start or cancel timers, including their own.
+ */
+typedef struct hrtimer {
+    struct list_head    node;       /**< Entry in the CPU's expiry-ordered queue */
+    uint64_t            expires;    /**< Absolute expiry in nanoseconds */
+    hrtimer_function_t  function;   /**< Expiry callback */
+    void*               data;       /**< Callback argument */
+    uint32_t            cpu;        /**< CPU whose queue holds the timer */
+    bool                queued;     /**< Timer is pending */
+} hrtimer_t;
+
+/**
+ * @brief Per-CPU hrtimer statistics
+ */
+typedef struct {
+    uint64_t    started;            /**< hrtimer_start() calls */
+    uint64_t    cancelled;          /**< Pending timers cancelled */
+    uint64_t    expired;            /**< Callbacks run */
+    uint64_t    interrupts;         /**< Clock event interrupts taken */
+    uint64_t    reprograms;         /**< Clock event device writes */
+    uint64_t    total_latency_ns;   /**< Sum of expiry-to-callback delays */
+    uint64_t    max_latency_ns;     /**< Worst expiry-to-callback delay */
+} hrtimer_stats_t;
+
+/**
+ * @brief Initialize the hrtimer queues and choose the expiry mode
+ *
+ * Called from timer_init() after the clock source and the local APIC
+ * timer are calibrated. From then on timer_set_periodic() and
+ * timer_set_oneshot() drive the tick hrtimer in high-resolution mode.
+ */
+void hrtimers_init(void);
+
+/**
+ * @brief Check whether hrtimers are programmed into the clock event device
+ *
+ * @return true in high-resolution mode, false if they expire from the tick
+ */
+bool hrtimer_hres_active(void);
+
+/**
+ * @brief Prepare a timer for use
+ *
+ * @param timer Timer to initialize
+ * @param function Expiry callback
+ * @param data Callback argument
+ */
+void hrtimer_setup(hrtimer_t* timer, hrtimer_function_t function, void* data);
+
+/**
+ * @brief Start or restart a timer on the calling CPU
+ *
+ * @param timer Timer to start
+ * @param time Expiry time, see mode
+ * @param mode HRTIMER_MODE_ABS or HRTIMER_MODE_REL
+ */
+void hrtimer_start(hrtimer_t* timer, uint64_t time, hrtimer_mode_t mode);
+
+/**
+ * @brief Cancel a timer
+ *
+ * Waits for the callback to finish if it is running on another CPU.
+ *
+ * @param timer Timer to cancel
+ * @return 1 if the timer was pending, 0 otherwise
+ */
+int hrtimer_cancel(hrtimer_t* timer);
+
+/**
+ * @brief Check whether a timer is pending
+ *
+ * @param timer Timer to check
+ * @return true if queued
+ */
+bool hrtimer_active(const hrtimer_t* timer);
+
+/**
+ * @brief Move a timer's expiry past the current time
+ *
+ * Used by periodic callbacks before returning HRTIMER_RESTART.
+ *
+ * @param timer Timer (not queued)
+ * @param interval Period in nanoseconds
+ * @return Number of periods the expiry was advanced by
+ */
+uint64_t hrtimer_forward_now(hrtimer_t* timer, uint64_t interval);
+
+/**
+ * @brief Get the calling CPU's earliest pending expiry
+ *
+ * @return Absolute expiry in nanoseconds, HRTIMER_NO_EVENT if none
+ */
+uint64_t hrtimer_get_next_event(void);
+
+/**
+ * @brief Clock event interrupt in high-resolution mode
+ *
+ * Runs expired timers and programs the next expiry.
+ */
+void hrtimer_interrupt(void);
+
+/**
+ * @brief Run expired timers from the tick in low-resolution mode
+ */
+void hrtimer_run_queues(void);
+
+/**
+ * @brief Sleep the calling thread with nanosecond precision
+ *
+ * Busy-waits when there is no thread context yet.
+ *
+ * @param ns Nanoseconds to sleep
+ * @return 0 on success
+ */
+int hrtimer_nanosleep(uint64_t ns);
+
+/**
+ * @brief Run the calling CPU's tick hrtimer periodically
+ *
+ * @param period_ns Tick period in nanoseconds
+ */
+void hrtimer_tick_set_periodic(uint64_t period_ns);
+
+/**
+ * @brief Fire the calling CPU's tick hrtimer once
+ *
+ * @param delay_ns Nanoseconds until the tick, 0 stops it
+ */
+void hrtimer_tick_set_oneshot(uint64_t delay_ns);
+
+/**
+ * @brief Get the time left until the calling CPU's next tick
+ *
+ * @return Nanoseconds, 0 if it is due or stopped
+ */
+uint64_t hrtimer_tick_remaining_ns(void);
+
+/**
+ * @brief Get hrtimer statistics for a CPU
+ *
+ * @param cpu CPU number
+ * @return Statistics, NULL for an invalid CPU
+ */
+const hrtimer_stats_t* hrtimer_get_stats(uint32_t cpu);
+
+/**
+ * @brief Dump hrtimer state and statistics for debugging
+ */
+void hrtimer_dump_status(void);
+
+#endif /* __HRTIMER_H__ */
@@ -14,13 +14,20 @@
 
 #include "idt.h"
 #include "interrupt.h"
+#include "softirq.h"
+#include "irqtrace.h"
 #include "../include/kernel.h"
 #include "../arch/x86_64/arch.h"
+#include "../sched/cputime.h"
+#include "../sched/scheduler.h"
 #include <stddef.h>
 
 // Global interrupt manager
 static interrupt_manager_t g_interrupt_manager;
 
+// Vectors handed out by idt_alloc_vector()
+static uint64_t g_vectors_allocated[IDT_ENTRIES / 64];
+
 // Default exception names
 static const char* exception_names[32] = {
     "Divide by Zero",
@@ -77,8 +84,6 @@ static void default_exception_handler(uint8_t vector, uint64_t error_code, struc
     
     // Update statistics
     g_interrupt_manager.stats.exceptions++;
-    g_interrupt_manager.stats.total_interrupts++;
-    g_interrupt_manager.stats.interrupt_frequency[vector]++;
     
     // For critical exceptions, panic the system
     if (vector == EXCEPTION_DOUBLE_FAULT || 
@@ -100,14 +105,10 @@ static void default_exception_handler(uint8_t vector, uint64_t error_code, struc
  * @param context CPU context at time of interrupt
  */
 static void default_interrupt_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
-    // Update statistics
-    g_interrupt_manager.stats.total_interrupts++;
-    g_interrupt_manager.stats.interrupt_frequency[vector]++;
-    
+    // Update statistics (totals are counted in interrupt_common_handler)
     if (vector >= IRQ_TIMER && vector <= IRQ_SECONDARY_ATA) {
-        g_interrupt_manager.stats.hardware_interrupts++;
         // Send EOI for hardware interrupts
-        pic_send_eoi(vector - IRQ_TIMER);
+        irq_send_eoi(vector - IRQ_TIMER);
     } else if (vector >= INT_SYSCALL) {
         g_interrupt_manager.stats.software_interrupts++;
     } else {
@@ -193,6 +194,51 @@ int idt_unregister_handler(uint8_t vector) {
     return 0;
 }
 
+/**
+ * @brief Allocate an unused device interrupt vector
+ * 
+ * @return Vector number, negative error code if none is free
+ */
+int idt_alloc_vector(void) {
+    if (g_interrupt_manager.state == INTERRUPT_SYSTEM_DISABLED) {
+        return -1;
+    }
+    
+    uint64_t flags = interrupts_disable();
+    
+    for (uint32_t vector = IDT_DYNAMIC_VECTOR_FIRST; vector <= IDT_DYNAMIC_VECTOR_LAST; vector++) {
+        if (vector >= INT_SYSCALL && vector <= INT_IPI) {
+            continue;
+        }
+        
+        uint64_t bit = 1ULL << (vector % 64);
+        if ((g_vectors_allocated[vector / 64] & bit) ||
+            g_interrupt_manager.handlers[vector] != default_interrupt_handler) {
+            continue;
+        }
+        
+        g_vectors_allocated[vector / 64] |= bit;
+        interrupts_restore(flags);
+        return (int)vector;
+    }
+    
+    interrupts_restore(flags);
+    return -2;
+}
+
+/**
+ * @brief Return a vector from idt_alloc_vector() and remove its handler
+ * 
+ * @param vector Interrupt vector number
+ */
+void idt_free_vector(uint8_t vector) {
+    idt_unregister_handler(vector);
+    
+    uint64_t flags = interrupts_disable();
+    g_vectors_allocated[vector / 64] &= ~(1ULL << (vector % 64));
+    interrupts_restore(flags);
+}
+
 /**
  * @brief Load the IDT into the processor
  */
@@ -204,13 +250,17 @@ void idt_load(void) {
  * @brief Enable interrupts globally
  */
 void interrupts_enable(void) {
-    if (g_interrupt_manager.disabled_count > 0) {
-        g_interrupt_manager.disabled_count--;
-    }
-    
-    if (g_interrupt_manager.disabled_count == 0) {
-        __asm__ volatile ("sti" : : : "memory");
-    }
+    interrupts_enable_caller(__builtin_return_address(0));
+}
+
+/**
+ * @brief Enable interrupts, naming the caller for irqs-off tracing
+ * 
+ * @param caller Code that enables them
+ */
+void interrupts_enable_caller(void* caller) {
+    irqtrace_irqs_on(caller);
+    __asm__ volatile ("sti" : : : "memory");
 }
 
 /**
@@ -219,6 +269,16 @@ void interrupts_enable(void) {
  * @return Previous interrupt state
  */
 uint64_t interrupts_disable(void) {
+    return interrupts_disable_caller(__builtin_return_address(0));
+}
+
+/**
+ * @brief Disable interrupts, naming the caller for irqs-off tracing
+ * 
+ * @param caller Code that disables them
+ * @return Previous interrupt state
+ */
+uint64_t interrupts_disable_caller(void* caller) {
     uint64_t flags;
     __asm__ volatile (
         "pushfq\n\t"
@@ -229,7 +289,10 @@ uint64_t interrupts_disable(void) {
         : "memory"
     );
     
-    g_interrupt_manager.disabled_count++;
+    // Nested disables leave the section of the outermost one open
+    if (flags & 0x200) {
+        irqtrace_irqs_off(caller);
+    }
     return flags;
 }
 
@@ -239,8 +302,18 @@ uint64_t interrupts_disable(void) {
  * @param state Previous interrupt state
  */
 void interrupts_restore(uint64_t state) {
+    interrupts_restore_caller(state, __builtin_return_address(0));
+}
+
+/**
+ * @brief Restore interrupt state, naming the caller for irqs-off tracing
+ * 
+ * @param state Previous interrupt state
+ * @param caller Code that restores it
+ */
+void interrupts_restore_caller(uint64_t state, void* caller) {
     if (state & 0x200) { // IF flag was set
-        interrupts_enable();
+        interrupts_enable_caller(caller);
     }
 }
 
@@ -384,16 +457,52 @@ void idt_dump(uint8_t start_vector, uint8_t count) {
  * @param context CPU context
  */
 void interrupt_common_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
+    // Hardware interrupts are accounted as IRQ time; exceptions and INT 0x80
+    // system calls belong to the task
+    bool hardware_irq = vector >= IRQ_TIMER && vector != INT_SYSCALL;
+
+    // Every vector is counted here, whoever handles it; the IRQ balancer
+    // reads the per-vector counts from other CPUs
+    __atomic_fetch_add(&g_interrupt_manager.stats.total_interrupts, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_interrupt_manager.stats.interrupt_frequency[vector], 1, __ATOMIC_RELAXED);
+    if (hardware_irq) {
+        __atomic_fetch_add(&g_interrupt_manager.stats.hardware_interrupts, 1, __ATOMIC_RELAXED);
+    }
+
+    if (hardware_irq) {
+        cputime_irq_enter(context && (context->cs & 3));
+        irq_enter();
+    }
+    
     // Update nesting level
     g_interrupt_manager.nested_level++;
     
-    // Call registered handler
+    // Call registered handler, timed from entry to exit
+    uint64_t entry = irqtrace_irq_enter(vector, g_interrupt_manager.nested_level, hardware_irq);
     if (g_interrupt_manager.handlers[vector]) {
         g_interrupt_manager.handlers[vector](vector, error_code, context);
     }
+    irqtrace_irq_exit(vector, entry);
     
     // Update nesting level
     g_interrupt_manager.nested_level--;
+    
+    // Deferred work runs on the way out and is charged as interrupt time
+    if (hardware_irq) {
+        irq_exit();
+        cputime_irq_exit();
+    }
+    
+    // Back to the interrupted context, INT 0x80 system calls included:
+    // a pending reschedule from a wakeup or slice expiry takes effect now
+    if ((hardware_irq || vector == INT_SYSCALL) && g_interrupt_manager.nested_level == 0) {
+        preempt_schedule_irq();
+    }
+    
+    // IRET turns interrupts back on; close a section softirqs left open
+    if (hardware_irq) {
+        irqtrace_irqs_on(NULL);
+    }
 }
 
 /**
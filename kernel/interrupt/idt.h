@@ -72,6 +72,12 @@
 #define INT_YIELD               0x81    /**< Process yield interrupt */
 #define INT_IPI                 0x82    /**< Inter-processor interrupt */
 
+/**
+ * @brief Vectors handed out at run time (MSI/MSI-X)
+ */
+#define IDT_DYNAMIC_VECTOR_FIRST    0x30    /**< First vector above the ISA IRQs */
+#define IDT_DYNAMIC_VECTOR_LAST     0xEE    /**< Last vector below the local APIC's own */
+
 /**
  * @brief IDT Entry structure for x86_64
  * 
@@ -142,7 +148,6 @@ typedef struct {
     interrupt_stats_t           stats;                      /**< Interrupt statistics */
     interrupt_system_state_t    state;                      /**< System state */
     uint32_t                    nested_level;               /**< Current nesting level */
-    uint64_t                    disabled_count;             /**< Disable/enable balance */
     bool                        pic_initialized;           /**< PIC initialization status */
     bool                        apic_available;             /**< APIC availability */
     bool                        apic_enabled;               /**< APIC enabled status */
@@ -188,6 +193,24 @@ int idt_register_handler(uint8_t vector, interrupt_handler_t handler);
  */
 int idt_unregister_handler(uint8_t vector);
 
+/**
+ * @brief Allocate an unused device interrupt vector
+ * 
+ * Hands out vectors between IDT_DYNAMIC_VECTOR_FIRST and
+ * IDT_DYNAMIC_VECTOR_LAST that have no handler and are not reserved for
+ * software interrupts.
+ * 
+ * @return Vector number, negative error code if none is free
+ */
+int idt_alloc_vector(void);
+
+/**
+ * @brief Return a vector from idt_alloc_vector() and remove its handler
+ * 
+ * @param vector Interrupt vector number
+ */
+void idt_free_vector(uint8_t vector);
+
 /**
  * @brief Load the IDT into the processor
  * 
@@ -218,6 +241,32 @@ uint64_t interrupts_disable(void);
  */
 void interrupts_restore(uint64_t state);
 
+/**
+ * @brief Enable interrupts on behalf of a caller
+ * 
+ * As interrupts_enable(), but irqs-off tracing charges the enable to
+ * caller; for wrappers such as critical_section_exit().
+ * 
+ * @param caller Return address of the wrapper
+ */
+void interrupts_enable_caller(void* caller);
+
+/**
+ * @brief Disable interrupts on behalf of a caller
+ * 
+ * @param caller Return address of the wrapper
+ * @return Previous interrupt state (for restoration)
+ */
+uint64_t interrupts_disable_caller(void* caller);
+
+/**
+ * @brief Restore interrupt state on behalf of a caller
+ * 
+ * @param state Previous interrupt state from interrupts_disable()
+ * @param caller Return address of the wrapper
+ */
+void interrupts_restore_caller(uint64_t state, void* caller);
+
 /**
  * @brief Check if interrupts are enabled
  * 
@@ -18,6 +18,17 @@
 #include "../include/kernel.h"
 #include "../arch/x86_64/arch.h"
 #include "../sched/scheduler.h"
+#include "../mm/memory.h"
+#include "tick.h"
+#include "softirq.h"
+#include "irq.h"
+#include "irq_poll.h"
+#include "irq_balance.h"
+#include "irqtrace.h"
+#include "apic.h"
+#include "clocksource.h"
+#include "hrtimer.h"
+#include "../sched/workqueue.h"
 
 // Global variables
 static timer_manager_t g_timer_manager;
@@ -26,6 +37,15 @@ static hardware_interrupt_info_t g_hardware_interrupts[16];
 static interrupt_context_t* g_current_context = NULL;
 static interrupt_priority_t g_current_priority = INTERRUPT_PRIORITY_NORMAL;
 
+// Scancodes handed from the keyboard IRQ to its work item
+#define KBD_BUFFER_SIZE 64
+static volatile uint8_t g_kbd_buffer[KBD_BUFFER_SIZE];
+static volatile uint32_t g_kbd_head = 0;
+static volatile uint32_t g_kbd_tail = 0;
+static uint64_t g_kbd_dropped = 0;
+static void keyboard_work_fn(struct work_struct* work);
+static struct work_struct g_kbd_work = WORK_INIT(g_kbd_work, keyboard_work_fn);
+
 // PIC I/O functions (simplified for demonstration)
 static inline void outb(uint16_t port, uint8_t value) {
     // In a real kernel, this would be inline assembly
@@ -131,21 +151,20 @@ static void init_hardware_interrupt_table(void) {
 static void timer_interrupt_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
     (void)vector; (void)error_code; (void)context;
     
-    g_timer_manager.ticks++;
-    g_timer_manager.milliseconds = g_timer_manager.ticks * (1000 / g_timer_manager.frequency);
-    g_timer_manager.seconds = g_timer_manager.milliseconds / 1000;
-    
-    // Update hardware interrupt statistics
-    g_hardware_interrupts[0].count++;
-    g_hardware_interrupts[0].last_time = g_timer_manager.ticks;
-    
-    // Send EOI to PIC
-    pic_send_eoi(0);
+    // Acknowledge at whichever controller delivered it
+    irq_send_eoi(0);
     
-    // Call scheduler for preemptive multitasking
-    if (scheduler_is_enabled()) {
-        scheduler_tick();
-    }
+    // Account the tick(s), run timers and drive the scheduler
+    tick_handle_interrupt();
+}
+
+/**
+ * @brief Advance the timer by a number of ticks
+ */
+void timer_account_ticks(uint64_t nticks) {
+    g_timer_manager.ticks += nticks;
+    g_timer_manager.milliseconds = (g_timer_manager.ticks * 1000) / g_timer_manager.frequency;
+    g_timer_manager.seconds = g_timer_manager.milliseconds / 1000;
 }
 
 /**
@@ -157,15 +176,30 @@ static void keyboard_interrupt_handler(uint8_t vector, uint64_t error_code, stru
     // Read keyboard scancode (simplified)
     uint8_t scancode = inb(0x60);
     
-    // Update statistics
-    g_hardware_interrupts[1].count++;
-    g_hardware_interrupts[1].last_time = g_timer_manager.ticks;
+    // Queue the scancode; a worker thread does the slow processing
+    uint32_t next = (g_kbd_head + 1) % KBD_BUFFER_SIZE;
+    if (next != g_kbd_tail) {
+        g_kbd_buffer[g_kbd_head] = scancode;
+        g_kbd_head = next;
+    } else {
+        g_kbd_dropped++;
+    }
+    schedule_work(&g_kbd_work);
     
-    // For now, just acknowledge the interrupt
-    printf("[DEBUG] Keyboard interrupt: scancode 0x%02X\n", scancode);
+    // Acknowledge at whichever controller delivered it
+    irq_send_eoi(1);
+}
+
+/**
+ * @brief Keyboard bottom half: drain the scancodes queued by the IRQ
+ */
+static void keyboard_work_fn(struct work_struct* work) {
+    (void)work;
     
-    // Send EOI to PIC
-    pic_send_eoi(1);
+    while (g_kbd_tail != g_kbd_head) {
+        KDEBUG("Keyboard scancode 0x%02X", g_kbd_buffer[g_kbd_tail]);
+        g_kbd_tail = (g_kbd_tail + 1) % KBD_BUFFER_SIZE;
+    }
 }
 
 /**
@@ -179,6 +213,11 @@ static void page_fault_handler(uint8_t vector, uint64_t error_code, struct cpu_s
     
     g_exceptions[EXCEPTION_PAGE_FAULT].count++;
     
+    // Lazily populated thread stack pages; guard page hits panic
+    if (vmstack_handle_fault(fault_address, error_code)) {
+        return;
+    }
+    
     printf("\n[PAGE FAULT] Address: 0x%016llX\n", fault_address);
     printf("Error Code: 0x%016llX (", error_code);
     
@@ -270,15 +309,16 @@ void pic_enable_irq(uint8_t irq) {
     
     uint16_t port;
     uint8_t mask;
+    uint8_t line = irq;
     
     if (irq < 8) {
         port = PIC1_DATA;
     } else {
         port = PIC2_DATA;
-        irq -= 8;
+        line -= 8;
     }
     
-    mask = inb(port) & ~(1 << irq);
+    mask = inb(port) & ~(1 << line);
     outb(port, mask);
     
     g_hardware_interrupts[irq].enabled = true;
@@ -292,15 +332,16 @@ void pic_disable_irq(uint8_t irq) {
     
     uint16_t port;
     uint8_t mask;
+    uint8_t line = irq;
     
     if (irq < 8) {
         port = PIC1_DATA;
     } else {
         port = PIC2_DATA;
-        irq -= 8;
+        line -= 8;
     }
     
-    mask = inb(port) | (1 << irq);
+    mask = inb(port) | (1 << line);
     outb(port, mask);
     
     g_hardware_interrupts[irq].enabled = false;
@@ -323,6 +364,45 @@ void pic_set_irq_mask(uint16_t mask) {
     outb(PIC2_DATA, (mask >> 8) & 0xFF);
 }
 
+/**
+ * @brief Send End of Interrupt for an ISA IRQ
+ */
+void irq_send_eoi(uint8_t irq) {
+    if (apic_is_enabled()) {
+        apic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+/**
+ * @brief Unmask an ISA IRQ line
+ */
+void irq_enable(uint8_t irq) {
+    if (irq >= 16) return;
+    
+    if (apic_is_enabled()) {
+        ioapic_set_irq_masked(irq, false);
+        g_hardware_interrupts[irq].enabled = true;
+    } else {
+        pic_enable_irq(irq);
+    }
+}
+
+/**
+ * @brief Mask an ISA IRQ line
+ */
+void irq_disable(uint8_t irq) {
+    if (irq >= 16) return;
+    
+    if (apic_is_enabled()) {
+        ioapic_set_irq_masked(irq, true);
+        g_hardware_interrupts[irq].enabled = false;
+    } else {
+        pic_disable_irq(irq);
+    }
+}
+
 /**
  * @brief Initialize timer interrupt
  */
@@ -337,24 +417,119 @@ int timer_init(uint32_t frequency) {
     g_timer_manager.tick_overruns = 0;
     g_timer_manager.initialized = true;
     
-    // Calculate timer divisor
-    uint32_t divisor = TIMER_DIVISOR / frequency;
+    // Pick the clock before calibrating the local APIC timer against it
+    clocksource_init();
     
-    // Set PIT to mode 3 (square wave generator)
-    outb(0x43, 0x36);  // Command port
-    outb(0x40, divisor & 0xFF);         // Low byte
-    outb(0x40, (divisor >> 8) & 0xFF);  // High byte
+    // The local APIC timer replaces IRQ 0 when the APIC is in use
+    if (apic_is_enabled()) {
+        apic_timer_calibrate();
+    }
+    hrtimers_init();
     
-    // Register timer interrupt handler
+    // Program periodic mode and set up NO_HZ tick management
+    timer_set_periodic(frequency);
+    tick_init();
+    
+    // Register timer interrupt handler (the APIC registers its own vector)
     idt_register_handler(IRQ_TIMER, timer_interrupt_handler);
     
     // Enable timer IRQ
-    pic_enable_irq(0);
+    if (!apic_is_enabled()) {
+        irq_enable(0);
+    }
     
     printf("[INFO] Timer initialized successfully\n");
     return 0;
 }
 
+/**
+ * @brief Program the tick timer for periodic interrupts
+ */
+void timer_set_periodic(uint32_t frequency) {
+    if (hrtimer_hres_active()) {
+        hrtimer_tick_set_periodic(NSEC_PER_SEC / frequency);
+    } else if (apic_is_enabled()) {
+        apic_timer_set_periodic(frequency);
+    } else {
+        pit_set_periodic(frequency);
+    }
+}
+
+/**
+ * @brief Program the tick timer for a single interrupt
+ */
+void timer_set_oneshot(uint32_t counts) {
+    if (hrtimer_hres_active()) {
+        hrtimer_tick_set_oneshot((uint64_t)counts * NSEC_PER_SEC / TIMER_DIVISOR);
+    } else if (apic_is_enabled()) {
+        uint64_t apic_counts = (uint64_t)counts * apic_timer_frequency() / TIMER_DIVISOR;
+        apic_timer_set_oneshot(apic_counts ? (uint32_t)apic_counts : 1);
+    } else {
+        pit_set_oneshot((uint16_t)(counts > PIT_MAX_COUNTS ? PIT_MAX_COUNTS : counts));
+    }
+}
+
+/**
+ * @brief Read the counts left in the tick timer's current one-shot
+ */
+uint32_t timer_read_counter(void) {
+    if (hrtimer_hres_active()) {
+        return (uint32_t)(hrtimer_tick_remaining_ns() * TIMER_DIVISOR / NSEC_PER_SEC);
+    }
+    if (apic_is_enabled()) {
+        uint64_t hz = apic_timer_frequency();
+        return hz ? (uint32_t)((uint64_t)apic_timer_read_counter() * TIMER_DIVISOR / hz) : 0;
+    }
+    return pit_read_counter();
+}
+
+/**
+ * @brief Get the longest one-shot the tick timer can be programmed for
+ */
+uint32_t timer_max_oneshot_counts(void) {
+    if (hrtimer_hres_active()) {
+        return 0xFFFFFFFF;      // hrtimers split long delays themselves
+    }
+    if (apic_is_enabled()) {
+        uint64_t hz = apic_timer_frequency();
+        uint64_t counts = hz ? 0xFFFFFFFFULL * TIMER_DIVISOR / hz : PIT_MAX_COUNTS;
+        return counts > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)counts;
+    }
+    return PIT_MAX_COUNTS;
+}
+
+/**
+ * @brief Program the PIT for periodic interrupts
+ */
+void pit_set_periodic(uint32_t frequency) {
+    uint32_t divisor = TIMER_DIVISOR / frequency;
+    
+    // Set PIT to mode 3 (square wave generator)
+    outb(PIT_COMMAND, PIT_MODE_PERIODIC);
+    outb(PIT_CHANNEL0, divisor & 0xFF);         // Low byte
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);  // High byte
+}
+
+/**
+ * @brief Program the PIT for a single interrupt
+ */
+void pit_set_oneshot(uint16_t counts) {
+    // Mode 0 raises IRQ 0 once when the counter reaches zero
+    outb(PIT_COMMAND, PIT_MODE_ONESHOT);
+    outb(PIT_CHANNEL0, counts & 0xFF);
+    outb(PIT_CHANNEL0, (counts >> 8) & 0xFF);
+}
+
+/**
+ * @brief Read the current PIT channel 0 down-counter
+ */
+uint16_t pit_read_counter(void) {
+    outb(PIT_COMMAND, PIT_LATCH_COUNTER);
+    uint8_t low = inb(PIT_CHANNEL0);
+    uint8_t high = inb(PIT_CHANNEL0);
+    return (uint16_t)((high << 8) | low);
+}
+
 /**
  * @brief Initialize the complete interrupt handling system
  */
@@ -372,6 +547,11 @@ int interrupt_init(void) {
     init_exception_table();
     init_hardware_interrupt_table();
     
+    // Initialize bottom halves before any handler can raise them
+    softirq_init();
+    irq_desc_init();
+    irq_poll_subsys_init();
+    
     // Initialize PIC
     result = pic_init();
     if (result != 0) {
@@ -379,6 +559,9 @@ int interrupt_init(void) {
         return result;
     }
     
+    // Hand delivery to the local APIC and I/O APIC when ACPI describes them
+    apic_init();
+    
     // Register critical exception handlers
     idt_register_handler(EXCEPTION_PAGE_FAULT, page_fault_handler);
     idt_register_handler(EXCEPTION_GENERAL_PROTECTION, gpf_handler);
@@ -391,9 +574,13 @@ int interrupt_init(void) {
         return result;
     }
     
+    // Spread device interrupts once more than one CPU takes them
+    irq_balance_init();
+    
     printf("[INFO] Interrupt system initialized successfully\n");
     printf("[INFO]   ΓåÆ IDT: %d entries configured\n", IDT_ENTRIES);
-    printf("[INFO]   ΓåÆ PIC: Remapped and initialized\n");
+    printf("[INFO]   ΓåÆ %s\n", apic_is_enabled() ? "APIC: I/O APIC routing, 8259 masked"
+                                                    : "PIC: Remapped and initialized");
     printf("[INFO]   ΓåÆ Timer: %d Hz frequency\n", TIMER_FREQUENCY);
     printf("[INFO]   ΓåÆ Exception handlers: Registered\n");
     
@@ -410,6 +597,7 @@ void interrupt_shutdown(void) {
     interrupts_disable();
     
     // Disable all IRQs
+    apic_shutdown();
     pic_set_irq_mask(0xFFFF);
     
     g_timer_manager.initialized = false;
@@ -438,15 +626,39 @@ uint64_t timer_get_uptime_sec(void) {
     return g_timer_manager.seconds;
 }
 
+/**
+ * @brief Check whether the caller may block in a timed sleep
+ */
+static bool timer_can_sleep(void) {
+    // Early boot, interrupt context and irqs-off sections have to spin
+    return scheduler_is_enabled() && get_current_thread() &&
+           !in_interrupt() && interrupts_enabled();
+}
+
 /**
  * @brief Sleep for specified milliseconds
  */
 void timer_sleep_ms(uint32_t ms) {
-    uint64_t start = timer_get_uptime_ms();
-    while ((timer_get_uptime_ms() - start) < ms) {
-        // Busy wait - in a real kernel, this would yield to scheduler
-        __asm__ volatile ("pause");
+    if (timer_can_sleep()) {
+        // Block on an hrtimer; the CPU runs other threads meanwhile
+        hrtimer_nanosleep((uint64_t)ms * NSEC_PER_MSEC);
+        return;
     }
+    
+    mdelay(ms);
+}
+
+/**
+ * @brief Sleep for specified microseconds
+ */
+void timer_sleep_us(uint32_t us) {
+    // Below TIMER_SLEEP_MIN_US two context switches cost more than the wait
+    if (us >= TIMER_SLEEP_MIN_US && timer_can_sleep()) {
+        hrtimer_nanosleep((uint64_t)us * NSEC_PER_USEC);
+        return;
+    }
+    
+    udelay(us);
 }
 
 /**
@@ -465,6 +677,16 @@ const hardware_interrupt_info_t* irq_get_info(uint8_t irq) {
     return &g_hardware_interrupts[irq];
 }
 
+/**
+ * @brief Account one interrupt of an ISA line
+ */
+void irq_account_time(uint8_t irq, uint64_t timestamp, uint64_t cycles) {
+    if (irq >= 16) return;
+    g_hardware_interrupts[irq].count++;
+    g_hardware_interrupts[irq].last_time = timestamp;
+    g_hardware_interrupts[irq].total_time += cycles;
+}
+
 /**
  * @brief Get timer manager information
  */
@@ -476,22 +698,14 @@ const timer_manager_t* timer_get_manager(void) {
  * @brief Enter critical section
  */
 uint64_t critical_section_enter(void) {
-    return interrupts_disable();
+    return interrupts_disable_caller(__builtin_return_address(0));
 }
 
 /**
  * @brief Exit critical section
  */
 void critical_section_exit(uint64_t state) {
-    interrupts_restore(state);
-}
-
-/**
- * @brief Check if we're in an interrupt
- */
-bool in_interrupt(void) {
-    const interrupt_stats_t* stats = idt_get_stats();
-    return stats->nested_interrupts > 0;
+    interrupts_restore_caller(state, __builtin_return_address(0));
 }
 
 /**
@@ -527,15 +741,29 @@ void interrupt_dump_status(void) {
            g_timer_manager.milliseconds, g_timer_manager.seconds);
     printf("Frequency: %u Hz\n", g_timer_manager.frequency);
     
+    clocksource_dump_status();
+    tick_dump_status();
+    hrtimer_dump_status();
+    softirq_dump_status();
+    irq_poll_dump_status();
+    apic_dump_status();
+    irq_dump_status();
+    irq_balance_dump_status();
+    irqtrace_dump_status();
+    
     printf("\n=== Hardware Interrupts ===\n");
     for (int i = 0; i < 16; i++) {
         if (g_hardware_interrupts[i].count > 0 || g_hardware_interrupts[i].enabled) {
-            printf("IRQ %2d (%s): %u interrupts, %s\n", 
+            printf("IRQ %2d (%s): %u interrupts, %llu ns in handler, %s\n", 
                    i, g_hardware_interrupts[i].name, 
                    g_hardware_interrupts[i].count,
+                   irqtrace_cycles_to_ns(g_hardware_interrupts[i].total_time),
                    g_hardware_interrupts[i].enabled ? "Enabled" : "Disabled");
         }
     }
+    if (g_kbd_dropped) {
+        printf("Keyboard scancodes dropped: %llu\n", g_kbd_dropped);
+    }
     
     printf("\n=== Recent Exceptions ===\n");
     for (int i = 0; i < 32; i++) {
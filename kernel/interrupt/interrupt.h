@@ -42,6 +42,17 @@
 #define TIMER_FREQUENCY     1000        /**< Timer frequency in Hz (1ms) */
 #define TIMER_DIVISOR       1193180     /**< PIT base frequency */
 #define TIMER_RELOAD_VALUE  (TIMER_DIVISOR / TIMER_FREQUENCY)
+#define TIMER_SLEEP_MIN_US  50          /**< Shortest wait worth blocking for */
+
+/**
+ * @brief PIT (Programmable Interval Timer) ports and modes
+ */
+#define PIT_CHANNEL0        0x40    /**< Channel 0 data port */
+#define PIT_COMMAND         0x43    /**< Mode/command port */
+#define PIT_MODE_ONESHOT    0x30    /**< Channel 0, lo/hi, mode 0 (terminal count) */
+#define PIT_MODE_PERIODIC   0x36    /**< Channel 0, lo/hi, mode 3 (square wave) */
+#define PIT_LATCH_COUNTER   0x00    /**< Channel 0 counter latch command */
+#define PIT_MAX_COUNTS      0xFFFF  /**< Largest 16-bit reload value */
 
 /**
  * @brief Exception error codes
@@ -79,8 +90,8 @@ typedef struct {
     uint8_t         vector;         /**< Interrupt vector */
     uint32_t        count;          /**< Interrupt count */
     bool            enabled;        /**< Interrupt enabled state */
-    uint64_t        last_time;      /**< Last interrupt time */
-    uint64_t        total_time;     /**< Total processing time */
+    uint64_t        last_time;      /**< TSC at the last interrupt entry */
+    uint64_t        total_time;     /**< TSC cycles spent in the handler */
 } hardware_interrupt_info_t;
 
 /**
@@ -180,6 +191,29 @@ uint16_t pic_get_irq_mask(void);
  */
 void pic_set_irq_mask(uint16_t mask);
 
+/**
+ * @brief Send End of Interrupt for an ISA IRQ
+ * 
+ * Goes to the local APIC when it has replaced the PIC, else to the 8259.
+ * 
+ * @param irq IRQ number that was serviced
+ */
+void irq_send_eoi(uint8_t irq);
+
+/**
+ * @brief Unmask an ISA IRQ line at the I/O APIC or the 8259
+ * 
+ * @param irq IRQ number to enable (0-15)
+ */
+void irq_enable(uint8_t irq);
+
+/**
+ * @brief Mask an ISA IRQ line at the I/O APIC or the 8259
+ * 
+ * @param irq IRQ number to disable (0-15)
+ */
+void irq_disable(uint8_t irq);
+
 /**
  * @brief Initialize timer interrupt
  * 
@@ -190,6 +224,69 @@ void pic_set_irq_mask(uint16_t mask);
  */
 int timer_init(uint32_t frequency);
 
+/**
+ * @brief Program the tick timer for periodic interrupts
+ * 
+ * The tick timer is the calling CPU's local APIC timer when the APIC is in
+ * use, else the PIT.
+ * 
+ * @param frequency Interrupt frequency in Hz
+ */
+void timer_set_periodic(uint32_t frequency);
+
+/**
+ * @brief Program the tick timer for a single interrupt
+ * 
+ * @param counts Delay in PIT input clock counts (TIMER_DIVISOR per second),
+ *               whichever device is used
+ */
+void timer_set_oneshot(uint32_t counts);
+
+/**
+ * @brief Read the counts left in the tick timer's current one-shot
+ * 
+ * @return Remaining PIT input clock counts
+ */
+uint32_t timer_read_counter(void);
+
+/**
+ * @brief Get the longest one-shot the tick timer can be programmed for
+ * 
+ * @return Limit in PIT input clock counts
+ */
+uint32_t timer_max_oneshot_counts(void);
+
+/**
+ * @brief Program the PIT for periodic interrupts
+ * 
+ * @param frequency Interrupt frequency in Hz
+ */
+void pit_set_periodic(uint32_t frequency);
+
+/**
+ * @brief Program the PIT for a single interrupt
+ * 
+ * @param counts PIT input clock counts until the interrupt
+ */
+void pit_set_oneshot(uint16_t counts);
+
+/**
+ * @brief Read the current PIT channel 0 down-counter
+ * 
+ * @return Remaining counts of the current period
+ */
+uint16_t pit_read_counter(void);
+
+/**
+ * @brief Advance the timer by a number of ticks
+ * 
+ * Used by the tick code to account several ticks at once after the
+ * periodic tick was stopped.
+ * 
+ * @param nticks Number of elapsed ticks
+ */
+void timer_account_ticks(uint64_t nticks);
+
 /**
  * @brief Get current timer ticks
  * 
@@ -214,6 +311,9 @@ uint64_t timer_get_uptime_sec(void);
 /**
  * @brief Sleep for specified milliseconds
  * 
+ * Blocks the calling thread on an hrtimer once the scheduler runs; in
+ * early boot, interrupt context or with interrupts off it spins instead.
+ * 
  * @param ms Milliseconds to sleep
  */
 void timer_sleep_ms(uint32_t ms);
@@ -221,6 +321,8 @@ void timer_sleep_ms(uint32_t ms);
 /**
  * @brief Sleep for specified microseconds
  * 
+ * Waits shorter than TIMER_SLEEP_MIN_US always spin with udelay().
+ * 
  * @param us Microseconds to sleep
  */
 void timer_sleep_us(uint32_t us);
@@ -275,6 +377,17 @@ const exception_info_t* exception_get_info(uint8_t exception);
  */
 const hardware_interrupt_info_t* irq_get_info(uint8_t irq);
 
+/**
+ * @brief Account one interrupt of an ISA line
+ * 
+ * Called on handler exit with the TSC taken on entry.
+ * 
+ * @param irq IRQ number (0-15)
+ * @param timestamp TSC at handler entry
+ * @param cycles TSC cycles spent in the handler
+ */
+void irq_account_time(uint8_t irq, uint64_t timestamp, uint64_t cycles);
+
 /**
  * @brief Get timer manager information
  * 
@@ -316,6 +429,9 @@ void interrupt_exit(interrupt_context_t* ctx);
 /**
  * @brief Check if we're currently in an interrupt
  * 
+ * Implemented by the softirq layer, which tracks hard interrupt and
+ * softirq context per CPU.
+ * 
  * @return true if in interrupt context, false otherwise
  */
 bool in_interrupt(void);
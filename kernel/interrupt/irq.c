@@ -0,0 +1,764 @@
+/**
+ * @file irq.c
+ * @brief Device interrupt requests: shared lines and threaded handlers for FG-OS
+ *
+ * A line with at least one request has irq_flow_handler() in its IDT slot.
+ * The flow handler runs every action on the chain, wakes the threads of
+ * actions that asked for it and acknowledges the controller once. When a
+ * IRQF_ONESHOT thread is woken the line is masked before the EOI, so a
+ * level-triggered device that is still asserting cannot interrupt again
+ * until its thread has serviced it; the last such thread to finish
+ * unmasks it.
+ *
+ * Actions are added and removed under the descriptor lock with interrupts
+ * off; the flow handler walks the chain without the lock and counts
+ * itself in desc->in_progress so free_irq() can wait it out before
+ * freeing an action.
+ *
+ * Affinity changes go through the chip's set_affinity operation with the
+ * descriptor lock held, so a line is never routed to a CPU outside the
+ * mask it was last given.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "irq.h"
+#include "interrupt.h"
+#include "apic.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../mm/memory.h"
+#include "../sched/scheduler.h"
+#include "../sched/wait.h"
+#include "../sched/topology.h"
+#include "../include/syscall.h"
+
+/**
+ * @brief Thread state bits (irqaction_t.thread_flags)
+ */
+#define IRQTF_RUNTHREAD     (1 << 0)    /**< Thread function is due */
+#define IRQTF_STOP          (1 << 1)    /**< free_irq() wants the thread gone */
+#define IRQTF_EXITED        (1 << 2)    /**< Thread has returned */
+
+/**
+ * @brief One handler attached to a line
+ */
+typedef struct irqaction {
+    struct irqaction*   next;           /**< Next handler on the line */
+    irq_handler_t       handler;        /**< Primary handler, NULL to just wake the thread */
+    irq_handler_t       thread_fn;      /**< Thread function, NULL if none */
+    void*               dev_id;         /**< Owner cookie */
+    uint32_t            flags;          /**< IRQF_* */
+    uint32_t            irq;            /**< Line */
+    const char*         name;           /**< Owner name */
+    struct thread*      thread;         /**< Thread running thread_fn */
+    wait_queue_head_t   thread_wq;      /**< Thread sleeps here */
+    volatile uint32_t   thread_flags;   /**< IRQTF_* */
+} irqaction_t;
+
+/**
+ * @brief Interrupt descriptor of a line
+ */
+typedef struct {
+    spinlock_t          lock;               /**< Protects the chain, depth and chip */
+    irqaction_t*        action;             /**< Handler chain */
+    const irq_chip_t*   chip;               /**< Controller operations */
+    void*               chip_data;          /**< Argument to the chip */
+    uint32_t            depth;              /**< disable_irq() nesting */
+    volatile uint32_t   in_progress;        /**< Flow handlers running */
+    volatile uint32_t   threads_oneshot;    /**< ONESHOT threads due; line masked while nonzero */
+    volatile uint32_t   threads_active;     /**< Thread functions running */
+    uint32_t            spurious_window;    /**< Interrupts in the current detection window */
+    uint32_t            spurious_count;     /**< Unclaimed interrupts in the window */
+    irq_line_stats_t    stats;              /**< Statistics */
+} irq_desc_t;
+
+static irq_desc_t g_irq_descs[IDT_ENTRIES];
+
+// Threaded handlers run under one process, created on first use
+static struct process* g_irq_process = NULL;
+
+// Internal function declarations
+static void irq_flow_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context);
+static void irq_wake_thread(irq_desc_t* desc, irqaction_t* action);
+static void irq_finalize_oneshot(irq_desc_t* desc);
+static void irq_note_unhandled(irq_desc_t* desc, uint32_t irq, bool handled);
+static void irq_thread(void* arg);
+static int irq_start_thread(irqaction_t* action);
+static void irq_stop_thread(irqaction_t* action);
+static bool irq_valid(uint32_t irq);
+static void irq_chip_mask(irq_desc_t* desc, uint32_t irq);
+static void irq_chip_unmask(irq_desc_t* desc, uint32_t irq);
+static void isa_irq_mask(uint32_t irq, void* chip_data);
+static void isa_irq_unmask(uint32_t irq, void* chip_data);
+static void isa_irq_eoi(uint32_t irq, void* chip_data);
+static void apic_irq_eoi(uint32_t irq, void* chip_data);
+static int isa_irq_set_affinity(uint32_t irq, void* chip_data, uint32_t cpu);
+static int irq_do_set_affinity(irq_desc_t* desc, uint32_t irq, uint32_t cpu);
+
+/**
+ * @brief PIC or I/O APIC routed ISA lines
+ */
+static const irq_chip_t isa_irq_chip = {
+    .name = "ISA",
+    .mask = isa_irq_mask,
+    .unmask = isa_irq_unmask,
+    .eoi = isa_irq_eoi,
+    .set_affinity = isa_irq_set_affinity,
+};
+
+/**
+ * @brief Vectors only the local APIC knows about (messages, IPIs)
+ */
+static const irq_chip_t apic_irq_chip = {
+    .name = "APIC",
+    .mask = NULL,
+    .unmask = NULL,
+    .eoi = apic_irq_eoi,
+    .set_affinity = NULL,
+};
+
+/**
+ * @brief Initialize the interrupt descriptors
+ */
+void irq_desc_init(void) {
+    memset(g_irq_descs, 0, sizeof(g_irq_descs));
+
+    // The I/O APIC starts out delivering everything to the boot CPU
+    uint32_t boot_cpu = smp_processor_id();
+
+    for (uint32_t irq = 0; irq < IDT_ENTRIES; irq++) {
+        irq_desc_t* desc = &g_irq_descs[irq];
+        spin_lock_init(&desc->lock);
+        bool isa = irq >= IRQ_TIMER && irq <= IRQ_SECONDARY_ATA;
+        desc->chip = isa ? &isa_irq_chip : &apic_irq_chip;
+        desc->stats.affinity = CPU_MASK_ALL;
+        desc->stats.effective_cpu = boot_cpu;
+    }
+
+    printf("[INFO] Interrupt descriptors initialized\n");
+}
+
+/**
+ * @brief Attach a handler and an optional thread function to a line
+ */
+int request_threaded_irq(uint32_t irq, irq_handler_t handler, irq_handler_t thread_fn,
+                         uint32_t flags, const char* name, void* dev_id) {
+    if (!irq_valid(irq) || (!handler && !thread_fn)) {
+        return KERN_INVALID;
+    }
+    if ((flags & IRQF_SHARED) && !dev_id) {
+        return KERN_INVALID;
+    }
+    if (!handler) {
+        flags |= IRQF_ONESHOT;
+    }
+
+    irqaction_t* action = (irqaction_t*)kcalloc(1, sizeof(irqaction_t));
+    if (!action) {
+        return KERN_NOMEM;
+    }
+    action->handler = handler;
+    action->thread_fn = thread_fn;
+    action->dev_id = dev_id;
+    action->flags = flags;
+    action->irq = irq;
+    action->name = name ? name : "unknown";
+    init_waitqueue_head(&action->thread_wq);
+
+    if (thread_fn) {
+        int result = irq_start_thread(action);
+        if (result != KERN_SUCCESS) {
+            kfree(action);
+            return result;
+        }
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t lock_flags = spin_lock_irqsave(&desc->lock);
+
+    irqaction_t* old = desc->action;
+    if (old) {
+        // Everyone on a shared line has to agree to share it, and on
+        // whether it stays masked for the threads
+        bool mismatch = !(old->flags & flags & IRQF_SHARED) ||
+                        ((old->flags ^ flags) & IRQF_ONESHOT);
+        if (mismatch) {
+            spin_unlock_irqrestore(&desc->lock, lock_flags);
+            irq_stop_thread(action);
+            kfree(action);
+            return KERN_BUSY;
+        }
+        while (old->next) {
+            old = old->next;
+        }
+        old->next = action;
+    } else {
+        desc->action = action;
+        desc->spurious_window = 0;
+        desc->spurious_count = 0;
+        idt_register_handler((uint8_t)irq, irq_flow_handler);
+        if (desc->depth == 0) {
+            irq_chip_unmask(desc, irq);
+        }
+    }
+    desc->stats.actions++;
+
+    spin_unlock_irqrestore(&desc->lock, lock_flags);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Attach a handler to a line
+ */
+int request_irq(uint32_t irq, irq_handler_t handler, uint32_t flags, const char* name, void* dev_id) {
+    if (!handler) {
+        return KERN_INVALID;
+    }
+    return request_threaded_irq(irq, handler, NULL, flags, name, dev_id);
+}
+
+/**
+ * @brief Detach a handler
+ */
+int free_irq(uint32_t irq, void* dev_id) {
+    if (!irq_valid(irq)) {
+        return KERN_INVALID;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+
+    irqaction_t** link = &desc->action;
+    while (*link && (*link)->dev_id != dev_id) {
+        link = &(*link)->next;
+    }
+    irqaction_t* action = *link;
+    if (!action) {
+        spin_unlock_irqrestore(&desc->lock, flags);
+        return KERN_NOTFOUND;
+    }
+    *link = action->next;
+    desc->stats.actions--;
+
+    if (!desc->action) {
+        irq_chip_mask(desc, irq);
+        idt_unregister_handler((uint8_t)irq);
+    }
+    spin_unlock_irqrestore(&desc->lock, flags);
+
+    // A flow handler on another CPU may still be calling the action. The
+    // unlock only releases, so order the unlink before the in_progress
+    // load; pairs with the locked increment in irq_flow_handler()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&desc->in_progress, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile ("pause");
+    }
+
+    irq_stop_thread(action);
+    kfree(action);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Install the controller operations of a line
+ */
+void irq_set_chip(uint32_t irq, const irq_chip_t* chip, void* chip_data) {
+    if (!irq_valid(irq)) {
+        return;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    if (!chip) {
+        bool isa = irq >= IRQ_TIMER && irq <= IRQ_SECONDARY_ATA;
+        chip = isa ? &isa_irq_chip : &apic_irq_chip;
+    }
+    desc->chip = chip;
+    desc->chip_data = chip_data;
+    spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * @brief Mask a line without waiting for running handlers
+ */
+void disable_irq_nosync(uint32_t irq) {
+    if (!irq_valid(irq)) {
+        return;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    if (desc->depth++ == 0) {
+        irq_chip_mask(desc, irq);
+    }
+    desc->stats.depth = desc->depth;
+    spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * @brief Mask a line and wait for its handlers and threads to finish
+ */
+void disable_irq(uint32_t irq) {
+    disable_irq_nosync(irq);
+    synchronize_irq(irq);
+}
+
+/**
+ * @brief Undo one disable_irq()
+ */
+void enable_irq(uint32_t irq) {
+    if (!irq_valid(irq)) {
+        return;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    if (desc->depth == 0) {
+        printf("[WARNING] Unbalanced enable_irq(0x%02X)\n", irq);
+    } else if (--desc->depth == 0 && desc->action && desc->threads_oneshot == 0) {
+        irq_chip_unmask(desc, irq);
+    }
+    desc->stats.depth = desc->depth;
+    spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * @brief Wait for running primary handlers and thread functions of a line
+ */
+void synchronize_irq(uint32_t irq) {
+    if (!irq_valid(irq)) {
+        return;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+
+    // Earlier stores (an unlinked action, a disabled line) before the load
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&desc->in_progress, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile ("pause");
+    }
+
+    // Threads may sleep in the thread function; let them run to the end
+    for (;;) {
+        bool busy = __atomic_load_n(&desc->threads_active, __ATOMIC_ACQUIRE) != 0;
+
+        uint64_t flags = spin_lock_irqsave(&desc->lock);
+        for (irqaction_t* action = desc->action; action && !busy; action = action->next) {
+            busy = (action->thread_flags & IRQTF_RUNTHREAD) != 0;
+        }
+        spin_unlock_irqrestore(&desc->lock, flags);
+
+        if (!busy) {
+            break;
+        }
+        yield();
+    }
+}
+
+/**
+ * @brief Set the CPUs a line may be delivered to
+ */
+int irq_set_affinity(uint32_t irq, cpumask_t mask) {
+    if (!irq_valid(irq)) {
+        return KERN_INVALID;
+    }
+
+    cpumask_t online = mask & cpu_online_mask;
+    if (online == CPU_MASK_NONE) {
+        return KERN_INVALID;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+
+    int result = KERN_SUCCESS;
+    uint32_t cpu = desc->stats.effective_cpu;
+    if (!cpumask_test_cpu(cpu, online)) {
+        result = irq_do_set_affinity(desc, irq, cpumask_first(online));
+    }
+    if (result == KERN_SUCCESS) {
+        desc->stats.affinity = mask;
+    }
+
+    spin_unlock_irqrestore(&desc->lock, flags);
+    return result;
+}
+
+/**
+ * @brief Route a line to one CPU of its affinity mask
+ */
+int irq_set_effective_cpu(uint32_t irq, uint32_t cpu) {
+    if (!irq_valid(irq) || !cpumask_test_cpu(cpu, cpu_online_mask)) {
+        return KERN_INVALID;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+
+    int result = KERN_SUCCESS;
+    if (!cpumask_test_cpu(cpu, desc->stats.affinity)) {
+        result = KERN_INVALID;
+    } else if (cpu != desc->stats.effective_cpu) {
+        result = irq_do_set_affinity(desc, irq, cpu);
+    }
+
+    spin_unlock_irqrestore(&desc->lock, flags);
+    return result;
+}
+
+/**
+ * @brief Record where a line's owner already routed it
+ */
+void irq_set_effective_affinity(uint32_t irq, cpumask_t mask, uint32_t cpu) {
+    if (!irq_valid(irq) || cpu >= MAX_CPUS) {
+        return;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    desc->stats.affinity = mask;
+    desc->stats.effective_cpu = cpu;
+    spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * @brief Get the statistics of a line
+ */
+int irq_get_line_stats(uint32_t irq, irq_line_stats_t* stats) {
+    if (irq >= IDT_ENTRIES || !stats) {
+        return KERN_INVALID;
+    }
+
+    irq_desc_t* desc = &g_irq_descs[irq];
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    *stats = desc->stats;
+
+    // Movable: requested, routable, and more than one CPU to choose from
+    stats->balance = desc->action && desc->chip->set_affinity &&
+                     cpumask_weight(desc->stats.affinity & cpu_online_mask) > 1;
+    for (irqaction_t* action = desc->action; action; action = action->next) {
+        if (action->flags & IRQF_NO_BALANCING) {
+            stats->balance = false;
+        }
+    }
+
+    spin_unlock_irqrestore(&desc->lock, flags);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Print the lines with handlers attached
+ */
+void irq_dump_status(void) {
+    printf("\n=== Requested IRQs ===\n");
+
+    for (uint32_t irq = 0; irq < IDT_ENTRIES; irq++) {
+        irq_desc_t* desc = &g_irq_descs[irq];
+        if (!desc->action && desc->stats.count == 0) {
+            continue;
+        }
+
+        printf("IRQ 0x%02X [%s]: %llu interrupts, %llu unhandled, %llu thread wakeups%s\n",
+               irq, desc->chip->name, desc->stats.count, desc->stats.unhandled,
+               desc->stats.thread_wakeups, desc->depth ? ", disabled" : "");
+        printf("  CPU %u, affinity 0x%llx, moved %u times\n",
+               desc->stats.effective_cpu, desc->stats.affinity, desc->stats.moves);
+
+        uint64_t flags = spin_lock_irqsave(&desc->lock);
+        for (irqaction_t* action = desc->action; action; action = action->next) {
+            printf("  %s%s%s%s\n", action->name,
+                   action->thread_fn ? " (threaded)" : "",
+                   (action->flags & IRQF_SHARED) ? " shared" : "",
+                   (action->flags & IRQF_ONESHOT) ? " oneshot" : "");
+        }
+        spin_unlock_irqrestore(&desc->lock, flags);
+    }
+}
+
+/**
+ * @brief SYS_IRQ_SETAFFINITY handler
+ */
+int64_t sys_irq_setaffinity(uint64_t irq, uint64_t size, uint64_t uaddr) {
+    if (!uaddr || size < sizeof(cpumask_t) || irq >= IDT_ENTRIES) {
+        return KERN_INVALID;
+    }
+
+    return irq_set_affinity((uint32_t)irq, *(const cpumask_t*)uaddr);
+}
+
+// Internal functions
+
+/**
+ * @brief Route a line to a CPU through its chip (desc->lock held)
+ */
+static int irq_do_set_affinity(irq_desc_t* desc, uint32_t irq, uint32_t cpu) {
+    if (!desc->chip->set_affinity) {
+        return KERN_INVALID;
+    }
+
+    int result = desc->chip->set_affinity(irq, desc->chip_data, cpu);
+    if (result != 0) {
+        return KERN_ERROR;
+    }
+
+    desc->stats.effective_cpu = cpu;
+    desc->stats.moves++;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief IDT entry of every requested line
+ */
+static void irq_flow_handler(uint8_t vector, uint64_t error_code, struct cpu_state* context) {
+    (void)error_code; (void)context;
+
+    irq_desc_t* desc = &g_irq_descs[vector];
+    uint32_t irq = vector;
+    uint32_t result = IRQ_NONE;
+
+    __atomic_add_fetch(&desc->in_progress, 1, __ATOMIC_ACQ_REL);
+    desc->stats.count++;
+
+    for (irqaction_t* action = desc->action; action; action = action->next) {
+        irqreturn_t ret = action->handler ? action->handler(irq, action->dev_id) : IRQ_WAKE_THREAD;
+
+        if ((ret & IRQ_WAKE_THREAD) && action->thread_fn) {
+            irq_wake_thread(desc, action);
+        }
+        result |= ret;
+    }
+
+    // ONESHOT: keep a still-asserted line quiet until the threads ran. The
+    // lock orders this against the last thread unmasking it
+    if (desc->threads_oneshot) {
+        spin_lock(&desc->lock);
+        if (desc->threads_oneshot) {
+            irq_chip_mask(desc, irq);
+        }
+        spin_unlock(&desc->lock);
+    }
+    irq_note_unhandled(desc, irq, result != IRQ_NONE);
+
+    if (desc->chip->eoi) {
+        desc->chip->eoi(irq, desc->chip_data);
+    }
+
+    __atomic_sub_fetch(&desc->in_progress, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Mark an action's thread function due and wake its thread
+ */
+static void irq_wake_thread(irq_desc_t* desc, irqaction_t* action) {
+    uint32_t old = __atomic_fetch_or(&action->thread_flags, IRQTF_RUNTHREAD, __ATOMIC_ACQ_REL);
+    if (old & (IRQTF_RUNTHREAD | IRQTF_STOP)) {
+        return;     // Already due: one run covers both interrupts
+    }
+
+    if (action->flags & IRQF_ONESHOT) {
+        __atomic_add_fetch(&desc->threads_oneshot, 1, __ATOMIC_ACQ_REL);
+    }
+    desc->stats.thread_wakeups++;
+    wake_up(&action->thread_wq);
+}
+
+/**
+ * @brief A ONESHOT thread is done; unmask once the last one is
+ */
+static void irq_finalize_oneshot(irq_desc_t* desc) {
+    uint32_t irq = (uint32_t)(desc - g_irq_descs);
+
+    uint64_t flags = spin_lock_irqsave(&desc->lock);
+    if (desc->threads_oneshot && --desc->threads_oneshot == 0 && desc->depth == 0 && desc->action) {
+        irq_chip_unmask(desc, irq);
+    }
+    spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * @brief Disable a line that keeps firing without anyone claiming it
+ */
+static void irq_note_unhandled(irq_desc_t* desc, uint32_t irq, bool handled) {
+    if (!handled) {
+        desc->stats.unhandled++;
+        desc->spurious_count++;
+    }
+
+    if (++desc->spurious_window < IRQ_SPURIOUS_WINDOW) {
+        return;
+    }
+
+    if (desc->spurious_count > IRQ_SPURIOUS_LIMIT) {
+        printf("[WARNING] IRQ 0x%02X: nobody cared (%u of %u unhandled), disabling\n",
+               irq, desc->spurious_count, desc->spurious_window);
+        spin_lock(&desc->lock);
+        if (desc->depth++ == 0) {
+            irq_chip_mask(desc, irq);
+        }
+        desc->stats.depth = desc->depth;
+        spin_unlock(&desc->lock);
+    }
+    desc->spurious_window = 0;
+    desc->spurious_count = 0;
+}
+
+/**
+ * @brief Body of a threaded handler's thread
+ *
+ * @param arg Action
+ */
+static void irq_thread(void* arg) {
+    irqaction_t* action = (irqaction_t*)arg;
+    irq_desc_t* desc = &g_irq_descs[action->irq];
+
+    for (;;) {
+        struct wait_queue_entry wait;
+        init_waitqueue_entry(&wait, get_current_thread(), 0);
+        uint64_t flags = interrupts_disable();
+        add_wait_queue(&action->thread_wq, &wait);
+
+        // Pairs with the flag update in irq_wake_thread() before wake_up()
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (action->thread_flags & (IRQTF_RUNTHREAD | IRQTF_STOP)) {
+            remove_wait_queue(&wait);
+        } else {
+            wait_entry_sleep(&wait, WAIT_FOREVER);
+        }
+        interrupts_restore(flags);
+
+        if (__atomic_load_n(&action->thread_flags, __ATOMIC_ACQUIRE) & IRQTF_STOP) {
+            break;
+        }
+        if (!(__atomic_load_n(&action->thread_flags, __ATOMIC_ACQUIRE) & IRQTF_RUNTHREAD)) {
+            continue;
+        }
+
+        __atomic_add_fetch(&desc->threads_active, 1, __ATOMIC_ACQ_REL);
+        // Clear first: an interrupt arriving while we run queues another pass
+        __atomic_and_fetch(&action->thread_flags, ~IRQTF_RUNTHREAD, __ATOMIC_ACQ_REL);
+        action->thread_fn(action->irq, action->dev_id);
+        if (action->flags & IRQF_ONESHOT) {
+            irq_finalize_oneshot(desc);
+        }
+        __atomic_sub_fetch(&desc->threads_active, 1, __ATOMIC_ACQ_REL);
+    }
+
+    // Work owed at shutdown is dropped, but the line must not stay masked
+    uint32_t old = __atomic_fetch_and(&action->thread_flags, ~IRQTF_RUNTHREAD, __ATOMIC_ACQ_REL);
+    if ((old & IRQTF_RUNTHREAD) && (action->flags & IRQF_ONESHOT)) {
+        irq_finalize_oneshot(desc);
+    }
+    __atomic_fetch_or(&action->thread_flags, IRQTF_EXITED, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Create the thread of a threaded handler
+ */
+static int irq_start_thread(irqaction_t* action) {
+    if (!g_irq_process) {
+        g_irq_process = create_process("irq", 0);
+    }
+
+    struct thread* task = g_irq_process ? create_thread(g_irq_process->pid, irq_thread, action) : NULL;
+    if (!task) {
+        return KERN_NOMEM;
+    }
+
+    // Interrupt work comes before ordinary threads, as it would in a hard handler
+    set_thread_priority(task->tid, PRIORITY_HIGH);
+    action->thread = task;
+    scheduler_add_thread(task);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Stop the thread of a threaded handler and wait for it to return
+ */
+static void irq_stop_thread(irqaction_t* action) {
+    if (!action->thread) {
+        return;
+    }
+
+    __atomic_fetch_or(&action->thread_flags, IRQTF_STOP, __ATOMIC_SEQ_CST);
+    wake_up(&action->thread_wq);
+    while (!(__atomic_load_n(&action->thread_flags, __ATOMIC_ACQUIRE) & IRQTF_EXITED)) {
+        yield();
+    }
+    action->thread = NULL;
+}
+
+/**
+ * @brief Check that a line can be requested
+ */
+static bool irq_valid(uint32_t irq) {
+    // Exceptions and the software interrupt gates are not device lines
+    return irq >= IRQ_TIMER && irq < IDT_ENTRIES && !(irq >= INT_SYSCALL && irq <= INT_IPI);
+}
+
+/**
+ * @brief Stop delivery through the line's chip
+ */
+static void irq_chip_mask(irq_desc_t* desc, uint32_t irq) {
+    if (desc->chip->mask) {
+        desc->chip->mask(irq, desc->chip_data);
+    }
+}
+
+/**
+ * @brief Resume delivery through the line's chip
+ */
+static void irq_chip_unmask(irq_desc_t* desc, uint32_t irq) {
+    if (desc->chip->unmask) {
+        desc->chip->unmask(irq, desc->chip_data);
+    }
+}
+
+/**
+ * @brief Mask an ISA line at the PIC or I/O APIC
+ */
+static void isa_irq_mask(uint32_t irq, void* chip_data) {
+    (void)chip_data;
+    irq_disable((uint8_t)(irq - IRQ_TIMER));
+}
+
+/**
+ * @brief Unmask an ISA line at the PIC or I/O APIC
+ */
+static void isa_irq_unmask(uint32_t irq, void* chip_data) {
+    (void)chip_data;
+    irq_enable((uint8_t)(irq - IRQ_TIMER));
+}
+
+/**
+ * @brief Acknowledge an ISA line
+ */
+static void isa_irq_eoi(uint32_t irq, void* chip_data) {
+    (void)chip_data;
+    irq_send_eoi((uint8_t)(irq - IRQ_TIMER));
+}
+
+/**
+ * @brief Point an ISA line's I/O APIC entry at another CPU
+ */
+static int isa_irq_set_affinity(uint32_t irq, void* chip_data, uint32_t cpu) {
+    (void)chip_data;
+
+    // The 8259 can only deliver to the boot CPU
+    if (!apic_is_enabled()) {
+        return -1;
+    }
+    return ioapic_set_irq_dest((uint8_t)(irq - IRQ_TIMER), cpu_get_topology(cpu)->apic_id);
+}
+
+/**
+ * @brief Acknowledge a vector at the local APIC
+ */
+static void apic_irq_eoi(uint32_t irq, void* chip_data) {
+    (void)irq; (void)chip_data;
+    apic_eoi();
+}
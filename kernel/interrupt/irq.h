@@ -0,0 +1,240 @@
+/**
+ * @file irq.h
+ * @brief Device interrupt requests: shared lines and threaded handlers for FG-OS
+ *
+ * Drivers attach to an interrupt with request_irq() or
+ * request_threaded_irq() instead of owning the IDT slot. Every vector
+ * with a request gets a descriptor holding a chain of actions, so several
+ * devices can share one INTx line, each handler reporting whether its
+ * device raised the interrupt. A handler may be split in two: a short
+ * primary handler in hard interrupt context that quiets the device and
+ * returns IRQ_WAKE_THREAD, and a thread function that does the rest in a
+ * dedicated kernel thread where it may sleep.
+ *
+ * IRQ numbers are IDT vectors: ISA line n is ISA_IRQ_VECTOR(n), message
+ * interrupts use the vector returned by idt_alloc_vector().
+ *
+ * Each line has an affinity mask of the CPUs it may be delivered to and
+ * one effective CPU it is currently routed to. The balancer moves lines
+ * within their masks; a line whose mask holds a single CPU stays put.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __IRQ_H__
+#define __IRQ_H__
+
+#include <types.h>
+#include "idt.h"
+#include "../sched/topology.h"
+
+/**
+ * @brief IRQ number of an ISA line
+ */
+#define ISA_IRQ_VECTOR(line)    (IRQ_TIMER + (line))
+
+/**
+ * @brief request_irq() flags
+ */
+#define IRQF_SHARED             (1 << 0)    /**< Line may be shared with other devices */
+#define IRQF_ONESHOT            (1 << 1)    /**< Keep the line masked until the thread function ran */
+#define IRQF_NO_BALANCING       (1 << 2)    /**< Never move the line between CPUs */
+
+/**
+ * @brief Spurious interrupt detection
+ *
+ * Out of every IRQ_SPURIOUS_WINDOW interrupts on a line, more than
+ * IRQ_SPURIOUS_LIMIT that no handler claims disable the line.
+ */
+#define IRQ_SPURIOUS_WINDOW     100000
+#define IRQ_SPURIOUS_LIMIT      99900
+
+/**
+ * @brief Handler result
+ */
+typedef enum {
+    IRQ_NONE = 0,                   /**< Interrupt was not from this device */
+    IRQ_HANDLED = (1 << 0),         /**< Interrupt was handled */
+    IRQ_WAKE_THREAD = (1 << 1)      /**< Run the thread function */
+} irqreturn_t;
+
+/**
+ * @brief Primary or thread handler
+ *
+ * @param irq IRQ number (IDT vector)
+ * @param dev_id Cookie given to request_irq()
+ * @return irqreturn_t
+ */
+typedef irqreturn_t (*irq_handler_t)(uint32_t irq, void* dev_id);
+
+/**
+ * @brief Interrupt controller operations of a line
+ *
+ * ISA lines default to the PIC or I/O APIC, everything else to a local
+ * APIC EOI without masking. Message interrupt owners install their own
+ * chip so a line can be masked at the device.
+ */
+typedef struct {
+    const char* name;                                   /**< Controller name */
+    void (*mask)(uint32_t irq, void* chip_data);        /**< Stop delivery, may be NULL */
+    void (*unmask)(uint32_t irq, void* chip_data);      /**< Resume delivery, may be NULL */
+    void (*eoi)(uint32_t irq, void* chip_data);         /**< Acknowledge the interrupt */
+    int (*set_affinity)(uint32_t irq, void* chip_data, uint32_t cpu); /**< Route to a CPU, may be NULL */
+} irq_chip_t;
+
+/**
+ * @brief Per-line statistics
+ */
+typedef struct {
+    uint64_t    count;              /**< Interrupts taken */
+    uint64_t    unhandled;          /**< Interrupts no handler claimed */
+    uint64_t    thread_wakeups;     /**< Thread functions woken */
+    uint32_t    actions;            /**< Handlers attached */
+    uint32_t    depth;              /**< disable_irq() nesting */
+    cpumask_t   affinity;           /**< CPUs the line may target */
+    uint32_t    effective_cpu;      /**< CPU the line is routed to */
+    uint32_t    moves;              /**< Times the line changed CPU */
+    bool        balance;            /**< The balancer may move the line */
+} irq_line_stats_t;
+
+/**
+ * @brief Initialize the interrupt descriptors
+ */
+void irq_desc_init(void);
+
+/**
+ * @brief Attach a handler and an optional thread function to a line
+ *
+ * With a NULL handler the primary handler just wakes the thread, and the
+ * line is kept masked until it ran (IRQF_ONESHOT is implied). All users
+ * of a shared line must pass IRQF_SHARED, agree on IRQF_ONESHOT and give
+ * a unique dev_id.
+ *
+ * @param irq IRQ number (IDT vector)
+ * @param handler Primary handler, hard interrupt context
+ * @param thread_fn Thread function, NULL for none
+ * @param flags IRQF_* flags
+ * @param name Owner name for statistics
+ * @param dev_id Cookie passed to the handlers and to free_irq()
+ * @return 0 on success, negative error code on failure
+ */
+int request_threaded_irq(uint32_t irq, irq_handler_t handler, irq_handler_t thread_fn,
+                         uint32_t flags, const char* name, void* dev_id);
+
+/**
+ * @brief Attach a handler to a line
+ *
+ * @param irq IRQ number (IDT vector)
+ * @param handler Handler, hard interrupt context
+ * @param flags IRQF_* flags
+ * @param name Owner name for statistics
+ * @param dev_id Cookie passed to the handler and to free_irq()
+ * @return 0 on success, negative error code on failure
+ */
+int request_irq(uint32_t irq, irq_handler_t handler, uint32_t flags, const char* name, void* dev_id);
+
+/**
+ * @brief Detach a handler
+ *
+ * Waits for running handlers and stops the thread. The line is masked and
+ * its IDT slot released when the last handler goes. Must not be called
+ * from interrupt context.
+ *
+ * @param irq IRQ number
+ * @param dev_id Cookie given to request_irq()
+ * @return 0 on success, negative error code if no such handler
+ */
+int free_irq(uint32_t irq, void* dev_id);
+
+/**
+ * @brief Install the controller operations of a line
+ *
+ * @param irq IRQ number
+ * @param chip Operations, NULL for the default
+ * @param chip_data Argument passed to the operations
+ */
+void irq_set_chip(uint32_t irq, const irq_chip_t* chip, void* chip_data);
+
+/**
+ * @brief Mask a line without waiting for running handlers
+ *
+ * Calls nest; each needs a matching enable_irq(). Safe in handlers.
+ *
+ * @param irq IRQ number
+ */
+void disable_irq_nosync(uint32_t irq);
+
+/**
+ * @brief Mask a line and wait for its handlers and threads to finish
+ *
+ * @param irq IRQ number
+ */
+void disable_irq(uint32_t irq);
+
+/**
+ * @brief Undo one disable_irq()
+ *
+ * @param irq IRQ number
+ */
+void enable_irq(uint32_t irq);
+
+/**
+ * @brief Wait for running primary handlers and thread functions of a line
+ *
+ * @param irq IRQ number
+ */
+void synchronize_irq(uint32_t irq);
+
+/**
+ * @brief Set the CPUs a line may be delivered to
+ *
+ * Keeps the current CPU if it is still allowed, otherwise routes the line
+ * to the first online CPU of the mask.
+ *
+ * @param irq IRQ number
+ * @param mask Allowed CPUs
+ * @return 0 on success, negative error code if no CPU of the mask is
+ *         online or the controller cannot route the line
+ */
+int irq_set_affinity(uint32_t irq, cpumask_t mask);
+
+/**
+ * @brief Route a line to one CPU of its affinity mask
+ *
+ * @param irq IRQ number
+ * @param cpu Target CPU, online and in the mask
+ * @return 0 on success, negative error code on failure
+ */
+int irq_set_effective_cpu(uint32_t irq, uint32_t cpu);
+
+/**
+ * @brief Record where a line's owner already routed it
+ *
+ * For owners that program the destination themselves before requesting
+ * the line, such as MSI-X queues spread over the CPUs.
+ *
+ * @param irq IRQ number
+ * @param mask Allowed CPUs
+ * @param cpu CPU the line is routed to
+ */
+void irq_set_effective_affinity(uint32_t irq, cpumask_t mask, uint32_t cpu);
+
+/**
+ * @brief Get the statistics of a line
+ *
+ * @param irq IRQ number
+ * @param stats Filled in on success
+ * @return 0 on success, negative error code if irq is invalid
+ */
+int irq_get_line_stats(uint32_t irq, irq_line_stats_t* stats);
+
+/**
+ * @brief Print the lines with handlers attached
+ */
+void irq_dump_status(void);
+
+#endif /* __IRQ_H__ */
@@ -0,0 +1,245 @@
+/**
+ * @file irq_balance.c
+ * @brief In-kernel interrupt load balancing for FG-OS
+ *
+ * The load of a line is the number of interrupts its vector took since the
+ * previous pass, from the per-vector counts kept by
+ * interrupt_common_handler(); the load of a CPU is the sum over the lines
+ * routed to it. Each pass moves at most IRQ_BALANCE_MAX_MOVES lines, each
+ * time taking from the busiest CPU the line whose rate best halves the gap
+ * to the idlest one, so two hot lines end up on different CPUs instead of
+ * swapping places every pass.
+ *
+ * Passes are serialized by g_balance_lock; the lines themselves are moved
+ * through irq_set_effective_cpu(), under their descriptor locks.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "irq_balance.h"
+#include "irq.h"
+#include "idt.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../sched/scheduler.h"
+#include "../sched/wait.h"
+#include "../sched/topology.h"
+
+static spinlock_t g_balance_lock;
+static wait_queue_head_t g_balance_wq;
+static volatile bool g_balance_enabled = true;
+static irq_balance_stats_t g_balance_stats;
+
+// Vector counts at the previous pass, and the rates they gave
+static uint32_t g_balance_last_count[IDT_ENTRIES];
+static uint32_t g_balance_rate[IDT_ENTRIES];
+static uint64_t g_balance_load[MAX_CPUS];
+
+// Internal function declarations
+static void irq_balance_thread(void* arg);
+static void irq_balance_sample(irq_line_stats_t* lines);
+static uint32_t irq_balance_idlest(cpumask_t mask);
+static bool irq_balance_move(uint32_t irq, irq_line_stats_t* line, uint32_t cpu);
+
+/**
+ * @brief Start the balancer thread
+ */
+int irq_balance_init(void) {
+    spin_lock_init(&g_balance_lock);
+    init_waitqueue_head(&g_balance_wq);
+    memset(&g_balance_stats, 0, sizeof(g_balance_stats));
+    memset(g_balance_load, 0, sizeof(g_balance_load));
+
+    // Start counting from now, not from boot
+    const interrupt_stats_t* stats = idt_get_stats();
+    for (uint32_t vector = 0; vector < IDT_ENTRIES; vector++) {
+        g_balance_last_count[vector] = stats->interrupt_frequency[vector];
+        g_balance_rate[vector] = 0;
+    }
+
+    struct process* proc = create_process("irqbalance", 0);
+    struct thread* task = proc ? create_thread(proc->pid, irq_balance_thread, NULL) : NULL;
+    if (!task) {
+        printf("[ERROR] Failed to create IRQ balancer thread\n");
+        return KERN_NOMEM;
+    }
+    scheduler_add_thread(task);
+
+    printf("[INFO] IRQ balancer: %u ms interval\n", IRQ_BALANCE_INTERVAL_MS);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Turn balancing on or off
+ */
+void irq_balance_set_enabled(bool enabled) {
+    g_balance_enabled = enabled;
+}
+
+/**
+ * @brief Run one balancing pass now
+ */
+void irq_balance_run(void) {
+    static irq_line_stats_t lines[IDT_ENTRIES];
+
+    uint64_t flags = spin_lock_irqsave(&g_balance_lock);
+
+    cpumask_t targets = cpu_online_mask & ~cpu_isolated_mask;
+    if (targets == CPU_MASK_NONE) {
+        targets = cpu_online_mask;
+    }
+    irq_balance_sample(lines);
+    g_balance_stats.passes++;
+
+    // Housekeeping first: nothing but pinned lines belongs on an isolated CPU
+    for (uint32_t irq = IRQ_TIMER; irq < IDT_ENTRIES; irq++) {
+        irq_line_stats_t* line = &lines[irq];
+        if (!line->balance || cpumask_test_cpu(line->effective_cpu, targets)) {
+            continue;
+        }
+        uint32_t cpu = irq_balance_idlest(line->affinity & targets);
+        if (cpu < MAX_CPUS && irq_balance_move(irq, line, cpu)) {
+            g_balance_stats.isolated_moves++;
+        }
+    }
+
+    uint32_t nr_targets = cpumask_weight(targets);
+    for (uint32_t moves = 0; nr_targets > 1 && moves < IRQ_BALANCE_MAX_MOVES; moves++) {
+        uint64_t total = 0;
+        uint32_t busiest = MAX_CPUS;
+        for (cpumask_t mask = targets; mask; mask &= mask - 1) {
+            uint32_t cpu = cpumask_first(mask);
+            total += g_balance_load[cpu];
+            if (busiest == MAX_CPUS || g_balance_load[cpu] > g_balance_load[busiest]) {
+                busiest = cpu;
+            }
+        }
+        uint32_t idlest = irq_balance_idlest(targets);
+
+        // Close enough to even: moving would only shuffle cache lines around
+        uint64_t gap = g_balance_load[busiest] - g_balance_load[idlest];
+        uint64_t average = total / nr_targets;
+        if (gap < IRQ_BALANCE_MIN_GAP ||
+            g_balance_load[busiest] * 100 <= average * IRQ_BALANCE_TOLERANCE_PCT) {
+            break;
+        }
+
+        // The line that leaves the two CPUs closest to even; one with a rate
+        // of gap or more would just make the idlest CPU the busiest
+        uint32_t best = IDT_ENTRIES;
+        uint64_t best_error = 0;
+        for (uint32_t irq = IRQ_TIMER; irq < IDT_ENTRIES; irq++) {
+            irq_line_stats_t* line = &lines[irq];
+            uint64_t rate = g_balance_rate[irq];
+            if (!line->balance || line->effective_cpu != busiest || rate == 0 || rate >= gap ||
+                !cpumask_test_cpu(idlest, line->affinity)) {
+                continue;
+            }
+            uint64_t error = gap > 2 * rate ? gap - 2 * rate : 2 * rate - gap;
+            if (best == IDT_ENTRIES || error < best_error) {
+                best = irq;
+                best_error = error;
+            }
+        }
+        if (best == IDT_ENTRIES || !irq_balance_move(best, &lines[best], idlest)) {
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&g_balance_lock, flags);
+}
+
+/**
+ * @brief Print balancer statistics and the interrupt load per CPU
+ */
+void irq_balance_dump_status(void) {
+    printf("\n=== IRQ Balancer ===\n");
+    printf("Status: %s, interval %u ms\n", g_balance_enabled ? "Enabled" : "Disabled",
+           IRQ_BALANCE_INTERVAL_MS);
+    printf("Passes: %llu, moves: %llu (off isolated CPUs: %llu), refused: %llu\n",
+           g_balance_stats.passes, g_balance_stats.moves, g_balance_stats.isolated_moves,
+           g_balance_stats.failed);
+    for (cpumask_t mask = cpu_online_mask; mask; mask &= mask - 1) {
+        uint32_t cpu = cpumask_first(mask);
+        printf("  CPU %u: %llu interrupts last pass%s\n", cpu, g_balance_load[cpu],
+               cpumask_test_cpu(cpu, cpu_isolated_mask) ? " (isolated)" : "");
+    }
+}
+
+// Internal functions
+
+/**
+ * @brief Balancer thread: one pass per interval
+ */
+static void irq_balance_thread(void* arg) {
+    (void)arg;
+
+    for (;;) {
+        wait_queue_sleep(&g_balance_wq, false, IRQ_BALANCE_INTERVAL_MS);
+        if (g_balance_enabled && cpumask_weight(cpu_online_mask) > 1) {
+            irq_balance_run();
+        }
+    }
+}
+
+/**
+ * @brief Take the line states and the per-vector rates since the last pass
+ */
+static void irq_balance_sample(irq_line_stats_t* lines) {
+    const interrupt_stats_t* stats = idt_get_stats();
+    memset(g_balance_load, 0, sizeof(g_balance_load));
+
+    for (uint32_t irq = IRQ_TIMER; irq < IDT_ENTRIES; irq++) {
+        uint32_t count = __atomic_load_n(&stats->interrupt_frequency[irq], __ATOMIC_RELAXED);
+        g_balance_rate[irq] = count - g_balance_last_count[irq];
+        g_balance_last_count[irq] = count;
+
+        irq_line_stats_t* line = &lines[irq];
+        if (irq_get_line_stats(irq, line) != KERN_SUCCESS || !line->actions) {
+            line->balance = false;
+            continue;
+        }
+        if (line->effective_cpu < MAX_CPUS) {
+            g_balance_load[line->effective_cpu] += g_balance_rate[irq];
+        }
+    }
+}
+
+/**
+ * @brief Least loaded CPU of a mask, MAX_CPUS if it is empty
+ */
+static uint32_t irq_balance_idlest(cpumask_t mask) {
+    uint32_t idlest = MAX_CPUS;
+    for (; mask; mask &= mask - 1) {
+        uint32_t cpu = cpumask_first(mask);
+        if (idlest == MAX_CPUS || g_balance_load[cpu] < g_balance_load[idlest]) {
+            idlest = cpu;
+        }
+    }
+    return idlest;
+}
+
+/**
+ * @brief Move a line and account its rate to the new CPU
+ */
+static bool irq_balance_move(uint32_t irq, irq_line_stats_t* line, uint32_t cpu) {
+    if (irq_set_effective_cpu(irq, cpu) != KERN_SUCCESS) {
+        // Leave it out of the rest of this pass
+        line->balance = false;
+        g_balance_stats.failed++;
+        return false;
+    }
+
+    uint32_t rate = g_balance_rate[irq];
+    if (line->effective_cpu < MAX_CPUS) {
+        g_balance_load[line->effective_cpu] -= rate;
+    }
+    g_balance_load[cpu] += rate;
+    line->effective_cpu = cpu;
+    g_balance_stats.moves++;
+    return true;
+}
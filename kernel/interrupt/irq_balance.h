@@ -0,0 +1,71 @@
+/**
+ * @file irq_balance.h
+ * @brief In-kernel interrupt load balancing for FG-OS
+ *
+ * Without balancing every device line stays on the CPU it was first routed
+ * to, normally the boot CPU. A kernel thread samples the per-vector
+ * interrupt counts every IRQ_BALANCE_INTERVAL_MS, works out the interrupt
+ * load of each CPU and moves busy lines from the most loaded CPU to the
+ * least loaded one, within each line's affinity mask. Lines are first
+ * moved off isolated CPUs. Lines pinned to one CPU, such as the queues of
+ * a multi-queue device, or requested with IRQF_NO_BALANCING are left alone.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __IRQ_BALANCE_H__
+#define __IRQ_BALANCE_H__
+
+#include <types.h>
+
+/**
+ * @brief Balancing parameters
+ */
+#define IRQ_BALANCE_INTERVAL_MS     2000    /**< Time between passes */
+#define IRQ_BALANCE_MIN_GAP         1000    /**< Interrupts per pass worth a move */
+#define IRQ_BALANCE_TOLERANCE_PCT   125     /**< Busiest CPU load, % of average, left alone */
+#define IRQ_BALANCE_MAX_MOVES       4       /**< Lines moved per pass */
+
+/**
+ * @brief Balancer statistics
+ */
+typedef struct {
+    uint64_t    passes;             /**< Balancing passes */
+    uint64_t    moves;              /**< Lines moved */
+    uint64_t    isolated_moves;     /**< Lines moved off isolated CPUs */
+    uint64_t    failed;             /**< Moves the controller refused */
+} irq_balance_stats_t;
+
+/**
+ * @brief Start the balancer thread
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int irq_balance_init(void);
+
+/**
+ * @brief Turn balancing on or off
+ *
+ * Lines stay where they are when it is turned off.
+ *
+ * @param enabled Balance on the next passes
+ */
+void irq_balance_set_enabled(bool enabled);
+
+/**
+ * @brief Run one balancing pass now
+ *
+ * Must not be called from interrupt context.
+ */
+void irq_balance_run(void);
+
+/**
+ * @brief Print balancer statistics and the interrupt load per CPU
+ */
+void irq_balance_dump_status(void);
+
+#endif /* __IRQ_BALANCE_H__ */
@@ -0,0 +1,305 @@
+/**
+ * @file irq_poll.c
+ * @brief Interrupt-mitigating completion polling for FG-OS
+ *
+ * Each CPU has a list of scheduled pollers, run from BLOCK_SOFTIRQ. A
+ * poller is taken off the list before its poll function is called, so the
+ * driver may complete it, and the interrupt handler schedule it again,
+ * without touching the list the softirq is walking; one that used its
+ * whole weight is put back at the tail. A run stops after IRQ_POLL_BUDGET
+ * completions or IRQ_POLL_TIME_NS and raises the softirq again for the
+ * rest, leaving the softirq restart limit to push it past the next
+ * interrupt exit when the CPU is needed elsewhere.
+ *
+ * Moderation samples the batch sizes over IRQ_POLL_SAMPLE_POLLS polls:
+ * batches filling half the weight step towards more coalescing, batches
+ * below IRQ_POLL_LOW_BATCH step back towards none, keeping latency low
+ * for light traffic.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "irq_poll.h"
+#include "idt.h"
+#include "softirq.h"
+#include "clocksource.h"
+#include "../include/kernel.h"
+#include "../sched/scheduler.h"
+
+/**
+ * @brief Coalescing profile
+ */
+typedef struct {
+    uint32_t    usecs;              /**< Delay before the next interrupt or poll */
+    uint32_t    frames;             /**< Completions that end the delay early */
+} irq_poll_profile_t;
+
+/**
+ * @brief Totals over all pollers
+ */
+typedef struct {
+    uint64_t    runs;               /**< Softirq runs */
+    uint64_t    polls;              /**< Poll function calls */
+    uint64_t    completions;        /**< Completions reaped */
+    uint64_t    limited;            /**< Runs stopped by the budget or time limit */
+    uint64_t    rearmed;            /**< Polls deferred by software coalescing */
+} irq_poll_totals_t;
+
+static const irq_poll_profile_t g_irq_poll_profiles[IRQ_POLL_PROFILES] = {
+    { 0, 1 }, { 8, 4 }, { 16, 8 }, { 32, 16 }, { 64, 32 }
+};
+
+static struct list_head g_irq_poll_list[MAX_CPUS];
+static irq_poll_totals_t g_irq_poll_totals;
+
+// Internal function declarations
+static void irq_poll_softirq(void);
+static void irq_poll_sample(irq_poll_t* iop, int work);
+static hrtimer_restart_t irq_poll_timer_fn(hrtimer_t* timer);
+
+/**
+ * @brief Initialize the per-CPU poll lists and open the BLOCK softirq
+ */
+void irq_poll_subsys_init(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        INIT_LIST_HEAD(&g_irq_poll_list[cpu]);
+    }
+    memset(&g_irq_poll_totals, 0, sizeof(g_irq_poll_totals));
+
+    open_softirq(BLOCK_SOFTIRQ, irq_poll_softirq);
+    printf("[INFO] irq_poll: budget %d, weight %d\n", IRQ_POLL_BUDGET, IRQ_POLL_DEFAULT_WEIGHT);
+}
+
+/**
+ * @brief Initialize a poller
+ */
+void irq_poll_init(irq_poll_t* iop, int weight, irq_poll_fn poll) {
+    memset(iop, 0, sizeof(irq_poll_t));
+    INIT_LIST_HEAD(&iop->list);
+    iop->weight = weight > 0 ? weight : IRQ_POLL_DEFAULT_WEIGHT;
+    iop->poll = poll;
+    hrtimer_setup(&iop->timer, irq_poll_timer_fn, iop);
+}
+
+/**
+ * @brief Turn adaptive moderation on or off
+ */
+void irq_poll_set_adaptive(irq_poll_t* iop, bool on, irq_poll_moderate_fn moderate) {
+    iop->moderate = on ? moderate : NULL;
+    iop->profile = 0;
+    iop->sample_polls = 0;
+    iop->sample_work = 0;
+
+    if (on) {
+        __atomic_fetch_or(&iop->state, IRQ_POLL_F_ADAPTIVE, __ATOMIC_ACQ_REL);
+    } else {
+        __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_ADAPTIVE, __ATOMIC_ACQ_REL);
+    }
+
+    // Start from no coalescing
+    if (moderate) {
+        moderate(iop, g_irq_poll_profiles[0].usecs, g_irq_poll_profiles[0].frames);
+    }
+}
+
+/**
+ * @brief Queue a poller on the current CPU
+ */
+void irq_poll_sched(irq_poll_t* iop) {
+    uint32_t old = __atomic_fetch_or(&iop->state, IRQ_POLL_F_SCHED, __ATOMIC_ACQ_REL);
+    if (old & IRQ_POLL_F_SCHED) {
+        return;
+    }
+    if (old & IRQ_POLL_F_DISABLE) {
+        __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_SCHED, __ATOMIC_RELEASE);
+        return;
+    }
+
+    uint64_t flags = interrupts_disable();
+    list_add_tail(&iop->list, &g_irq_poll_list[smp_processor_id()]);
+    raise_softirq_irqoff(BLOCK_SOFTIRQ);
+    iop->stats.scheduled++;
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Leave polling mode
+ */
+void irq_poll_complete(irq_poll_t* iop) {
+    uint64_t flags = interrupts_disable();
+    if (!list_empty(&iop->list)) {
+        list_del_init(&iop->list);
+    }
+    __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_SCHED, __ATOMIC_RELEASE);
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Leave polling mode unless moderation wants to poll again shortly
+ */
+bool irq_poll_complete_done(irq_poll_t* iop, int work_done) {
+    uint32_t state = __atomic_load_n(&iop->state, __ATOMIC_ACQUIRE);
+    uint32_t usecs = g_irq_poll_profiles[iop->profile].usecs;
+
+    // Software coalescing: stay scheduled and look again after the delay
+    // instead of taking an interrupt for every completion
+    if ((state & IRQ_POLL_F_ADAPTIVE) && !(state & IRQ_POLL_F_DISABLE) &&
+        !iop->moderate && usecs && work_done > 0) {
+        iop->stats.rearmed++;
+        __atomic_fetch_add(&g_irq_poll_totals.rearmed, 1, __ATOMIC_RELAXED);
+        hrtimer_start(&iop->timer, usecs * NSEC_PER_USEC, HRTIMER_MODE_REL);
+        return false;
+    }
+
+    irq_poll_complete(iop);
+    return true;
+}
+
+/**
+ * @brief Stop a poller and wait for a running poll to finish
+ */
+void irq_poll_disable(irq_poll_t* iop) {
+    __atomic_fetch_or(&iop->state, IRQ_POLL_F_DISABLE, __ATOMIC_ACQ_REL);
+
+    // A pending re-arm holds SCHED; nobody else will clear it
+    if (hrtimer_cancel(&iop->timer)) {
+        __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_SCHED, __ATOMIC_RELEASE);
+    }
+
+    while (__atomic_load_n(&iop->state, __ATOMIC_ACQUIRE) & IRQ_POLL_F_SCHED) {
+        do_softirq();
+        yield();
+    }
+}
+
+/**
+ * @brief Allow a disabled poller to be scheduled again
+ */
+void irq_poll_enable(irq_poll_t* iop) {
+    __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_DISABLE, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Print irq_poll totals
+ */
+void irq_poll_dump_status(void) {
+    printf("\n=== IRQ Polling ===\n");
+    printf("Softirq runs: %llu, limited by budget/time: %llu\n",
+           g_irq_poll_totals.runs, g_irq_poll_totals.limited);
+    printf("Polls: %llu, completions: %llu, coalescing re-arms: %llu\n",
+           g_irq_poll_totals.polls, g_irq_poll_totals.completions, g_irq_poll_totals.rearmed);
+    if (g_irq_poll_totals.polls) {
+        printf("Average batch: %llu\n", g_irq_poll_totals.completions / g_irq_poll_totals.polls);
+    }
+}
+
+// Internal functions
+
+/**
+ * @brief BLOCK_SOFTIRQ handler: run the scheduled pollers of this CPU
+ */
+static void irq_poll_softirq(void) {
+    struct list_head* list = &g_irq_poll_list[smp_processor_id()];
+    uint64_t start = ktime_get_ns();
+    int budget = IRQ_POLL_BUDGET;
+
+    g_irq_poll_totals.runs++;
+
+    uint64_t flags = interrupts_disable();
+    while (!list_empty(list)) {
+        if (budget <= 0 || ktime_get_ns() - start > IRQ_POLL_TIME_NS) {
+            g_irq_poll_totals.limited++;
+            raise_softirq_irqoff(BLOCK_SOFTIRQ);
+            break;
+        }
+
+        irq_poll_t* iop = list_first_entry(list, irq_poll_t, list);
+        list_del_init(&iop->list);
+        interrupts_restore(flags);
+
+        int weight = iop->weight;
+        int work = 0;
+        if (__atomic_load_n(&iop->state, __ATOMIC_ACQUIRE) & IRQ_POLL_F_DISABLE) {
+            irq_poll_complete(iop);
+        } else {
+            work = iop->poll(iop, weight);
+            irq_poll_sample(iop, work);
+        }
+        budget -= work;
+
+        flags = interrupts_disable();
+
+        // Still has work: back of the line, behind the other pollers
+        if (work >= weight) {
+            iop->stats.weight_exhausted++;
+            if (__atomic_load_n(&iop->state, __ATOMIC_ACQUIRE) & IRQ_POLL_F_DISABLE) {
+                __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_SCHED, __ATOMIC_RELEASE);
+            } else if ((iop->state & IRQ_POLL_F_SCHED) && list_empty(&iop->list)) {
+                list_add_tail(&iop->list, list);
+            }
+        }
+    }
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Account a poll and adjust the moderation profile
+ */
+static void irq_poll_sample(irq_poll_t* iop, int work) {
+    iop->stats.polls++;
+    iop->stats.completions += (uint64_t)work;
+    g_irq_poll_totals.polls++;
+    g_irq_poll_totals.completions += (uint64_t)work;
+
+    if (!(iop->state & IRQ_POLL_F_ADAPTIVE)) {
+        return;
+    }
+
+    iop->sample_work += (uint64_t)work;
+    if (++iop->sample_polls < IRQ_POLL_SAMPLE_POLLS) {
+        return;
+    }
+
+    uint64_t batch = iop->sample_work / iop->sample_polls;
+    uint32_t profile = iop->profile;
+    iop->sample_polls = 0;
+    iop->sample_work = 0;
+
+    if (batch * 2 >= (uint64_t)iop->weight && profile + 1 < IRQ_POLL_PROFILES) {
+        profile++;
+    } else if (batch < IRQ_POLL_LOW_BATCH && profile > 0) {
+        profile--;
+    }
+
+    if (profile != iop->profile) {
+        iop->profile = profile;
+        iop->stats.profile_changes++;
+        if (iop->moderate) {
+            iop->moderate(iop, g_irq_poll_profiles[profile].usecs, g_irq_poll_profiles[profile].frames);
+        }
+    }
+}
+
+/**
+ * @brief Coalescing delay over: queue the poller again
+ */
+static hrtimer_restart_t irq_poll_timer_fn(hrtimer_t* timer) {
+    irq_poll_t* iop = (irq_poll_t*)timer->data;
+
+    if (__atomic_load_n(&iop->state, __ATOMIC_ACQUIRE) & IRQ_POLL_F_DISABLE) {
+        __atomic_fetch_and(&iop->state, ~IRQ_POLL_F_SCHED, __ATOMIC_RELEASE);
+        return HRTIMER_NORESTART;
+    }
+
+    uint64_t flags = interrupts_disable();
+    if (list_empty(&iop->list)) {
+        list_add_tail(&iop->list, &g_irq_poll_list[smp_processor_id()]);
+    }
+    raise_softirq_irqoff(BLOCK_SOFTIRQ);
+    interrupts_restore(flags);
+    return HRTIMER_NORESTART;
+}
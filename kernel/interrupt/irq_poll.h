@@ -0,0 +1,181 @@
+/**
+ * @file irq_poll.h
+ * @brief Interrupt-mitigating completion polling for FG-OS
+ *
+ * Under load a device that raises one interrupt per completion spends
+ * most of the CPU entering and leaving handlers. With irq_poll the hard
+ * handler masks the device's interrupt and calls irq_poll_sched(); the
+ * BLOCK softirq then calls the driver's poll function, which reaps up to
+ * its weight of completions per call. A driver that finds fewer than its
+ * weight completes the poll and unmasks its interrupt again; one that
+ * fills its weight stays in polling mode and is called again after the
+ * other pollers had their turn. Each softirq run is bounded in work and
+ * time, so a storm leaves the CPU to threads instead of starving them.
+ *
+ * Adaptive moderation watches the batch sizes and picks a coalescing
+ * profile: the driver's moderate() callback programs it into the device,
+ * or without one the poll itself is re-armed after the profile's delay
+ * instead of unmasking, so completions arriving meanwhile are reaped in
+ * one batch.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __IRQ_POLL_H__
+#define __IRQ_POLL_H__
+
+#include <types.h>
+#include "../include/list.h"
+#include "hrtimer.h"
+
+/**
+ * @brief Polling limits
+ */
+#define IRQ_POLL_BUDGET         256         /**< Completions per softirq run, all pollers */
+#define IRQ_POLL_TIME_NS        1000000ULL  /**< Time per softirq run (one tick) */
+#define IRQ_POLL_DEFAULT_WEIGHT 32          /**< Completions per poll call */
+
+/**
+ * @brief Adaptive moderation
+ */
+#define IRQ_POLL_PROFILES       5           /**< Coalescing profiles, 0 = none */
+#define IRQ_POLL_SAMPLE_POLLS   16          /**< Polls per moderation decision */
+#define IRQ_POLL_LOW_BATCH      4           /**< Average batch below which to back off */
+
+/**
+ * @brief State bits (irq_poll_t.state)
+ */
+#define IRQ_POLL_F_SCHED        (1 << 0)    /**< Queued, running or re-arming */
+#define IRQ_POLL_F_DISABLE      (1 << 1)    /**< Being disabled, do not poll */
+#define IRQ_POLL_F_ADAPTIVE     (1 << 2)    /**< Adaptive moderation on */
+
+struct irq_poll;
+
+/**
+ * @brief Reap completions
+ *
+ * @param iop Poller
+ * @param budget Most completions to process
+ * @return Completions processed; below budget only after irq_poll_complete_done()
+ */
+typedef int (*irq_poll_fn)(struct irq_poll* iop, int budget);
+
+/**
+ * @brief Program a device's interrupt coalescing
+ *
+ * @param iop Poller
+ * @param usecs Longest delay before an interrupt is raised
+ * @param frames Completions that raise one at once
+ */
+typedef void (*irq_poll_moderate_fn)(struct irq_poll* iop, uint32_t usecs, uint32_t frames);
+
+/**
+ * @brief Poller statistics
+ */
+typedef struct {
+    uint64_t    scheduled;          /**< irq_poll_sched() calls that queued the poller */
+    uint64_t    polls;              /**< Poll function calls */
+    uint64_t    completions;        /**< Completions reaped */
+    uint64_t    weight_exhausted;   /**< Polls that filled their weight */
+    uint64_t    rearmed;            /**< Polls re-armed by the coalescing timer */
+    uint64_t    profile_changes;    /**< Moderation profile switches */
+} irq_poll_stats_t;
+
+/**
+ * @brief Completion poller of one device or queue
+ */
+typedef struct irq_poll {
+    struct list_head        list;       /**< Entry in the CPU's poll list */
+    volatile uint32_t       state;      /**< IRQ_POLL_F_* */
+    int                     weight;     /**< Completions per poll call */
+    irq_poll_fn             poll;       /**< Driver poll function */
+    irq_poll_moderate_fn    moderate;   /**< Device coalescing, NULL for software re-arming */
+    hrtimer_t               timer;      /**< Software coalescing delay */
+    uint32_t                profile;    /**< Current moderation profile */
+    uint32_t                sample_polls;   /**< Polls in the current sample */
+    uint64_t                sample_work;    /**< Completions in the current sample */
+    irq_poll_stats_t        stats;      /**< Statistics */
+} irq_poll_t;
+
+/**
+ * @brief Initialize the per-CPU poll lists and open the BLOCK softirq
+ */
+void irq_poll_subsys_init(void);
+
+/**
+ * @brief Initialize a poller
+ *
+ * @param iop Poller
+ * @param weight Completions per poll call, 0 for IRQ_POLL_DEFAULT_WEIGHT
+ * @param poll Driver poll function
+ */
+void irq_poll_init(irq_poll_t* iop, int weight, irq_poll_fn poll);
+
+/**
+ * @brief Turn adaptive moderation on or off
+ *
+ * @param iop Poller, not scheduled
+ * @param on Enable adaptive moderation
+ * @param moderate Device coalescing callback, NULL to coalesce in software
+ */
+void irq_poll_set_adaptive(irq_poll_t* iop, bool on, irq_poll_moderate_fn moderate);
+
+/**
+ * @brief Queue a poller on the current CPU
+ *
+ * Called from the device's interrupt handler after masking the device
+ * interrupt. Does nothing if the poller is already scheduled or disabled.
+ *
+ * @param iop Poller
+ */
+void irq_poll_sched(irq_poll_t* iop);
+
+/**
+ * @brief Leave polling mode
+ *
+ * Called from the poll function once it found less than its budget. The
+ * poller may be scheduled again as soon as this returns.
+ *
+ * @param iop Poller
+ */
+void irq_poll_complete(irq_poll_t* iop);
+
+/**
+ * @brief Leave polling mode unless moderation wants to poll again shortly
+ *
+ * Called from the poll function instead of irq_poll_complete(). When
+ * software coalescing defers the next poll the poller stays scheduled and
+ * the driver must keep its interrupt masked.
+ *
+ * @param iop Poller
+ * @param work_done Completions processed by this poll
+ * @return true if the driver should unmask its interrupt
+ */
+bool irq_poll_complete_done(irq_poll_t* iop, int work_done);
+
+/**
+ * @brief Stop a poller and wait for a running poll to finish
+ *
+ * Must not be called from interrupt context.
+ *
+ * @param iop Poller
+ */
+void irq_poll_disable(irq_poll_t* iop);
+
+/**
+ * @brief Allow a disabled poller to be scheduled again
+ *
+ * @param iop Poller
+ */
+void irq_poll_enable(irq_poll_t* iop);
+
+/**
+ * @brief Print irq_poll totals
+ */
+void irq_poll_dump_status(void);
+
+#endif /* __IRQ_POLL_H__ */
@@ -0,0 +1,305 @@
+/**
+ * @file irqtrace.c
+ * @brief Interrupt latency and handler-time instrumentation for FG-OS
+ *
+ * Handler times are counted with relaxed atomics, since the same vector
+ * (the local APIC timer, IPIs) fires on several CPUs at once. Irqs-off
+ * sections are per CPU and need no locking while they are open, as
+ * nothing else runs on that CPU until they close; only the shared list
+ * of longest sections is guarded, by a try-lock so a CPU never spins
+ * with interrupts off just to record a statistic. The list keeps one
+ * entry per disabling call site, so a single hot path cannot crowd out
+ * the others.
+ *
+ * A hardware interrupt can only arrive with interrupts on, so a section
+ * still open on its entry was left behind by code that returned through
+ * IRET instead of re-enabling, and is dropped; one opened in the
+ * handler's softirqs is closed on the way out, where IRET sets IF again.
+ * Exceptions (a page fault inside a spin_lock_irqsave() section) keep
+ * the section open.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "irqtrace.h"
+#include "idt.h"
+#include "interrupt.h"
+#include "clocksource.h"
+#include "../include/kernel.h"
+#include "../arch/x86_64/arch.h"
+#include "../sched/topology.h"
+
+/**
+ * @brief Per-CPU tracing state
+ */
+typedef struct {
+    uint64_t    irqsoff_start;      /**< TSC when interrupts went off, 0 if on */
+    void*       irqsoff_caller;     /**< Code that turned them off */
+    uint64_t    irqsoff_max;        /**< Longest section on this CPU */
+    uint32_t    max_depth;          /**< Deepest nesting on this CPU */
+} irqtrace_cpu_t;
+
+static irqtrace_vector_stats_t g_irqtrace_vectors[IDT_ENTRIES];
+static irqtrace_cpu_t g_irqtrace_cpus[MAX_CPUS];
+
+// Longest irqs-off sections, longest first
+static irqtrace_irqsoff_t g_irqtrace_irqsoff[IRQTRACE_IRQSOFF_RECORDS];
+static volatile uint32_t g_irqtrace_irqsoff_lock;
+
+static volatile uint32_t g_irqtrace_max_depth;
+static volatile uint32_t g_irqtrace_max_depth_vector;
+
+// Internal function declarations
+static uint32_t irqtrace_bucket(uint64_t cycles);
+static void irqtrace_update_max(volatile uint64_t* max, uint64_t value);
+static void irqtrace_record_irqsoff(uint64_t cycles, void* caller, void* end_caller, uint32_t cpu);
+
+/**
+ * @brief Time an interrupt handler from here
+ */
+uint64_t irqtrace_irq_enter(uint8_t vector, uint32_t depth, bool hardware) {
+    uint64_t now = rdtsc();
+    irqtrace_cpu_t* c = &g_irqtrace_cpus[smp_processor_id()];
+
+    // Interrupts were on when a hardware one arrived; see the file comment
+    if (hardware) {
+        c->irqsoff_start = 0;
+    }
+
+    if (depth > c->max_depth) {
+        c->max_depth = depth;
+        if (depth > g_irqtrace_max_depth) {
+            g_irqtrace_max_depth = depth;
+            g_irqtrace_max_depth_vector = vector;
+        }
+    }
+
+    g_irqtrace_vectors[vector].last_entry = now;
+    return now;
+}
+
+/**
+ * @brief Account the handler time of an interrupt
+ */
+uint64_t irqtrace_irq_exit(uint8_t vector, uint64_t entry) {
+    uint64_t cycles = rdtsc() - entry;
+    irqtrace_vector_stats_t* stats = &g_irqtrace_vectors[vector];
+
+    __atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->total_cycles, cycles, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->hist[irqtrace_bucket(cycles)], 1, __ATOMIC_RELAXED);
+    irqtrace_update_max(&stats->max_cycles, cycles);
+
+    // The legacy per-line table keeps its own totals
+    if (vector >= IRQ_TIMER && vector < IRQ_TIMER + 16) {
+        irq_account_time(vector - IRQ_TIMER, entry, cycles);
+    }
+
+    return cycles;
+}
+
+#ifdef CONFIG_IRQSOFF_TRACE
+/**
+ * @brief Note that interrupts were just disabled
+ */
+void irqtrace_irqs_off(void* caller) {
+    irqtrace_cpu_t* c = &g_irqtrace_cpus[smp_processor_id()];
+    c->irqsoff_caller = caller;
+    c->irqsoff_start = rdtsc();
+}
+
+/**
+ * @brief Note that interrupts are about to be enabled
+ */
+void irqtrace_irqs_on(void* caller) {
+    uint32_t cpu = smp_processor_id();
+    irqtrace_cpu_t* c = &g_irqtrace_cpus[cpu];
+    if (!c->irqsoff_start) {
+        return;
+    }
+
+    uint64_t cycles = rdtsc() - c->irqsoff_start;
+    c->irqsoff_start = 0;
+
+    if (cycles > c->irqsoff_max) {
+        c->irqsoff_max = cycles;
+    }
+
+    // Cheap check first: most sections are shorter than every record
+    uint64_t shortest = __atomic_load_n(&g_irqtrace_irqsoff[IRQTRACE_IRQSOFF_RECORDS - 1].cycles,
+                                        __ATOMIC_RELAXED);
+    if (cycles > shortest) {
+        irqtrace_record_irqsoff(cycles, c->irqsoff_caller, caller, cpu);
+    }
+}
+#else
+void irqtrace_irqs_off(void* caller) {
+    (void)caller;
+}
+
+void irqtrace_irqs_on(void* caller) {
+    (void)caller;
+}
+#endif
+
+/**
+ * @brief Get the handler time of a vector
+ */
+const irqtrace_vector_stats_t* irqtrace_get_vector_stats(uint8_t vector) {
+    return &g_irqtrace_vectors[vector];
+}
+
+/**
+ * @brief Convert TSC cycles to nanoseconds
+ */
+uint64_t irqtrace_cycles_to_ns(uint64_t cycles) {
+    uint64_t khz = clocksource_tsc_khz();
+    if (!khz) {
+        return cycles;
+    }
+
+    // Split so that cycles * 10^6 cannot overflow
+    return (cycles / khz) * 1000000ULL + ((cycles % khz) * 1000000ULL) / khz;
+}
+
+/**
+ * @brief Clear all handler times, irqs-off records and nesting maxima
+ */
+void irqtrace_reset(void) {
+    uint64_t flags = interrupts_disable();
+
+    memset(g_irqtrace_vectors, 0, sizeof(g_irqtrace_vectors));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        g_irqtrace_cpus[cpu].irqsoff_max = 0;
+        g_irqtrace_cpus[cpu].max_depth = 0;
+    }
+    while (__atomic_exchange_n(&g_irqtrace_irqsoff_lock, 1, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile ("pause");
+    }
+    memset(g_irqtrace_irqsoff, 0, sizeof(g_irqtrace_irqsoff));
+    __atomic_store_n(&g_irqtrace_irqsoff_lock, 0, __ATOMIC_RELEASE);
+    g_irqtrace_max_depth = 0;
+    g_irqtrace_max_depth_vector = 0;
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Print handler times, irqs-off sections and nesting maxima
+ */
+void irqtrace_dump_status(void) {
+    const char* unit = clocksource_tsc_khz() ? "ns" : "cycles";
+
+    printf("\n=== Interrupt Latency ===\n");
+    printf("Max nesting depth: %u (vector 0x%02X)\n", g_irqtrace_max_depth, g_irqtrace_max_depth_vector);
+    for (cpumask_t mask = cpu_online_mask; mask; mask &= mask - 1) {
+        uint32_t cpu = cpumask_first(mask);
+        printf("  CPU %u: max nesting %u, longest irqs-off %llu %s\n", cpu,
+               g_irqtrace_cpus[cpu].max_depth,
+               irqtrace_cycles_to_ns(g_irqtrace_cpus[cpu].irqsoff_max), unit);
+    }
+
+    printf("Handler time per vector:\n");
+    for (uint32_t vector = 0; vector < IDT_ENTRIES; vector++) {
+        const irqtrace_vector_stats_t* stats = &g_irqtrace_vectors[vector];
+        if (!stats->count) {
+            continue;
+        }
+        printf("  Vector 0x%02X: %llu handled, avg %llu %s, max %llu %s\n", vector, stats->count,
+               irqtrace_cycles_to_ns(stats->total_cycles / stats->count), unit,
+               irqtrace_cycles_to_ns(stats->max_cycles), unit);
+        for (uint32_t bucket = 0; bucket < IRQTRACE_BUCKETS; bucket++) {
+            if (!stats->hist[bucket]) {
+                continue;
+            }
+            if (bucket == IRQTRACE_BUCKETS - 1) {
+                printf("    >= %llu %s: %u\n", irqtrace_cycles_to_ns(1ULL << bucket), unit,
+                       stats->hist[bucket]);
+            } else {
+                printf("    <  %llu %s: %u\n", irqtrace_cycles_to_ns(2ULL << bucket), unit,
+                       stats->hist[bucket]);
+            }
+        }
+    }
+
+#ifdef CONFIG_IRQSOFF_TRACE
+    printf("Longest irqs-off sections:\n");
+    for (uint32_t i = 0; i < IRQTRACE_IRQSOFF_RECORDS; i++) {
+        const irqtrace_irqsoff_t* rec = &g_irqtrace_irqsoff[i];
+        if (!rec->cycles) {
+            break;
+        }
+        if (rec->end_caller) {
+            printf("  %llu %s on CPU %u: off at 0x%016llX, on at 0x%016llX\n",
+                   irqtrace_cycles_to_ns(rec->cycles), unit, rec->cpu,
+                   (uint64_t)rec->caller, (uint64_t)rec->end_caller);
+        } else {
+            printf("  %llu %s on CPU %u: off at 0x%016llX, on at interrupt return\n",
+                   irqtrace_cycles_to_ns(rec->cycles), unit, rec->cpu, (uint64_t)rec->caller);
+        }
+    }
+#else
+    printf("Irqs-off tracing: not compiled in (CONFIG_IRQSOFF_TRACE)\n");
+#endif
+}
+
+// Internal functions
+
+/**
+ * @brief Histogram bucket of a handler time
+ */
+static uint32_t irqtrace_bucket(uint64_t cycles) {
+    if (!cycles) {
+        return 0;
+    }
+    uint32_t bucket = 63 - (uint32_t)__builtin_clzll(cycles);
+    return bucket < IRQTRACE_BUCKETS ? bucket : IRQTRACE_BUCKETS - 1;
+}
+
+/**
+ * @brief Raise a maximum shared between CPUs
+ */
+static void irqtrace_update_max(volatile uint64_t* max, uint64_t value) {
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(max, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Insert a section into the longest-sections list
+ */
+static void irqtrace_record_irqsoff(uint64_t cycles, void* caller, void* end_caller, uint32_t cpu) {
+    // Another CPU is recording: drop this one rather than spin with IF clear
+    if (__atomic_exchange_n(&g_irqtrace_irqsoff_lock, 1, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // One entry per call site: replace its record, or the shortest one
+    uint32_t slot = IRQTRACE_IRQSOFF_RECORDS - 1;
+    for (uint32_t i = 0; i < IRQTRACE_IRQSOFF_RECORDS; i++) {
+        if (g_irqtrace_irqsoff[i].caller == caller && g_irqtrace_irqsoff[i].cycles) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (cycles > g_irqtrace_irqsoff[slot].cycles) {
+        // Shift the shorter records down over the slot being replaced
+        uint32_t pos = slot;
+        while (pos > 0 && g_irqtrace_irqsoff[pos - 1].cycles < cycles) {
+            g_irqtrace_irqsoff[pos] = g_irqtrace_irqsoff[pos - 1];
+            pos--;
+        }
+        g_irqtrace_irqsoff[pos].cycles = cycles;
+        g_irqtrace_irqsoff[pos].caller = caller;
+        g_irqtrace_irqsoff[pos].end_caller = end_caller;
+        g_irqtrace_irqsoff[pos].cpu = cpu;
+    }
+
+    __atomic_store_n(&g_irqtrace_irqsoff_lock, 0, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file irqtrace.h
+ * @brief Interrupt latency and handler-time instrumentation for FG-OS
+ *
+ * Every interrupt is timestamped with the TSC on entry and exit of its
+ * handler; the cycles spent are kept per vector as a count, a total, a
+ * maximum and a log2 histogram. Sections run with interrupts disabled
+ * through interrupts_disable()/interrupts_restore() and their wrappers
+ * are timed from the disable that cleared IF to the enable that set it
+ * again, and the longest ones are kept with the addresses of both ends.
+ * The deepest interrupt nesting seen is recorded as well.
+ *
+ * Irqs-off tracing runs on every interrupts_disable() and is compiled in
+ * only with CONFIG_IRQSOFF_TRACE (ENABLE_IRQSOFF_TRACE).
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __IRQTRACE_H__
+#define __IRQTRACE_H__
+
+#include <types.h>
+
+/**
+ * @brief Handler-time histogram buckets
+ *
+ * Bucket n counts handlers that took [2^n, 2^(n+1)) TSC cycles; the last
+ * one also takes everything longer.
+ */
+#define IRQTRACE_BUCKETS            24
+
+/**
+ * @brief Longest irqs-off sections kept
+ */
+#define IRQTRACE_IRQSOFF_RECORDS    8
+
+/**
+ * @brief Handler time of one vector
+ */
+typedef struct {
+    uint64_t    count;                      /**< Handlers timed */
+    uint64_t    total_cycles;               /**< TSC cycles in the handler */
+    uint64_t    max_cycles;                 /**< Longest handler */
+    uint64_t    last_entry;                 /**< TSC at the last entry */
+    uint32_t    hist[IRQTRACE_BUCKETS];     /**< log2 cycle histogram */
+} irqtrace_vector_stats_t;
+
+/**
+ * @brief One irqs-off section
+ */
+typedef struct {
+    uint64_t    cycles;                     /**< TSC cycles with interrupts off */
+    void*       caller;                     /**< Code that disabled interrupts */
+    void*       end_caller;                 /**< Code that enabled them again */
+    uint32_t    cpu;                        /**< CPU it ran on */
+} irqtrace_irqsoff_t;
+
+/**
+ * @brief Time an interrupt handler from here
+ *
+ * @param vector Interrupt vector
+ * @param depth Nesting level including this interrupt
+ * @param hardware Hardware interrupt rather than an exception or INT 0x80
+ * @return TSC at entry, for irqtrace_irq_exit()
+ */
+uint64_t irqtrace_irq_enter(uint8_t vector, uint32_t depth, bool hardware);
+
+/**
+ * @brief Account the handler time of an interrupt
+ *
+ * @param vector Interrupt vector
+ * @param entry TSC returned by irqtrace_irq_enter()
+ * @return TSC cycles spent in the handler
+ */
+uint64_t irqtrace_irq_exit(uint8_t vector, uint64_t entry);
+
+/**
+ * @brief Note that interrupts were just disabled
+ *
+ * @param caller Code that disabled them
+ */
+void irqtrace_irqs_off(void* caller);
+
+/**
+ * @brief Note that interrupts are about to be enabled
+ *
+ * @param caller Code that enables them
+ */
+void irqtrace_irqs_on(void* caller);
+
+/**
+ * @brief Get the handler time of a vector
+ *
+ * @param vector Interrupt vector
+ * @return Pointer to the statistics
+ */
+const irqtrace_vector_stats_t* irqtrace_get_vector_stats(uint8_t vector);
+
+/**
+ * @brief Convert TSC cycles to nanoseconds
+ *
+ * @param cycles TSC cycles
+ * @return Nanoseconds, or cycles while the TSC is not calibrated
+ */
+uint64_t irqtrace_cycles_to_ns(uint64_t cycles);
+
+/**
+ * @brief Clear all handler times, irqs-off records and nesting maxima
+ */
+void irqtrace_reset(void);
+
+/**
+ * @brief Print handler times, irqs-off sections and nesting maxima
+ */
+void irqtrace_dump_status(void);
+
+#endif /* __IRQTRACE_H__ */
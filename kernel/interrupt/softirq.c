@@ -0,0 +1,380 @@
+/**
+ * @file softirq.c
+ * @brief Softirq bottom halves and tasklets for FG-OS
+ *
+ * Each CPU keeps a pending bitmask and a count of hard interrupt and
+ * softirq nesting. The outermost irq_exit() runs the pending vectors with
+ * interrupts enabled, so a device interrupt arriving meanwhile only raises
+ * more work. Vectors raised again while running are picked up by another
+ * pass, up to SOFTIRQ_MAX_RESTART passes; anything left after that waits
+ * for the next interrupt exit or the idle loop so a storm cannot starve
+ * threads.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "softirq.h"
+#include "idt.h"
+#include "../include/kernel.h"
+#include "../sched/scheduler.h"
+
+/**
+ * @brief Per-CPU softirq state
+ */
+typedef struct {
+    volatile uint32_t   pending;        /**< Raised vectors */
+    uint32_t            hardirq_count;  /**< Hard interrupt nesting */
+    uint32_t            softirq_count;  /**< Softirq and bh-disable nesting */
+} softirq_cpu_t;
+
+/**
+ * @brief Per-CPU tasklet list
+ */
+typedef struct {
+    tasklet_struct_t*   head;
+    tasklet_struct_t**  tail;
+} tasklet_list_t;
+
+// Softirq handlers and per-CPU state
+static softirq_action_t g_softirq_vec[NR_SOFTIRQS];
+static softirq_cpu_t g_softirq_cpu[MAX_CPUS];
+static tasklet_list_t g_tasklet_vec[MAX_CPUS];
+static tasklet_list_t g_tasklet_hi_vec[MAX_CPUS];
+static softirq_stats_t g_softirq_stats;
+
+static const char* g_softirq_names[NR_SOFTIRQS] = {
+    "HI", "TIMER", "NET_RX", "BLOCK", "TASKLET", "RCU"
+};
+
+// Forward declarations
+static void tasklet_action(void);
+static void tasklet_hi_action(void);
+static void tasklet_run_list(tasklet_list_t* list, softirq_vector_t nr);
+static void tasklet_enqueue(tasklet_struct_t* t, tasklet_list_t* list, softirq_vector_t nr);
+
+/**
+ * @brief Initialize softirq and tasklet processing
+ *
+ * Handlers opened before this call, such as RCU's, are kept.
+ */
+void softirq_init(void) {
+    memset(g_softirq_cpu, 0, sizeof(g_softirq_cpu));
+    memset(&g_softirq_stats, 0, sizeof(g_softirq_stats));
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        g_tasklet_vec[cpu].head = NULL;
+        g_tasklet_vec[cpu].tail = &g_tasklet_vec[cpu].head;
+        g_tasklet_hi_vec[cpu].head = NULL;
+        g_tasklet_hi_vec[cpu].tail = &g_tasklet_hi_vec[cpu].head;
+    }
+
+    open_softirq(HI_SOFTIRQ, tasklet_hi_action);
+    open_softirq(TASKLET_SOFTIRQ, tasklet_action);
+
+    printf("[INFO] Softirqs and tasklets initialized\n");
+}
+
+/**
+ * @brief Install the handler of a softirq vector
+ */
+void open_softirq(softirq_vector_t nr, softirq_action_t action) {
+    if (nr < NR_SOFTIRQS) {
+        g_softirq_vec[nr] = action;
+    }
+}
+
+/**
+ * @brief Mark a softirq pending, interrupts already disabled
+ */
+void raise_softirq_irqoff(softirq_vector_t nr) {
+    if (nr >= NR_SOFTIRQS) {
+        return;
+    }
+
+    g_softirq_cpu[smp_processor_id()].pending |= 1U << nr;
+    g_softirq_stats.raised[nr]++;
+}
+
+/**
+ * @brief Mark a softirq pending on the current CPU
+ */
+void raise_softirq(softirq_vector_t nr) {
+    uint64_t flags = interrupts_disable();
+    raise_softirq_irqoff(nr);
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Check whether softirqs are pending on the current CPU
+ */
+uint32_t local_softirq_pending(void) {
+    return g_softirq_cpu[smp_processor_id()].pending;
+}
+
+/**
+ * @brief Run pending softirqs on the current CPU
+ */
+void do_softirq(void) {
+    uint64_t flags = interrupts_disable();
+    softirq_cpu_t* sc = &g_softirq_cpu[smp_processor_id()];
+
+    if (sc->hardirq_count || sc->softirq_count || !sc->pending) {
+        interrupts_restore(flags);
+        return;
+    }
+
+    sc->softirq_count++;
+
+    for (uint32_t restart = SOFTIRQ_MAX_RESTART; sc->pending; ) {
+        uint32_t pending = sc->pending;
+        sc->pending = 0;
+        g_softirq_stats.passes++;
+
+        // Handlers run with interrupts on; new raises land in sc->pending
+        interrupts_enable();
+        while (pending) {
+            uint32_t nr = (uint32_t)__builtin_ctz(pending);
+            pending &= pending - 1;
+
+            if (g_softirq_vec[nr]) {
+                g_softirq_vec[nr]();
+                g_softirq_stats.handled[nr]++;
+            }
+        }
+        interrupts_disable();
+
+        if (--restart == 0) {
+            if (sc->pending) {
+                g_softirq_stats.deferred++;
+            }
+            break;
+        }
+    }
+
+    sc->softirq_count--;
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Enter hard interrupt context
+ */
+void irq_enter(void) {
+    g_softirq_cpu[smp_processor_id()].hardirq_count++;
+}
+
+/**
+ * @brief Leave hard interrupt context, running softirqs at the outermost level
+ */
+void irq_exit(void) {
+    softirq_cpu_t* sc = &g_softirq_cpu[smp_processor_id()];
+
+    if (sc->hardirq_count) {
+        sc->hardirq_count--;
+    }
+
+    if (!sc->hardirq_count && !sc->softirq_count && sc->pending) {
+        do_softirq();
+    }
+}
+
+/**
+ * @brief Check for hard interrupt or softirq context
+ */
+bool in_interrupt(void) {
+    const softirq_cpu_t* sc = &g_softirq_cpu[smp_processor_id()];
+    return sc->hardirq_count || sc->softirq_count;
+}
+
+/**
+ * @brief Check for softirq context or a bh-disabled section
+ */
+bool in_softirq(void) {
+    return g_softirq_cpu[smp_processor_id()].softirq_count != 0;
+}
+
+/**
+ * @brief Keep softirqs from running on the current CPU
+ */
+void local_bh_disable(void) {
+    uint64_t flags = interrupts_disable();
+    g_softirq_cpu[smp_processor_id()].softirq_count++;
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Allow softirqs again and run any that became pending
+ */
+void local_bh_enable(void) {
+    uint64_t flags = interrupts_disable();
+    softirq_cpu_t* sc = &g_softirq_cpu[smp_processor_id()];
+
+    if (sc->softirq_count) {
+        sc->softirq_count--;
+    }
+    bool run = !sc->hardirq_count && !sc->softirq_count && sc->pending;
+    interrupts_restore(flags);
+
+    if (run) {
+        do_softirq();
+    }
+}
+
+/**
+ * @brief Initialize a tasklet
+ */
+void tasklet_init(tasklet_struct_t* t, void (*func)(unsigned long), unsigned long data) {
+    t->next = NULL;
+    t->state = 0;
+    t->count = 0;
+    t->func = func;
+    t->data = data;
+}
+
+/**
+ * @brief Schedule a tasklet on the current CPU's TASKLET softirq
+ */
+void tasklet_schedule(tasklet_struct_t* t) {
+    if (!(__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) & TASKLET_STATE_SCHED)) {
+        tasklet_enqueue(t, &g_tasklet_vec[smp_processor_id()], TASKLET_SOFTIRQ);
+    }
+}
+
+/**
+ * @brief Schedule a tasklet on the current CPU's HI softirq
+ */
+void tasklet_hi_schedule(tasklet_struct_t* t) {
+    if (!(__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) & TASKLET_STATE_SCHED)) {
+        tasklet_enqueue(t, &g_tasklet_hi_vec[smp_processor_id()], HI_SOFTIRQ);
+    }
+}
+
+/**
+ * @brief Disable a tasklet and wait for a running instance to finish
+ */
+void tasklet_disable(tasklet_struct_t* t) {
+    __atomic_add_fetch(&t->count, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&t->state, __ATOMIC_ACQUIRE) & TASKLET_STATE_RUN) {
+        __asm__ __volatile__("pause");
+    }
+}
+
+/**
+ * @brief Re-enable a disabled tasklet
+ */
+void tasklet_enable(tasklet_struct_t* t) {
+    __atomic_sub_fetch(&t->count, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Wait for a tasklet to finish and keep it from running again
+ */
+void tasklet_kill(tasklet_struct_t* t) {
+    if (in_interrupt()) {
+        printf("[WARNING] tasklet_kill() from interrupt context\n");
+        return;
+    }
+
+    // Claim SCHED ourselves so nobody can queue it again
+    while (__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) & TASKLET_STATE_SCHED) {
+        do {
+            do_softirq();
+            yield();
+        } while (__atomic_load_n(&t->state, __ATOMIC_ACQUIRE) & TASKLET_STATE_SCHED);
+    }
+
+    while (__atomic_load_n(&t->state, __ATOMIC_ACQUIRE) & TASKLET_STATE_RUN) {
+        __asm__ __volatile__("pause");
+    }
+    __atomic_and_fetch(&t->state, ~TASKLET_STATE_SCHED, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get softirq statistics
+ */
+const softirq_stats_t* softirq_get_stats(void) {
+    return &g_softirq_stats;
+}
+
+/**
+ * @brief Print softirq and tasklet statistics
+ */
+void softirq_dump_status(void) {
+    printf("\n=== Softirqs ===\n");
+    for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+        printf("%-8s raised %llu, handled %llu\n", g_softirq_names[nr],
+               g_softirq_stats.raised[nr], g_softirq_stats.handled[nr]);
+    }
+    printf("Passes: %llu, deferred after restart limit: %llu\n",
+           g_softirq_stats.passes, g_softirq_stats.deferred);
+    printf("Tasklets: run %llu, requeued %llu\n",
+           g_softirq_stats.tasklets_run, g_softirq_stats.tasklets_requeued);
+    printf("Pending (this CPU): 0x%x\n", local_softirq_pending());
+}
+
+// Helper functions implementation
+
+/**
+ * @brief TASKLET_SOFTIRQ handler
+ */
+static void tasklet_action(void) {
+    tasklet_run_list(&g_tasklet_vec[smp_processor_id()], TASKLET_SOFTIRQ);
+}
+
+/**
+ * @brief HI_SOFTIRQ handler
+ */
+static void tasklet_hi_action(void) {
+    tasklet_run_list(&g_tasklet_hi_vec[smp_processor_id()], HI_SOFTIRQ);
+}
+
+/**
+ * @brief Run the tasklets queued on a per-CPU list
+ *
+ * The list is detached first so tasklets scheduled meanwhile go to a new
+ * list. A tasklet running on another CPU or disabled is queued again.
+ */
+static void tasklet_run_list(tasklet_list_t* list, softirq_vector_t nr) {
+    uint64_t flags = interrupts_disable();
+    tasklet_struct_t* t = list->head;
+    list->head = NULL;
+    list->tail = &list->head;
+    interrupts_restore(flags);
+
+    while (t) {
+        tasklet_struct_t* next = t->next;
+
+        bool claimed = !(__atomic_fetch_or(&t->state, TASKLET_STATE_RUN, __ATOMIC_ACQ_REL) & TASKLET_STATE_RUN);
+        if (claimed) {
+            if (__atomic_load_n(&t->count, __ATOMIC_ACQUIRE) == 0) {
+                // Clear SCHED before running so the function may reschedule itself
+                __atomic_and_fetch(&t->state, ~TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL);
+                t->func(t->data);
+                __atomic_and_fetch(&t->state, ~TASKLET_STATE_RUN, __ATOMIC_RELEASE);
+                g_softirq_stats.tasklets_run++;
+                t = next;
+                continue;
+            }
+            __atomic_and_fetch(&t->state, ~TASKLET_STATE_RUN, __ATOMIC_RELEASE);
+        }
+
+        g_softirq_stats.tasklets_requeued++;
+        tasklet_enqueue(t, list, nr);
+        t = next;
+    }
+}
+
+/**
+ * @brief Append a tasklet to a per-CPU list and raise its softirq
+ */
+static void tasklet_enqueue(tasklet_struct_t* t, tasklet_list_t* list, softirq_vector_t nr) {
+    uint64_t flags = interrupts_disable();
+    t->next = NULL;
+    *list->tail = t;
+    list->tail = &t->next;
+    raise_softirq_irqoff(nr);
+    interrupts_restore(flags);
+}
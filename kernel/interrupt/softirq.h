@@ -0,0 +1,219 @@
+/**
+ * @file softirq.h
+ * @brief Softirq bottom halves and tasklets for FG-OS
+ *
+ * Hard interrupt handlers acknowledge the device, record what happened and
+ * raise a softirq; the bulk of the work then runs on the way out of the
+ * outermost interrupt with interrupts enabled. Softirq vectors are fixed
+ * and raised per CPU. Tasklets are dynamically created deferred functions
+ * run from the HI and TASKLET softirqs, never concurrently with themselves.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __SOFTIRQ_H__
+#define __SOFTIRQ_H__
+
+#include <types.h>
+
+/**
+ * @brief Softirq vectors, run in ascending order
+ */
+typedef enum {
+    HI_SOFTIRQ = 0,                 /**< High priority tasklets */
+    TIMER_SOFTIRQ,                  /**< Deferred timer processing */
+    NET_RX_SOFTIRQ,                 /**< Network receive completion */
+    BLOCK_SOFTIRQ,                  /**< Block I/O completion */
+    TASKLET_SOFTIRQ,                /**< Normal priority tasklets */
+    RCU_SOFTIRQ,                    /**< RCU callback invocation */
+    NR_SOFTIRQS
+} softirq_vector_t;
+
+/**
+ * @brief Softirq processing limits
+ */
+#define SOFTIRQ_MAX_RESTART     10      /**< Passes per do_softirq() before deferring */
+
+/**
+ * @brief Softirq handler
+ */
+typedef void (*softirq_action_t)(void);
+
+/**
+ * @brief Tasklet state bits
+ */
+#define TASKLET_STATE_SCHED     (1 << 0)    /**< Queued to run */
+#define TASKLET_STATE_RUN       (1 << 1)    /**< Running on a CPU */
+
+/**
+ * @brief Tasklet
+ */
+typedef struct tasklet_struct {
+    struct tasklet_struct*  next;           /**< Next in the per-CPU list */
+    volatile uint32_t       state;          /**< TASKLET_STATE_* bits */
+    volatile uint32_t       count;          /**< Disable count, runs only at 0 */
+    void (*func)(unsigned long data);       /**< Deferred function */
+    unsigned long           data;           /**< Argument to func */
+} tasklet_struct_t;
+
+/**
+ * @brief Static initializer for a tasklet
+ */
+#define TASKLET_INIT(func, data) { NULL, 0, 0, (func), (data) }
+
+/**
+ * @brief Softirq statistics
+ */
+typedef struct {
+    uint64_t    raised[NR_SOFTIRQS];        /**< Times each vector was raised */
+    uint64_t    handled[NR_SOFTIRQS];       /**< Times each handler ran */
+    uint64_t    passes;                     /**< do_softirq() passes */
+    uint64_t    deferred;                   /**< Work left pending after the restart limit */
+    uint64_t    tasklets_run;               /**< Tasklet functions invoked */
+    uint64_t    tasklets_requeued;          /**< Tasklets busy or disabled when reached */
+} softirq_stats_t;
+
+/**
+ * @brief Initialize softirq and tasklet processing
+ */
+void softirq_init(void);
+
+/**
+ * @brief Install the handler of a softirq vector
+ *
+ * @param nr Softirq vector
+ * @param action Handler run with interrupts enabled
+ */
+void open_softirq(softirq_vector_t nr, softirq_action_t action);
+
+/**
+ * @brief Mark a softirq pending on the current CPU
+ *
+ * May be called from any context. The softirq runs at the next interrupt
+ * exit, local_bh_enable() or idle loop pass.
+ *
+ * @param nr Softirq vector
+ */
+void raise_softirq(softirq_vector_t nr);
+
+/**
+ * @brief Mark a softirq pending, interrupts already disabled
+ *
+ * @param nr Softirq vector
+ */
+void raise_softirq_irqoff(softirq_vector_t nr);
+
+/**
+ * @brief Check whether softirqs are pending on the current CPU
+ *
+ * @return Bitmask of pending vectors
+ */
+uint32_t local_softirq_pending(void);
+
+/**
+ * @brief Run pending softirqs on the current CPU
+ *
+ * Does nothing inside a hard interrupt, a softirq or a bh-disabled section.
+ */
+void do_softirq(void);
+
+/**
+ * @brief Enter hard interrupt context
+ */
+void irq_enter(void);
+
+/**
+ * @brief Leave hard interrupt context, running softirqs at the outermost level
+ */
+void irq_exit(void);
+
+/**
+ * @brief Check for hard interrupt or softirq context
+ *
+ * @return true if the caller must not sleep
+ */
+bool in_interrupt(void);
+
+/**
+ * @brief Check for softirq context or a bh-disabled section
+ *
+ * @return true if softirqs cannot run on this CPU right now
+ */
+bool in_softirq(void);
+
+/**
+ * @brief Keep softirqs from running on the current CPU
+ */
+void local_bh_disable(void);
+
+/**
+ * @brief Allow softirqs again and run any that became pending
+ */
+void local_bh_enable(void);
+
+/**
+ * @brief Initialize a tasklet
+ *
+ * @param t Tasklet
+ * @param func Deferred function
+ * @param data Argument passed to func
+ */
+void tasklet_init(tasklet_struct_t* t, void (*func)(unsigned long), unsigned long data);
+
+/**
+ * @brief Schedule a tasklet on the current CPU's TASKLET softirq
+ *
+ * Scheduling an already scheduled tasklet is a no-op, so several interrupts
+ * before the tasklet runs are handled by a single call.
+ *
+ * @param t Tasklet
+ */
+void tasklet_schedule(tasklet_struct_t* t);
+
+/**
+ * @brief Schedule a tasklet on the current CPU's HI softirq
+ *
+ * @param t Tasklet
+ */
+void tasklet_hi_schedule(tasklet_struct_t* t);
+
+/**
+ * @brief Disable a tasklet and wait for a running instance to finish
+ *
+ * @param t Tasklet
+ */
+void tasklet_disable(tasklet_struct_t* t);
+
+/**
+ * @brief Re-enable a disabled tasklet
+ *
+ * @param t Tasklet
+ */
+void tasklet_enable(tasklet_struct_t* t);
+
+/**
+ * @brief Wait for a tasklet to finish and keep it from running again
+ *
+ * Must not be called from interrupt context.
+ *
+ * @param t Tasklet
+ */
+void tasklet_kill(tasklet_struct_t* t);
+
+/**
+ * @brief Get softirq statistics
+ *
+ * @return Pointer to softirq statistics
+ */
+const softirq_stats_t* softirq_get_stats(void);
+
+/**
+ * @brief Print softirq and tasklet statistics
+ */
+void softirq_dump_status(void);
+
+#endif /* __SOFTIRQ_H__ */
@@ -0,0 +1,328 @@
+/**
+ * @file tick.c
+ * @brief Periodic and dynamic (NO_HZ) tick management for FG-OS
+ *
+ * The tick timer (the local APIC timer of each CPU, or the PIT without an
+ * APIC) normally interrupts TIMER_FREQUENCY times per second. When a CPU
+ * goes idle, or runs a single thread with nothing queued behind it, the
+ * periodic tick is stopped and the timer is programmed in one-shot mode for
+ * the next timer wheel, sleeper or hrtimer expiry. Elapsed ticks are
+ * accounted in one step when the one-shot fires or when another interrupt
+ * wakes the CPU. In hrtimer high-resolution mode the tick timer is itself
+ * an hrtimer on top of the local APIC timer.
+ * Only TICK_DO_TIMER_CPU advances the global tick count and the wheel.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "tick.h"
+#include "clocksource.h"
+#include "hrtimer.h"
+#include "interrupt.h"
+#include "timer_wheel.h"
+#include "../include/kernel.h"
+#include "../include/rcu.h"
+#include "../arch/x86_64/arch.h"
+#include "../sched/scheduler.h"
+
+// Per-CPU tick state
+static tick_sched_t g_tick_sched[MAX_CPUS];
+static bool g_nohz_enabled = TICK_NOHZ_DEFAULT_ENABLED;
+
+// Forward declarations
+static void tick_account(tick_sched_t* ts, uint64_t nticks);
+static uint64_t tick_next_event(uint64_t now);
+static bool tick_program_oneshot(tick_sched_t* ts, uint64_t now);
+static void tick_restart(tick_sched_t* ts);
+static uint64_t tick_consume_oneshot(tick_sched_t* ts, bool fired);
+
+/**
+ * @brief Initialize tick management
+ */
+void tick_init(void) {
+    memset(g_tick_sched, 0, sizeof(g_tick_sched));
+    timer_wheel_init(timer_get_ticks());
+
+    printf("[INFO] Tick management initialized (NO_HZ: %s)\n",
+           g_nohz_enabled ? "enabled" : "disabled");
+}
+
+/**
+ * @brief Enable or disable NO_HZ mode at runtime
+ */
+void tick_nohz_set_enabled(bool enable) {
+    g_nohz_enabled = enable;
+    if (!enable) {
+        tick_nohz_kick();
+    }
+}
+
+/**
+ * @brief Check whether NO_HZ mode is enabled
+ */
+bool tick_nohz_enabled(void) {
+    return g_nohz_enabled;
+}
+
+/**
+ * @brief Handle a timer interrupt
+ */
+void tick_handle_interrupt(void) {
+    tick_sched_t* ts = &g_tick_sched[smp_processor_id()];
+
+    if (ts->stopped == TICK_RUNNING) {
+        tick_account(ts, 1);
+    } else {
+        // One-shot expired: account everything that elapsed since programming
+        ts->oneshot_fired++;
+        tick_account(ts, tick_consume_oneshot(ts, true));
+    }
+
+    if (!g_nohz_enabled) {
+        if (ts->stopped != TICK_RUNNING) {
+            tick_restart(ts);
+        }
+        return;
+    }
+
+    if (ts->idle_active) {
+        // Still idle: keep the tick stopped and arm the next one-shot
+        if (ts->stopped != TICK_RUNNING && !tick_program_oneshot(ts, timer_get_ticks())) {
+            tick_restart(ts);
+        }
+        return;
+    }
+
+    if (scheduler_tick_needed()) {
+        if (ts->stopped != TICK_RUNNING) {
+            tick_restart(ts);
+        }
+        return;
+    }
+
+    // Busy CPU with nothing to preempt to: the tick only serves timers
+    bool was_running = (ts->stopped == TICK_RUNNING);
+    if (tick_program_oneshot(ts, timer_get_ticks())) {
+        if (was_running) {
+            ts->busy_stops++;
+        }
+        ts->stopped = TICK_STOPPED_BUSY;
+    } else if (!was_running) {
+        tick_restart(ts);
+    }
+}
+
+/**
+ * @brief Prepare the current CPU for idle
+ */
+void tick_nohz_idle_enter(void) {
+    tick_sched_t* ts = &g_tick_sched[smp_processor_id()];
+
+    ts->idle_active = true;
+    ts->idle_entries++;
+
+    if (!g_nohz_enabled) {
+        return;
+    }
+
+    if (ts->stopped == TICK_RUNNING) {
+        if (tick_program_oneshot(ts, timer_get_ticks())) {
+            ts->stopped = TICK_STOPPED_IDLE;
+            ts->idle_stops++;
+        }
+    } else {
+        ts->stopped = TICK_STOPPED_IDLE;
+    }
+}
+
+/**
+ * @brief Leave idle on the current CPU
+ */
+void tick_nohz_idle_exit(void) {
+    tick_sched_t* ts = &g_tick_sched[smp_processor_id()];
+    uint64_t flags = interrupts_disable();
+
+    ts->idle_active = false;
+
+    if (ts->stopped != TICK_RUNNING) {
+        // Woken by another interrupt before the one-shot: catch up now
+        if (ts->programmed_counts != 0) {
+            ts->early_wakeups++;
+            tick_account(ts, tick_consume_oneshot(ts, false));
+        }
+        tick_restart(ts);
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Restart the periodic tick if it is stopped
+ */
+void tick_nohz_kick(void) {
+    tick_sched_t* ts = &g_tick_sched[smp_processor_id()];
+    uint64_t flags = interrupts_disable();
+
+    if (ts->stopped == TICK_STOPPED_BUSY) {
+        if (ts->programmed_counts != 0) {
+            tick_account(ts, tick_consume_oneshot(ts, false));
+        }
+        tick_restart(ts);
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Get tick state of a CPU
+ */
+const tick_sched_t* tick_get_sched(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) return NULL;
+    return &g_tick_sched[cpu];
+}
+
+/**
+ * @brief Dump tick management status for debugging
+ */
+void tick_dump_status(void) {
+    const tick_sched_t* ts = &g_tick_sched[smp_processor_id()];
+    const timer_wheel_stats_t* wheel = timer_wheel_get_stats();
+
+    printf("\n=== Tick Management (NO_HZ: %s) ===\n", g_nohz_enabled ? "On" : "Off");
+    printf("Tick State: %s\n",
+           ts->stopped == TICK_RUNNING ? "Periodic" :
+           ts->stopped == TICK_STOPPED_IDLE ? "Stopped (idle)" : "Stopped (busy)");
+    printf("Idle Entries: %llu (tick stopped %llu times)\n", ts->idle_entries, ts->idle_stops);
+    printf("Busy Stops: %llu\n", ts->busy_stops);
+    printf("Ticks Skipped: %llu\n", ts->ticks_skipped);
+    printf("One-shots Fired: %llu, Early Wakeups: %llu\n", ts->oneshot_fired, ts->early_wakeups);
+    printf("Pending Timers: %u (expired %llu)\n", wheel->pending, wheel->timers_expired);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Account elapsed ticks and run expired work
+ */
+static void tick_account(tick_sched_t* ts, uint64_t nticks) {
+    if (nticks == 0) {
+        return;
+    }
+
+    if (nticks > 1) {
+        ts->ticks_skipped += nticks - 1;
+    }
+
+    // With per-CPU timers, one CPU keeps time for everyone
+    if (smp_processor_id() == TICK_DO_TIMER_CPU) {
+        timer_account_ticks(nticks);
+        timer_wheel_run(timer_get_ticks());
+    }
+    rcu_check_callbacks();
+    hrtimer_run_queues();
+
+    if (scheduler_is_enabled()) {
+        scheduler_tick();
+    }
+}
+
+/**
+ * @brief Get the next tick at which the CPU must be woken
+ */
+static uint64_t tick_next_event(uint64_t now) {
+    uint64_t next = timer_wheel_next_expiry();
+
+    // Pending RCU callbacks need the tick to see grace periods complete
+    if (rcu_needs_cpu()) {
+        return now + 1;
+    }
+
+    uint64_t frequency = timer_get_manager()->frequency;
+    uint64_t wake_ms = scheduler_next_wakeup();
+    if (wake_ms != UINT64_MAX) {
+        uint64_t wake_tick = (wake_ms * frequency) / 1000;
+        if (wake_tick < next) {
+            next = wake_tick;
+        }
+    }
+
+    // Without high-resolution mode hrtimers expire from the tick as well
+    if (!hrtimer_hres_active()) {
+        uint64_t hr_ns = hrtimer_get_next_event();
+        if (hr_ns != HRTIMER_NO_EVENT) {
+            uint64_t ktime = ktime_get_ns();
+            uint64_t tick_ns = NSEC_PER_SEC / frequency;
+            uint64_t hr_tick = now + (hr_ns > ktime ? (hr_ns - ktime + tick_ns - 1) / tick_ns : 0);
+            if (hr_tick < next) {
+                next = hr_tick;
+            }
+        }
+    }
+
+    return (next < now) ? now : next;
+}
+
+/**
+ * @brief Program a one-shot for the next event
+ *
+ * @return true if the tick may stay stopped, false if the next event is too close
+ */
+static bool tick_program_oneshot(tick_sched_t* ts, uint64_t now) {
+    uint64_t next = tick_next_event(now);
+    uint64_t delta = next - now;
+
+    if (delta < TICK_NOHZ_MIN_DEFER_TICKS) {
+        return false;
+    }
+
+    // One-shot range is limited (16 bits on the PIT), so long gaps are split into several
+    uint64_t counts = delta * TIMER_RELOAD_VALUE;
+    if (counts > ts->residual_counts) {
+        counts -= ts->residual_counts;
+    }
+    if (counts > timer_max_oneshot_counts()) {
+        counts = timer_max_oneshot_counts();
+    }
+
+    ts->stop_tick = now;
+    ts->next_event = next;
+    ts->programmed_counts = (uint32_t)counts;
+    timer_set_oneshot((uint32_t)counts);
+
+    return true;
+}
+
+/**
+ * @brief Return to periodic mode
+ */
+static void tick_restart(tick_sched_t* ts) {
+    ts->stopped = TICK_RUNNING;
+    ts->programmed_counts = 0;
+    ts->residual_counts = 0;
+    timer_set_periodic(timer_get_manager()->frequency);
+}
+
+/**
+ * @brief Convert the elapsed part of a one-shot into whole ticks
+ *
+ * @param fired true if the one-shot reached terminal count
+ * @return Number of whole ticks elapsed
+ */
+static uint64_t tick_consume_oneshot(tick_sched_t* ts, bool fired) {
+    uint32_t elapsed = ts->programmed_counts;
+
+    if (!fired) {
+        uint32_t remaining = timer_read_counter();
+        elapsed = (remaining < ts->programmed_counts) ? ts->programmed_counts - remaining : 0;
+    }
+
+    uint64_t total = (uint64_t)elapsed + ts->residual_counts;
+    ts->programmed_counts = 0;
+    ts->residual_counts = (uint32_t)(total % TIMER_RELOAD_VALUE);
+
+    return total / TIMER_RELOAD_VALUE;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file tick.h
+ * @brief Periodic and dynamic (NO_HZ) tick management for FG-OS
+ *
+ * This file provides the per-CPU tick state used to stop the periodic timer
+ * interrupt on idle CPUs, and on busy CPUs that have nothing to preempt to.
+ * While the tick is stopped the timer is programmed in one-shot mode for
+ * the next timer wheel expiry.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __TICK_H__
+#define __TICK_H__
+
+#include <types.h>
+
+/**
+ * @brief NO_HZ configuration
+ */
+#define TICK_NOHZ_DEFAULT_ENABLED   true    /**< NO_HZ enabled at boot */
+#define TICK_NOHZ_MIN_DEFER_TICKS   2       /**< Do not stop the tick for shorter gaps */
+#define TICK_DO_TIMER_CPU           0       /**< CPU that advances the tick count and runs the wheel */
+
+/**
+ * @brief Reason the periodic tick is currently stopped
+ */
+typedef enum {
+    TICK_RUNNING = 0,               /**< Periodic tick active */
+    TICK_STOPPED_IDLE,              /**< Stopped because the CPU is idle */
+    TICK_STOPPED_BUSY               /**< Stopped because nothing can preempt */
+} tick_stop_reason_t;
+
+/**
+ * @brief Per-CPU tick state
+ */
+typedef struct {
+    tick_stop_reason_t  stopped;            /**< Tick stop state */
+    bool                idle_active;        /**< CPU is in the idle loop */
+    uint64_t            stop_tick;          /**< Tick count when the tick was stopped */
+    uint64_t            next_event;         /**< Absolute tick of the programmed one-shot */
+    uint32_t            programmed_counts;  /**< Timer counts of the programmed one-shot */
+    uint32_t            residual_counts;    /**< Sub-tick remainder carried between one-shots */
+    uint64_t            idle_entries;       /**< Times the idle loop was entered */
+    uint64_t            idle_stops;         /**< Tick stops while idle */
+    uint64_t            busy_stops;         /**< Tick stops while busy */
+    uint64_t            ticks_skipped;      /**< Periodic interrupts avoided */
+    uint64_t            oneshot_fired;      /**< One-shot interrupts taken */
+    uint64_t            early_wakeups;      /**< Wakeups before the one-shot expired */
+} tick_sched_t;
+
+/**
+ * @brief Initialize tick management
+ */
+void tick_init(void);
+
+/**
+ * @brief Enable or disable NO_HZ mode at runtime
+ *
+ * @param enable true to allow the tick to be stopped
+ */
+void tick_nohz_set_enabled(bool enable);
+
+/**
+ * @brief Check whether NO_HZ mode is enabled
+ *
+ * @return true if enabled, false otherwise
+ */
+bool tick_nohz_enabled(void);
+
+/**
+ * @brief Handle a timer interrupt
+ *
+ * Accounts elapsed ticks (one for a periodic tick, possibly many after a
+ * one-shot) and decides whether the periodic tick may be stopped.
+ */
+void tick_handle_interrupt(void);
+
+/**
+ * @brief Prepare the current CPU for idle
+ *
+ * Must be called with interrupts disabled, right before halting.
+ */
+void tick_nohz_idle_enter(void);
+
+/**
+ * @brief Leave idle on the current CPU
+ *
+ * Catches up on ticks that elapsed while halted and restarts the tick.
+ */
+void tick_nohz_idle_exit(void);
+
+/**
+ * @brief Restart the periodic tick if it is stopped
+ *
+ * Called when new work becomes runnable and preemption may be needed.
+ */
+void tick_nohz_kick(void);
+
+/**
+ * @brief Get tick state of a CPU
+ *
+ * @param cpu CPU number
+ * @return Pointer to tick state, NULL if invalid
+ */
+const tick_sched_t* tick_get_sched(uint32_t cpu);
+
+/**
+ * @brief Dump tick management status for debugging
+ */
+void tick_dump_status(void);
+
+#endif /* __TICK_H__ */
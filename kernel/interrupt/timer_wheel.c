@@ -0,0 +1,280 @@
+/**
+ * @file timer_wheel.c
+ * @brief Tick-based kernel timer wheel implementation for FG-OS
+ *
+ * Timers are hashed into one of four 64-slot levels by their distance from
+ * the wheel clock. Level 0 holds timers due within 64 ticks; higher levels
+ * are cascaded down one level each time the level below wraps around, so
+ * every timer fires on its exact tick.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "timer_wheel.h"
+#include "idt.h"
+#include "../include/kernel.h"
+
+// Timer wheel state
+static struct {
+    timer_list_t*       slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  /**< Timer slots */
+    uint64_t            occupied[TIMER_WHEEL_LEVELS];  /**< Non-empty slot bitmap */
+    uint64_t            clk;                           /**< Next tick to process */
+    bool                running;                       /**< Running the timers of clk */
+    timer_wheel_stats_t stats;                         /**< Wheel statistics */
+} g_timer_wheel;
+
+/**
+ * @brief Get slot index of a tick at a wheel level
+ */
+static inline uint8_t wheel_index(uint64_t tick, uint8_t level) {
+    return (uint8_t)((tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+}
+
+/**
+ * @brief Link a timer into the slot matching its expiry
+ */
+static void wheel_enqueue(timer_list_t* timer) {
+    uint64_t expires = timer->expires;
+    uint64_t delta;
+    uint8_t level;
+
+    // Already due - fire on the next processed tick. While timer_wheel_run()
+    // drains the slot of clk that is clk + 1, or a callback re-arming its
+    // own timer for now would be run again without end
+    uint64_t first = g_timer_wheel.clk + (g_timer_wheel.running ? 1 : 0);
+    if (expires < first) {
+        expires = first;
+    }
+
+    delta = expires - g_timer_wheel.clk;
+    if (delta > TIMER_WHEEL_MAX_DELTA) {
+        delta = TIMER_WHEEL_MAX_DELTA;
+        expires = g_timer_wheel.clk + delta;
+        timer->expires = expires;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1ULL << ((level + 1) * TIMER_WHEEL_BITS))) {
+            break;
+        }
+    }
+
+    uint8_t slot = wheel_index(expires, level);
+    timer->level = level;
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = g_timer_wheel.slots[level][slot];
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    g_timer_wheel.slots[level][slot] = timer;
+    g_timer_wheel.occupied[level] |= (1ULL << slot);
+    timer->pending = true;
+}
+
+/**
+ * @brief Unlink a timer from its slot
+ */
+static void wheel_dequeue(timer_list_t* timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        g_timer_wheel.slots[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    if (!g_timer_wheel.slots[timer->level][timer->slot]) {
+        g_timer_wheel.occupied[timer->level] &= ~(1ULL << timer->slot);
+    }
+
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->pending = false;
+}
+
+/**
+ * @brief Move all timers of a slot down to lower levels
+ *
+ * @return The slot index that was cascaded
+ */
+static uint8_t wheel_cascade(uint8_t level, uint8_t slot) {
+    timer_list_t* timer = g_timer_wheel.slots[level][slot];
+
+    g_timer_wheel.slots[level][slot] = NULL;
+    g_timer_wheel.occupied[level] &= ~(1ULL << slot);
+
+    while (timer) {
+        timer_list_t* next = timer->next;
+        wheel_enqueue(timer);
+        g_timer_wheel.stats.cascades++;
+        timer = next;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Initialize the timer wheel
+ */
+void timer_wheel_init(uint64_t now) {
+    memset(&g_timer_wheel, 0, sizeof(g_timer_wheel));
+    g_timer_wheel.clk = now;
+}
+
+/**
+ * @brief Prepare a timer for use
+ */
+void timer_setup(timer_list_t* timer, timer_function_t function, void* data) {
+    if (!timer) return;
+
+    memset(timer, 0, sizeof(timer_list_t));
+    timer->function = function;
+    timer->data = data;
+}
+
+/**
+ * @brief Queue or re-queue a timer
+ */
+int mod_timer(timer_list_t* timer, uint64_t expires) {
+    if (!timer || !timer->function) return -1;
+
+    uint64_t flags = interrupts_disable();
+    int was_pending = timer->pending ? 1 : 0;
+
+    if (was_pending) {
+        wheel_dequeue(timer);
+    } else {
+        g_timer_wheel.stats.pending++;
+    }
+
+    timer->expires = expires;
+    wheel_enqueue(timer);
+    g_timer_wheel.stats.timers_added++;
+
+    interrupts_restore(flags);
+    return was_pending;
+}
+
+/**
+ * @brief Cancel a pending timer
+ */
+int del_timer(timer_list_t* timer) {
+    if (!timer) return 0;
+
+    uint64_t flags = interrupts_disable();
+    int was_pending = timer->pending ? 1 : 0;
+
+    if (was_pending) {
+        wheel_dequeue(timer);
+        g_timer_wheel.stats.pending--;
+        g_timer_wheel.stats.timers_deleted++;
+    }
+
+    interrupts_restore(flags);
+    return was_pending;
+}
+
+/**
+ * @brief Check whether a timer is queued
+ */
+bool timer_pending(const timer_list_t* timer) {
+    return timer && timer->pending;
+}
+
+/**
+ * @brief Run all timers that expired up to the given tick
+ */
+void timer_wheel_run(uint64_t now) {
+    uint64_t flags = interrupts_disable();
+
+    // Nothing queued: jump the clock instead of walking skipped ticks
+    if (g_timer_wheel.stats.pending == 0) {
+        if (now + 1 > g_timer_wheel.clk) {
+            g_timer_wheel.clk = now + 1;
+        }
+        interrupts_restore(flags);
+        return;
+    }
+
+    while (g_timer_wheel.clk <= now) {
+        uint8_t index = wheel_index(g_timer_wheel.clk, 0);
+
+        // Cascade higher levels whenever the level below wraps
+        if (index == 0) {
+            uint8_t level = 1;
+            while (level < TIMER_WHEEL_LEVELS &&
+                   wheel_cascade(level, wheel_index(g_timer_wheel.clk, level)) == 0) {
+                level++;
+            }
+        }
+
+        timer_list_t* timer;
+        g_timer_wheel.running = true;
+        while ((timer = g_timer_wheel.slots[0][index]) != NULL) {
+            wheel_dequeue(timer);
+            g_timer_wheel.stats.pending--;
+            g_timer_wheel.stats.timers_expired++;
+
+            // Run the callback with interrupts restored so it may re-arm
+            interrupts_restore(flags);
+            timer->function(timer);
+            flags = interrupts_disable();
+        }
+        g_timer_wheel.running = false;
+
+        g_timer_wheel.clk++;
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Get the earliest pending expiry
+ */
+uint64_t timer_wheel_next_expiry(void) {
+    uint64_t next = TIMER_WHEEL_NO_EXPIRY;
+    uint64_t flags = interrupts_disable();
+
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t occupied = g_timer_wheel.occupied[level];
+        if (!occupied) {
+            continue;
+        }
+
+        // Walk slots in wheel order; at level 0 the current slot comes first,
+        // above it the current slot only holds wrapped-around timers
+        uint8_t start = wheel_index(g_timer_wheel.clk, level);
+        if (level > 0) {
+            start = (start + 1) & TIMER_WHEEL_MASK;
+        }
+
+        for (uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+            uint8_t slot = (start + i) & TIMER_WHEEL_MASK;
+            if (!(occupied & (1ULL << slot))) {
+                continue;
+            }
+
+            for (timer_list_t* timer = g_timer_wheel.slots[level][slot]; timer; timer = timer->next) {
+                if (timer->expires < next) {
+                    next = timer->expires;
+                }
+            }
+            break;
+        }
+    }
+
+    interrupts_restore(flags);
+    return next;
+}
+
+/**
+ * @brief Get timer wheel statistics
+ */
+const timer_wheel_stats_t* timer_wheel_get_stats(void) {
+    return &g_timer_wheel.stats;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file timer_wheel.h
+ * @brief Tick-based kernel timer wheel for FG-OS
+ *
+ * This file provides a hierarchical cascading timer wheel for kernel timers
+ * expressed in timer ticks. The wheel can report the next pending expiry,
+ * which the NO_HZ tick code uses to program one-shot timer interrupts.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright Copyright (c) 2024 FGCompany Official. All rights reserved.
+ */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <types.h>
+
+/**
+ * @brief Timer wheel geometry
+ */
+#define TIMER_WHEEL_LEVELS      4       /**< Number of wheel levels */
+#define TIMER_WHEEL_BITS        6       /**< Index bits per level */
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_BITS)     /**< Slots per level */
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SLOTS - 1)     /**< Slot index mask */
+#define TIMER_WHEEL_MAX_DELTA   ((1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1)
+
+/**
+ * @brief Value returned when no timer is pending
+ */
+#define TIMER_WHEEL_NO_EXPIRY   UINT64_MAX
+
+struct timer_list;
+
+/**
+ * @brief Timer callback function type
+ *
+ * @param timer Expired timer
+ */
+typedef void (*timer_function_t)(struct timer_list* timer);
+
+/**
+ * @brief Kernel timer structure
+ */
+typedef struct timer_list {
+    struct timer_list*  next;           /**< Next timer in slot */
+    struct timer_list*  prev;           /**< Previous timer in slot */
+    uint64_t            expires;        /**< Absolute expiry tick */
+    timer_function_t    function;       /**< Expiry callback */
+    void*               data;           /**< Callback private data */
+    uint8_t             level;          /**< Wheel level holding the timer */
+    uint8_t             slot;           /**< Slot index within the level */
+    bool                pending;        /**< Timer is queued on the wheel */
+} timer_list_t;
+
+/**
+ * @brief Timer wheel statistics
+ */
+typedef struct {
+    uint64_t    timers_added;           /**< Timers queued */
+    uint64_t    timers_deleted;         /**< Timers cancelled */
+    uint64_t    timers_expired;         /**< Timers expired */
+    uint64_t    cascades;               /**< Timers moved down a level */
+    uint32_t    pending;                /**< Currently pending timers */
+} timer_wheel_stats_t;
+
+/**
+ * @brief Initialize the timer wheel
+ *
+ * @param now Current tick count
+ */
+void timer_wheel_init(uint64_t now);
+
+/**
+ * @brief Prepare a timer for use
+ *
+ * @param timer Timer to initialize
+ * @param function Expiry callback
+ * @param data Callback private data
+ */
+void timer_setup(timer_list_t* timer, timer_function_t function, void* data);
+
+/**
+ * @brief Queue or re-queue a timer
+ *
+ * @param timer Timer to queue
+ * @param expires Absolute expiry tick
+ * @return 1 if the timer was pending before, 0 otherwise
+ */
+int mod_timer(timer_list_t* timer, uint64_t expires);
+
+/**
+ * @brief Cancel a pending timer
+ *
+ * @param timer Timer to cancel
+ * @return 1 if the timer was pending, 0 otherwise
+ */
+int del_timer(timer_list_t* timer);
+
+/**
+ * @brief Check whether a timer is queued
+ *
+ * @param timer Timer to check
+ * @return true if pending, false otherwise
+ */
+bool timer_pending(const timer_list_t* timer);
+
+/**
+ * @brief Run all timers that expired up to the given tick
+ *
+ * @param now Current tick count
+ */
+void timer_wheel_run(uint64_t now);
+
+/**
+ * @brief Get the earliest pending expiry
+ *
+ * @return Absolute tick of the next expiry, TIMER_WHEEL_NO_EXPIRY if idle
+ */
+uint64_t timer_wheel_next_expiry(void);
+
+/**
+ * @brief Get timer wheel statistics
+ *
+ * @return Pointer to timer wheel statistics
+ */
+const timer_wheel_stats_t* timer_wheel_get_stats(void);
+
+#endif /* __TIMER_WHEEL_H__ */
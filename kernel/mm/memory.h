@@ -78,6 +78,27 @@ void* kcalloc(size_t count, size_t size);
 void* krealloc(void* ptr, size_t size);
 void kfree(void* ptr);
 
+// Thread Stacks (vmstack.c)
+#define THREAD_STACK_SIZE   (64 * 1024)     // Usable bytes per thread stack
+#define THREAD_STACK_GUARD  PAGE_SIZE       // Unmapped guard below each stack
+#define THREAD_STACK_EAGER  (16 * 1024)     // Populated up front with CONFIG_VMSTACK_LAZY
+
+struct vmstack_stats {
+    uint32_t slots_in_use;      // Slots allocated, including cached stacks
+    uint64_t slot_allocs;       // Stacks built from a fresh slot
+    uint64_t slot_frees;        // Stacks returned to the slot bitmap
+    uint64_t cache_hits;        // Allocations served by the per-CPU cache
+    uint64_t pages_mapped;      // Physical pages backing stacks
+    uint64_t lazy_faults;       // Pages populated on first touch
+};
+
+int vmstack_init(void);
+uint64_t vmstack_alloc(void);
+void vmstack_free(uint64_t base);
+bool vmstack_handle_fault(uint64_t fault_address, uint64_t error_code);
+struct vmstack_stats* vmstack_get_stats(void);
+void print_vmstack_stats(void);
+
 // Memory Utilities
 void memory_copy(void* dest, const void* src, size_t size);
 void memory_set(void* dest, int value, size_t size);
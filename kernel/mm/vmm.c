@@ -12,6 +12,7 @@
 #include <types.h>
 #include "../mm/memory.h"
 #include "../arch/x86_64/arch.h"
+#include "../sched/scheduler.h"
 
 // Page table structures
 static uint64_t *kernel_pml4 = NULL;
@@ -49,6 +50,11 @@ int vmm_init(void) {
             KERROR("VMM: Failed to identity map page 0x%016lX", addr);
             return -1;
         }
+        
+        // Preemption point every 2MB of the million-page loop
+        if ((addr & 0x1FFFFF) == 0) {
+            cond_resched();
+        }
     }
     
     // Map kernel to higher half
@@ -60,6 +66,10 @@ int vmm_init(void) {
             KERROR("VMM: Failed to map kernel page 0x%016lX -> 0x%016lX", virt, phys);
             return -1;
         }
+        
+        if ((phys & 0x1FFFFF) == 0) {
+            cond_resched();
+        }
     }
     
     KINFO("VMM: Initialization complete");
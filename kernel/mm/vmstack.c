@@ -0,0 +1,297 @@
+/*
+ * FG-OS Virtually Mapped Thread Stacks
+ * Phase 5: Memory Management Implementation
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Thread stacks live in a dedicated virtual area, one fixed-size slot per
+ * stack. The lowest page of every slot is never mapped, so an overflow
+ * faults instead of silently corrupting a neighbour. The kernel has no
+ * TSS yet, so that fault is delivered on the overflowed stack itself and
+ * escalates to a double and then a triple fault: an overflow resets the
+ * machine rather than reaching the guard-page report below.
+ *
+ * Freed stacks go to a small per-CPU cache and are handed out again
+ * without touching the page tables or the physical allocator.
+ *
+ * With CONFIG_VMSTACK_LAZY only the top of a stack is populated up front;
+ * the rest is mapped by the page fault handler on first touch and trimmed
+ * again when the stack is cached, so rare deep call chains do not pin
+ * memory. The fault is taken on the stack that overflowed, so lazy mode
+ * needs page faults delivered on an IST stack.
+ */
+
+#include <kernel.h>
+#include <types.h>
+#include "../mm/memory.h"
+#include "../arch/x86_64/arch.h"
+#include "../include/spinlock.h"
+#include "../include/panic.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/interrupt.h"
+
+// Virtual area layout
+#define VMSTACK_AREA_BASE       0xFFFFC90000000000UL
+#define VMSTACK_SLOT_SIZE       (THREAD_STACK_GUARD + THREAD_STACK_SIZE)
+#define VMSTACK_MAX_SLOTS       1024
+#define VMSTACK_AREA_END        (VMSTACK_AREA_BASE + (uint64_t)VMSTACK_MAX_SLOTS * VMSTACK_SLOT_SIZE)
+
+// Stacks kept per CPU for reuse
+#define VMSTACK_CACHE_SIZE      4
+
+// Per-CPU cache of freed, still mapped stacks
+struct vmstack_cache {
+    uint64_t stacks[VMSTACK_CACHE_SIZE];    // Stack bases
+    uint32_t count;                         // Cached stacks
+};
+
+static struct vmstack_cache stack_cache[MAX_CPUS];
+
+// Slot allocation bitmap
+static uint64_t slot_bitmap[VMSTACK_MAX_SLOTS / 64];
+static uint32_t next_slot = 0;
+static spinlock_t slot_lock;
+
+// Statistics
+static struct vmstack_stats vmstack_stats = {0};
+
+// Forward declarations for internal functions
+static int vmstack_populate(uint64_t start, uint64_t end);
+static void vmstack_depopulate(uint64_t start, uint64_t end);
+static uint64_t vmstack_slot_base(uint32_t slot);
+
+/**
+ * Initialize the thread stack allocator
+ * @return 0 on success, negative error code on failure
+ */
+int vmstack_init(void) {
+    memory_set(slot_bitmap, 0, sizeof(slot_bitmap));
+    memory_set(stack_cache, 0, sizeof(stack_cache));
+    memory_set(&vmstack_stats, 0, sizeof(vmstack_stats));
+    next_slot = 0;
+    spin_lock_init(&slot_lock);
+
+#ifdef CONFIG_VMSTACK_LAZY
+    KINFO("VMSTACK: %u slots of %u KB at 0x%016lX (lazy, %u KB eager)",
+          VMSTACK_MAX_SLOTS, THREAD_STACK_SIZE / 1024, VMSTACK_AREA_BASE,
+          THREAD_STACK_EAGER / 1024);
+#else
+    KINFO("VMSTACK: %u slots of %u KB at 0x%016lX",
+          VMSTACK_MAX_SLOTS, THREAD_STACK_SIZE / 1024, VMSTACK_AREA_BASE);
+#endif
+    return 0;
+}
+
+/**
+ * Allocate a guarded thread stack
+ * @return Lowest usable address of the stack, or 0 on failure
+ */
+uint64_t vmstack_alloc(void) {
+    // Fast path: reuse a stack freed on this CPU
+    uint64_t flags = interrupts_disable();
+    struct vmstack_cache *cache = &stack_cache[smp_processor_id()];
+    if (cache->count) {
+        uint64_t base = cache->stacks[--cache->count];
+        vmstack_stats.cache_hits++;
+        interrupts_restore(flags);
+        return base;
+    }
+    interrupts_restore(flags);
+
+    // Slow path: claim a free slot
+    flags = spin_lock_irqsave(&slot_lock);
+    uint32_t slot = VMSTACK_MAX_SLOTS;
+    for (uint32_t i = 0; i < VMSTACK_MAX_SLOTS; i++) {
+        uint32_t candidate = (next_slot + i) % VMSTACK_MAX_SLOTS;
+        if (!(slot_bitmap[candidate / 64] & (1ULL << (candidate % 64)))) {
+            slot = candidate;
+            slot_bitmap[slot / 64] |= 1ULL << (slot % 64);
+            next_slot = (slot + 1) % VMSTACK_MAX_SLOTS;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&slot_lock, flags);
+
+    if (slot == VMSTACK_MAX_SLOTS) {
+        KERROR("VMSTACK: Out of stack slots");
+        return 0;
+    }
+
+    uint64_t base = vmstack_slot_base(slot);
+    uint64_t top = base + THREAD_STACK_SIZE;
+
+#ifdef CONFIG_VMSTACK_LAZY
+    uint64_t populate_from = top - THREAD_STACK_EAGER;
+#else
+    uint64_t populate_from = base;
+#endif
+
+    if (vmstack_populate(populate_from, top) != 0) {
+        vmstack_depopulate(base, top);
+
+        flags = spin_lock_irqsave(&slot_lock);
+        slot_bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+        spin_unlock_irqrestore(&slot_lock, flags);
+
+        KERROR("VMSTACK: Failed to populate stack slot %u", slot);
+        return 0;
+    }
+
+    vmstack_stats.slots_in_use++;
+    vmstack_stats.slot_allocs++;
+    return base;
+}
+
+/**
+ * Free a thread stack
+ * @param base Lowest usable address returned by vmstack_alloc()
+ */
+void vmstack_free(uint64_t base) {
+    if (base < VMSTACK_AREA_BASE || base >= VMSTACK_AREA_END) {
+        KERROR("VMSTACK: Freeing invalid stack 0x%016lX", base);
+        return;
+    }
+
+    uint64_t top = base + THREAD_STACK_SIZE;
+
+#ifdef CONFIG_VMSTACK_LAZY
+    // Drop pages a deep call chain populated; the cache keeps only the eager part
+    vmstack_depopulate(base, top - THREAD_STACK_EAGER);
+#endif
+
+    // Keep the stack mapped in this CPU's cache if there is room
+    uint64_t flags = interrupts_disable();
+    struct vmstack_cache *cache = &stack_cache[smp_processor_id()];
+    if (cache->count < VMSTACK_CACHE_SIZE) {
+        cache->stacks[cache->count++] = base;
+        interrupts_restore(flags);
+        return;
+    }
+    interrupts_restore(flags);
+
+    // Cache full: return pages and the slot
+    vmstack_depopulate(base, top);
+
+    uint32_t slot = (uint32_t)((base - THREAD_STACK_GUARD - VMSTACK_AREA_BASE) / VMSTACK_SLOT_SIZE);
+    flags = spin_lock_irqsave(&slot_lock);
+    slot_bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+    spin_unlock_irqrestore(&slot_lock, flags);
+
+    vmstack_stats.slots_in_use--;
+    vmstack_stats.slot_frees++;
+}
+
+/**
+ * Handle a page fault inside the thread stack area
+ * @param fault_address Faulting virtual address (CR2)
+ * @param error_code Page fault error code
+ * @return true if the fault was resolved, false if it is not a stack fault
+ */
+bool vmstack_handle_fault(uint64_t fault_address, uint64_t error_code) {
+    if (fault_address < VMSTACK_AREA_BASE || fault_address >= VMSTACK_AREA_END) {
+        return false;
+    }
+
+    uint64_t offset = (fault_address - VMSTACK_AREA_BASE) % VMSTACK_SLOT_SIZE;
+    uint32_t slot = (uint32_t)((fault_address - VMSTACK_AREA_BASE) / VMSTACK_SLOT_SIZE);
+
+    // Only reachable once #PF runs on an IST stack; until then an
+    // overflow never gets this far (see the file comment)
+    if (offset < THREAD_STACK_GUARD) {
+        printf("\n[PAGE FAULT] Kernel stack overflow into guard page of slot %u (0x%016llX)\n",
+               slot, fault_address);
+        panic_stackoverflow();
+    }
+
+#ifdef CONFIG_VMSTACK_LAZY
+    if (!(error_code & PAGE_FAULT_PRESENT) && (slot_bitmap[slot / 64] & (1ULL << (slot % 64)))) {
+        uint64_t page = fault_address & ~(PAGE_SIZE - 1);
+        if (vmstack_populate(page, page + PAGE_SIZE) == 0) {
+            vmstack_stats.lazy_faults++;
+            return true;
+        }
+    }
+#else
+    (void)error_code;
+#endif
+
+    return false;
+}
+
+/**
+ * Get thread stack allocator statistics
+ * @return Pointer to statistics structure
+ */
+struct vmstack_stats* vmstack_get_stats(void) {
+    return &vmstack_stats;
+}
+
+/**
+ * Print thread stack allocator statistics
+ */
+void print_vmstack_stats(void) {
+    uint32_t cached = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cached += stack_cache[cpu].count;
+    }
+
+    KINFO("=== Thread Stacks ===");
+    KINFO("Slots in use: %u / %u (%u cached)", vmstack_stats.slots_in_use, VMSTACK_MAX_SLOTS, cached);
+    KINFO("Slot allocations: %lu, frees: %lu", vmstack_stats.slot_allocs, vmstack_stats.slot_frees);
+    KINFO("Cache hits: %lu", vmstack_stats.cache_hits);
+    KINFO("Pages mapped: %lu, lazy faults: %lu", vmstack_stats.pages_mapped, vmstack_stats.lazy_faults);
+    KINFO("=====================");
+}
+
+/**
+ * Map fresh pages over a stack range, skipping pages already present
+ * @param start First address (page aligned)
+ * @param end End address (page aligned, exclusive)
+ * @return 0 on success, negative error code on failure
+ */
+static int vmstack_populate(uint64_t start, uint64_t end) {
+    for (uint64_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (vmm_get_physical(addr)) {
+            continue;
+        }
+
+        uint64_t phys = pmm_alloc_page();
+        if (phys == 0) {
+            return -1;
+        }
+
+        if (vmm_map_page(addr, phys, PTE_PRESENT | PTE_WRITABLE) != 0) {
+            pmm_free_page(phys);
+            return -1;
+        }
+        vmstack_stats.pages_mapped++;
+    }
+
+    return 0;
+}
+
+/**
+ * Unmap a stack range and free its pages
+ * @param start First address (page aligned)
+ * @param end End address (page aligned, exclusive)
+ */
+static void vmstack_depopulate(uint64_t start, uint64_t end) {
+    for (uint64_t addr = start; addr < end; addr += PAGE_SIZE) {
+        uint64_t phys = vmm_get_physical(addr);
+        if (phys) {
+            vmm_unmap_page(addr);
+            pmm_free_page(phys);
+            vmstack_stats.pages_mapped--;
+        }
+    }
+}
+
+/**
+ * Get the lowest usable address of a stack slot
+ * @param slot Slot number
+ * @return Address just above the slot's guard page
+ */
+static uint64_t vmstack_slot_base(uint32_t slot) {
+    return VMSTACK_AREA_BASE + (uint64_t)slot * VMSTACK_SLOT_SIZE + THREAD_STACK_GUARD;
+}
@@ -0,0 +1,463 @@
+/*
+ * FG-OS CPU Time Accounting
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Charges TSC cycles to the running thread and its process at every
+ * accounting boundary: IRQ entry and exit, switch-out and switch-in. Each
+ * interval since the previous boundary goes to exactly one bucket, decided
+ * by what the CPU was doing during it (user, kernel or interrupt), minus
+ * any steal time reported by the hypervisor. Run delay is the time from
+ * being queued as runnable until the next switch-in.
+ */
+
+#include "cputime.h"
+#include "scheduler.h"
+#include "../include/kernel.h"
+#include "../include/rcu.h"
+#include "../include/syscall.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/clocksource.h"
+
+// KVM Paravirtual Steal Clock
+#define KVM_CPUID_SIGNATURE     0x40000000
+#define KVM_CPUID_FEATURES      0x40000001
+#define KVM_FEATURE_STEAL_TIME  5
+#define MSR_KVM_STEAL_TIME      0x4b564d03
+#define KVM_MSR_ENABLED         1
+
+// Shared with the hypervisor; updated under an odd/even version counter
+struct kvm_steal_time {
+    uint64_t steal;             // Total nanoseconds stolen from this vCPU
+    uint32_t version;           // Odd while the hypervisor updates the record
+    uint32_t flags;
+    uint8_t  preempted;
+    uint8_t  pad[47];
+} __attribute__((aligned(64)));
+
+// Per-CPU Accounting State
+struct cputime_cpu {
+    uint64_t checkpoint;        // TSC of the last accounting boundary
+    uint64_t steal_seen;        // Steal clock (ns) already charged
+    uint32_t idle_irq_depth;    // IRQ nesting while no thread runs
+    struct cputime idle;        // Time charged with no thread running
+    struct cputime total;       // Everything charged on this CPU
+};
+
+static struct cputime_cpu cpu_acct[MAX_CPUS];
+static struct kvm_steal_time steal_time[MAX_CPUS];
+static bool steal_enabled = false;
+
+// Forward declarations
+static void cputime_steal_init(uint32_t cpu);
+static uint64_t steal_clock_read(uint32_t cpu);
+static uint64_t cputime_tsc_khz(void);
+static void cputime_charge(uint32_t cpu, struct thread *thread, enum cputime_bucket bucket);
+static void cputime_sync(void);
+static void cputime_to_ns(const struct cputime *ct, struct cputime_ns *out);
+
+/**
+ * @brief Initialize CPU time accounting on the boot CPU
+ */
+void cputime_init(void) {
+    uint32_t cpu = smp_processor_id();
+
+    memset(&cpu_acct[cpu], 0, sizeof(cpu_acct[cpu]));
+
+    cpu_acct[cpu].checkpoint = rdtsc();
+
+    cputime_steal_init(cpu);
+
+    // Cycles are converted on read, so the clock source may calibrate the TSC later
+    KINFO("CPU time accounting initialized (TSC frequency from the clock source, steal clock: %s)",
+          steal_enabled ? "ON" : "OFF");
+}
+
+/**
+ * @brief Account the interval before a hardware interrupt
+ *
+ * @param from_user Whether the interrupt arrived in user mode
+ */
+void cputime_irq_enter(bool from_user) {
+    uint32_t cpu = smp_processor_id();
+    struct thread *thread = get_current_thread();
+    uint32_t *depth = thread ? &thread->cputime.irq_depth : &cpu_acct[cpu].idle_irq_depth;
+
+    enum cputime_bucket bucket = *depth ? CPUTIME_IRQ :
+                                 from_user ? CPUTIME_USER : CPUTIME_SYSTEM;
+    cputime_charge(cpu, thread, bucket);
+    (*depth)++;
+}
+
+/**
+ * @brief Account the interrupt handler interval on return
+ */
+void cputime_irq_exit(void) {
+    uint32_t cpu = smp_processor_id();
+    struct thread *thread = get_current_thread();
+    uint32_t *depth = thread ? &thread->cputime.irq_depth : &cpu_acct[cpu].idle_irq_depth;
+
+    cputime_charge(cpu, thread, CPUTIME_IRQ);
+    if (*depth) {
+        (*depth)--;
+    }
+}
+
+/**
+ * @brief Account a context switch
+ *
+ * Charges the outgoing context up to now and ends the incoming thread's
+ * run delay. prev == next ends the run delay of a thread that was
+ * requeued and picked again without switching.
+ *
+ * @param prev Outgoing thread, NULL for the idle context
+ * @param next Incoming thread, NULL for the idle context
+ */
+void cputime_switch(struct thread *prev, struct thread *next) {
+    uint64_t flags = interrupts_disable();
+    uint32_t cpu = smp_processor_id();
+    uint32_t depth = prev ? prev->cputime.irq_depth : cpu_acct[cpu].idle_irq_depth;
+
+    cputime_charge(cpu, prev, depth ? CPUTIME_IRQ : CPUTIME_SYSTEM);
+
+    if (next) {
+        struct thread_cputime *tc = &next->cputime;
+
+        if (tc->enqueued_at) {
+            uint64_t delay = cpu_acct[cpu].checkpoint - tc->enqueued_at;
+
+            tc->total.run_delay += delay;
+            if (delay > tc->total.max_run_delay) {
+                tc->total.max_run_delay = delay;
+            }
+            if (next->process) {
+                next->process->cputime.run_delay += delay;
+                if (delay > next->process->cputime.max_run_delay) {
+                    next->process->cputime.max_run_delay = delay;
+                }
+            }
+            cpu_acct[cpu].total.run_delay += delay;
+            tc->enqueued_at = 0;
+        }
+
+        tc->total.run_count++;
+        if (next->process) {
+            next->process->cputime.run_count++;
+        }
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Start a thread's run delay when it becomes runnable
+ *
+ * @param thread Thread being queued
+ */
+void cputime_enqueue(struct thread *thread) {
+    if (thread && !thread->cputime.enqueued_at) {
+        thread->cputime.enqueued_at = rdtsc();
+    }
+}
+
+/**
+ * @brief Get the CPU time of a thread
+ *
+ * @param tid Thread ID, 0 for the current thread
+ * @param out Filled with the thread's times in nanoseconds
+ * @return 0 on success, negative error code on failure
+ */
+int thread_get_cputime(uint32_t tid, struct cputime_ns *out) {
+    if (!out) {
+        return KERN_INVALID;
+    }
+
+    cputime_sync();
+
+    rcu_read_lock();
+    struct thread *thread = tid ? get_thread(tid) : get_current_thread();
+    if (!thread) {
+        rcu_read_unlock();
+        return KERN_NOTFOUND;
+    }
+
+    uint64_t flags = interrupts_disable();
+    struct cputime snapshot = thread->cputime.total;
+    interrupts_restore(flags);
+    rcu_read_unlock();
+
+    cputime_to_ns(&snapshot, out);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Get the CPU time of a process, summed over all its threads
+ *
+ * @param pid Process ID, 0 for the current process
+ * @param out Filled with the process's times in nanoseconds
+ * @return 0 on success, negative error code on failure
+ */
+int process_get_cputime(uint32_t pid, struct cputime_ns *out) {
+    if (!out) {
+        return KERN_INVALID;
+    }
+
+    cputime_sync();
+
+    rcu_read_lock();
+    struct process *proc = pid ? get_process(pid) : get_current_process();
+    if (!proc) {
+        rcu_read_unlock();
+        return KERN_NOTFOUND;
+    }
+
+    uint64_t flags = interrupts_disable();
+    struct cputime snapshot = proc->cputime;
+    interrupts_restore(flags);
+    rcu_read_unlock();
+
+    cputime_to_ns(&snapshot, out);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Get the time charged on a CPU, including idle time
+ *
+ * @param cpu CPU number
+ * @param out Filled with the CPU's times in nanoseconds
+ * @return 0 on success, negative error code on failure
+ */
+int cpu_get_cputime(uint32_t cpu, struct cputime_ns *out) {
+    if (!out || cpu >= MAX_CPUS) {
+        return KERN_INVALID;
+    }
+
+    cputime_sync();
+
+    uint64_t flags = interrupts_disable();
+    struct cputime snapshot = cpu_acct[cpu].total;
+    interrupts_restore(flags);
+
+    cputime_to_ns(&snapshot, out);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Convert TSC cycles to nanoseconds
+ *
+ * @param cycles TSC cycles
+ * @return Nanoseconds, 0 while the TSC is not calibrated
+ */
+uint64_t cputime_cycles_to_ns(uint64_t cycles) {
+    uint64_t khz = cputime_tsc_khz();
+    if (!khz) {
+        return 0;
+    }
+
+    // Split to avoid overflowing cycles * 10^6
+    return (cycles / khz) * 1000000ULL + (cycles % khz) * 1000000ULL / khz;
+}
+
+/**
+ * @brief Check whether hypervisor steal time is being accounted
+ *
+ * @return true if the steal clock is registered
+ */
+bool cputime_steal_enabled(void) {
+    return steal_enabled;
+}
+
+/**
+ * @brief Print the CPU time of a process and each of its threads
+ *
+ * @param pid Process ID, 0 for the current process
+ */
+void print_cputime(uint32_t pid) {
+    struct cputime_ns ns;
+
+    if (process_get_cputime(pid, &ns) != KERN_SUCCESS) {
+        KERROR("CPU time: process %u not found", pid);
+        return;
+    }
+
+    printf("CPU time (us)  %10s %10s %10s %10s %12s %10s\n",
+           "user", "system", "irq", "steal", "run-delay", "max-delay");
+    printf("  process      %10lu %10lu %10lu %10lu %12lu %10lu\n",
+           ns.user_ns / 1000, ns.system_ns / 1000, ns.irq_ns / 1000,
+           ns.steal_ns / 1000, ns.run_delay_ns / 1000, ns.max_run_delay_ns / 1000);
+
+    rcu_read_lock();
+    struct process *proc = pid ? get_process(pid) : get_current_process();
+    for (struct thread *thread = proc ? proc->threads : NULL; thread; thread = thread->next) {
+        cputime_to_ns(&thread->cputime.total, &ns);
+        printf("  TID %-8u %10lu %10lu %10lu %10lu %12lu %10lu\n", thread->tid,
+               ns.user_ns / 1000, ns.system_ns / 1000, ns.irq_ns / 1000,
+               ns.steal_ns / 1000, ns.run_delay_ns / 1000, ns.max_run_delay_ns / 1000);
+    }
+    rcu_read_unlock();
+}
+
+/**
+ * @brief SYS_GETRUSAGE handler
+ *
+ * @param who CPUTIME_WHO_THREAD, CPUTIME_WHO_PROCESS or CPUTIME_WHO_CPU
+ * @param id Thread ID, process ID or CPU number; 0 selects the caller
+ * @param uaddr User address of a struct cputime_ns
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_getrusage(uint64_t who, uint64_t id, uint64_t uaddr) {
+    if (!uaddr || (uaddr & 7)) {
+        return KERN_INVALID;
+    }
+
+    struct cputime_ns *out = (struct cputime_ns*)uaddr;
+
+    switch (who) {
+        case CPUTIME_WHO_THREAD:
+            return thread_get_cputime((uint32_t)id, out);
+        case CPUTIME_WHO_PROCESS:
+            return process_get_cputime((uint32_t)id, out);
+        case CPUTIME_WHO_CPU:
+            return cpu_get_cputime((uint32_t)id, out);
+        default:
+            return KERN_INVALID;
+    }
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Register the KVM steal time record for a CPU
+ *
+ * @param cpu CPU number
+ */
+static void cputime_steal_init(uint32_t cpu) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_count(KVM_CPUID_SIGNATURE, 0, &eax, &ebx, &ecx, &edx);
+
+    // "KVMKVMKVM\0\0\0"
+    if (ebx != 0x4b4d564b || ecx != 0x564b4d56 || edx != 0x0000004d ||
+        eax < KVM_CPUID_FEATURES) {
+        return;
+    }
+
+    cpuid_count(KVM_CPUID_FEATURES, 0, &eax, &ebx, &ecx, &edx);
+    if (!(eax & (1U << KVM_FEATURE_STEAL_TIME))) {
+        return;
+    }
+
+    uint64_t phys = vmm_get_physical((uint64_t)&steal_time[cpu]);
+    if (!phys) {
+        return;
+    }
+
+    memset(&steal_time[cpu], 0, sizeof(steal_time[cpu]));
+    wrmsr(MSR_KVM_STEAL_TIME, phys | KVM_MSR_ENABLED);
+    cpu_acct[cpu].steal_seen = steal_clock_read(cpu);
+    steal_enabled = true;
+}
+
+/**
+ * @brief Read the steal clock of a CPU
+ *
+ * @param cpu CPU number
+ * @return Nanoseconds stolen since registration
+ */
+static uint64_t steal_clock_read(uint32_t cpu) {
+    volatile struct kvm_steal_time *st = &steal_time[cpu];
+    uint32_t version;
+    uint64_t steal;
+
+    do {
+        version = __atomic_load_n(&st->version, __ATOMIC_ACQUIRE);
+        steal = st->steal;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((version & 1) || version != st->version);
+
+    return steal;
+}
+
+/**
+ * @brief Get the TSC frequency
+ *
+ * @return TSC frequency in kHz, 0 until the clock source has calibrated it
+ */
+static uint64_t cputime_tsc_khz(void) {
+    return clocksource_tsc_khz();
+}
+
+/**
+ * @brief Charge the interval since the last boundary
+ *
+ * Called with interrupts disabled.
+ *
+ * @param cpu Current CPU
+ * @param thread Thread that ran during the interval, NULL for idle
+ * @param bucket Bucket the interval belongs to
+ */
+static void cputime_charge(uint32_t cpu, struct thread *thread, enum cputime_bucket bucket) {
+    struct cputime_cpu *acct = &cpu_acct[cpu];
+    uint64_t now = rdtsc();
+    uint64_t delta = now - acct->checkpoint;
+    uint64_t steal = 0;
+
+    acct->checkpoint = now;
+
+    // Stolen time is not time this context actually ran
+    if (steal_enabled) {
+        uint64_t clock = steal_clock_read(cpu);
+        uint64_t khz = cputime_tsc_khz();
+
+        steal = khz ? (clock - acct->steal_seen) * khz / 1000000ULL : 0;
+        acct->steal_seen = clock;
+        if (steal > delta) {
+            steal = delta;
+        }
+        delta -= steal;
+    }
+
+    struct cputime *ct = thread ? &thread->cputime.total : &acct->idle;
+    ct->time[bucket] += delta;
+    ct->time[CPUTIME_STEAL] += steal;
+
+    if (thread && thread->process) {
+        thread->process->cputime.time[bucket] += delta;
+        thread->process->cputime.time[CPUTIME_STEAL] += steal;
+    }
+
+    acct->total.time[bucket] += delta;
+    acct->total.time[CPUTIME_STEAL] += steal;
+}
+
+/**
+ * @brief Charge the current context's in-progress interval before a query
+ */
+static void cputime_sync(void) {
+    uint64_t flags = interrupts_disable();
+    uint32_t cpu = smp_processor_id();
+    struct thread *thread = get_current_thread();
+    uint32_t depth = thread ? thread->cputime.irq_depth : cpu_acct[cpu].idle_irq_depth;
+
+    cputime_charge(cpu, thread, depth ? CPUTIME_IRQ : CPUTIME_SYSTEM);
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Convert accumulated cycles to a nanosecond snapshot
+ *
+ * @param ct Accumulated CPU time
+ * @param out Nanosecond snapshot
+ */
+static void cputime_to_ns(const struct cputime *ct, struct cputime_ns *out) {
+    out->user_ns = cputime_cycles_to_ns(ct->time[CPUTIME_USER]);
+    out->system_ns = cputime_cycles_to_ns(ct->time[CPUTIME_SYSTEM]);
+    out->irq_ns = cputime_cycles_to_ns(ct->time[CPUTIME_IRQ]);
+    out->steal_ns = cputime_cycles_to_ns(ct->time[CPUTIME_STEAL]);
+    out->run_delay_ns = cputime_cycles_to_ns(ct->run_delay);
+    out->max_run_delay_ns = cputime_cycles_to_ns(ct->max_run_delay);
+    out->run_count = ct->run_count;
+}
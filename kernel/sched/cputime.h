@@ -0,0 +1,79 @@
+/*
+ * FG-OS CPU Time Accounting Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * TSC-precise per-thread and per-process CPU time accounting.
+ */
+
+#ifndef CPUTIME_H
+#define CPUTIME_H
+
+#include <types.h>
+#include "../arch/x86_64/arch.h"
+
+// CPU Time Buckets
+enum cputime_bucket {
+    CPUTIME_USER = 0,           // Running in user mode
+    CPUTIME_SYSTEM,             // Running in kernel mode
+    CPUTIME_IRQ,                // Servicing hardware interrupts
+    CPUTIME_STEAL,              // Runnable while the hypervisor ran someone else
+    CPUTIME_NR_BUCKETS
+};
+
+// Accumulated CPU Time (TSC cycles)
+struct cputime {
+    uint64_t time[CPUTIME_NR_BUCKETS]; // Cycles per bucket
+    uint64_t run_delay;         // Cycles runnable but waiting for a CPU
+    uint64_t max_run_delay;     // Longest single wait on the ready queue
+    uint64_t run_count;         // Times switched in
+};
+
+// Per-Thread Accounting State
+// The IRQ depth is per thread because a switch can happen inside an IRQ
+// frame; the frame is unwound only when the thread runs again.
+struct thread_cputime {
+    struct cputime total;       // Time charged to this thread
+    uint64_t enqueued_at;       // TSC when made runnable, 0 while not queued
+    uint32_t irq_depth;         // Hardware interrupts nested on this stack
+};
+
+// CPU Time Snapshot (nanoseconds)
+struct cputime_ns {
+    uint64_t user_ns;           // User mode time
+    uint64_t system_ns;         // Kernel mode time
+    uint64_t irq_ns;            // Interrupt time
+    uint64_t steal_ns;          // Hypervisor steal time
+    uint64_t run_delay_ns;      // Total time spent runnable but not running
+    uint64_t max_run_delay_ns;  // Longest single run delay
+    uint64_t run_count;         // Times switched in
+};
+
+// Query Targets (sys_getrusage)
+#define CPUTIME_WHO_THREAD      0   // id is a TID, 0 for the caller
+#define CPUTIME_WHO_PROCESS     1   // id is a PID, 0 for the caller's process
+#define CPUTIME_WHO_CPU         2   // id is a CPU number
+
+struct thread;
+struct process;
+
+// Initialization
+void cputime_init(void);
+
+// Accounting Hooks
+void cputime_irq_enter(bool from_user);
+void cputime_irq_exit(void);
+void cputime_switch(struct thread *prev, struct thread *next);
+void cputime_enqueue(struct thread *thread);
+
+// Queries
+int thread_get_cputime(uint32_t tid, struct cputime_ns *out);
+int process_get_cputime(uint32_t pid, struct cputime_ns *out);
+int cpu_get_cputime(uint32_t cpu, struct cputime_ns *out);
+uint64_t cputime_cycles_to_ns(uint64_t cycles);
+bool cputime_steal_enabled(void);
+void print_cputime(uint32_t pid);
+
+#endif // CPUTIME_H
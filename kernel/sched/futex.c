@@ -0,0 +1,508 @@
+/*
+ * FG-OS Futex Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Futex waiters are kept in a hashed bucket table keyed on the user
+ * address: process-private futexes hash (process, virtual address),
+ * shared futexes hash the physical address so every mapping agrees.
+ * SYS_MUTEX_LOCK/UNLOCK implement the contended half of umutex_t.
+ *
+ * A PI umutex (UMUTEX_ATTR_PI) is backed by a kernel rt_mutex looked up
+ * by its key. On first contention the rt_mutex is marked held by the
+ * thread whose TID is in the word, so blocked lockers boost it; unlock
+ * hands the rt_mutex to the top waiter and writes its TID to the word,
+ * still flagged, so the rt_mutex is released only from the kernel.
+ */
+
+#include "scheduler.h"
+#include "wait.h"
+#include "rtmutex.h"
+#include "../include/kernel.h"
+#include "../include/futex.h"
+#include "../include/syscall.h"
+#include "../include/spinlock.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+
+// Futex Hash Table Geometry
+#define FUTEX_HASH_BITS         8
+#define FUTEX_HASH_SIZE         (1 << FUTEX_HASH_BITS)
+
+// Futex Key
+struct futex_key {
+    void *space;                // Owning process, NULL for shared futexes
+    uint64_t address;           // Virtual (private) or physical (shared) address
+};
+
+// Queued Futex Waiter
+struct futex_q {
+    struct wait_queue_entry wait;   // Entry in the bucket wait queue
+    struct futex_key key;           // Futex being waited on
+};
+
+// PI Mutex State
+struct futex_pi_state {
+    struct futex_key key;           // PI umutex word
+    struct rt_mutex mutex;          // Kernel mutex behind the word
+    spinlock_t lock;                // Serializes word updates with handoff
+    uint32_t refs;                  // Hash table and futex_pi_lookup() users
+    struct futex_pi_state *next;    // Next state in the hash chain
+};
+
+// Futex hash buckets; waiters of different futexes may share a bucket
+static wait_queue_head_t futex_buckets[FUTEX_HASH_SIZE];
+static bool futex_initialized = false;
+
+// PI mutex states, hashed like the buckets
+static struct futex_pi_state *pi_states[FUTEX_HASH_SIZE];
+static spinlock_t pi_states_lock;
+
+// Forward declarations
+static int futex_get_key(uint64_t uaddr, uint32_t flags, struct futex_key *key);
+static uint32_t futex_key_hash(const struct futex_key *key);
+static wait_queue_head_t* futex_hash(const struct futex_key *key);
+static struct futex_pi_state* futex_pi_lookup(uint64_t uaddr);
+static void futex_pi_put(struct futex_pi_state *pi);
+static int futex_lock_pi(struct futex_pi_state *pi, uint64_t uaddr);
+static int futex_unlock_pi(struct futex_pi_state *pi, uint64_t uaddr);
+static int futex_wait(uint64_t uaddr, uint32_t flags, uint32_t val, uint64_t timeout_ms);
+static int futex_wake(uint64_t uaddr, uint32_t flags, uint32_t nr_wake);
+
+/**
+ * @brief Initialize the futex hash table
+ */
+void futex_init(void) {
+    for (uint32_t i = 0; i < FUTEX_HASH_SIZE; i++) {
+        init_waitqueue_head(&futex_buckets[i]);
+        pi_states[i] = NULL;
+    }
+    spin_lock_init(&pi_states_lock);
+    futex_initialized = true;
+}
+
+/**
+ * @brief SYS_FUTEX handler
+ *
+ * @param uaddr User address of the futex word
+ * @param op FUTEX_WAIT or FUTEX_WAKE, optionally with FUTEX_PRIVATE_FLAG
+ * @param val Expected value (WAIT) or number of waiters to wake (WAKE)
+ * @param timeout_ms WAIT timeout in milliseconds, 0 for none
+ * @return 0 or number of woken waiters on success, negative error code on failure
+ */
+int64_t sys_futex(uint64_t uaddr, uint64_t op, uint64_t val, uint64_t timeout_ms) {
+    uint32_t flags = (uint32_t)op & FUTEX_PRIVATE_FLAG;
+
+    switch (op & FUTEX_OP_MASK) {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, flags, (uint32_t)val, timeout_ms);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, flags, (uint32_t)val);
+        default:
+            return KERN_INVALID;
+    }
+}
+
+/**
+ * @brief SYS_MUTEX_INIT handler
+ *
+ * @param uaddr User address of the umutex_t word
+ * @param attr Mutex attributes: 0 or UMUTEX_ATTR_PI
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_mutex_init(uint64_t uaddr, uint64_t attr) {
+    if (!uaddr || (uaddr & 3) || (attr & ~(uint64_t)UMUTEX_ATTR_PI)) {
+        return KERN_INVALID;
+    }
+
+    // A mutex that is already PI keeps its state; only the word is reset
+    struct futex_pi_state *pi = (attr & UMUTEX_ATTR_PI) ? futex_pi_lookup(uaddr) : NULL;
+    if (pi) {
+        futex_pi_put(pi);
+    } else if (attr & UMUTEX_ATTR_PI) {
+        if (!futex_initialized) {
+            return KERN_ERROR;
+        }
+
+        pi = (struct futex_pi_state*)kmalloc(sizeof(struct futex_pi_state));
+        if (!pi) {
+            return KERN_NOMEM;
+        }
+
+        futex_get_key(uaddr, FUTEX_PRIVATE_FLAG, &pi->key);
+        rt_mutex_init(&pi->mutex);
+        spin_lock_init(&pi->lock);
+        pi->refs = 1;
+
+        uint32_t index = futex_key_hash(&pi->key);
+        uint64_t flags = spin_lock_irqsave(&pi_states_lock);
+        pi->next = pi_states[index];
+        pi_states[index] = pi;
+        spin_unlock_irqrestore(&pi_states_lock, flags);
+    }
+
+    __atomic_store_n((volatile uint32_t*)uaddr, UMUTEX_UNLOCKED, __ATOMIC_RELEASE);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_MUTEX_LOCK handler: contended path of umutex_lock()
+ *
+ * @param uaddr User address of the umutex_t word
+ * @return 0 once the mutex is held, negative error code on failure
+ */
+int64_t sys_mutex_lock(uint64_t uaddr) {
+    if (!uaddr || (uaddr & 3)) {
+        return KERN_INVALID;
+    }
+
+    struct futex_pi_state *pi = futex_pi_lookup(uaddr);
+    if (pi) {
+        int result = futex_lock_pi(pi, uaddr);
+        futex_pi_put(pi);
+        return result;
+    }
+
+    volatile uint32_t *word = (volatile uint32_t*)uaddr;
+
+    while (__atomic_exchange_n(word, UMUTEX_CONTENDED, __ATOMIC_ACQUIRE) != UMUTEX_UNLOCKED) {
+        int result = futex_wait(uaddr, FUTEX_PRIVATE_FLAG, UMUTEX_CONTENDED, 0);
+        if (result != KERN_SUCCESS && result != KERN_BUSY) {
+            return result;
+        }
+    }
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_MUTEX_UNLOCK handler: contended path of umutex_unlock()
+ *
+ * @param uaddr User address of the umutex_t word
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_mutex_unlock(uint64_t uaddr) {
+    if (!uaddr || (uaddr & 3)) {
+        return KERN_INVALID;
+    }
+
+    struct futex_pi_state *pi = futex_pi_lookup(uaddr);
+    if (pi) {
+        int result = futex_unlock_pi(pi, uaddr);
+        futex_pi_put(pi);
+        return result;
+    }
+
+    __atomic_store_n((volatile uint32_t*)uaddr, UMUTEX_UNLOCKED, __ATOMIC_RELEASE);
+    futex_wake(uaddr, FUTEX_PRIVATE_FLAG, 1);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_MUTEX_DESTROY handler
+ *
+ * @param uaddr User address of the umutex_t word
+ * @return 0 on success, KERN_BUSY if the mutex is held or has waiters
+ */
+int64_t sys_mutex_destroy(uint64_t uaddr) {
+    if (!uaddr || (uaddr & 3)) {
+        return KERN_INVALID;
+    }
+
+    if (__atomic_load_n((volatile uint32_t*)uaddr, __ATOMIC_ACQUIRE) != UMUTEX_UNLOCKED) {
+        return KERN_BUSY;
+    }
+
+    // Drop the kernel state of a PI mutex
+    struct futex_key key;
+    if (futex_initialized && futex_get_key(uaddr, FUTEX_PRIVATE_FLAG, &key) == KERN_SUCCESS) {
+        uint64_t flags = spin_lock_irqsave(&pi_states_lock);
+        struct futex_pi_state **link = &pi_states[futex_key_hash(&key)];
+        while (*link && ((*link)->key.space != key.space || (*link)->key.address != key.address)) {
+            link = &(*link)->next;
+        }
+
+        // Threads inside lock or unlock hold a reference, blocked ones included
+        struct futex_pi_state *pi = *link;
+        if (pi) {
+            spin_lock(&pi->lock);
+            bool busy = pi->refs > 1 || rt_mutex_owner(&pi->mutex) || rt_mutex_has_waiters(&pi->mutex);
+            spin_unlock(&pi->lock);
+
+            if (busy) {
+                spin_unlock_irqrestore(&pi_states_lock, flags);
+                return KERN_BUSY;
+            }
+            *link = pi->next;
+        }
+        spin_unlock_irqrestore(&pi_states_lock, flags);
+
+        if (pi) {
+            futex_pi_put(pi);
+        }
+    }
+
+    return KERN_SUCCESS;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Build the hash key of a futex word
+ *
+ * @return 0 on success, KERN_INVALID for bad or unmapped addresses
+ */
+static int futex_get_key(uint64_t uaddr, uint32_t flags, struct futex_key *key) {
+    if (!uaddr || (uaddr & 3)) {
+        return KERN_INVALID;
+    }
+
+    if (flags & FUTEX_PRIVATE_FLAG) {
+        key->space = get_current_process();
+        key->address = uaddr;
+    } else {
+        key->space = NULL;
+        key->address = vmm_get_physical(uaddr);
+        if (!key->address) {
+            return KERN_INVALID;
+        }
+    }
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Hash a futex key to a table index
+ */
+static uint32_t futex_key_hash(const struct futex_key *key) {
+    uint64_t hash = (key->address >> 2) ^ ((uint64_t)key->space >> 4);
+    hash *= 0x9E3779B97F4A7C15ULL;  // Fibonacci hashing
+    return (uint32_t)(hash >> (64 - FUTEX_HASH_BITS));
+}
+
+/**
+ * @brief Map a futex key to its hash bucket
+ */
+static wait_queue_head_t* futex_hash(const struct futex_key *key) {
+    return &futex_buckets[futex_key_hash(key)];
+}
+
+/**
+ * @brief Find the PI state of a umutex word
+ *
+ * Takes a reference; drop it with futex_pi_put().
+ *
+ * @return PI state, NULL if the mutex was not created with UMUTEX_ATTR_PI
+ */
+static struct futex_pi_state* futex_pi_lookup(uint64_t uaddr) {
+    struct futex_key key;
+
+    if (!futex_initialized || futex_get_key(uaddr, FUTEX_PRIVATE_FLAG, &key) != KERN_SUCCESS) {
+        return NULL;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&pi_states_lock);
+    struct futex_pi_state *pi = pi_states[futex_key_hash(&key)];
+    while (pi && (pi->key.space != key.space || pi->key.address != key.address)) {
+        pi = pi->next;
+    }
+    if (pi) {
+        pi->refs++;
+    }
+    spin_unlock_irqrestore(&pi_states_lock, flags);
+
+    return pi;
+}
+
+/**
+ * @brief Drop a PI state reference; the last one frees the state
+ */
+static void futex_pi_put(struct futex_pi_state *pi) {
+    uint64_t flags = spin_lock_irqsave(&pi_states_lock);
+    bool last = --pi->refs == 0;
+    spin_unlock_irqrestore(&pi_states_lock, flags);
+
+    if (last) {
+        kfree(pi);
+    }
+}
+
+/**
+ * @brief Contended lock of a PI umutex
+ *
+ * @return 0 once held, KERN_DEADLK on a lock cycle, other negative codes on failure
+ */
+static int futex_lock_pi(struct futex_pi_state *pi, uint64_t uaddr) {
+    struct thread *self = get_current_thread();
+    if (!self) {
+        return KERN_BUSY;
+    }
+
+    volatile uint32_t *word = (volatile uint32_t*)uaddr;
+    uint32_t tid = self->tid & UMUTEX_PI_TID_MASK;
+    uint32_t owner_tid;
+    uint64_t flags = spin_lock_irqsave(&pi->lock);
+
+    // Take a free word, or flag waiters so the owner's unlock enters the kernel
+    for (;;) {
+        uint32_t val = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+        owner_tid = val & UMUTEX_PI_TID_MASK;
+
+        if (!owner_tid) {
+            if (__atomic_compare_exchange_n(word, &val, tid, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                spin_unlock_irqrestore(&pi->lock, flags);
+                return KERN_SUCCESS;
+            }
+            continue;
+        }
+
+        if (owner_tid == tid) {
+            spin_unlock_irqrestore(&pi->lock, flags);
+            return KERN_DEADLK;
+        }
+
+        if (__atomic_compare_exchange_n(word, &val, val | UMUTEX_PI_WAITERS, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    // First contention: the word's owner becomes the rt_mutex owner
+    if (!rt_mutex_owner(&pi->mutex)) {
+        struct thread *owner = get_thread(owner_tid);
+        if (!owner) {
+            spin_unlock_irqrestore(&pi->lock, flags);
+            return KERN_NOTFOUND;
+        }
+        rt_mutex_init_proxy_locked(&pi->mutex, owner);
+    }
+
+    // The unlocker writes our TID to the word when it hands the lock over
+    int result = rt_mutex_lock_release(&pi->mutex, &pi->lock);
+    interrupts_restore(flags);
+    return result;
+}
+
+/**
+ * @brief Contended unlock of a PI umutex
+ *
+ * @return 0 on success, KERN_PERM if the caller does not own the word
+ */
+static int futex_unlock_pi(struct futex_pi_state *pi, uint64_t uaddr) {
+    struct thread *self = get_current_thread();
+    if (!self) {
+        return KERN_BUSY;
+    }
+
+    volatile uint32_t *word = (volatile uint32_t*)uaddr;
+    uint32_t tid = self->tid & UMUTEX_PI_TID_MASK;
+    struct thread *next = NULL;
+    uint64_t flags = spin_lock_irqsave(&pi->lock);
+
+    if ((__atomic_load_n(word, __ATOMIC_ACQUIRE) & UMUTEX_PI_TID_MASK) != tid) {
+        spin_unlock_irqrestore(&pi->lock, flags);
+        return KERN_PERM;
+    }
+
+    // While the rt_mutex has an owner the word keeps UMUTEX_PI_WAITERS, so
+    // that owner's unlock comes back here instead of releasing the word
+    // in user space and leaving the rt_mutex with a stale owner
+    uint32_t new_word = 0;
+    if (rt_mutex_owner(&pi->mutex) == self) {
+        next = rt_mutex_unlock_handoff(&pi->mutex);
+        if (next) {
+            new_word = (next->tid & UMUTEX_PI_TID_MASK) | UMUTEX_PI_WAITERS;
+        }
+    }
+    __atomic_store_n(word, new_word, __ATOMIC_RELEASE);
+
+    spin_unlock_irqrestore(&pi->lock, flags);
+
+    // Run a higher priority new owner now that our boost is gone
+    if (next && next->prio < self->prio) {
+        yield();
+    }
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Sleep on a futex if it still holds the expected value
+ *
+ * @return 0 when woken, KERN_BUSY if the value changed, KERN_TIMEOUT on timeout
+ */
+static int futex_wait(uint64_t uaddr, uint32_t flags, uint32_t val, uint64_t timeout_ms) {
+    struct futex_q q;
+
+    if (!futex_initialized) {
+        return KERN_ERROR;
+    }
+
+    int result = futex_get_key(uaddr, flags, &q.key);
+    if (result != KERN_SUCCESS) {
+        return result;
+    }
+
+    wait_queue_head_t *bucket = futex_hash(&q.key);
+    init_waitqueue_entry(&q.wait, get_current_thread(), WQ_FLAG_EXCLUSIVE);
+
+    // Compare and queue atomically with respect to futex_wake()
+    uint64_t irq_flags = interrupts_disable();
+
+    if (__atomic_load_n((volatile uint32_t*)uaddr, __ATOMIC_ACQUIRE) != val) {
+        interrupts_restore(irq_flags);
+        return KERN_BUSY;
+    }
+
+    add_wait_queue(bucket, &q.wait);
+    result = wait_entry_sleep(&q.wait, timeout_ms);
+
+    interrupts_restore(irq_flags);
+    return result;
+}
+
+/**
+ * @brief Wake waiters of a futex
+ *
+ * @return Number of waiters woken, or negative error code
+ */
+static int futex_wake(uint64_t uaddr, uint32_t flags, uint32_t nr_wake) {
+    struct futex_key key;
+    struct wait_queue_entry *wait, *next;
+    int woken = 0;
+
+    if (!futex_initialized) {
+        return KERN_ERROR;
+    }
+
+    if (nr_wake == 0) {
+        return 0;
+    }
+
+    int result = futex_get_key(uaddr, flags, &key);
+    if (result != KERN_SUCCESS) {
+        return result;
+    }
+
+    wait_queue_head_t *bucket = futex_hash(&key);
+    uint64_t irq_flags = interrupts_disable();
+
+    list_for_each_entry_safe(wait, next, &bucket->head, entry) {
+        struct futex_q *q = container_of(wait, struct futex_q, wait);
+
+        if (q->key.space != key.space || q->key.address != key.address) {
+            continue;
+        }
+
+        wake_up_entry(wait);
+        if (++woken >= (int)nr_wake) {
+            break;
+        }
+    }
+
+    interrupts_restore(irq_flags);
+    return woken;
+}
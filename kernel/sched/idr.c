@@ -0,0 +1,239 @@
+/*
+ * FG-OS ID Allocator Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Fixed-depth radix tree giving O(1) ID lookup and lowest-free-ID
+ * allocation with cyclic recycling, so freed PIDs and TIDs are reused
+ * only after the ID space wraps.
+ */
+
+#include "idr.h"
+#include "../include/kernel.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+
+#define IDR_FULL_MASK   (~0ULL)
+
+// Forward declarations
+static struct idr_layer* idr_layer_alloc(void);
+static int idr_find_free(struct idr_layer *layer, uint32_t level, uint32_t prefix, uint32_t start);
+
+/**
+ * @brief Initialize an ID allocator
+ *
+ * @param idr Allocator to initialize
+ * @param min_id Lowest ID to hand out
+ * @return 0 on success, negative error code on failure
+ */
+int idr_init(struct idr *idr, uint32_t min_id) {
+    if (!idr || min_id > IDR_MAX_ID) {
+        return KERN_INVALID;
+    }
+
+    idr->top = idr_layer_alloc();
+    if (!idr->top) {
+        return KERN_NOMEM;
+    }
+
+    idr->min_id = min_id;
+    idr->next_id = min_id;
+    idr->count = 0;
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Allocate the next free ID at or after the cursor and bind it to ptr
+ *
+ * @param idr Allocator
+ * @param ptr Object to store (must not be NULL)
+ * @param id Receives the allocated ID
+ * @return 0 on success, negative error code on failure
+ */
+int idr_alloc_cyclic(struct idr *idr, void *ptr, uint32_t *id) {
+    if (!idr || !idr->top || !ptr || !id) {
+        return KERN_INVALID;
+    }
+
+    uint64_t flags = interrupts_disable();
+
+    int result = idr_find_free(idr->top, IDR_LEVELS - 1, 0, idr->next_id);
+    if (result == KERN_NOTFOUND && idr->next_id > idr->min_id) {
+        // Wrap around and recycle IDs freed since the last pass
+        result = idr_find_free(idr->top, IDR_LEVELS - 1, 0, idr->min_id);
+    }
+
+    if (result < 0) {
+        interrupts_restore(flags);
+        return result;
+    }
+
+    uint32_t new_id = (uint32_t)result;
+    struct idr_layer *path[IDR_LEVELS];
+    struct idr_layer *layer = idr->top;
+
+    for (int level = IDR_LEVELS - 1; level > 0; level--) {
+        path[level] = layer;
+        layer = layer->slots[(new_id >> (level * IDR_BITS)) & IDR_MASK];
+    }
+    path[0] = layer;
+
+    // Publish the object, then propagate "full" bits towards the root
+    uint32_t index = new_id & IDR_MASK;
+    __atomic_store_n(&layer->slots[index], ptr, __ATOMIC_RELEASE);
+    layer->full |= (1ULL << index);
+
+    for (int level = 1; level < IDR_LEVELS && path[level - 1]->full == IDR_FULL_MASK; level++) {
+        path[level]->full |= (1ULL << ((new_id >> (level * IDR_BITS)) & IDR_MASK));
+    }
+
+    idr->count++;
+    idr->next_id = (new_id >= IDR_MAX_ID) ? idr->min_id : new_id + 1;
+
+    interrupts_restore(flags);
+
+    *id = new_id;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Look up the object bound to an ID
+ *
+ * Lock-free; safe against concurrent allocation and removal.
+ *
+ * @param idr Allocator
+ * @param id ID to look up
+ * @return Object pointer, NULL if the ID is not allocated
+ */
+void* idr_find(const struct idr *idr, uint32_t id) {
+    if (!idr || id > IDR_MAX_ID) {
+        return NULL;
+    }
+
+    struct idr_layer *layer = idr->top;
+    for (int level = IDR_LEVELS - 1; layer && level > 0; level--) {
+        layer = __atomic_load_n(&layer->slots[(id >> (level * IDR_BITS)) & IDR_MASK],
+                                __ATOMIC_ACQUIRE);
+    }
+
+    if (!layer) {
+        return NULL;
+    }
+
+    return __atomic_load_n(&layer->slots[id & IDR_MASK], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Release an ID
+ *
+ * Layers stay allocated so lock-free readers never touch freed memory.
+ *
+ * @param idr Allocator
+ * @param id ID to release
+ * @return Object that was bound to the ID, NULL if it was not allocated
+ */
+void* idr_remove(struct idr *idr, uint32_t id) {
+    if (!idr || id > IDR_MAX_ID) {
+        return NULL;
+    }
+
+    uint64_t flags = interrupts_disable();
+
+    struct idr_layer *path[IDR_LEVELS];
+    struct idr_layer *layer = idr->top;
+
+    for (int level = IDR_LEVELS - 1; layer && level > 0; level--) {
+        path[level] = layer;
+        layer = layer->slots[(id >> (level * IDR_BITS)) & IDR_MASK];
+    }
+
+    void *ptr = layer ? layer->slots[id & IDR_MASK] : NULL;
+    if (!ptr) {
+        interrupts_restore(flags);
+        return NULL;
+    }
+
+    __atomic_store_n(&layer->slots[id & IDR_MASK], NULL, __ATOMIC_RELEASE);
+    layer->full &= ~(1ULL << (id & IDR_MASK));
+
+    // Every ancestor now has at least one free ID below it
+    for (int level = 1; level < IDR_LEVELS; level++) {
+        path[level]->full &= ~(1ULL << ((id >> (level * IDR_BITS)) & IDR_MASK));
+    }
+
+    idr->count--;
+
+    interrupts_restore(flags);
+    return ptr;
+}
+
+/**
+ * @brief Get the number of allocated IDs
+ *
+ * @param idr Allocator
+ * @return Number of allocated IDs
+ */
+uint32_t idr_count(const struct idr *idr) {
+    return idr ? idr->count : 0;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Allocate a zeroed radix tree layer
+ *
+ * @return New layer, NULL on allocation failure
+ */
+static struct idr_layer* idr_layer_alloc(void) {
+    struct idr_layer *layer = (struct idr_layer*)kmalloc(sizeof(struct idr_layer));
+    if (layer) {
+        memset(layer, 0, sizeof(struct idr_layer));
+    }
+    return layer;
+}
+
+/**
+ * @brief Find the lowest free ID at or above start below a layer
+ *
+ * Missing child layers are allocated on the way down.
+ *
+ * @param layer Layer to search
+ * @param level Level of the layer (0 = leaf)
+ * @param prefix ID bits above this layer
+ * @param start Lowest acceptable ID
+ * @return Free ID, or negative error code
+ */
+static int idr_find_free(struct idr_layer *layer, uint32_t level, uint32_t prefix, uint32_t start) {
+    uint32_t shift = level * IDR_BITS;
+    uint32_t first = (start >> shift) & IDR_MASK;
+
+    for (uint32_t index = first; index < IDR_SLOTS; index++) {
+        if (layer->full & (1ULL << index)) {
+            continue;
+        }
+
+        uint32_t base = prefix | (index << shift);
+        if (level == 0) {
+            return (int)base;
+        }
+
+        struct idr_layer *child = layer->slots[index];
+        if (!child) {
+            child = idr_layer_alloc();
+            if (!child) {
+                return KERN_NOMEM;
+            }
+            __atomic_store_n(&layer->slots[index], child, __ATOMIC_RELEASE);
+        }
+
+        int id = idr_find_free(child, level - 1, base, (index == first) ? start : base);
+        if (id != KERN_NOTFOUND) {
+            return id;
+        }
+    }
+
+    return KERN_NOTFOUND;
+}
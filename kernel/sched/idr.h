@@ -0,0 +1,47 @@
+/*
+ * FG-OS ID Allocator Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Radix tree mapping small integer IDs (PIDs, TIDs) to objects.
+ */
+
+#ifndef IDR_H
+#define IDR_H
+
+#include <types.h>
+
+// Radix Tree Geometry
+#define IDR_BITS                6
+#define IDR_SLOTS               (1 << IDR_BITS)
+#define IDR_MASK                (IDR_SLOTS - 1)
+#define IDR_LEVELS              3
+#define IDR_MAX_ID              ((1U << (IDR_BITS * IDR_LEVELS)) - 1)  // 262143
+
+// Radix Tree Node
+struct idr_layer {
+    void *slots[IDR_SLOTS];     // Child layers, or objects at the leaf level
+    uint64_t full;              // Bit set when the slot has no free ID left
+};
+
+// ID Allocator
+// Lookups are lock-free: writers publish slots with release stores and
+// readers use acquire loads. Layers are never freed while the IDR is live,
+// so a reader racing with idr_remove() sees either the object or NULL.
+struct idr {
+    struct idr_layer *top;      // Root layer
+    uint32_t min_id;            // Lowest ID handed out
+    uint32_t next_id;           // Cyclic allocation cursor
+    uint32_t count;             // Number of allocated IDs
+};
+
+// ID Allocator Interface
+int idr_init(struct idr *idr, uint32_t min_id);
+int idr_alloc_cyclic(struct idr *idr, void *ptr, uint32_t *id);
+void* idr_find(const struct idr *idr, uint32_t id);
+void* idr_remove(struct idr *idr, uint32_t id);
+uint32_t idr_count(const struct idr *idr);
+
+#endif // IDR_H
@@ -0,0 +1,166 @@
+/*
+ * FG-OS Kernel Mutex Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * The lock word follows the three-state futex protocol: an uncontended
+ * lock and unlock is a single atomic operation. A contended locker spins
+ * while the owner is running on a CPU, since the owner is likely to
+ * release soon, and otherwise marks the lock contended and sleeps.
+ */
+
+#include "mutex.h"
+#include "wait.h"
+#include "scheduler.h"
+#include "../include/kernel.h"
+#include "../interrupt/idt.h"
+
+// Mutex statistics
+static struct mutex_stats stats = {0};
+
+// Forward declarations
+static bool mutex_spin_on_owner(mutex_t *mutex);
+static void mutex_lock_slowpath(mutex_t *mutex);
+
+/**
+ * @brief Initialize a mutex
+ *
+ * @param mutex Mutex to initialize
+ */
+void mutex_init(mutex_t *mutex) {
+    mutex->lock = MUTEX_UNLOCKED;
+    mutex->owner = NULL;
+    init_waitqueue_head(&mutex->waiters);
+}
+
+/**
+ * @brief Acquire a mutex, sleeping if necessary
+ *
+ * @param mutex Mutex to lock
+ */
+void mutex_lock(mutex_t *mutex) {
+    uint32_t expected = MUTEX_UNLOCKED;
+
+    if (__atomic_compare_exchange_n(&mutex->lock, &expected, MUTEX_LOCKED, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        stats.fast_acquires++;
+    } else {
+        mutex_lock_slowpath(mutex);
+    }
+
+    mutex->owner = get_current_thread();
+}
+
+/**
+ * @brief Try to acquire a mutex without blocking
+ *
+ * @param mutex Mutex to lock
+ * @return true if acquired
+ */
+bool mutex_trylock(mutex_t *mutex) {
+    uint32_t expected = MUTEX_UNLOCKED;
+
+    if (!__atomic_compare_exchange_n(&mutex->lock, &expected, MUTEX_LOCKED, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    mutex->owner = get_current_thread();
+    stats.fast_acquires++;
+    return true;
+}
+
+/**
+ * @brief Release a mutex and wake one waiter if contended
+ *
+ * @param mutex Mutex to unlock
+ */
+void mutex_unlock(mutex_t *mutex) {
+    mutex->owner = NULL;
+
+    if (__atomic_exchange_n(&mutex->lock, MUTEX_UNLOCKED, __ATOMIC_RELEASE) == MUTEX_CONTENDED) {
+        if (wake_up(&mutex->waiters)) {
+            stats.wakeups++;
+        }
+    }
+}
+
+/**
+ * @brief Check whether a mutex is held
+ *
+ * @param mutex Mutex to check
+ * @return true if locked
+ */
+bool mutex_is_locked(const mutex_t *mutex) {
+    return __atomic_load_n(&mutex->lock, __ATOMIC_RELAXED) != MUTEX_UNLOCKED;
+}
+
+/**
+ * @brief Get mutex statistics
+ *
+ * @return Pointer to mutex statistics
+ */
+const struct mutex_stats* mutex_get_stats(void) {
+    return &stats;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Spin while the owner is running, trying to take the lock
+ *
+ * @param mutex Mutex to acquire
+ * @return true if the lock was acquired
+ */
+static bool mutex_spin_on_owner(mutex_t *mutex) {
+    for (uint32_t spins = 0; spins < MUTEX_SPIN_LIMIT; spins++) {
+        struct thread *owner = __atomic_load_n(&mutex->owner, __ATOMIC_RELAXED);
+
+        // A preempted or blocked owner will not release soon
+        if (owner && owner->state != THREAD_STATE_RUNNING) {
+            return false;
+        }
+
+        uint32_t expected = MUTEX_UNLOCKED;
+        if (__atomic_compare_exchange_n(&mutex->lock, &expected, MUTEX_LOCKED, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return true;
+        }
+
+        __asm__ __volatile__("pause");
+    }
+
+    return false;
+}
+
+/**
+ * @brief Contended acquisition: spin adaptively, then sleep
+ *
+ * @param mutex Mutex to acquire
+ */
+static void mutex_lock_slowpath(mutex_t *mutex) {
+    struct thread *self = get_current_thread();
+
+    // The owner can only be running elsewhere if it is not this thread
+    if (mutex->owner != self && mutex_spin_on_owner(mutex)) {
+        stats.spin_acquires++;
+        return;
+    }
+
+    // Mark the lock contended; acquiring it this way keeps the contended
+    // state so the eventual unlock wakes the next waiter
+    uint64_t flags = interrupts_disable();
+    while (__atomic_exchange_n(&mutex->lock, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+        if (wait_queue_sleep(&mutex->waiters, true, WAIT_FOREVER) == KERN_BUSY) {
+            // No thread context to block (early boot): wait for the holder
+            interrupts_restore(flags);
+            __asm__ __volatile__("pause");
+            flags = interrupts_disable();
+        }
+    }
+    interrupts_restore(flags);
+
+    stats.sleep_acquires++;
+}
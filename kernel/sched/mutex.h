@@ -0,0 +1,44 @@
+/*
+ * FG-OS Kernel Mutex Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Adaptive sleeping mutexes built on mutex_t and wait queues.
+ */
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <types.h>
+#include "wait.h"
+
+// Mutex Lock Word States
+#define MUTEX_UNLOCKED          0   // Free
+#define MUTEX_LOCKED            1   // Held, no waiters
+#define MUTEX_CONTENDED         2   // Held, waiters may be sleeping
+
+// Adaptive Spinning
+#define MUTEX_SPIN_LIMIT        1000    // Spin iterations while the owner runs
+
+// Static initializer for a mutex
+#define MUTEX_INIT(name) { MUTEX_UNLOCKED, NULL, WAIT_QUEUE_HEAD_INIT((name).waiters) }
+
+// Mutex Statistics
+struct mutex_stats {
+    uint64_t fast_acquires;     // Uncontended acquisitions
+    uint64_t spin_acquires;     // Acquired while spinning on a running owner
+    uint64_t sleep_acquires;    // Acquired after sleeping
+    uint64_t wakeups;           // Waiters woken by unlock
+};
+
+// Mutex Interface
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+bool mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+bool mutex_is_locked(const mutex_t *mutex);
+const struct mutex_stats* mutex_get_stats(void);
+
+#endif // MUTEX_H
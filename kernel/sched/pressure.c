@@ -0,0 +1,545 @@
+/*
+ * FG-OS Load and Pressure Metrics
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * The scheduler reports every task state change here. System-wide task
+ * counts decide, at each change, which resources are under pressure, and
+ * the time spent in each pressure state is accumulated in TSC cycles.
+ * A tick on any CPU turns the totals into 10/60/300 second averages every
+ * two seconds and samples the load average every five, replaying the
+ * periods a tickless stretch skipped.
+ *
+ * Pressure follows the usual definitions: "some" is time in which at
+ * least one task was stalled on the resource, "full" time in which no
+ * runnable task made progress. CPU full is not defined system-wide and
+ * stays zero.
+ */
+
+#include "pressure.h"
+#include "scheduler.h"
+#include "cputime.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/syscall.h"
+#include "../fs/procfs.h"
+
+// Fixed-point exponential averages
+#define FSHIFT                  11
+#define FIXED_1                 (1ULL << FSHIFT)
+#define EXP_1                   1884    // 1/exp(5s/1min)
+#define EXP_5                   2014    // 1/exp(5s/5min)
+#define EXP_15                  2037    // 1/exp(5s/15min)
+#define EXP_10S                 1677    // 1/exp(2s/10s)
+#define EXP_60S                 1981    // 1/exp(2s/60s)
+#define EXP_300S                2034    // 1/exp(2s/300s)
+
+// Periods replayed after a tickless stretch; older history has decayed away
+#define MAX_CATCHUP_PERIODS     150
+
+// Task counts
+enum {
+    NR_RUNNING = 0,
+    NR_ONCPU,
+    NR_SLEEPING,
+    NR_IOWAIT,
+    NR_MEMSTALL,
+    NR_MEMSTALL_RUNNING,        // Runnable tasks inside a memory stall section
+    NR_PSI_COUNTS
+};
+
+static spinlock_t psi_lock;                         // Protects counts and stall times
+static uint32_t task_counts[NR_PSI_COUNTS];
+static uint64_t state_start;                        // TSC of the last state change
+static uint64_t stall_cycles[PSI_NR_RESOURCES][2];  // Some and full time per resource
+
+// Averages, updated by one CPU at a time
+static uint64_t psi_avg[PSI_NR_RESOURCES][2][3];    // Percent in fixed point
+static uint64_t psi_prev_ns[PSI_NR_RESOURCES][2];
+static uint64_t load_avg[3];                        // Tasks in fixed point
+static uint32_t cpu_util[MAX_CPUS];                 // Hundredths of a percent
+static uint64_t cpu_prev_busy_ns[MAX_CPUS];
+static uint64_t psi_last_update;
+static uint64_t load_last_update;
+static volatile uint32_t averages_busy;
+
+static const uint64_t psi_exp[3] = { EXP_10S, EXP_60S, EXP_300S };
+static const uint64_t load_exp[3] = { EXP_1, EXP_5, EXP_15 };
+static const char *const psi_names[PSI_NR_RESOURCES] = { "cpu", "memory", "io" };
+
+// Forward declarations
+static void psi_task_change(struct thread *thread, uint32_t clear, uint32_t set);
+static void psi_account_counts(uint32_t flags, uint32_t delta);
+static void psi_record_time(uint64_t now);
+static void update_pressure_averages(uint64_t now);
+static void update_load_average(uint64_t now);
+static uint64_t calc_load_n(uint64_t load, uint64_t exp, uint64_t active, uint64_t periods);
+static uint32_t fixed_to_hundredths(uint64_t value);
+static void proc_show_loadavg(proc_buffer_t *buffer);
+static void proc_show_cpuutil(proc_buffer_t *buffer);
+static void proc_show_pressure(proc_buffer_t *buffer, enum psi_resource res);
+static void proc_show_pressure_cpu(proc_buffer_t *buffer);
+static void proc_show_pressure_memory(proc_buffer_t *buffer);
+static void proc_show_pressure_io(proc_buffer_t *buffer);
+
+/**
+ * @brief Reset all metrics and register the /proc files
+ */
+void pressure_init(void) {
+    spin_lock_init(&psi_lock);
+    memset(task_counts, 0, sizeof(task_counts));
+    memset(stall_cycles, 0, sizeof(stall_cycles));
+    memset(psi_avg, 0, sizeof(psi_avg));
+    memset(psi_prev_ns, 0, sizeof(psi_prev_ns));
+    memset(load_avg, 0, sizeof(load_avg));
+    memset(cpu_util, 0, sizeof(cpu_util));
+    memset(cpu_prev_busy_ns, 0, sizeof(cpu_prev_busy_ns));
+
+    state_start = rdtsc();
+    psi_last_update = get_system_time();
+    load_last_update = psi_last_update;
+    averages_busy = 0;
+
+    proc_create("loadavg", proc_show_loadavg);
+    proc_create("cpuutil", proc_show_cpuutil);
+    proc_create("pressure/cpu", proc_show_pressure_cpu);
+    proc_create("pressure/memory", proc_show_pressure_memory);
+    proc_create("pressure/io", proc_show_pressure_io);
+}
+
+/**
+ * @brief A thread became runnable
+ *
+ * @param thread Thread placed on the ready queue
+ */
+void psi_enqueue(struct thread *thread) {
+    psi_task_change(thread, PSI_TSK_SLEEPING | PSI_TSK_IOWAIT, PSI_TSK_RUNNING);
+}
+
+/**
+ * @brief A terminated thread left the scheduler for good
+ *
+ * @param thread Thread being removed
+ */
+void psi_dequeue(struct thread *thread) {
+    psi_task_change(thread, thread->psi_flags, 0);
+}
+
+/**
+ * @brief Account a CPU handing over from prev to next
+ *
+ * Called after prev was requeued if it is still runnable.
+ *
+ * @param prev Thread leaving the CPU, NULL from idle
+ * @param next Thread taking the CPU, NULL to idle
+ */
+void psi_sched_switch(struct thread *prev, struct thread *next) {
+    if (prev) {
+        uint32_t clear = PSI_TSK_ONCPU;
+        uint32_t set = 0;
+
+        if (prev->state != THREAD_STATE_READY && prev->state != THREAD_STATE_RUNNING) {
+            clear |= PSI_TSK_RUNNING;
+            if (prev->state == THREAD_STATE_BLOCKED || prev->state == THREAD_STATE_SLEEPING) {
+                set |= PSI_TSK_SLEEPING;
+                if (prev->in_iowait) {
+                    set |= PSI_TSK_IOWAIT;
+                }
+            }
+        }
+        psi_task_change(prev, clear, set);
+    }
+
+    if (next) {
+        psi_task_change(next, 0, PSI_TSK_ONCPU);
+    }
+}
+
+/**
+ * @brief Periodic averaging, called from the scheduler tick of every CPU
+ */
+void pressure_tick(void) {
+    uint64_t now = get_system_time();
+    if (now < psi_last_update + PSI_FREQ_MS && now < load_last_update + LOAD_FREQ_MS) {
+        return;
+    }
+
+    // One CPU updates the averages; the others skip this tick
+    if (__atomic_exchange_n(&averages_busy, 1, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    if (now >= psi_last_update + PSI_FREQ_MS) {
+        update_pressure_averages(now);
+    }
+    if (now >= load_last_update + LOAD_FREQ_MS) {
+        update_load_average(now);
+    }
+
+    __atomic_store_n(&averages_busy, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Mark the current thread's next block as waiting for I/O
+ *
+ * @return Previous I/O wait marking, for io_schedule_finish()
+ */
+bool io_schedule_prepare(void) {
+    struct thread *current = get_current_thread();
+    if (!current) {
+        return false;
+    }
+
+    bool old = current->in_iowait;
+    current->in_iowait = true;
+    return old;
+}
+
+/**
+ * @brief End an I/O wait started with io_schedule_prepare()
+ *
+ * @param old_iowait Value returned by io_schedule_prepare()
+ */
+void io_schedule_finish(bool old_iowait) {
+    struct thread *current = get_current_thread();
+    if (current) {
+        current->in_iowait = old_iowait;
+    }
+}
+
+/**
+ * @brief Enter a section in which the current thread waits for memory
+ */
+void psi_memstall_enter(void) {
+    struct thread *current = get_current_thread();
+    if (current) {
+        psi_task_change(current, 0, PSI_TSK_MEMSTALL);
+    }
+}
+
+/**
+ * @brief Leave a memory stall section
+ */
+void psi_memstall_leave(void) {
+    struct thread *current = get_current_thread();
+    if (current) {
+        psi_task_change(current, PSI_TSK_MEMSTALL, 0);
+    }
+}
+
+/**
+ * @brief Take a snapshot of all load and pressure metrics
+ *
+ * @param out Snapshot to fill
+ * @return 0 on success, negative error code on failure
+ */
+int pressure_get_stats(struct loadstats *out) {
+    if (!out) {
+        return KERN_INVALID;
+    }
+
+    memset(out, 0, sizeof(struct loadstats));
+    out->version = LOADSTATS_VERSION;
+    out->size = sizeof(struct loadstats);
+    out->nr_cpus = cpumask_weight(cpu_online_mask);
+
+    uint64_t cycles[PSI_NR_RESOURCES][2];
+    uint64_t flags = spin_lock_irqsave(&psi_lock);
+    psi_record_time(rdtsc());
+    out->nr_running = task_counts[NR_RUNNING];
+    out->nr_sleeping = task_counts[NR_SLEEPING];
+    out->nr_iowait = task_counts[NR_IOWAIT];
+    out->nr_memstall = task_counts[NR_MEMSTALL];
+    memcpy(cycles, stall_cycles, sizeof(cycles));
+    spin_unlock_irqrestore(&psi_lock, flags);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        out->loadavg[i] = fixed_to_hundredths(load_avg[i]);
+    }
+    memcpy(out->cpu_util, cpu_util, sizeof(out->cpu_util));
+
+    for (uint32_t res = 0; res < PSI_NR_RESOURCES; res++) {
+        struct psi_line *lines[2] = { &out->psi[res].some, &out->psi[res].full };
+        for (uint32_t state = 0; state < 2; state++) {
+            lines[state]->avg10 = fixed_to_hundredths(psi_avg[res][state][0]);
+            lines[state]->avg60 = fixed_to_hundredths(psi_avg[res][state][1]);
+            lines[state]->avg300 = fixed_to_hundredths(psi_avg[res][state][2]);
+            lines[state]->total_us = cputime_cycles_to_ns(cycles[res][state]) / 1000;
+        }
+    }
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Get the number of blocked or sleeping threads
+ *
+ * @return Threads that left the CPU waiting and were not woken yet
+ */
+uint32_t psi_nr_sleeping(void) {
+    return task_counts[NR_SLEEPING];
+}
+
+/**
+ * @brief Print load averages, utilisation and pressure
+ */
+void print_pressure_status(void) {
+    struct loadstats stats;
+    pressure_get_stats(&stats);
+
+    printf("\n=== Load and Pressure ===\n");
+    printf("Load average: %u.%02u %u.%02u %u.%02u (%u running, %u sleeping, %u iowait)\n",
+           stats.loadavg[0] / 100, stats.loadavg[0] % 100,
+           stats.loadavg[1] / 100, stats.loadavg[1] % 100,
+           stats.loadavg[2] / 100, stats.loadavg[2] % 100,
+           stats.nr_running, stats.nr_sleeping, stats.nr_iowait);
+
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        uint32_t cpu = cpumask_first(online);
+        printf("CPU %u utilisation: %u.%02u%%\n", cpu,
+               stats.cpu_util[cpu] / 100, stats.cpu_util[cpu] % 100);
+    }
+
+    for (uint32_t res = 0; res < PSI_NR_RESOURCES; res++) {
+        const struct psi_pressure *psi = &stats.psi[res];
+        printf("Pressure %-6s some avg10=%u.%02u avg60=%u.%02u avg300=%u.%02u total=%lu us\n",
+               psi_names[res], psi->some.avg10 / 100, psi->some.avg10 % 100,
+               psi->some.avg60 / 100, psi->some.avg60 % 100,
+               psi->some.avg300 / 100, psi->some.avg300 % 100, psi->some.total_us);
+        printf("                full avg10=%u.%02u avg60=%u.%02u avg300=%u.%02u total=%lu us\n",
+               psi->full.avg10 / 100, psi->full.avg10 % 100,
+               psi->full.avg60 / 100, psi->full.avg60 % 100,
+               psi->full.avg300 / 100, psi->full.avg300 % 100, psi->full.total_us);
+    }
+}
+
+/**
+ * @brief SYS_GETLOADSTATS handler
+ *
+ * Copies at most size bytes of a struct loadstats. Callers built against
+ * an older, shorter layout get the prefix they know.
+ *
+ * @param uaddr User address of a struct loadstats
+ * @param size Size of the user buffer in bytes
+ * @return Bytes copied, or negative error code on failure
+ */
+int64_t sys_getloadstats(uint64_t uaddr, uint64_t size) {
+    if (!uaddr || (uaddr & 7) || size < 2 * sizeof(uint32_t)) {
+        return KERN_INVALID;
+    }
+
+    struct loadstats stats;
+    pressure_get_stats(&stats);
+
+    uint64_t copy = size < sizeof(stats) ? size : sizeof(stats);
+    stats.size = (uint32_t)copy;
+    memcpy((void*)uaddr, &stats, copy);
+    return (int64_t)copy;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Change a thread's task state flags and the global counts
+ */
+static void psi_task_change(struct thread *thread, uint32_t clear, uint32_t set) {
+    uint64_t flags = spin_lock_irqsave(&psi_lock);
+
+    uint32_t old = thread->psi_flags;
+    uint32_t new = (old & ~clear) | set;
+    if (new != old) {
+        // Time so far belongs to the state before this change
+        psi_record_time(rdtsc());
+        psi_account_counts(old, (uint32_t)-1);
+        psi_account_counts(new, 1);
+        thread->psi_flags = new;
+    }
+
+    spin_unlock_irqrestore(&psi_lock, flags);
+}
+
+/**
+ * @brief Add delta to every count a set of flags contributes to (psi_lock held)
+ */
+static void psi_account_counts(uint32_t flags, uint32_t delta) {
+    if (flags & PSI_TSK_RUNNING) task_counts[NR_RUNNING] += delta;
+    if (flags & PSI_TSK_ONCPU) task_counts[NR_ONCPU] += delta;
+    if (flags & PSI_TSK_SLEEPING) task_counts[NR_SLEEPING] += delta;
+    if (flags & PSI_TSK_IOWAIT) task_counts[NR_IOWAIT] += delta;
+    if (flags & PSI_TSK_MEMSTALL) {
+        task_counts[NR_MEMSTALL] += delta;
+        if (flags & PSI_TSK_RUNNING) task_counts[NR_MEMSTALL_RUNNING] += delta;
+    }
+}
+
+/**
+ * @brief Charge the time since the last change to the current states (psi_lock held)
+ */
+static void psi_record_time(uint64_t now) {
+    uint64_t delta = now - state_start;
+    state_start = now;
+
+    uint32_t running = task_counts[NR_RUNNING];
+
+    if (running > task_counts[NR_ONCPU]) {
+        stall_cycles[PSI_CPU][0] += delta;
+    }
+
+    if (task_counts[NR_MEMSTALL]) {
+        stall_cycles[PSI_MEM][0] += delta;
+        if (running == task_counts[NR_MEMSTALL_RUNNING]) {
+            stall_cycles[PSI_MEM][1] += delta;
+        }
+    }
+
+    if (task_counts[NR_IOWAIT]) {
+        stall_cycles[PSI_IO][0] += delta;
+        if (!running) {
+            stall_cycles[PSI_IO][1] += delta;
+        }
+    }
+}
+
+/**
+ * @brief Fold the stall time since the last update into the averages
+ */
+static void update_pressure_averages(uint64_t now) {
+    uint64_t elapsed_ms = now - psi_last_update;
+    uint64_t periods = elapsed_ms / PSI_FREQ_MS;
+    uint64_t elapsed_ns = elapsed_ms * 1000000ULL;
+    psi_last_update = now;
+
+    uint64_t cycles[PSI_NR_RESOURCES][2];
+    uint64_t flags = spin_lock_irqsave(&psi_lock);
+    psi_record_time(rdtsc());
+    memcpy(cycles, stall_cycles, sizeof(cycles));
+    spin_unlock_irqrestore(&psi_lock, flags);
+
+    for (uint32_t res = 0; res < PSI_NR_RESOURCES; res++) {
+        for (uint32_t state = 0; state < 2; state++) {
+            uint64_t total_ns = cputime_cycles_to_ns(cycles[res][state]);
+            uint64_t stalled_ns = total_ns - psi_prev_ns[res][state];
+            psi_prev_ns[res][state] = total_ns;
+
+            // Share of wall time stalled, as a fixed-point percentage
+            uint64_t sample = stalled_ns * 100 * FIXED_1 / elapsed_ns;
+            if (sample > 100 * FIXED_1) {
+                sample = 100 * FIXED_1;
+            }
+
+            for (uint32_t i = 0; i < 3; i++) {
+                psi_avg[res][state][i] = calc_load_n(psi_avg[res][state][i], psi_exp[i], sample, periods);
+            }
+        }
+    }
+
+    // Busy share of each CPU over the same window
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        uint32_t cpu = cpumask_first(online);
+        struct cputime_ns ns;
+        if (cpu_get_cputime(cpu, &ns) != KERN_SUCCESS) {
+            continue;
+        }
+
+        uint64_t busy_ns = ns.user_ns + ns.system_ns + ns.irq_ns;
+        uint64_t util = (busy_ns - cpu_prev_busy_ns[cpu]) * 10000 / elapsed_ns;
+        cpu_prev_busy_ns[cpu] = busy_ns;
+        cpu_util[cpu] = util > 10000 ? 10000 : (uint32_t)util;
+    }
+}
+
+/**
+ * @brief Sample the number of active tasks into the load average
+ */
+static void update_load_average(uint64_t now) {
+    uint64_t periods = (now - load_last_update) / LOAD_FREQ_MS;
+    load_last_update += periods * LOAD_FREQ_MS;
+
+    // Like the classic load average, tasks blocked on I/O count as active
+    uint64_t active = (uint64_t)(task_counts[NR_RUNNING] + task_counts[NR_IOWAIT]) * FIXED_1;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        load_avg[i] = calc_load_n(load_avg[i], load_exp[i], active, periods);
+    }
+}
+
+/**
+ * @brief Apply the same sample to an exponential average for several periods
+ */
+static uint64_t calc_load_n(uint64_t load, uint64_t exp, uint64_t active, uint64_t periods) {
+    if (periods > MAX_CATCHUP_PERIODS) {
+        return active;
+    }
+
+    while (periods--) {
+        uint64_t next = load * exp + active * (FIXED_1 - exp);
+        if (active >= load) {
+            next += FIXED_1 - 1;
+        }
+        load = next / FIXED_1;
+    }
+    return load;
+}
+
+/**
+ * @brief Convert a fixed-point value to hundredths, rounded
+ */
+static uint32_t fixed_to_hundredths(uint64_t value) {
+    return (uint32_t)((value * 100 + FIXED_1 / 2) / FIXED_1);
+}
+
+/**
+ * @brief /proc/loadavg: three load averages and running/total threads
+ */
+static void proc_show_loadavg(proc_buffer_t *buffer) {
+    struct loadstats stats;
+    pressure_get_stats(&stats);
+
+    proc_printf(buffer, "%u.%02u %u.%02u %u.%02u %u/%u\n",
+                stats.loadavg[0] / 100, stats.loadavg[0] % 100,
+                stats.loadavg[1] / 100, stats.loadavg[1] % 100,
+                stats.loadavg[2] / 100, stats.loadavg[2] % 100,
+                stats.nr_running, stats.nr_running + stats.nr_sleeping);
+}
+
+/**
+ * @brief /proc/cpuutil: busy percentage of each online CPU
+ */
+static void proc_show_cpuutil(proc_buffer_t *buffer) {
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        uint32_t cpu = cpumask_first(online);
+        proc_printf(buffer, "cpu%u %u.%02u\n", cpu, cpu_util[cpu] / 100, cpu_util[cpu] % 100);
+    }
+}
+
+/**
+ * @brief /proc/pressure/<resource>: some and full lines
+ */
+static void proc_show_pressure(proc_buffer_t *buffer, enum psi_resource res) {
+    struct loadstats stats;
+    pressure_get_stats(&stats);
+
+    const struct psi_line *lines[2] = { &stats.psi[res].some, &stats.psi[res].full };
+    for (uint32_t state = 0; state < 2; state++) {
+        const struct psi_line *line = lines[state];
+        proc_printf(buffer, "%s avg10=%u.%02u avg60=%u.%02u avg300=%u.%02u total=%llu\n",
+                    state ? "full" : "some",
+                    line->avg10 / 100, line->avg10 % 100,
+                    line->avg60 / 100, line->avg60 % 100,
+                    line->avg300 / 100, line->avg300 % 100, line->total_us);
+    }
+}
+
+static void proc_show_pressure_cpu(proc_buffer_t *buffer) {
+    proc_show_pressure(buffer, PSI_CPU);
+}
+
+static void proc_show_pressure_memory(proc_buffer_t *buffer) {
+    proc_show_pressure(buffer, PSI_MEM);
+}
+
+static void proc_show_pressure_io(proc_buffer_t *buffer) {
+    proc_show_pressure(buffer, PSI_IO);
+}
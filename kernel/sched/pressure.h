@@ -0,0 +1,93 @@
+/*
+ * FG-OS Load and Pressure Metrics Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Load averages, per-CPU utilisation and pressure stall information.
+ */
+
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <types.h>
+#include "topology.h"
+
+struct thread;
+
+// Task State Flags (struct thread psi_flags)
+#define PSI_TSK_RUNNING         (1U << 0)   // Runnable: queued or on a CPU
+#define PSI_TSK_ONCPU           (1U << 1)   // Currently on a CPU
+#define PSI_TSK_SLEEPING        (1U << 2)   // Left the CPU blocked or sleeping
+#define PSI_TSK_IOWAIT          (1U << 3)   // Blocked waiting for I/O
+#define PSI_TSK_MEMSTALL        (1U << 4)   // Inside a memory stall section
+
+// Stall Resources
+enum psi_resource {
+    PSI_CPU = 0,                // Runnable tasks waiting for a CPU
+    PSI_MEM,                    // Tasks stalled on memory
+    PSI_IO,                     // Tasks waiting for I/O
+    PSI_NR_RESOURCES
+};
+
+// Averaging Periods
+#define LOAD_FREQ_MS            5000    // Load average sampling period
+#define PSI_FREQ_MS             2000    // Pressure and utilisation sampling period
+
+// Pressure of one resource in one state (some or full)
+// Averages are percentages of wall time in hundredths (1234 = 12.34%).
+struct psi_line {
+    uint32_t avg10;             // Over the last 10 seconds
+    uint32_t avg60;             // Over the last 60 seconds
+    uint32_t avg300;            // Over the last 300 seconds
+    uint32_t reserved;
+    uint64_t total_us;          // Total stall time since boot
+};
+
+// Pressure of one resource
+// some: at least one task was stalled; full: every non-idle task was.
+struct psi_pressure {
+    struct psi_line some;
+    struct psi_line full;
+};
+
+// Load and Pressure Snapshot (SYS_GETLOADSTATS)
+// Fields are only ever appended; size tells the caller how much was filled.
+#define LOADSTATS_VERSION       1
+
+struct loadstats {
+    uint32_t version;           // LOADSTATS_VERSION
+    uint32_t size;              // Bytes filled in by the kernel
+    uint32_t nr_cpus;           // Online CPUs
+    uint32_t nr_running;        // Runnable threads, queued or on a CPU
+    uint32_t nr_sleeping;       // Blocked or sleeping threads
+    uint32_t nr_iowait;         // Threads blocked on I/O
+    uint32_t nr_memstall;       // Threads in a memory stall
+    uint32_t reserved;
+    uint32_t loadavg[3];        // 1, 5 and 15 minute load in hundredths
+    uint32_t cpu_util[MAX_CPUS]; // Busy share of each CPU over the last period, in hundredths of a percent
+    struct psi_pressure psi[PSI_NR_RESOURCES];
+};
+
+// Initialization
+void pressure_init(void);
+
+// Scheduler Hooks
+void psi_enqueue(struct thread *thread);
+void psi_dequeue(struct thread *thread);
+void psi_sched_switch(struct thread *prev, struct thread *next);
+void pressure_tick(void);
+
+// Stall Annotations (current thread)
+bool io_schedule_prepare(void);
+void io_schedule_finish(bool old_iowait);
+void psi_memstall_enter(void);
+void psi_memstall_leave(void);
+
+// Queries
+int pressure_get_stats(struct loadstats *out);
+uint32_t psi_nr_sleeping(void);
+void print_pressure_status(void);
+
+#endif // PRESSURE_H
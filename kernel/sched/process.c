@@ -9,16 +9,20 @@
  */
 
 #include "scheduler.h"
+#include "idr.h"
 #include "../include/kernel.h"
 #include "../include/panic.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
 #include "../mm/memory.h"
 #include "../arch/x86_64/arch.h"
+#include "../interrupt/interrupt.h"
 // #include <string.h>  // Using kernel string functions instead
 
 // Global process management variables
 static struct process *process_list = NULL;    // Head of process list
 static struct process *current_process = NULL; // Currently running process
-static uint32_t next_pid = 1;                 // Next available PID
+static struct idr pid_idr;                     // PID to process map
 static uint32_t process_count = 0;             // Total number of processes
 static spinlock_t process_lock = {0};          // Process list lock
 
@@ -46,11 +50,16 @@ int process_init(void) {
     // Initialize process list
     process_list = NULL;
     current_process = NULL;
-    next_pid = 1;
     process_count = 0;
     
+    // Initialize PID allocator (PID 0 is reserved for the kernel)
+    if (idr_init(&pid_idr, 1) != KERN_SUCCESS) {
+        KERROR("Failed to initialize PID allocator");
+        return KERN_NOMEM;
+    }
+    
     // Initialize locks
-    process_lock.lock = 0;
+    spin_lock_init(&process_lock);
     
     // Reset statistics
     memset(&process_stats, 0, sizeof(process_stats));
@@ -83,7 +92,14 @@ struct process* create_process(const char *name, uint32_t parent_pid) {
     memset(proc, 0, sizeof(struct process));
     
     // Set basic process information
-    proc->pid = next_pid++;
+    uint64_t flags = spin_lock_irqsave(&process_lock);
+    int result = idr_alloc_cyclic(&pid_idr, proc, &proc->pid);
+    spin_unlock_irqrestore(&process_lock, flags);
+    if (result != KERN_SUCCESS) {
+        KERROR("Failed to allocate PID");
+        kfree(proc);
+        return NULL;
+    }
     proc->ppid = parent_pid;
     strncpy(proc->name, name, sizeof(proc->name) - 1);
     proc->name[sizeof(proc->name) - 1] = '\0';
@@ -101,6 +117,9 @@ struct process* create_process(const char *name, uint32_t parent_pid) {
     // Initialize memory layout
     if (allocate_process_memory(proc) != KERN_SUCCESS) {
         KERROR("Failed to allocate process memory");
+        flags = spin_lock_irqsave(&process_lock);
+        idr_remove(&pid_idr, proc->pid);
+        spin_unlock_irqrestore(&process_lock, flags);
         kfree(proc);
         return NULL;
     }
@@ -136,17 +155,16 @@ struct process* create_process(const char *name, uint32_t parent_pid) {
     }
     
     // Add to global process list
-    // TODO: Add proper locking for SMP safety
-    if (process_list == NULL) {
-        process_list = proc;
-    } else {
-        proc->next = process_list;
+    flags = spin_lock_irqsave(&process_lock);
+    proc->next = process_list;
+    if (process_list) {
         process_list->prev = proc;
-        process_list = proc;
     }
+    rcu_assign_pointer(process_list, proc);
     
     process_count++;
     process_stats.processes_created++;
+    spin_unlock_irqrestore(&process_lock, flags);
     
     KINFO("Created process '%s' with PID %u", name, proc->pid);
     return proc;
@@ -186,10 +204,12 @@ int destroy_process(uint32_t pid) {
     cleanup_process_memory(proc);
     
     // Remove from process list
+    uint64_t flags = spin_lock_irqsave(&process_lock);
+    // proc->next stays valid for readers still on this entry
     if (proc->prev) {
-        proc->prev->next = proc->next;
+        rcu_assign_pointer(proc->prev->next, proc->next);
     } else {
-        process_list = proc->next;
+        rcu_assign_pointer(process_list, proc->next);
     }
     
     if (proc->next) {
@@ -201,11 +221,15 @@ int destroy_process(uint32_t pid) {
         proc->parent->children = NULL; // Simplified - should handle multiple children
     }
     
-    // Free the process structure
-    kfree(proc);
+    // Release the PID; it is recycled only after the PID space wraps
+    idr_remove(&pid_idr, pid);
     
     process_count--;
     process_stats.processes_destroyed++;
+    spin_unlock_irqrestore(&process_lock, flags);
+    
+    // Free the process structure once lockless readers are done with it
+    kfree_rcu(proc, rcu);
     
     KINFO("Process PID %u destroyed successfully", pid);
     return KERN_SUCCESS;
@@ -214,20 +238,14 @@ int destroy_process(uint32_t pid) {
 /**
  * @brief Get process by PID
  * 
+ * Lockless lookup; the process stays valid until rcu_read_unlock() when
+ * called inside an RCU read-side section.
+ * 
  * @param pid Process ID to find
  * @return Pointer to process on success, NULL if not found
  */
 struct process* get_process(uint32_t pid) {
-    struct process *proc = process_list;
-    
-    while (proc) {
-        if (proc->pid == pid) {
-            return proc;
-        }
-        proc = proc->next;
-    }
-    
-    return NULL;
+    return (struct process*)idr_find(&pid_idr, pid);
 }
 
 /**
@@ -388,7 +406,8 @@ void print_process_list(void) {
     printf("║ PID │ NAME                │ STATE    │ PRIORITY  │ CPU TIME ║\n");
     printf("╠═════╪═════════════════════╪══════════╪═══════════╪══════════╣\n");
     
-    struct process *proc = process_list;
+    rcu_read_lock();
+    struct process *proc = rcu_dereference(process_list);
     int count = 0;
     
     while (proc && count < 20) { // Limit display to 20 processes
@@ -407,7 +426,7 @@ void print_process_list(void) {
         printf("║ %3u │ %-19s │ %s │ %8u  │ %7lu  ║\n",
                proc->pid, proc->name, state_str, proc->priority, proc->cpu_time);
         
-        proc = proc->next;
+        proc = rcu_dereference(proc->next);
         count++;
     }
     
@@ -415,6 +434,7 @@ void print_process_list(void) {
         printf("║     │ ... (%u more)      │          │           │          ║\n",
                process_count - count);
     }
+    rcu_read_unlock();
     
     printf("╚═════╧═════════════════════╧══════════╧═══════════╧══════════╝\n");
     printf("Total Processes: %u | Created: %lu | Destroyed: %lu\n",
@@ -508,8 +528,6 @@ static void init_process_context(struct process *proc) {
  * @return Current system time in milliseconds
  */
 uint64_t get_system_time(void) {
-    // Placeholder implementation
-    // In a real system, this would read from the system timer
-    static uint64_t fake_time = 0;
-    return ++fake_time;
+    // Shares the timer tick timebase so sleep deadlines match the NO_HZ one-shot
+    return timer_get_uptime_ms();
 } 
\ No newline at end of file
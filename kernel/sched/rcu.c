@@ -0,0 +1,469 @@
+/*
+ * FG-OS Read-Copy-Update Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * A grace period starts with a bitmap of the online, non-idle CPUs and
+ * ends when each has reported a quiescent state. Callbacks are queued per
+ * CPU and move through three segments: next (queued), wait (waiting for a
+ * grace period number) and done (ready to invoke). All callbacks queued
+ * while one grace period runs are batched onto the following one.
+ * Ready callbacks are invoked from RCU_SOFTIRQ, outside the timer interrupt.
+ */
+
+#include "scheduler.h"
+#include "wait.h"
+#include "../include/kernel.h"
+#include "../include/rcu.h"
+#include "../include/spinlock.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/tick.h"
+#include "../interrupt/softirq.h"
+
+// kfree_rcu() passes the rcu_head offset in place of a callback
+#define RCU_KFREE_OFFSET_MAX    4096
+
+// Per-CPU Callback Lists
+struct rcu_data {
+    struct rcu_head  *next_list;    // Queued, no grace period assigned yet
+    struct rcu_head **next_tail;
+    uint64_t          next_count;
+    struct rcu_head  *wait_list;    // Waiting for grace period wait_gp
+    struct rcu_head **wait_tail;
+    uint64_t          wait_count;
+    uint64_t          wait_gp;
+    struct rcu_head  *done_list;    // Grace period over, ready to invoke
+    struct rcu_head **done_tail;
+    uint64_t          done_count;
+};
+
+// Global Grace Period State
+static struct {
+    spinlock_t lock;            // Protects this structure and all rcu_data
+    uint64_t   gp_seq;          // Last grace period started
+    uint64_t   completed;       // Last grace period completed
+    uint64_t   gp_requested;    // Highest grace period a callback waits for
+    uint64_t   qs_pending;      // CPUs yet to report a quiescent state for gp_seq
+    uint64_t   online;          // Online CPUs
+    uint64_t   idle;            // CPUs in idle (extended quiescent state)
+    uint32_t   online_count;
+} rcu_state;
+
+// Read-side nesting depth of each CPU
+volatile uint32_t rcu_read_nesting[MAX_CPUS];
+
+static struct rcu_data rcu_data[MAX_CPUS];
+static struct rcu_stats stats = {0};
+static bool rcu_initialized = false;
+
+// synchronize_rcu() waiter
+struct rcu_synchronize {
+    struct rcu_head   head;
+    spinlock_t        lock;     // Held by the callback while it touches wq
+    wait_queue_head_t wq;
+    volatile bool     done;
+};
+
+// Forward declarations
+static void rcu_report_qs(uint32_t cpu);
+static void rcu_start_gp(void);
+static void rcu_request_gp(uint64_t gp);
+static void rcu_accelerate(struct rcu_data *rdp);
+static bool rcu_advance(struct rcu_data *rdp);
+static void rcu_do_batch(struct rcu_data *rdp);
+static void rcu_wakeme_after_gp(struct rcu_head *head);
+static void rcu_process_callbacks(void);
+
+/**
+ * @brief Initialize RCU with the boot CPU online
+ */
+void rcu_init(void) {
+    memset(&rcu_state, 0, sizeof(rcu_state));
+    memset(rcu_data, 0, sizeof(rcu_data));
+    spin_lock_init(&rcu_state.lock);
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        rcu_read_nesting[cpu] = 0;
+        rcu_data[cpu].next_tail = &rcu_data[cpu].next_list;
+        rcu_data[cpu].wait_tail = &rcu_data[cpu].wait_list;
+        rcu_data[cpu].done_tail = &rcu_data[cpu].done_list;
+    }
+
+    rcu_state.online = 1ULL << smp_processor_id();
+    rcu_state.online_count = 1;
+    open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
+    rcu_initialized = true;
+
+    KINFO("RCU initialized");
+}
+
+/**
+ * @brief Queue a callback to run after a grace period
+ *
+ * @param head RCU head embedded in the object
+ * @param func Callback, invoked with head once pre-existing readers are done
+ */
+void call_rcu(struct rcu_head *head, rcu_callback_t func) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+
+    head->func = func;
+    head->next = NULL;
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+
+    *rdp->next_tail = head;
+    rdp->next_tail = &head->next;
+    rdp->next_count++;
+    stats.callbacks_queued++;
+
+    rcu_accelerate(rdp);
+
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+    // The tick drives grace periods; restart it if it was stopped while busy
+    tick_nohz_kick();
+}
+
+/**
+ * @brief Wait until all pre-existing read-side sections have finished
+ *
+ * Must not be called from a read-side section or interrupt context.
+ */
+void synchronize_rcu(void) {
+    if (rcu_read_lock_held()) {
+        KERROR("synchronize_rcu() called inside an RCU read-side section");
+        return;
+    }
+
+    if (!rcu_initialized) {
+        return;
+    }
+
+    // With a single CPU online the caller itself is the only possible reader
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+    bool single = rcu_state.online_count == 1;
+    if (single) {
+        stats.sync_fast++;
+    }
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+    if (single) {
+        return;
+    }
+
+    struct rcu_synchronize rs;
+    spin_lock_init(&rs.lock);
+    init_waitqueue_head(&rs.wq);
+    rs.done = false;
+    call_rcu(&rs.head, rcu_wakeme_after_gp);
+
+    flags = interrupts_disable();
+    while (!rs.done) {
+        if (wait_queue_sleep(&rs.wq, false, WAIT_FOREVER) == KERN_BUSY) {
+            // No thread context to block (early boot): drive this CPU by hand
+            rcu_check_callbacks();
+            rcu_process_callbacks();
+            interrupts_restore(flags);
+            __asm__ __volatile__("pause");
+            flags = interrupts_disable();
+        }
+    }
+
+    // rs lives on this stack: let the callback finish with it first
+    spin_lock(&rs.lock);
+    spin_unlock(&rs.lock);
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Report the quiescent state implied by a context switch
+ */
+void rcu_note_context_switch(void) {
+    uint32_t cpu = smp_processor_id();
+
+    if (!rcu_initialized) {
+        return;
+    }
+
+    if (rcu_read_nesting[cpu] != 0) {
+        KERROR("Context switch inside an RCU read-side section");
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+    rcu_report_qs(cpu);
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+}
+
+/**
+ * @brief Per-tick RCU work: report a quiescent state if no reader is
+ * active, advance callbacks and raise RCU_SOFTIRQ for those whose grace
+ * period ended
+ */
+void rcu_check_callbacks(void) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+
+    if (!rcu_initialized) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+
+    // Readers cannot be preempted, so none from before the grace period remains
+    if (rcu_read_nesting[cpu] == 0) {
+        rcu_report_qs(cpu);
+    }
+    bool ready = rcu_advance(rdp);
+
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+    // Invoking callbacks can take a while; keep it out of the timer interrupt
+    if (ready) {
+        raise_softirq(RCU_SOFTIRQ);
+    }
+}
+
+/**
+ * @brief Enter idle: the CPU stops holding up grace periods
+ */
+void rcu_idle_enter(void) {
+    uint32_t cpu = smp_processor_id();
+    struct rcu_data *rdp = &rcu_data[cpu];
+
+    if (!rcu_initialized) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+
+    rcu_state.idle |= 1ULL << cpu;
+    rcu_report_qs(cpu);
+    bool ready = rcu_advance(rdp);
+
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+    if (ready) {
+        rcu_do_batch(rdp);
+    }
+}
+
+/**
+ * @brief Leave idle: later grace periods wait for this CPU again
+ */
+void rcu_idle_exit(void) {
+    if (!rcu_initialized) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+    rcu_state.idle &= ~(1ULL << smp_processor_id());
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+}
+
+/**
+ * @brief Include a newly started CPU in later grace periods
+ *
+ * The CPU cannot hold a reader from before the current grace period, so
+ * only grace periods started from now on wait for it.
+ *
+ * @param cpu CPU number
+ */
+void rcu_cpu_online(uint32_t cpu) {
+    if (!rcu_initialized || cpu >= MAX_CPUS) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+    if (!(rcu_state.online & (1ULL << cpu))) {
+        rcu_state.online |= 1ULL << cpu;
+        rcu_state.online_count++;
+    }
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+}
+
+/**
+ * @brief Check whether the current CPU has callbacks that need the tick
+ *
+ * @return true if callbacks are pending on this CPU
+ */
+bool rcu_needs_cpu(void) {
+    const struct rcu_data *rdp = &rcu_data[smp_processor_id()];
+    return rdp->next_list || rdp->wait_list || rdp->done_list;
+}
+
+/**
+ * @brief Get RCU statistics
+ *
+ * @return Pointer to RCU statistics
+ */
+const struct rcu_stats* rcu_get_stats(void) {
+    return &stats;
+}
+
+/**
+ * @brief Print RCU state and statistics
+ */
+void rcu_dump_status(void) {
+    printf("\n=== RCU ===\n");
+    printf("Grace Periods: started %llu, completed %llu (pending CPUs 0x%llx)\n",
+           stats.gp_started, stats.gp_completed, rcu_state.qs_pending);
+    printf("Callbacks: queued %llu, invoked %llu, largest batch %llu\n",
+           stats.callbacks_queued, stats.callbacks_invoked, stats.max_batch);
+    printf("Online CPUs: %u, synchronize_rcu fast path: %llu\n",
+           rcu_state.online_count, stats.sync_fast);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief RCU_SOFTIRQ handler: invoke this CPU's ready callbacks
+ */
+static void rcu_process_callbacks(void) {
+    struct rcu_data *rdp = &rcu_data[smp_processor_id()];
+
+    if (rdp->done_list) {
+        rcu_do_batch(rdp);
+    }
+}
+
+/**
+ * @brief Record a quiescent state of a CPU (rcu_state.lock held)
+ */
+static void rcu_report_qs(uint32_t cpu) {
+    uint64_t bit = 1ULL << cpu;
+
+    if (!(rcu_state.qs_pending & bit)) {
+        return;
+    }
+
+    rcu_state.qs_pending &= ~bit;
+    if (rcu_state.qs_pending == 0) {
+        rcu_state.completed = rcu_state.gp_seq;
+        stats.gp_completed++;
+        rcu_start_gp();
+    }
+}
+
+/**
+ * @brief Start grace periods until the highest requested one is running
+ * (rcu_state.lock held)
+ */
+static void rcu_start_gp(void) {
+    while (rcu_state.gp_requested > rcu_state.completed &&
+           rcu_state.gp_seq == rcu_state.completed) {
+        rcu_state.gp_seq++;
+        stats.gp_started++;
+
+        rcu_state.qs_pending = rcu_state.online & ~rcu_state.idle;
+        if (rcu_state.qs_pending) {
+            return;
+        }
+
+        // Every CPU is idle, so nothing can be reading
+        rcu_state.completed = rcu_state.gp_seq;
+        stats.gp_completed++;
+    }
+}
+
+/**
+ * @brief Ask for a grace period to be run (rcu_state.lock held)
+ */
+static void rcu_request_gp(uint64_t gp) {
+    if (gp > rcu_state.gp_requested) {
+        rcu_state.gp_requested = gp;
+    }
+    rcu_start_gp();
+}
+
+/**
+ * @brief Assign queued callbacks to a grace period (rcu_state.lock held)
+ *
+ * Readers of the grace period in progress may predate the callbacks, so
+ * they wait for the next one.
+ */
+static void rcu_accelerate(struct rcu_data *rdp) {
+    if (rdp->wait_list || !rdp->next_list) {
+        return;
+    }
+
+    rdp->wait_list = rdp->next_list;
+    rdp->wait_tail = rdp->next_tail;
+    rdp->wait_count = rdp->next_count;
+    rdp->wait_gp = rcu_state.gp_seq + 1;
+
+    rdp->next_list = NULL;
+    rdp->next_tail = &rdp->next_list;
+    rdp->next_count = 0;
+
+    rcu_request_gp(rdp->wait_gp);
+}
+
+/**
+ * @brief Retire callbacks whose grace period completed (rcu_state.lock held)
+ *
+ * @return true if callbacks are ready to invoke
+ */
+static bool rcu_advance(struct rcu_data *rdp) {
+    if (rdp->wait_list && rdp->wait_gp <= rcu_state.completed) {
+        *rdp->done_tail = rdp->wait_list;
+        rdp->done_tail = rdp->wait_tail;
+        rdp->done_count += rdp->wait_count;
+
+        if (rdp->wait_count > stats.max_batch) {
+            stats.max_batch = rdp->wait_count;
+        }
+
+        rdp->wait_list = NULL;
+        rdp->wait_tail = &rdp->wait_list;
+        rdp->wait_count = 0;
+    }
+
+    rcu_accelerate(rdp);
+    return rdp->done_list != NULL;
+}
+
+/**
+ * @brief Invoke the ready callbacks of a CPU
+ */
+static void rcu_do_batch(struct rcu_data *rdp) {
+    uint64_t flags = spin_lock_irqsave(&rcu_state.lock);
+
+    struct rcu_head *list = rdp->done_list;
+    uint64_t count = rdp->done_count;
+    rdp->done_list = NULL;
+    rdp->done_tail = &rdp->done_list;
+    rdp->done_count = 0;
+    stats.callbacks_invoked += count;
+
+    spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+    while (list) {
+        struct rcu_head *next = list->next;
+        uintptr_t offset = (uintptr_t)list->func;
+
+        if (offset < RCU_KFREE_OFFSET_MAX) {
+            kfree((char*)list - offset);
+        } else {
+            list->func(list);
+        }
+
+        list = next;
+    }
+}
+
+/**
+ * @brief Callback completing a synchronize_rcu() wait
+ */
+static void rcu_wakeme_after_gp(struct rcu_head *head) {
+    struct rcu_synchronize *rs = container_of(head, struct rcu_synchronize, head);
+
+    uint64_t flags = spin_lock_irqsave(&rs->lock);
+    rs->done = true;
+    wake_up_all(&rs->wq);
+    spin_unlock_irqrestore(&rs->lock, flags);
+}
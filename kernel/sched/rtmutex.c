@@ -0,0 +1,485 @@
+/*
+ * FG-OS Priority Inheritance Mutex Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Every owner keeps its locks' top waiters on its pi_waiters list, and its
+ * effective priority (prio) is the better of its own priority and the top
+ * of that list. When a waiter blocks or a priority changes, the chain of
+ * owners is walked: each blocked owner is requeued on the lock it waits
+ * for and that lock's owner is recomputed, until a priority stops
+ * changing. Before blocking, the same chain is checked for the locker
+ * itself, which would be a deadlock.
+ *
+ * Unlock hands the lock directly to the top waiter, so a woken waiter
+ * never competes for it and the highest priority waiter always wins.
+ */
+
+#include "rtmutex.h"
+#include "scheduler.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+
+// Serializes waiter lists, pi_waiters and priority chains
+static spinlock_t pi_lock = {0};
+
+// PI mutex statistics
+static struct rt_mutex_stats stats = {0};
+
+// Forward declarations
+static struct thread* owner_of(uintptr_t word);
+static struct rt_mutex_waiter* top_waiter(struct rt_mutex *lock);
+static void enqueue_waiter(struct rt_mutex *lock, struct rt_mutex_waiter *waiter);
+static void enqueue_pi_waiter(struct thread *owner, struct rt_mutex_waiter *waiter);
+static uint8_t effective_prio(struct thread *thread);
+static void adjust_prio_chain(struct thread *task);
+static bool would_deadlock(struct rt_mutex *lock, struct thread *self);
+
+/**
+ * @brief Initialize an rt_mutex
+ *
+ * @param lock Mutex to initialize
+ */
+void rt_mutex_init(struct rt_mutex *lock) {
+    lock->owner = 0;
+    INIT_LIST_HEAD(&lock->waiters);
+}
+
+/**
+ * @brief Acquire an rt_mutex, boosting the owner chain while blocked
+ *
+ * @param lock Mutex to lock
+ * @return 0 once held, KERN_DEADLK if blocking would deadlock,
+ *         KERN_BUSY without a thread context
+ */
+int rt_mutex_lock(struct rt_mutex *lock) {
+    return rt_mutex_lock_release(lock, NULL);
+}
+
+/**
+ * @brief Acquire an rt_mutex, dropping an outer spinlock once queued
+ *
+ * The outer lock is released after the caller is queued as a waiter and
+ * before it sleeps, so state it protects cannot change in between.
+ * Interrupts must be disabled by the caller's acquisition of it.
+ *
+ * @param lock Mutex to lock
+ * @param outer Spinlock held by the caller, NULL for none
+ * @return 0 once held, negative error code on failure
+ */
+int rt_mutex_lock_release(struct rt_mutex *lock, spinlock_t *outer) {
+    struct thread *self = get_current_thread();
+    uintptr_t expected = 0;
+
+    if (!self) {
+        if (outer) {
+            spin_unlock(outer);
+        }
+        return KERN_BUSY;
+    }
+
+    if (__atomic_compare_exchange_n(&lock->owner, &expected, (uintptr_t)self, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        if (outer) {
+            spin_unlock(outer);
+        }
+        stats.fast_acquires++;
+        return KERN_SUCCESS;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&pi_lock);
+
+    // Mark waiters so a concurrent fast unlock fails; take the lock if it was freed
+    struct thread *owner;
+    for (;;) {
+        uintptr_t old = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+        owner = owner_of(old);
+
+        if (!owner) {
+            uintptr_t new = (uintptr_t)self | (list_empty(&lock->waiters) ? 0 : RT_MUTEX_HAS_WAITERS);
+            if (__atomic_compare_exchange_n(&lock->owner, &old, new, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                spin_unlock_irqrestore(&pi_lock, flags);
+                if (outer) {
+                    spin_unlock(outer);
+                }
+                stats.fast_acquires++;
+                return KERN_SUCCESS;
+            }
+        } else if (__atomic_compare_exchange_n(&lock->owner, &old, old | RT_MUTEX_HAS_WAITERS, false,
+                                               __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (owner == self || would_deadlock(lock, self)) {
+        if (list_empty(&lock->waiters)) {
+            __atomic_and_fetch(&lock->owner, ~RT_MUTEX_HAS_WAITERS, __ATOMIC_RELAXED);
+        }
+        stats.deadlocks++;
+        spin_unlock_irqrestore(&pi_lock, flags);
+        if (outer) {
+            spin_unlock(outer);
+        }
+        KWARN("rt_mutex deadlock refused for thread %u", self->tid);
+        return KERN_DEADLK;
+    }
+
+    struct rt_mutex_waiter waiter;
+    INIT_LIST_HEAD(&waiter.list_entry);
+    INIT_LIST_HEAD(&waiter.pi_entry);
+    waiter.task = self;
+    waiter.lock = lock;
+    waiter.prio = self->prio;
+    waiter.granted = false;
+
+    // Queue and, as the new top waiter, boost the owner chain
+    struct rt_mutex_waiter *prev_top = top_waiter(lock);
+    enqueue_waiter(lock, &waiter);
+    self->pi_blocked_on = &waiter;
+
+    if (top_waiter(lock) == &waiter) {
+        if (prev_top) {
+            list_del_init(&prev_top->pi_entry);
+        }
+        enqueue_pi_waiter(owner, &waiter);
+        adjust_prio_chain(owner);
+    }
+
+    if (outer) {
+        spin_unlock(outer);
+    }
+
+    // Sleep until the unlocker hands the lock over
+    while (!waiter.granted) {
+        self->state = THREAD_STATE_BLOCKED;
+        spin_unlock(&pi_lock);
+        schedule();
+        spin_lock(&pi_lock);
+    }
+
+    stats.slow_acquires++;
+    spin_unlock_irqrestore(&pi_lock, flags);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Try to acquire an rt_mutex without blocking
+ *
+ * @param lock Mutex to lock
+ * @return true if acquired
+ */
+bool rt_mutex_trylock(struct rt_mutex *lock) {
+    struct thread *self = get_current_thread();
+    uintptr_t expected = 0;
+
+    if (!self) {
+        return false;
+    }
+
+    if (!__atomic_compare_exchange_n(&lock->owner, &expected, (uintptr_t)self, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    stats.fast_acquires++;
+    return true;
+}
+
+/**
+ * @brief Release an rt_mutex and run a higher priority new owner at once
+ *
+ * @param lock Mutex to unlock
+ */
+void rt_mutex_unlock(struct rt_mutex *lock) {
+    struct thread *self = get_current_thread();
+    struct thread *next = rt_mutex_unlock_handoff(lock);
+
+    // Dropping the inherited priority may leave a better thread runnable
+    if (self && next && next->prio < self->prio) {
+        yield();
+    }
+}
+
+/**
+ * @brief Release an rt_mutex, handing it to the top waiter
+ *
+ * Does not reschedule, so it may be called with a spinlock held.
+ *
+ * @param lock Mutex to unlock
+ * @return New owner, NULL if nobody was waiting
+ */
+struct thread* rt_mutex_unlock_handoff(struct rt_mutex *lock) {
+    struct thread *self = get_current_thread();
+    uintptr_t expected = (uintptr_t)self;
+
+    if (__atomic_compare_exchange_n(&lock->owner, &expected, 0, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&pi_lock);
+
+    struct thread *owner = owner_of(lock->owner);
+    if (owner != self) {
+        spin_unlock_irqrestore(&pi_lock, flags);
+        KWARN("rt_mutex unlocked by thread %u, not its owner", self ? self->tid : 0);
+        return NULL;
+    }
+
+    struct rt_mutex_waiter *waiter = top_waiter(lock);
+    if (!waiter) {
+        __atomic_store_n(&lock->owner, 0, __ATOMIC_RELEASE);
+        spin_unlock_irqrestore(&pi_lock, flags);
+        return NULL;
+    }
+
+    // Hand over ownership; the next waiter in line becomes the new owner's top
+    list_del_init(&waiter->list_entry);
+    list_del_init(&waiter->pi_entry);
+
+    struct thread *next = waiter->task;
+    struct rt_mutex_waiter *new_top = top_waiter(lock);
+
+    next->pi_blocked_on = NULL;
+    __atomic_store_n(&lock->owner, (uintptr_t)next | (new_top ? RT_MUTEX_HAS_WAITERS : 0),
+                     __ATOMIC_RELEASE);
+    if (new_top) {
+        enqueue_pi_waiter(next, new_top);
+    }
+
+    // Old owner loses this lock's boost, new owner gains the remaining waiters'
+    adjust_prio_chain(self);
+    adjust_prio_chain(next);
+
+    waiter->granted = true;
+    wake_up_thread(next);
+
+    spin_unlock_irqrestore(&pi_lock, flags);
+    return next;
+}
+
+/**
+ * @brief Get the owner of an rt_mutex
+ *
+ * @param lock Mutex to check
+ * @return Owning thread, NULL if unlocked
+ */
+struct thread* rt_mutex_owner(const struct rt_mutex *lock) {
+    return owner_of(__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @brief Check whether threads are blocked on an rt_mutex
+ *
+ * @param lock Mutex to check
+ * @return true if waiters are queued
+ */
+bool rt_mutex_has_waiters(const struct rt_mutex *lock) {
+    return !list_empty(&lock->waiters);
+}
+
+/**
+ * @brief Mark an unlocked rt_mutex as held by another thread
+ *
+ * Used when a lock held outside the kernel (a PI umutex word) becomes
+ * contended, so the waiters that follow boost its real owner.
+ *
+ * @param lock Unlocked mutex
+ * @param owner Thread that already owns the lock
+ */
+void rt_mutex_init_proxy_locked(struct rt_mutex *lock, struct thread *owner) {
+    __atomic_store_n(&lock->owner, (uintptr_t)owner, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Initialize the priority inheritance state of a new thread
+ *
+ * @param thread Thread being created
+ */
+void rt_mutex_init_task(struct thread *thread) {
+    thread->prio = thread->priority;
+    INIT_LIST_HEAD(&thread->pi_waiters);
+    thread->pi_blocked_on = NULL;
+}
+
+/**
+ * @brief Change a thread's own priority and propagate it along its chain
+ *
+ * @param thread Thread to change
+ * @param priority New base priority
+ */
+void rt_mutex_setprio(struct thread *thread, uint8_t priority) {
+    uint64_t flags = spin_lock_irqsave(&pi_lock);
+
+    thread->priority = priority;
+    adjust_prio_chain(thread);
+
+    spin_unlock_irqrestore(&pi_lock, flags);
+}
+
+/**
+ * @brief Get PI mutex statistics
+ *
+ * @return Pointer to PI mutex statistics
+ */
+const struct rt_mutex_stats* rt_mutex_get_stats(void) {
+    return &stats;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Strip flag bits from an owner word
+ */
+static struct thread* owner_of(uintptr_t word) {
+    return (struct thread*)(word & ~RT_MUTEX_HAS_WAITERS);
+}
+
+/**
+ * @brief Highest priority waiter of a lock, NULL if none
+ */
+static struct rt_mutex_waiter* top_waiter(struct rt_mutex *lock) {
+    if (list_empty(&lock->waiters)) {
+        return NULL;
+    }
+
+    return list_first_entry(&lock->waiters, struct rt_mutex_waiter, list_entry);
+}
+
+/**
+ * @brief Insert a waiter in a lock's priority-sorted waiter list
+ */
+static void enqueue_waiter(struct rt_mutex *lock, struct rt_mutex_waiter *waiter) {
+    struct list_head *pos;
+
+    for (pos = lock->waiters.next; pos != &lock->waiters; pos = pos->next) {
+        if (list_entry(pos, struct rt_mutex_waiter, list_entry)->prio > waiter->prio) {
+            break;
+        }
+    }
+
+    __list_add(&waiter->list_entry, pos->prev, pos);
+}
+
+/**
+ * @brief Insert a lock's top waiter in its owner's priority-sorted pi_waiters
+ */
+static void enqueue_pi_waiter(struct thread *owner, struct rt_mutex_waiter *waiter) {
+    struct list_head *pos;
+
+    for (pos = owner->pi_waiters.next; pos != &owner->pi_waiters; pos = pos->next) {
+        if (list_entry(pos, struct rt_mutex_waiter, pi_entry)->prio > waiter->prio) {
+            break;
+        }
+    }
+
+    __list_add(&waiter->pi_entry, pos->prev, pos);
+}
+
+/**
+ * @brief Own priority or the best inherited one, whichever is higher
+ */
+static uint8_t effective_prio(struct thread *thread) {
+    uint8_t prio = thread->priority;
+
+    if (!list_empty(&thread->pi_waiters)) {
+        struct rt_mutex_waiter *top = list_first_entry(&thread->pi_waiters,
+                                                       struct rt_mutex_waiter, pi_entry);
+        if (top->prio < prio) {
+            prio = top->prio;
+        }
+    }
+
+    return prio;
+}
+
+/**
+ * @brief Recompute priorities along the chain of blocked owners
+ *
+ * Called with pi_lock held.
+ *
+ * @param task First thread whose waiters or own priority changed
+ */
+static void adjust_prio_chain(struct thread *task) {
+    uint64_t depth = 0;
+
+    while (task) {
+        uint8_t prio = effective_prio(task);
+        if (prio == task->prio) {
+            break;
+        }
+        if (prio < task->prio) {
+            stats.boosts++;
+        }
+        task->prio = prio;
+
+        struct rt_mutex_waiter *waiter = task->pi_blocked_on;
+        if (!waiter) {
+            break;
+        }
+
+        if (++depth > RT_MUTEX_MAX_CHAIN) {
+            KWARN("rt_mutex chain longer than %u, stopping", RT_MUTEX_MAX_CHAIN);
+            break;
+        }
+
+        // Requeue the blocked task on its lock at the new priority
+        struct rt_mutex *lock = waiter->lock;
+        struct rt_mutex_waiter *prev_top = top_waiter(lock);
+
+        list_del_init(&waiter->list_entry);
+        waiter->prio = prio;
+        enqueue_waiter(lock, waiter);
+
+        struct rt_mutex_waiter *new_top = top_waiter(lock);
+        struct thread *owner = owner_of(lock->owner);
+        if (!owner) {
+            break;
+        }
+
+        // Keep the owner's pi_waiters pointing at this lock's current top
+        if (prev_top != new_top) {
+            list_del_init(&prev_top->pi_entry);
+            enqueue_pi_waiter(owner, new_top);
+        } else if (new_top == waiter) {
+            list_del_init(&waiter->pi_entry);
+            enqueue_pi_waiter(owner, waiter);
+        }
+
+        task = owner;
+    }
+
+    if (depth > stats.max_chain) {
+        stats.max_chain = depth;
+    }
+}
+
+/**
+ * @brief Check whether blocking on a lock would close a cycle
+ *
+ * Called with pi_lock held.
+ *
+ * @param lock Lock about to be waited for
+ * @param self Thread about to block
+ * @return true if self already owns a lock in the chain
+ */
+static bool would_deadlock(struct rt_mutex *lock, struct thread *self) {
+    struct thread *owner = owner_of(lock->owner);
+
+    for (uint32_t depth = 0; owner; depth++) {
+        if (owner == self || depth >= RT_MUTEX_MAX_CHAIN) {
+            return true;
+        }
+
+        struct rt_mutex_waiter *waiter = owner->pi_blocked_on;
+        if (!waiter) {
+            break;
+        }
+        owner = owner_of(waiter->lock->owner);
+    }
+
+    return false;
+}
@@ -0,0 +1,68 @@
+/*
+ * FG-OS Priority Inheritance Mutex Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Sleeping mutexes whose owner runs at the priority of its highest
+ * priority waiter, transitively along chains of blocked owners.
+ */
+
+#ifndef RTMUTEX_H
+#define RTMUTEX_H
+
+#include <types.h>
+#include "../include/list.h"
+
+// Owner word bit: waiters are queued, so unlock must take the slow path
+#define RT_MUTEX_HAS_WAITERS    1UL
+
+// Longest owner chain walked before giving up
+#define RT_MUTEX_MAX_CHAIN      1024
+
+// Priority Inheritance Mutex
+struct rt_mutex {
+    volatile uintptr_t owner;   // Owning thread | RT_MUTEX_HAS_WAITERS
+    struct list_head waiters;   // Waiters sorted by priority, FIFO within one
+};
+
+// Blocked Locker, on the locker's stack
+struct rt_mutex_waiter {
+    struct list_head list_entry;    // Entry in lock->waiters
+    struct list_head pi_entry;      // Entry in owner->pi_waiters while top waiter
+    struct thread *task;            // Blocked thread
+    struct rt_mutex *lock;          // Lock being waited for
+    uint8_t prio;                   // Priority the waiter is queued at
+    volatile bool granted;          // Ownership handed over by the unlocker
+};
+
+// Static initializer for an rt_mutex
+#define RT_MUTEX_INIT(name) { 0, LIST_HEAD_INIT((name).waiters) }
+
+// PI Mutex Statistics
+struct rt_mutex_stats {
+    uint64_t fast_acquires;     // Uncontended acquisitions
+    uint64_t slow_acquires;     // Acquisitions after blocking
+    uint64_t boosts;            // Owner priority raised by inheritance
+    uint64_t max_chain;         // Longest owner chain walked
+    uint64_t deadlocks;         // Lock attempts refused as deadlocks
+};
+
+// PI Mutex Interface
+void rt_mutex_init(struct rt_mutex *lock);
+int rt_mutex_lock(struct rt_mutex *lock);
+int rt_mutex_lock_release(struct rt_mutex *lock, spinlock_t *outer);
+bool rt_mutex_trylock(struct rt_mutex *lock);
+void rt_mutex_unlock(struct rt_mutex *lock);
+struct thread* rt_mutex_unlock_handoff(struct rt_mutex *lock);
+struct thread* rt_mutex_owner(const struct rt_mutex *lock);
+bool rt_mutex_has_waiters(const struct rt_mutex *lock);
+void rt_mutex_init_proxy_locked(struct rt_mutex *lock, struct thread *owner);
+
+// Scheduler Hooks
+void rt_mutex_init_task(struct thread *thread);
+void rt_mutex_setprio(struct thread *thread, uint8_t priority);
+const struct rt_mutex_stats* rt_mutex_get_stats(void);
+
+#endif // RTMUTEX_H
@@ -0,0 +1,105 @@
+/*
+ * FG-OS Scheduler Benchmarks
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Ping-pong context switch latency benchmark: two threads yield to each
+ * other and the TSC cost per switch is reported.
+ */
+
+#include "scheduler.h"
+#include "../include/kernel.h"
+#include "../arch/x86_64/arch.h"
+#include "../arch/x86_64/fpu.h"
+
+// Benchmark thread parameters
+static uint32_t bench_iterations;
+static bool bench_use_fpu;
+
+/**
+ * @brief Ping-pong thread body
+ *
+ * @param arg Unused
+ */
+static void pingpong_thread(void *arg) {
+    (void)arg;
+
+    for (uint32_t i = 0; i < bench_iterations; i++) {
+        if (bench_use_fpu) {
+            // Dirty the x87 state so every switch must move FPU state
+            __asm__ __volatile__("fld1\n\tfstp %%st(0)" ::: "memory");
+        }
+        yield();
+    }
+}
+
+/**
+ * @brief Measure thread-to-thread context switch latency
+ *
+ * Must be called from the idle context with the scheduler enabled. Two
+ * threads of a dedicated process yield to each other until both have
+ * completed the requested number of iterations.
+ *
+ * @param iterations Yields per thread
+ * @param use_fpu Touch the FPU before each yield to include lazy FPU cost
+ * @param result Receives the measurement
+ * @return 0 on success, negative error code on failure
+ */
+int sched_bench_pingpong(uint32_t iterations, bool use_fpu, struct sched_bench_result *result) {
+    if (!result || iterations == 0) {
+        return KERN_INVALID;
+    }
+
+    if (!scheduler_is_enabled() || get_current_thread()) {
+        KERROR("Ping-pong benchmark must run from the idle context");
+        return KERN_BUSY;
+    }
+
+    struct process *proc = create_process("pingpong", 0);
+    if (!proc) {
+        return KERN_NOMEM;
+    }
+
+    bench_iterations = iterations;
+    bench_use_fpu = use_fpu;
+
+    struct thread *ping = create_thread(proc->pid, pingpong_thread, NULL);
+    struct thread *pong = create_thread(proc->pid, pingpong_thread, NULL);
+    if (!ping || !pong) {
+        if (ping) destroy_thread(ping->tid);
+        if (pong) destroy_thread(pong->tid);
+        destroy_process(proc->pid);
+        return KERN_NOMEM;
+    }
+
+    uint64_t switches_before = get_scheduler_stats()->context_switches;
+    uint64_t traps_before = fpu_get_stats()->traps;
+    uint64_t start = rdtsc();
+
+    scheduler_add_thread(ping);
+    scheduler_add_thread(pong);
+
+    // Both threads park themselves in THREAD_STATE_TERMINATED when done
+    while (ping->state != THREAD_STATE_TERMINATED || pong->state != THREAD_STATE_TERMINATED) {
+        schedule();
+    }
+
+    uint64_t end = rdtsc();
+
+    result->iterations = iterations;
+    result->switches = get_scheduler_stats()->context_switches - switches_before;
+    result->total_cycles = end - start;
+    result->cycles_per_switch = result->switches ? result->total_cycles / result->switches : 0;
+    result->fpu_traps = fpu_get_stats()->traps - traps_before;
+
+    destroy_thread(ping->tid);
+    destroy_thread(pong->tid);
+    destroy_process(proc->pid);
+
+    KINFO("Ping-pong (%s): %llu switches, %llu cycles/switch, %llu FPU traps",
+          use_fpu ? "FPU" : "no FPU", result->switches, result->cycles_per_switch,
+          result->fpu_traps);
+    return KERN_SUCCESS;
+}
@@ -9,10 +9,17 @@
  */
 
 #include "scheduler.h"
+#include "workqueue.h"
 #include "../include/kernel.h"
 #include "../include/panic.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
+#include "../include/syscall.h"
 #include "../mm/memory.h"
 #include "../arch/x86_64/arch.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/tick.h"
+#include "../interrupt/softirq.h"
 
 // Scheduler configuration
 static uint8_t current_policy = SCHED_POLICY_ROUND_ROBIN;
@@ -23,7 +30,7 @@ static bool preemption_enabled = false;
 // Scheduler queues (simple round-robin for now)
 static struct thread *ready_queue = NULL;
 static struct thread *sleeping_queue = NULL;
-static spinlock_t sched_lock = {0};
+static spinlock_t sched_lock = {0};         // Protects both queues
 
 // Scheduler statistics
 static struct scheduler_stats stats = {0};
@@ -32,12 +39,32 @@ static struct scheduler_stats stats = {0};
 static uint64_t tick_counter = 0;
 static uint64_t last_schedule_time = 0;
 
+// Saved stack pointer of each CPU's idle (boot) context while a thread runs
+static uint64_t idle_rsp[MAX_CPUS];
+
+// CPUs halted in scheduler_idle(), preferred by wakeup placement
+static cpumask_t idle_cpus = CPU_MASK_NONE;
+
+// Per-CPU reschedule requests, honoured on interrupt return and at cond_resched()
+static volatile bool need_resched_flags[MAX_CPUS];
+
+// Wakeup-to-run latency per priority class
+static struct sched_latency_hist wakeup_latency[SCHED_LAT_CLASSES];
+
 // Forward declarations
 static struct thread* select_next_thread(void);
 static void context_switch(struct thread *prev, struct thread *next);
+static void switch_to_idle(struct thread *prev);
 static void add_to_ready_queue(struct thread *thread);
-static struct thread* remove_from_ready_queue(void);
+static void add_to_sleep_queue(struct thread *thread);
+static struct thread* remove_from_ready_queue(bool by_priority);
+static uint32_t select_task_cpu(struct thread *thread, uint32_t waker_cpu);
+static bool can_run_on(struct thread *thread, uint32_t cpu);
 static void update_sleep_queue(void);
+static void enqueue_woken(struct thread *thread);
+static void check_preempt_wakeup(struct thread *thread);
+static void preempt_current(void);
+static void record_wakeup_latency(struct thread *thread);
 static void update_thread_statistics(struct thread *thread, uint64_t time_used);
 
 /**
@@ -59,15 +86,38 @@ int scheduler_init(void) {
     sleeping_queue = NULL;
     
     // Initialize locks
-    sched_lock.lock = 0;
+    spin_lock_init(&sched_lock);
+    
+    // Initialize futex hash buckets
+    futex_init();
+    
+    // Discover the boot CPU and its cache domain
+    topology_init();
+    
+    // Initialize read-copy-update
+    rcu_init();
+    
+    // Start TSC CPU time accounting
+    cputime_init();
+    
+    // Start load average and pressure tracking
+    pressure_init();
     
     // Reset statistics
     memset(&stats, 0, sizeof(struct scheduler_stats));
+    memset(wakeup_latency, 0, sizeof(wakeup_latency));
+    memset((void*)need_resched_flags, 0, sizeof(need_resched_flags));
     
     // Reset counters
     tick_counter = 0;
     last_schedule_time = get_system_time();
     
+    // Start the per-CPU kernel worker pools
+    if (workqueue_init() != KERN_SUCCESS) {
+        KERROR("Failed to initialize work queues");
+        return KERN_ERROR;
+    }
+    
     KINFO("Scheduler subsystem initialized successfully");
     return KERN_SUCCESS;
 }
@@ -103,23 +153,35 @@ void schedule(void) {
         return;
     }
     
+    // This pass answers any pending reschedule request
+    need_resched_flags[smp_processor_id()] = false;
+    
+    // Leaving the current context is a quiescent state for RCU
+    rcu_note_context_switch();
+    
     struct thread *current = get_current_thread();
+    
+    // A blocking worker may need another one to keep its pool busy
+    if (current && current->worker &&
+        (current->state == THREAD_STATE_BLOCKED || current->state == THREAD_STATE_SLEEPING)) {
+        wq_worker_sleeping(current);
+    }
     struct thread *next = select_next_thread();
     
     // No thread to schedule
     if (!next) {
-        if (!current) {
-            // No threads at all - halt CPU
-            arch_halt();
+        if (current && current->state != THREAD_STATE_RUNNING) {
+            // Current thread blocked or exited - return to the idle loop
+            switch_to_idle(current);
         }
         return;
     }
     
     // Same thread - reset time slice and continue
     if (current == next) {
-        if (current) {
-            current->remaining_time = current->time_slice;
-        }
+        cputime_switch(current, current);
+        current->state = THREAD_STATE_RUNNING;
+        current->remaining_time = current->time_slice;
         return;
     }
     
@@ -133,14 +195,14 @@ void schedule(void) {
         update_thread_statistics(current, time_used);
     }
     
-    // Perform context switch
-    context_switch(current, next);
-    
     // Update scheduling time
     last_schedule_time = current_time;
     
     KDEBUG("Scheduled thread TID %u (was TID %u)", 
            next ? next->tid : 0, current ? current->tid : 0);
+    
+    // Perform context switch; returns once current is scheduled again
+    context_switch(current, next);
 }
 
 /**
@@ -160,6 +222,8 @@ void yield(void) {
         if (current->state == THREAD_STATE_RUNNING) {
             current->state = THREAD_STATE_READY;
             add_to_ready_queue(current);
+        } else if (current->state == THREAD_STATE_SLEEPING) {
+            add_to_sleep_queue(current);
         }
     }
     
@@ -180,19 +244,164 @@ void scheduler_tick(void) {
     // Update sleeping threads
     update_sleep_queue();
     
+    // Load average and pressure sampling
+    pressure_tick();
+    
     // Handle preemptive scheduling
     if (preemption_enabled) {
         struct thread *current = get_current_thread();
         if (current && current->remaining_time > 0) {
             current->remaining_time--;
+        }
+        
+        // Time slice expired - preempt on the way out of the interrupt
+        if (current && current->remaining_time == 0) {
+            resched_cpu(smp_processor_id());
+        }
+    }
+}
+
+/**
+ * @brief Ask a CPU to reschedule at its next preemption point
+ * 
+ * @param cpu CPU to reschedule
+ */
+void resched_cpu(uint32_t cpu) {
+    if (cpu < MAX_CPUS) {
+        need_resched_flags[cpu] = true;
+    }
+}
+
+/**
+ * @brief Check whether the current CPU has a pending reschedule request
+ * 
+ * @return true if the running thread should give up the CPU
+ */
+bool need_resched(void) {
+    return need_resched_flags[smp_processor_id()];
+}
+
+/**
+ * @brief Preempt the running thread on return from an interrupt or system call
+ * 
+ * Called at the outermost interrupt exit. Does nothing unless a reschedule
+ * is pending and preemption is allowed; a request made while an RCU reader
+ * runs stays pending for the next return.
+ */
+void preempt_schedule_irq(void) {
+    if (!need_resched() || !scheduler_enabled || !preemption_enabled ||
+        in_interrupt() || rcu_read_lock_held()) {
+        return;
+    }
+    
+    // The idle loop reschedules by itself once the interrupt returns
+    struct thread *current = get_current_thread();
+    if (!current || current->state != THREAD_STATE_RUNNING) {
+        return;
+    }
+    
+    stats.irq_preemptions++;
+    preempt_current();
+}
+
+/**
+ * @brief Preemption point for long-running kernel loops
+ * 
+ * Gives up the CPU if a reschedule is pending. Works with preemption
+ * disabled, since the caller chose a safe point; must not be called with
+ * spinlocks held.
+ */
+void cond_resched(void) {
+    if (!need_resched() || !scheduler_enabled || in_interrupt() || rcu_read_lock_held()) {
+        return;
+    }
+    
+    struct thread *current = get_current_thread();
+    if (!current || current->state != THREAD_STATE_RUNNING) {
+        return;
+    }
+    
+    stats.voluntary_preemptions++;
+    preempt_current();
+}
+
+/**
+ * @brief Get the wakeup-to-run latency histogram of a priority class
+ * 
+ * @param prio_class Class from sched_prio_class()
+ * @return Histogram, NULL for an invalid class
+ */
+const struct sched_latency_hist* sched_get_wakeup_latency(uint32_t prio_class) {
+    return prio_class < SCHED_LAT_CLASSES ? &wakeup_latency[prio_class] : NULL;
+}
+
+/**
+ * @brief Check whether the scheduler is enabled
+ * 
+ * @return true if enabled, false otherwise
+ */
+bool scheduler_is_enabled(void) {
+    return scheduler_enabled;
+}
+
+/**
+ * @brief Check whether the periodic tick is needed for preemption
+ * 
+ * The tick only drives time slicing when another thread is waiting to run.
+ * 
+ * @return true if the tick must keep running, false otherwise
+ */
+bool scheduler_tick_needed(void) {
+    return scheduler_enabled && preemption_enabled && ready_queue != NULL;
+}
+
+/**
+ * @brief Get the earliest wakeup time of all sleeping threads
+ * 
+ * @return Wakeup time in milliseconds, UINT64_MAX if nothing sleeps
+ */
+uint64_t scheduler_next_wakeup(void) {
+    uint64_t next = UINT64_MAX;
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
+    
+    for (struct thread *thread = sleeping_queue; thread; thread = thread->sched_next) {
+        if (thread->sleep_until < next) {
+            next = thread->sleep_until;
+        }
+    }
+    
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return next;
+}
+
+/**
+ * @brief Idle loop of the current CPU
+ * 
+ * Halts until work arrives. The periodic tick is stopped while halted and
+ * only the next timer or sleeper expiry wakes the CPU.
+ */
+void scheduler_idle(void) {
+    while (1) {
+        // Softirqs deferred by a busy interrupt exit run before halting
+        do_softirq();
+        
+        uint64_t flags = interrupts_disable();
+        
+        if (!ready_queue && !local_softirq_pending()) {
+            uint32_t cpu = smp_processor_id();
             
-            // Time slice expired - preempt
-            if (current->remaining_time == 0) {
-                current->state = THREAD_STATE_READY;
-                add_to_ready_queue(current);
-                schedule();
-            }
+            // Interrupts stay disabled until the hlt so no wakeup is missed
+            __atomic_or_fetch(&idle_cpus, CPU_MASK_CPU(cpu), __ATOMIC_RELAXED);
+            rcu_idle_enter();
+            tick_nohz_idle_enter();
+            safe_halt();
+            tick_nohz_idle_exit();
+            rcu_idle_exit();
+            __atomic_and_fetch(&idle_cpus, ~CPU_MASK_CPU(cpu), __ATOMIC_RELAXED);
         }
+        
+        interrupts_restore(flags);
+        schedule();
     }
 }
 
@@ -213,6 +422,33 @@ void scheduler_add_thread(struct thread *thread) {
     KDEBUG("Added thread TID %u to ready queue", thread->tid);
 }
 
+/**
+ * @brief Make a blocked or sleeping thread runnable
+ * 
+ * @param thread Thread to wake
+ * @return true if the thread was woken, false if it was not waiting
+ */
+bool wake_up_thread(struct thread *thread) {
+    if (!thread) {
+        return false;
+    }
+    
+    uint64_t flags = interrupts_disable();
+    bool woken = false;
+    
+    if (thread->state == THREAD_STATE_SLEEPING) {
+        scheduler_remove_thread(thread);
+    }
+    
+    if (thread->state == THREAD_STATE_BLOCKED || thread->state == THREAD_STATE_SLEEPING) {
+        enqueue_woken(thread);
+        woken = true;
+    }
+    
+    interrupts_restore(flags);
+    return woken;
+}
+
 /**
  * @brief Remove thread from scheduler queues
  * 
@@ -223,6 +459,8 @@ void scheduler_remove_thread(struct thread *thread) {
         return;
     }
     
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
+    
     // Remove from ready queue
     if (ready_queue == thread) {
         ready_queue = thread->sched_next;
@@ -251,9 +489,50 @@ void scheduler_remove_thread(struct thread *thread) {
     
     thread->sched_next = NULL;
     
+    spin_unlock_irqrestore(&sched_lock, flags);
+    
+    // A terminated thread no longer counts towards load or pressure
+    if (thread->state == THREAD_STATE_TERMINATED) {
+        psi_dequeue(thread);
+    }
+    
     KDEBUG("Removed thread TID %u from scheduler queues", thread->tid);
 }
 
+/**
+ * @brief Set the CPUs excluded from general load balancing
+ * 
+ * Isolated CPUs only run threads placed on them explicitly by affinity.
+ * At least one online CPU must stay available for housekeeping.
+ * 
+ * @param mask CPUs to isolate
+ * @return 0 on success, negative error code on failure
+ */
+int sched_set_isolated_cpus(cpumask_t mask) {
+    if (!(cpu_online_mask & ~mask)) {
+        return KERN_INVALID;
+    }
+    
+    cpu_isolated_mask = mask;
+    KINFO("Isolated CPUs: 0x%016lX", mask);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_SCHED_SETISOLATED handler
+ * 
+ * @param size Size of the user mask in bytes
+ * @param uaddr User address of the CPU mask
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_sched_setisolated(uint64_t size, uint64_t uaddr) {
+    if (!uaddr || size < sizeof(cpumask_t)) {
+        return KERN_INVALID;
+    }
+    
+    return sched_set_isolated_cpus(*(const cpumask_t*)uaddr);
+}
+
 /**
  * @brief Set scheduling policy
  * 
@@ -323,8 +602,28 @@ void print_scheduler_status(void) {
            preemption_enabled ? "ON" : "OFF", tick_counter, stats.context_switches);
     printf("╠══════════════════════════════════════════════════════════════╣\n");
     printf("║ Ready Threads: %3u │ Sleeping Threads: %3u │ Total CPU: %6lu ║\n",
-           stats.runnable_threads, 0, stats.total_cpu_time); // TODO: count sleeping
+           stats.runnable_threads, psi_nr_sleeping(), stats.total_cpu_time);
+    printf("║ Preemptions - wakeup: %6lu │ irq return: %6lu │ voluntary: %6lu ║\n",
+           stats.wakeup_preemptions, stats.irq_preemptions, stats.voluntary_preemptions);
     printf("╚══════════════════════════════════════════════════════════════╝\n");
+    
+    static const char *class_names[SCHED_LAT_CLASSES] = { "HIGH", "NORMAL", "LOW", "IDLE" };
+    printf("Wakeup latency by priority class:\n");
+    for (uint32_t cls = 0; cls < SCHED_LAT_CLASSES; cls++) {
+        const struct sched_latency_hist *hist = &wakeup_latency[cls];
+        if (!hist->count) {
+            continue;
+        }
+        printf("  %-6s %8lu wakeups, avg %8lu ns, max %8lu ns\n", class_names[cls],
+               hist->count, hist->total_ns / hist->count, hist->max_ns);
+        for (uint32_t bucket = 0; bucket < SCHED_LAT_BUCKETS; bucket++) {
+            if (hist->buckets[bucket]) {
+                printf("    < %8lu us: %lu\n", 2UL << bucket, hist->buckets[bucket]);
+            }
+        }
+    }
+    
+    print_pressure_status();
     printf("\n");
 }
 
@@ -339,19 +638,16 @@ static struct thread* select_next_thread(void) {
     switch (current_policy) {
         case SCHED_POLICY_ROUND_ROBIN:
         default:
-            return remove_from_ready_queue();
+            return remove_from_ready_queue(false);
         
         case SCHED_POLICY_PRIORITY:
-            // TODO: Implement priority-based selection
-            return remove_from_ready_queue();
+        case SCHED_POLICY_REALTIME:
+            // Highest effective priority first, including inherited boosts
+            return remove_from_ready_queue(true);
         
         case SCHED_POLICY_CFS:
             // TODO: Implement CFS algorithm
-            return remove_from_ready_queue();
-        
-        case SCHED_POLICY_REALTIME:
-            // TODO: Implement real-time scheduling
-            return remove_from_ready_queue();
+            return remove_from_ready_queue(false);
     }
 }
 
@@ -367,13 +663,16 @@ static void context_switch(struct thread *prev, struct thread *next) {
         return;
     }
     
-    // Save current thread context (if any)
+    // A preempted thread that was not requeued goes back on the ready queue
     if (prev && prev->state == THREAD_STATE_RUNNING) {
-        // TODO: Save CPU registers to prev->context
-        // This would typically be done in assembly code
-        prev->state = THREAD_STATE_READY;
+        add_to_ready_queue(prev);
     }
     
+    // Charge prev up to now and end next's run delay
+    cputime_switch(prev, next);
+    psi_sched_switch(prev, next);
+    record_wakeup_latency(next);
+    
     // Set new current thread
     set_current_thread(next);
     next->state = THREAD_STATE_RUNNING;
@@ -390,13 +689,31 @@ static void context_switch(struct thread *prev, struct thread *next) {
         }
     }
     
-    // Restore new thread context
-    // TODO: Restore CPU registers from next->context
-    // This would typically be done in assembly code
+    // FPU state follows lazily on the next thread's first FPU instruction
+    fpu_switch(prev ? &prev->fpu : NULL, &next->fpu);
+    
+    // Swap kernel stacks; returns when prev is scheduled again
+    uint64_t *prev_rsp = prev ? &prev->kernel_rsp : &idle_rsp[smp_processor_id()];
+    switch_to_asm(prev_rsp, next->kernel_rsp);
     
     KDEBUG("Context switched to thread TID %u", next->tid);
 }
 
+/**
+ * @brief Switch from a thread that cannot continue to the idle context
+ * 
+ * @param prev Thread giving up the CPU
+ */
+static void switch_to_idle(struct thread *prev) {
+    cputime_switch(prev, NULL);
+    psi_sched_switch(prev, NULL);
+    set_current_thread(NULL);
+    set_current_process(NULL);
+    fpu_switch(&prev->fpu, NULL);
+    
+    switch_to_asm(&prev->kernel_rsp, idle_rsp[smp_processor_id()]);
+}
+
 /**
  * @brief Add thread to ready queue
  * 
@@ -407,33 +724,166 @@ static void add_to_ready_queue(struct thread *thread) {
         return;
     }
     
-    thread->sched_next = ready_queue;
-    ready_queue = thread;
+    // A worker coming back from a block counts as running again
+    if (thread->worker &&
+        (thread->state == THREAD_STATE_BLOCKED || thread->state == THREAD_STATE_SLEEPING)) {
+        wq_worker_waking_up(thread);
+    }
+    
+    // Place the thread before publishing it to other CPUs
+    thread->cpu = select_task_cpu(thread, smp_processor_id());
+    
+    // Queue at the tail so equal candidates are picked in FIFO order
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
+    struct thread **tail = &ready_queue;
+    while (*tail) {
+        tail = &(*tail)->sched_next;
+    }
+    thread->sched_next = NULL;
+    *tail = thread;
     thread->state = THREAD_STATE_READY;
+    cputime_enqueue(thread);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    
+    psi_enqueue(thread);
+    
+    // A runnable thread may need time slicing again
+    tick_nohz_kick();
+}
+
+/**
+ * @brief Add thread to sleeping queue
+ * 
+ * @param thread Thread to add
+ */
+static void add_to_sleep_queue(struct thread *thread) {
+    if (!thread) {
+        return;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
+    thread->sched_next = sleeping_queue;
+    sleeping_queue = thread;
+    spin_unlock_irqrestore(&sched_lock, flags);
 }
 
 /**
  * @brief Remove and return next thread from ready queue
  * 
- * @return Next thread from ready queue, or NULL if empty
+ * Threads placed on this CPU are taken first; otherwise any thread this
+ * CPU may pull is balanced onto it. With by_priority, the highest
+ * effective priority wins before placement is considered.
+ * 
+ * @param by_priority Pick by effective priority
+ * @return Next thread from ready queue, or NULL if none can run here
  */
-static struct thread* remove_from_ready_queue(void) {
-    if (!ready_queue) {
-        return NULL;
+static struct thread* remove_from_ready_queue(bool by_priority) {
+    uint32_t cpu = smp_processor_id();
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
+    
+    struct thread **link = NULL;
+    bool link_placed = false;
+    for (struct thread **curr = &ready_queue; *curr; curr = &(*curr)->sched_next) {
+        struct thread *thread = *curr;
+        if (!can_run_on(thread, cpu)) {
+            continue;
+        }
+        
+        bool placed = thread->cpu == cpu;
+        if (link) {
+            struct thread *best = *link;
+            if (by_priority && thread->prio != best->prio) {
+                if (thread->prio > best->prio) {
+                    continue;
+                }
+            } else if (!placed || link_placed) {
+                continue;
+            }
+        }
+        
+        link = curr;
+        link_placed = placed;
     }
     
-    struct thread *thread = ready_queue;
-    ready_queue = thread->sched_next;
-    thread->sched_next = NULL;
+    struct thread *thread = link ? *link : NULL;
+    if (thread) {
+        *link = thread->sched_next;
+        thread->sched_next = NULL;
+        thread->cpu = cpu;
+    }
     
+    spin_unlock_irqrestore(&sched_lock, flags);
     return thread;
 }
 
+/**
+ * @brief Check whether a CPU may pull a queued thread
+ * 
+ * Isolated CPUs take part only for threads placed on them.
+ * 
+ * @param thread Queued thread
+ * @param cpu CPU looking for work
+ * @return true if the thread may run on cpu
+ */
+static bool can_run_on(struct thread *thread, uint32_t cpu) {
+    if (!cpumask_test_cpu(cpu, thread->cpus_allowed)) {
+        return false;
+    }
+    
+    return !cpumask_test_cpu(cpu, cpu_isolated_mask) || thread->cpu == cpu;
+}
+
+/**
+ * @brief Choose the CPU a thread being made runnable should run on
+ * 
+ * Prefers, in order: the previous CPU if it shares a cache with the waker,
+ * an idle CPU in the waker's LLC domain, any CPU in that domain, then any
+ * idle allowed CPU. Isolated CPUs are used only when affinity leaves no
+ * other choice.
+ * 
+ * @param thread Thread being enqueued
+ * @param waker_cpu CPU doing the wakeup
+ * @return Target CPU
+ */
+static uint32_t select_task_cpu(struct thread *thread, uint32_t waker_cpu) {
+    cpumask_t allowed = thread->cpus_allowed & cpu_online_mask;
+    
+    // Affinity lost every online CPU: fall back to any online CPU
+    if (!allowed) {
+        KWARN("Thread %u has no online CPU in its affinity mask", thread->tid);
+        allowed = cpu_online_mask;
+    }
+    
+    // Keep general work off isolated CPUs
+    if (allowed & ~cpu_isolated_mask) {
+        allowed &= ~cpu_isolated_mask;
+    }
+    
+    if (cpumask_test_cpu(thread->cpu, allowed) && cpus_share_cache(thread->cpu, waker_cpu)) {
+        return thread->cpu;
+    }
+    
+    cpumask_t llc = allowed & cpu_llc_mask(waker_cpu);
+    if (llc & idle_cpus) {
+        return cpumask_first(llc & idle_cpus);
+    }
+    if (llc) {
+        return cpumask_test_cpu(waker_cpu, llc) ? waker_cpu : cpumask_first(llc);
+    }
+    if (allowed & idle_cpus) {
+        return cpumask_first(allowed & idle_cpus);
+    }
+    
+    return cpumask_test_cpu(thread->cpu, allowed) ? thread->cpu : cpumask_first(allowed);
+}
+
 /**
  * @brief Update sleeping threads and wake up those whose time has expired
  */
 static void update_sleep_queue(void) {
     uint64_t current_time = get_system_time();
+    struct thread *expired = NULL;
+    uint64_t flags = spin_lock_irqsave(&sched_lock);
     struct thread *thread = sleeping_queue;
     struct thread *prev = NULL;
     
@@ -442,22 +892,113 @@ static void update_sleep_queue(void) {
         
         // Check if sleep time has expired
         if (thread->sleep_until <= current_time) {
-            // Remove from sleeping queue
+            // Move from sleeping queue to the local expired list
             if (prev) {
                 prev->sched_next = next;
             } else {
                 sleeping_queue = next;
             }
-            
-            // Wake up thread
-            wakeup(thread);
-            add_to_ready_queue(thread);
+            thread->sched_next = expired;
+            expired = thread;
         } else {
             prev = thread;
         }
         
         thread = next;
     }
+    
+    spin_unlock_irqrestore(&sched_lock, flags);
+    
+    // Wake up threads outside the lock; requeueing takes it again
+    while (expired) {
+        thread = expired;
+        expired = thread->sched_next;
+        
+        enqueue_woken(thread);
+    }
+}
+
+/**
+ * @brief Queue a blocked or sleeping thread and check for wakeup preemption
+ * 
+ * The thread must still be in its waiting state so add_to_ready_queue()
+ * sees a wakeup.
+ * 
+ * @param thread Thread being woken
+ */
+static void enqueue_woken(struct thread *thread) {
+    thread->sleep_until = 0;
+    thread->woken_at = rdtsc();
+    add_to_ready_queue(thread);
+    check_preempt_wakeup(thread);
+}
+
+/**
+ * @brief Flag the woken thread's CPU if the thread should run right away
+ * 
+ * Under the priority policies a woken thread that outranks the running one
+ * preempts it at the next interrupt return instead of waiting for the time
+ * slice to expire. Remote CPUs are flagged unconditionally and compare
+ * priorities when they reschedule.
+ * 
+ * @param thread Thread just queued
+ */
+static void check_preempt_wakeup(struct thread *thread) {
+    if (!scheduler_enabled || !preemption_enabled ||
+        (current_policy != SCHED_POLICY_PRIORITY && current_policy != SCHED_POLICY_REALTIME)) {
+        return;
+    }
+    
+    if (thread->cpu != smp_processor_id()) {
+        stats.wakeup_preemptions++;
+        resched_cpu(thread->cpu);
+        return;
+    }
+    
+    // An idle CPU picks the thread up when the interrupt returns anyway
+    struct thread *current = get_current_thread();
+    if (current && thread->prio < current->prio) {
+        stats.wakeup_preemptions++;
+        resched_cpu(thread->cpu);
+    }
+}
+
+/**
+ * @brief Requeue the running thread and schedule
+ */
+static void preempt_current(void) {
+    struct thread *current = get_current_thread();
+    
+    current->state = THREAD_STATE_READY;
+    add_to_ready_queue(current);
+    schedule();
+}
+
+/**
+ * @brief Record how long a woken thread waited before it was dispatched
+ * 
+ * @param thread Thread being switched in
+ */
+static void record_wakeup_latency(struct thread *thread) {
+    if (!thread->woken_at) {
+        return;
+    }
+    
+    uint64_t ns = cputime_cycles_to_ns(rdtsc() - thread->woken_at);
+    thread->woken_at = 0;
+    
+    uint32_t bucket = 0;
+    for (uint64_t us = ns / 1000; us > 1 && bucket < SCHED_LAT_BUCKETS - 1; us >>= 1) {
+        bucket++;
+    }
+    
+    struct sched_latency_hist *hist = &wakeup_latency[sched_prio_class(thread->prio)];
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->total_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
 }
 
 /**
@@ -471,8 +1012,7 @@ static void update_thread_statistics(struct thread *thread, uint64_t time_used)
         return;
     }
     
-    // Update thread statistics
-    // TODO: Add thread-specific CPU time tracking
+    // Per-thread time is charged in TSC cycles by cputime_switch()
     
     // Update process statistics
     thread->process->cpu_time += time_used;
@@ -13,6 +13,10 @@
 
 #include <types.h>
 #include "../arch/x86_64/arch.h"
+#include "../arch/x86_64/fpu.h"
+#include "cputime.h"
+#include "topology.h"
+#include "pressure.h"
 
 // Process States
 typedef enum {
@@ -60,6 +64,7 @@ struct process {
     uint64_t creation_time;     // Process creation time
     uint64_t cpu_time;          // Total CPU time used
     uint64_t last_scheduled;    // Last time scheduled
+    struct cputime cputime;     // TSC CPU time of all threads (cputime.h)
     
     // Priority and scheduling
     uint8_t priority;           // Process priority
@@ -75,12 +80,14 @@ struct process {
     // File descriptors and resources
     void *file_table;           // File descriptor table
     void *signal_handlers;      // Signal handler table
+    uint32_t trace_flags;       // PROC_TRACE_* (syscall_trace.h)
     
     // Process relationships
     struct process *parent;     // Parent process
     struct process *children;   // Child processes
-    struct process *next;       // Next in process list
+    struct process *next;       // Next in process list (RCU)
     struct process *prev;       // Previous in process list
+    struct rcu_head rcu;        // Deferred free after removal
 };
 
 // Thread Control Block (TCB)
@@ -91,6 +98,8 @@ struct thread {
     
     // CPU context
     struct cpu_state context;   // Saved CPU context
+    uint64_t kernel_rsp;        // Saved stack pointer while switched out
+    struct fpu fpu;             // Extended FPU/SIMD state (lazily saved)
     uint64_t stack_pointer;     // Stack pointer
     uint64_t stack_base;        // Stack base address
     size_t stack_size;          // Stack size
@@ -100,15 +109,27 @@ struct thread {
     uint32_t time_slice;        // Time slice
     uint32_t remaining_time;    // Remaining time
     uint64_t sleep_until;       // Sleep until time
+    uint8_t prio;               // Effective priority, raised by inheritance
+    cpumask_t cpus_allowed;     // CPUs the thread may run on
+    uint32_t cpu;               // CPU chosen at the last enqueue
+    struct thread_cputime cputime; // TSC CPU time and run delay (cputime.h)
+    struct worker *worker;      // Workqueue worker, NULL for other threads
+    uint64_t woken_at;          // TSC of the last wakeup, 0 once dispatched
+    uint32_t psi_flags;         // PSI_TSK_* task state (pressure.h)
+    bool in_iowait;             // Blocks count as waiting for I/O
     
     // Synchronization
     void *wait_queue;           // Wait queue if blocked
     void *mutex_list;           // Owned mutexes
+    struct list_head pi_waiters;    // Top waiters of owned rt_mutexes, by priority
+    struct rt_mutex_waiter *pi_blocked_on; // rt_mutex wait, NULL if none
     
     // Thread relationships
     struct process *process;    // Parent process
     struct thread *next;        // Next thread in process
     struct thread *sched_next;  // Next in scheduler queue
+    struct thread *list_next;   // Next in global thread list (RCU)
+    struct rcu_head rcu;        // Deferred free after removal
 };
 
 // Scheduler Statistics
@@ -120,18 +141,41 @@ struct scheduler_stats {
     uint32_t active_processes;  // Active process count
     uint32_t active_threads;    // Active thread count
     uint32_t runnable_threads;  // Runnable thread count
+    uint64_t wakeup_preemptions;    // Wakeups that flagged the CPU for rescheduling
+    uint64_t irq_preemptions;       // Preemptions on interrupt or syscall return
+    uint64_t voluntary_preemptions; // Preemptions at cond_resched() points
 };
 
+// Wakeup Latency Histograms
+// Wakeup-to-run latency per priority class (HIGH, NORMAL, LOW, IDLE ranges).
+// Bucket i counts latencies below 2^(i+1) us that are at least 2^i us;
+// bucket 0 also takes everything under 1 us.
+#define SCHED_LAT_CLASSES       4
+#define SCHED_LAT_BUCKETS       24
+
+struct sched_latency_hist {
+    uint64_t buckets[SCHED_LAT_BUCKETS];
+    uint64_t count;             // Wakeups measured
+    uint64_t total_ns;          // Sum of latencies
+    uint64_t max_ns;            // Longest latency
+};
+
+static inline uint32_t sched_prio_class(uint8_t prio) {
+    return prio < PRIORITY_NORMAL ? 0 : prio < PRIORITY_LOW ? 1 : prio < PRIORITY_IDLE ? 2 : 3;
+}
+
 // Scheduler Functions
 
 // Initialization Functions
 int process_init(void);
 int thread_init(void);
+void futex_init(void);
 
 // Helper Functions  
 void set_current_process(struct process *proc);
 void set_current_thread(struct thread *thread);
 uint64_t get_system_time(void);
+void thread_bootstrap(void (*entry_point)(void*), void *arg);
 
 // Process Management
 struct process* create_process(const char *name, uint32_t parent_pid);
@@ -158,6 +202,11 @@ int set_thread_priority(uint32_t tid, uint8_t priority);
 uint8_t get_process_priority(uint32_t pid);
 uint8_t get_thread_priority(uint32_t tid);
 
+// CPU Affinity
+int set_thread_affinity(uint32_t tid, cpumask_t mask);
+int get_thread_affinity(uint32_t tid, cpumask_t *mask);
+int sched_set_isolated_cpus(cpumask_t mask);
+
 // Process Control
 int suspend_process(uint32_t pid);
 int resume_process(uint32_t pid);
@@ -175,9 +224,32 @@ void scheduler_disable(void);
 void scheduler_tick(void);
 void scheduler_add_thread(struct thread *thread);
 void scheduler_remove_thread(struct thread *thread);
+bool wake_up_thread(struct thread *thread);
 int scheduler_set_policy(uint8_t policy);
 uint8_t scheduler_get_policy(void);
 void print_scheduler_status(void);
+bool scheduler_is_enabled(void);
+bool scheduler_tick_needed(void);
+uint64_t scheduler_next_wakeup(void);
+void scheduler_idle(void);
+
+// Preemption
+void resched_cpu(uint32_t cpu);
+bool need_resched(void);
+void preempt_schedule_irq(void);
+void cond_resched(void);
+const struct sched_latency_hist* sched_get_wakeup_latency(uint32_t prio_class);
+
+// Scheduler Benchmarks
+struct sched_bench_result {
+    uint32_t iterations;        // Yields per thread
+    uint64_t switches;          // Context switches measured
+    uint64_t total_cycles;      // TSC cycles for the whole run
+    uint64_t cycles_per_switch; // Average TSC cycles per switch
+    uint64_t fpu_traps;         // Lazy FPU traps taken during the run
+};
+
+int sched_bench_pingpong(uint32_t iterations, bool use_fpu, struct sched_bench_result *result);
 
 // Scheduler Policies
 #define SCHED_POLICY_ROUND_ROBIN    1
@@ -9,15 +9,20 @@
  */
 
 #include "scheduler.h"
+#include "idr.h"
+#include "rtmutex.h"
 #include "../include/kernel.h"
 #include "../include/panic.h"
+#include "../include/spinlock.h"
+#include "../include/rcu.h"
+#include "../include/syscall.h"
 #include "../mm/memory.h"
 #include "../arch/x86_64/arch.h"
 
 // Global thread management variables
 static struct thread *thread_list = NULL;     // Head of thread list
 static struct thread *current_thread = NULL;  // Currently running thread
-static uint32_t next_tid = 1;                // Next available TID
+static struct idr tid_idr;                   // TID to thread map
 static uint32_t thread_count = 0;            // Total number of threads
 static spinlock_t thread_lock = {0};         // Thread list lock
 
@@ -45,11 +50,19 @@ int thread_init(void) {
     // Initialize thread list
     thread_list = NULL;
     current_thread = NULL;
-    next_tid = 1;
     thread_count = 0;
     
+    // Initialize TID allocator
+    if (idr_init(&tid_idr, 1) != KERN_SUCCESS) {
+        KERROR("Failed to initialize TID allocator");
+        return KERN_NOMEM;
+    }
+    
     // Initialize locks
-    thread_lock.lock = 0;
+    spin_lock_init(&thread_lock);
+    
+    // Initialize the guarded stack area
+    vmstack_init();
     
     // Reset statistics
     memset(&thread_stats, 0, sizeof(thread_stats));
@@ -90,20 +103,36 @@ struct thread* create_thread(uint32_t pid, void (*entry_point)(void*), void *arg
     memset(thread, 0, sizeof(struct thread));
     
     // Set basic thread information
-    thread->tid = next_tid++;
+    uint64_t flags = spin_lock_irqsave(&thread_lock);
+    int result = idr_alloc_cyclic(&tid_idr, thread, &thread->tid);
+    spin_unlock_irqrestore(&thread_lock, flags);
+    if (result != KERN_SUCCESS) {
+        KERROR("Failed to allocate TID");
+        kfree(thread);
+        return NULL;
+    }
     thread->pid = pid;
     thread->state = THREAD_STATE_NEW;
     thread->process = parent_proc;
     
     // Set default priority and timing
     thread->priority = parent_proc->priority;
+    rt_mutex_init_task(thread);
     thread->time_slice = TIME_SLICE_DEFAULT;
     thread->remaining_time = thread->time_slice;
     thread->sleep_until = 0;
     
+    // Inherit affinity from a creating thread of the same process
+    thread->cpus_allowed = (current_thread && current_thread->process == parent_proc) ?
+                           current_thread->cpus_allowed : CPU_MASK_ALL;
+    thread->cpu = smp_processor_id();
+    
     // Allocate thread stack
     if (allocate_thread_stack(thread) != KERN_SUCCESS) {
         KERROR("Failed to allocate thread stack");
+        flags = spin_lock_irqsave(&thread_lock);
+        idr_remove(&tid_idr, thread->tid);
+        spin_unlock_irqrestore(&thread_lock, flags);
         kfree(thread);
         return NULL;
     }
@@ -120,6 +149,7 @@ struct thread* create_thread(uint32_t pid, void (*entry_point)(void*), void *arg
     thread->sched_next = NULL;
     
     // Add to parent process thread list
+    flags = spin_lock_irqsave(&thread_lock);
     if (parent_proc->threads == NULL) {
         parent_proc->threads = thread;
         parent_proc->main_thread = thread; // First thread is main thread
@@ -129,16 +159,13 @@ struct thread* create_thread(uint32_t pid, void (*entry_point)(void*), void *arg
     }
     parent_proc->thread_count++;
     
-    // Add to global thread list
-    if (thread_list == NULL) {
-        thread_list = thread;
-    } else {
-        thread->sched_next = thread_list;
-        thread_list = thread;
-    }
+    // Publish on the global thread list; readers may walk it concurrently
+    thread->list_next = thread_list;
+    rcu_assign_pointer(thread_list, thread);
     
     thread_count++;
     thread_stats.threads_created++;
+    spin_unlock_irqrestore(&thread_lock, flags);
     
     // Set thread state to ready
     thread->state = THREAD_STATE_READY;
@@ -168,13 +195,16 @@ int destroy_thread(uint32_t tid) {
     
     KINFO("Destroying thread TID %u", tid);
     
-    // Set thread state to terminated
+    // Set thread state to terminated and drop it from the run queues
     thread->state = THREAD_STATE_TERMINATED;
+    scheduler_remove_thread(thread);
     
-    // Clean up stack
+    // Clean up stack and extended FPU state
     cleanup_thread_stack(thread);
+    fpu_release(&thread->fpu);
     
     // Remove from parent process thread list
+    uint64_t flags = spin_lock_irqsave(&thread_lock);
     if (thread->process) {
         struct thread **curr = &thread->process->threads;
         while (*curr) {
@@ -193,24 +223,24 @@ int destroy_thread(uint32_t tid) {
         thread->process->thread_count--;
     }
     
-    // Remove from global thread list
-    if (thread_list == thread) {
-        thread_list = thread->sched_next;
-    } else {
-        struct thread *curr = thread_list;
-        while (curr && curr->sched_next != thread) {
-            curr = curr->sched_next;
-        }
-        if (curr) {
-            curr->sched_next = thread->sched_next;
-        }
+    // Unlink from the global thread list; list_next stays valid for readers
+    struct thread **link = &thread_list;
+    while (*link && *link != thread) {
+        link = &(*link)->list_next;
+    }
+    if (*link) {
+        rcu_assign_pointer(*link, thread->list_next);
     }
     
-    // Free the thread structure
-    kfree(thread);
+    // Release the TID; it is recycled only after the TID space wraps
+    idr_remove(&tid_idr, tid);
     
     thread_count--;
     thread_stats.threads_destroyed++;
+    spin_unlock_irqrestore(&thread_lock, flags);
+    
+    // Free the thread structure once lockless readers are done with it
+    kfree_rcu(thread, rcu);
     
     KINFO("Thread TID %u destroyed successfully", tid);
     return KERN_SUCCESS;
@@ -219,20 +249,14 @@ int destroy_thread(uint32_t tid) {
 /**
  * @brief Get thread by TID
  * 
+ * Lockless lookup; the thread stays valid until rcu_read_unlock() when
+ * called inside an RCU read-side section.
+ * 
  * @param tid Thread ID to find
  * @return Pointer to thread on success, NULL if not found
  */
 struct thread* get_thread(uint32_t tid) {
-    struct thread *thread = thread_list;
-    
-    while (thread) {
-        if (thread->tid == tid) {
-            return thread;
-        }
-        thread = thread->sched_next;
-    }
-    
-    return NULL;
+    return (struct thread*)idr_find(&tid_idr, tid);
 }
 
 /**
@@ -253,6 +277,9 @@ void set_current_thread(struct thread *thread) {
     current_thread = thread;
     if (thread) {
         thread->state = THREAD_STATE_RUNNING;
+        
+        // SYSCALL from this thread enters on its own kernel stack
+        syscall_set_kernel_stack(thread->stack_base + thread->stack_size);
     }
 }
 
@@ -273,7 +300,8 @@ int set_thread_priority(uint32_t tid, uint8_t priority) {
         return KERN_NOTFOUND;
     }
     
-    thread->priority = priority;
+    // Inherited boosts stay in effect until the locks are released
+    rt_mutex_setprio(thread, priority);
     KINFO("Set thread %u priority to %u", tid, priority);
     return KERN_SUCCESS;
 }
@@ -293,6 +321,97 @@ uint8_t get_thread_priority(uint32_t tid) {
     return thread->priority;
 }
 
+/**
+ * @brief Set the CPUs a thread may run on
+ * 
+ * The mask must contain at least one online CPU. A running thread that
+ * loses its current CPU is moved off it before this returns.
+ * 
+ * @param tid Thread ID, 0 for the current thread
+ * @param mask Allowed CPUs
+ * @return 0 on success, negative error code on failure
+ */
+int set_thread_affinity(uint32_t tid, cpumask_t mask) {
+    if (!(mask & cpu_online_mask)) {
+        return KERN_INVALID;
+    }
+    
+    struct thread *thread = tid ? get_thread(tid) : current_thread;
+    if (!thread) {
+        return KERN_NOTFOUND;
+    }
+    
+    thread->cpus_allowed = mask;
+    KINFO("Set thread %u affinity to 0x%016lX", thread->tid, mask);
+    
+    // Migrate away from a CPU that is no longer allowed
+    if (thread == current_thread && !cpumask_test_cpu(smp_processor_id(), mask)) {
+        yield();
+    }
+    
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Get the CPUs a thread may run on
+ * 
+ * @param tid Thread ID, 0 for the current thread
+ * @param mask Receives the allowed CPUs
+ * @return 0 on success, negative error code on failure
+ */
+int get_thread_affinity(uint32_t tid, cpumask_t *mask) {
+    if (!mask) {
+        return KERN_INVALID;
+    }
+    
+    struct thread *thread = tid ? get_thread(tid) : current_thread;
+    if (!thread) {
+        return KERN_NOTFOUND;
+    }
+    
+    *mask = thread->cpus_allowed;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_SCHED_SETAFFINITY handler
+ * 
+ * @param tid Thread ID, 0 for the caller
+ * @param size Size of the user mask in bytes
+ * @param uaddr User address of the CPU mask
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_sched_setaffinity(uint64_t tid, uint64_t size, uint64_t uaddr) {
+    if (!uaddr || size < sizeof(cpumask_t)) {
+        return KERN_INVALID;
+    }
+    
+    return set_thread_affinity((uint32_t)tid, *(const cpumask_t*)uaddr);
+}
+
+/**
+ * @brief SYS_SCHED_GETAFFINITY handler
+ * 
+ * @param tid Thread ID, 0 for the caller
+ * @param size Size of the user buffer in bytes
+ * @param uaddr User address receiving the CPU mask
+ * @return Bytes written on success, negative error code on failure
+ */
+int64_t sys_sched_getaffinity(uint64_t tid, uint64_t size, uint64_t uaddr) {
+    if (!uaddr || size < sizeof(cpumask_t)) {
+        return KERN_INVALID;
+    }
+    
+    cpumask_t mask;
+    int result = get_thread_affinity((uint32_t)tid, &mask);
+    if (result != KERN_SUCCESS) {
+        return result;
+    }
+    
+    *(cpumask_t*)uaddr = mask;
+    return sizeof(cpumask_t);
+}
+
 /**
  * @brief Make thread sleep for specified time
  * 
@@ -327,6 +446,31 @@ void wakeup(struct thread *thread) {
     }
 }
 
+/**
+ * @brief First C code run by a new thread
+ * 
+ * Entered from thread_entry_trampoline after the first switch to the thread.
+ * 
+ * @param entry_point Thread entry point function
+ * @param arg Argument to pass to entry point
+ */
+void thread_bootstrap(void (*entry_point)(void*), void *arg) {
+    // A switch may happen from the timer interrupt with interrupts disabled
+    sti();
+    
+    entry_point(arg);
+    
+    // Entry returned: park the thread until it is destroyed
+    if (current_thread) {
+        current_thread->state = THREAD_STATE_TERMINATED;
+    }
+    
+    while (1) {
+        schedule();
+        halt();
+    }
+}
+
 /**
  * @brief Print list of threads for a process
  * 
@@ -345,13 +489,14 @@ void print_thread_list(uint32_t pid) {
     printf("║ TID │ PID │ STATE           │ PRIORITY │ TIME SLICE│ SLEEP    ║\n");
     printf("╠═════╪═════╪═════════════════╪══════════╪═══════════╪══════════╣\n");
     
-    struct thread *thread = thread_list;
+    rcu_read_lock();
+    struct thread *thread = rcu_dereference(thread_list);
     int count = 0;
     
     while (thread && count < 20) { // Limit display to 20 threads
         // Filter by PID if specified
         if (pid != 0 && thread->pid != pid) {
-            thread = thread->sched_next;
+            thread = rcu_dereference(thread->list_next);
             continue;
         }
         
@@ -370,13 +515,14 @@ void print_thread_list(uint32_t pid) {
                thread->tid, thread->pid, state_str, thread->priority, 
                thread->remaining_time, thread->sleep_until);
         
-        thread = thread->sched_next;
+        thread = rcu_dereference(thread->list_next);
         count++;
     }
     
     if (thread != NULL) {
         printf("║     │     │ ... (more)      │          │           │          ║\n");
     }
+    rcu_read_unlock();
     
     printf("╚═════╧═════╧═════════════════╧══════════╧═══════════╧══════════╝\n");
     printf("Total Threads: %u | Created: %lu | Destroyed: %lu\n",
@@ -401,13 +547,15 @@ void* get_thread_stats(void) {
     
     // Count runnable threads
     uint32_t runnable = 0;
-    struct thread *thread = thread_list;
+    rcu_read_lock();
+    struct thread *thread = rcu_dereference(thread_list);
     while (thread) {
         if (thread->state == THREAD_STATE_READY || thread->state == THREAD_STATE_RUNNING) {
             runnable++;
         }
-        thread = thread->sched_next;
+        thread = rcu_dereference(thread->list_next);
     }
+    rcu_read_unlock();
     
     stats.total_threads = thread_count;
     stats.active_threads = thread_count;
@@ -428,26 +576,17 @@ void* get_thread_stats(void) {
  * @return 0 on success, negative error code on failure
  */
 static int allocate_thread_stack(struct thread *thread) {
-    // Default stack size: 64KB
-    const size_t stack_size = 64 * 1024;
-    
-    // Allocate stack memory
-    void *stack = kmalloc(stack_size);
+    // Guarded, page-aligned stack from the stack area (mm/vmstack.c)
+    uint64_t stack = vmstack_alloc();
     if (!stack) {
         KERROR("Failed to allocate thread stack");
         return KERN_NOMEM;
     }
     
     // Set up stack information
-    thread->stack_base = (uint64_t)stack;
-    thread->stack_size = stack_size;
-    thread->stack_pointer = thread->stack_base + stack_size - sizeof(uint64_t);
-    
-    // Initialize stack with canary values for debugging
-    uint64_t *stack_words = (uint64_t*)stack;
-    for (size_t i = 0; i < stack_size / sizeof(uint64_t); i++) {
-        stack_words[i] = 0xDEADBEEFCAFEBABE;
-    }
+    thread->stack_base = stack;
+    thread->stack_size = THREAD_STACK_SIZE;
+    thread->stack_pointer = thread->stack_base + THREAD_STACK_SIZE - sizeof(uint64_t);
     
     return KERN_SUCCESS;
 }
@@ -459,9 +598,8 @@ static int allocate_thread_stack(struct thread *thread) {
  */
 static void cleanup_thread_stack(struct thread *thread) {
     if (thread->stack_base) {
-        // Clear stack memory before freeing
-        memset((void*)thread->stack_base, 0, thread->stack_size);
-        kfree((void*)thread->stack_base);
+        // Back to the per-CPU stack cache, or unmapped if the cache is full
+        vmstack_free(thread->stack_base);
         
         thread->stack_base = 0;
         thread->stack_size = 0;
@@ -497,5 +635,24 @@ static void init_thread_context(struct thread *thread, void (*entry_point)(void*
     // Set up flags (enable interrupts)
     thread->context.rflags = 0x202;  // IF flag set
     
+    // Build the initial switch_to_asm() frame: callee-saved registers
+    // followed by the return address of thread_entry_trampoline. The
+    // trampoline is entered with a 16-byte aligned stack as the ABI expects.
+    uint64_t top = (thread->stack_base + thread->stack_size) & ~0xFULL;
+    uint64_t *frame = (uint64_t*)(top - 16 - 7 * sizeof(uint64_t));
+    frame[0] = 0;                                   // r15
+    frame[1] = 0;                                   // r14
+    frame[2] = (uint64_t)arg;                       // r13: entry argument
+    frame[3] = (uint64_t)entry_point;               // r12: entry point
+    frame[4] = 0;                                   // rbx
+    frame[5] = 0;                                   // rbp
+    frame[6] = (uint64_t)thread_entry_trampoline;   // return address
+    ((uint64_t*)(top - 16))[0] = 0;                 // Terminate stack traces
+    ((uint64_t*)(top - 16))[1] = 0;
+    thread->kernel_rsp = (uint64_t)frame;
+    
+    // No FPU state until the thread executes its first FPU instruction
+    fpu_init_thread(&thread->fpu);
+    
     KINFO("Initialized thread context for TID %u", thread->tid);
 } 
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*
+ * FG-OS CPU Topology
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Tracks which CPUs are online and isolated, and groups CPUs into
+ * last-level cache domains from CPUID so wakeups can stay cache-warm.
+ * Each CPU reads its own APIC ID and cache sharing when it comes online.
+ */
+
+#include "topology.h"
+#include "../include/kernel.h"
+#include "../arch/x86_64/arch.h"
+
+// CPU sets
+cpumask_t cpu_online_mask = 0;
+cpumask_t cpu_isolated_mask = 0;
+
+// Per-CPU topology
+static struct cpu_topology topology[MAX_CPUS];
+
+// CPUID deterministic cache parameters
+#define CPUID_CACHE_PARAMS      0x04
+#define CPUID_CACHE_TYPE_NULL   0
+
+// Forward declarations
+static uint32_t detect_llc_shift(void);
+
+/**
+ * @brief Initialize topology with the boot CPU online
+ */
+void topology_init(void) {
+    memset(topology, 0, sizeof(topology));
+    cpu_online_mask = 0;
+    cpu_isolated_mask = 0;
+
+    topology_cpu_online(smp_processor_id());
+}
+
+/**
+ * @brief Record the calling CPU's topology and mark it online
+ *
+ * Must run on the CPU being brought online.
+ *
+ * @param cpu CPU number
+ */
+void topology_cpu_online(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+
+    topology[cpu].apic_id = ebx >> 24;
+    topology[cpu].llc_id = topology[cpu].apic_id >> detect_llc_shift();
+    topology[cpu].node = 0;
+
+    __atomic_or_fetch(&cpu_online_mask, CPU_MASK_CPU(cpu), __ATOMIC_RELEASE);
+
+    KINFO("CPU %u online (APIC ID %u, LLC domain %u)",
+          cpu, topology[cpu].apic_id, topology[cpu].llc_id);
+}
+
+/**
+ * @brief Get the online CPUs sharing a CPU's last-level cache
+ *
+ * @param cpu CPU number
+ * @return Mask of CPUs in the same LLC domain, including cpu
+ */
+cpumask_t cpu_llc_mask(uint32_t cpu) {
+    cpumask_t mask = CPU_MASK_NONE;
+
+    if (!cpumask_test_cpu(cpu, cpu_online_mask)) {
+        return mask;
+    }
+
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        uint32_t other = cpumask_first(online);
+        if (topology[other].llc_id == topology[cpu].llc_id) {
+            mask |= CPU_MASK_CPU(other);
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Check whether two CPUs share a last-level cache
+ *
+ * @param cpu_a First CPU
+ * @param cpu_b Second CPU
+ * @return true if both are online in the same LLC domain
+ */
+bool cpus_share_cache(uint32_t cpu_a, uint32_t cpu_b) {
+    if (!cpumask_test_cpu(cpu_a, cpu_online_mask) || !cpumask_test_cpu(cpu_b, cpu_online_mask)) {
+        return false;
+    }
+
+    return topology[cpu_a].llc_id == topology[cpu_b].llc_id;
+}
+
+/**
+ * @brief Get the topology of a CPU
+ *
+ * @param cpu CPU number
+ * @return Topology entry, NULL if cpu is out of range
+ */
+const struct cpu_topology* cpu_get_topology(uint32_t cpu) {
+    return cpu < MAX_CPUS ? &topology[cpu] : NULL;
+}
+
+/**
+ * @brief Print online CPUs and their cache domains
+ */
+void print_cpu_topology(void) {
+    printf("CPU  APIC  LLC  Node  Isolated\n");
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        uint32_t cpu = cpumask_first(online);
+        printf("%3u  %4u  %3u  %4u  %s\n", cpu, topology[cpu].apic_id,
+               topology[cpu].llc_id, topology[cpu].node,
+               cpumask_test_cpu(cpu, cpu_isolated_mask) ? "yes" : "no");
+    }
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Get how many low APIC ID bits distinguish CPUs sharing the LLC
+ *
+ * @return Shift that maps an APIC ID to its LLC domain
+ */
+static uint32_t detect_llc_shift(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t sharing = 1;
+
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax < CPUID_CACHE_PARAMS) {
+        return 0;
+    }
+
+    // The last cache reported is the last level
+    for (uint32_t index = 0; ; index++) {
+        cpuid_count(CPUID_CACHE_PARAMS, index, &eax, &ebx, &ecx, &edx);
+        if ((eax & 0x1F) == CPUID_CACHE_TYPE_NULL) {
+            break;
+        }
+        sharing = ((eax >> 14) & 0xFFF) + 1;
+    }
+
+    uint32_t shift = 0;
+    while ((1U << shift) < sharing) {
+        shift++;
+    }
+    return shift;
+}
@@ -0,0 +1,56 @@
+/*
+ * FG-OS CPU Topology Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * CPU masks, online and isolated CPU sets, and last-level cache domains.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <types.h>
+#include "../include/kernel.h"
+
+// CPU Mask (one bit per CPU, MAX_CPUS <= 64)
+typedef uint64_t cpumask_t;
+
+#define CPU_MASK_NONE           ((cpumask_t)0)
+#define CPU_MASK_ALL            (~(cpumask_t)0)
+#define CPU_MASK_CPU(cpu)       ((cpumask_t)1 << (cpu))
+
+static inline bool cpumask_test_cpu(uint32_t cpu, cpumask_t mask) {
+    return cpu < MAX_CPUS && (mask & CPU_MASK_CPU(cpu));
+}
+
+static inline uint32_t cpumask_weight(cpumask_t mask) {
+    return (uint32_t)__builtin_popcountll(mask);
+}
+
+// First CPU in the mask, MAX_CPUS if empty
+static inline uint32_t cpumask_first(cpumask_t mask) {
+    return mask ? (uint32_t)__builtin_ctzll(mask) : MAX_CPUS;
+}
+
+// Topology Information
+struct cpu_topology {
+    uint32_t apic_id;           // Initial APIC ID
+    uint32_t llc_id;            // Last-level cache domain
+    uint32_t node;              // NUMA node (0 until SRAT is parsed)
+};
+
+// CPU Sets
+extern cpumask_t cpu_online_mask;   // CPUs running the scheduler
+extern cpumask_t cpu_isolated_mask; // CPUs excluded from general balancing
+
+// Topology Interface
+void topology_init(void);
+void topology_cpu_online(uint32_t cpu);
+cpumask_t cpu_llc_mask(uint32_t cpu);
+bool cpus_share_cache(uint32_t cpu_a, uint32_t cpu_b);
+const struct cpu_topology* cpu_get_topology(uint32_t cpu);
+void print_cpu_topology(void);
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,215 @@
+/*
+ * FG-OS Wait Queue Implementation
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Blocking and wakeup of threads on wait queues. Timeouts are hrtimers,
+ * so a timed wait costs no polling and is not rounded up to a tick.
+ */
+
+#include "wait.h"
+#include "scheduler.h"
+#include "../include/kernel.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/interrupt.h"
+#include "../interrupt/clocksource.h"
+#include "../interrupt/hrtimer.h"
+
+// Forward declarations
+static hrtimer_restart_t wait_timeout_expired(hrtimer_t *timer);
+
+/**
+ * @brief Initialize a wait queue head
+ *
+ * @param wq Wait queue to initialize
+ */
+void init_waitqueue_head(wait_queue_head_t *wq) {
+    INIT_LIST_HEAD(&wq->head);
+}
+
+/**
+ * @brief Initialize a wait queue entry
+ *
+ * @param wait Entry to initialize
+ * @param thread Thread that will wait
+ * @param flags WQ_FLAG_* flags
+ */
+void init_waitqueue_entry(struct wait_queue_entry *wait, struct thread *thread, uint32_t flags) {
+    INIT_LIST_HEAD(&wait->entry);
+    wait->thread = thread;
+    wait->flags = flags;
+    wait->woken = false;
+}
+
+/**
+ * @brief Queue an entry on a wait queue
+ *
+ * @param wq Wait queue
+ * @param wait Entry to queue
+ */
+void add_wait_queue(wait_queue_head_t *wq, struct wait_queue_entry *wait) {
+    uint64_t flags = interrupts_disable();
+
+    if (wait->flags & WQ_FLAG_EXCLUSIVE) {
+        list_add_tail(&wait->entry, &wq->head);
+    } else {
+        list_add(&wait->entry, &wq->head);
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Remove an entry from its wait queue, if still queued
+ *
+ * @param wait Entry to remove
+ */
+void remove_wait_queue(struct wait_queue_entry *wait) {
+    uint64_t flags = interrupts_disable();
+
+    if (!list_empty(&wait->entry)) {
+        list_del_init(&wait->entry);
+    }
+
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Block the current thread on a queued entry
+ *
+ * @param wait Entry already added to a wait queue
+ * @param timeout_ms Timeout in milliseconds, WAIT_FOREVER for none
+ * @return 0 when woken, KERN_TIMEOUT on timeout, KERN_BUSY without a thread context
+ */
+int wait_entry_sleep(struct wait_queue_entry *wait, uint64_t timeout_ms) {
+    struct thread *self = get_current_thread();
+    if (!self || wait->thread != self) {
+        remove_wait_queue(wait);
+        return KERN_BUSY;
+    }
+
+    uint64_t flags = interrupts_disable();
+
+    hrtimer_t timer;
+    hrtimer_setup(&timer, wait_timeout_expired, wait);
+    if (timeout_ms != WAIT_FOREVER) {
+        hrtimer_start(&timer, timeout_ms * NSEC_PER_MSEC, HRTIMER_MODE_REL);
+    }
+
+    // The waker may already have run between queueing and here
+    while (!wait->woken && !list_empty(&wait->entry)) {
+        self->wait_queue = wait;
+        self->state = THREAD_STATE_BLOCKED;
+        schedule();
+    }
+    self->wait_queue = NULL;
+
+    hrtimer_cancel(&timer);
+    if (!list_empty(&wait->entry)) {
+        list_del_init(&wait->entry);
+    }
+
+    interrupts_restore(flags);
+    return wait->woken ? KERN_SUCCESS : KERN_TIMEOUT;
+}
+
+/**
+ * @brief Block the current thread on a wait queue
+ *
+ * @param wq Wait queue
+ * @param exclusive Wait as an exclusive waiter
+ * @param timeout_ms Timeout in milliseconds, WAIT_FOREVER for none
+ * @return 0 when woken, KERN_TIMEOUT on timeout, KERN_BUSY without a thread context
+ */
+int wait_queue_sleep(wait_queue_head_t *wq, bool exclusive, uint64_t timeout_ms) {
+    struct wait_queue_entry wait;
+
+    init_waitqueue_entry(&wait, get_current_thread(), exclusive ? WQ_FLAG_EXCLUSIVE : 0);
+    add_wait_queue(wq, &wait);
+
+    return wait_entry_sleep(&wait, timeout_ms);
+}
+
+/**
+ * @brief Wake the thread of a single entry and dequeue it
+ *
+ * @param wait Entry to wake
+ * @return true if the entry was waiting
+ */
+bool wake_up_entry(struct wait_queue_entry *wait) {
+    uint64_t flags = interrupts_disable();
+
+    bool was_queued = !list_empty(&wait->entry);
+    if (was_queued) {
+        list_del_init(&wait->entry);
+        wait->woken = true;
+        wake_up_thread(wait->thread);
+    }
+
+    interrupts_restore(flags);
+    return was_queued;
+}
+
+/**
+ * @brief Wake waiters of a wait queue
+ *
+ * All non-exclusive waiters are woken, followed by up to nr_exclusive
+ * exclusive waiters in FIFO order.
+ *
+ * @param wq Wait queue
+ * @param nr_exclusive Exclusive waiters to wake, 0 for all
+ * @return Number of threads woken
+ */
+uint32_t __wake_up(wait_queue_head_t *wq, uint32_t nr_exclusive) {
+    struct wait_queue_entry *wait, *next;
+    uint32_t woken = 0;
+    uint64_t flags = interrupts_disable();
+
+    list_for_each_entry_safe(wait, next, &wq->head, entry) {
+        bool exclusive = (wait->flags & WQ_FLAG_EXCLUSIVE) != 0;
+
+        wake_up_entry(wait);
+        woken++;
+
+        if (exclusive && nr_exclusive && --nr_exclusive == 0) {
+            break;
+        }
+    }
+
+    interrupts_restore(flags);
+    return woken;
+}
+
+/**
+ * @brief Check whether a wait queue has waiters
+ *
+ * @param wq Wait queue
+ * @return true if at least one entry is queued
+ */
+bool waitqueue_active(const wait_queue_head_t *wq) {
+    return !list_empty(&wq->head);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Timer callback ending a timed wait
+ *
+ * @param timer Expired timeout timer
+ * @return HRTIMER_NORESTART
+ */
+static hrtimer_restart_t wait_timeout_expired(hrtimer_t *timer) {
+    struct wait_queue_entry *wait = (struct wait_queue_entry*)timer->data;
+    uint64_t flags = interrupts_disable();
+
+    if (!wait->woken && !list_empty(&wait->entry)) {
+        // Dequeue without setting woken so the sleeper reports a timeout
+        list_del_init(&wait->entry);
+        wake_up_thread(wait->thread);
+    }
+
+    interrupts_restore(flags);
+    return HRTIMER_NORESTART;
+}
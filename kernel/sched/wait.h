@@ -0,0 +1,55 @@
+/*
+ * FG-OS Wait Queue Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Kernel wait queues with exclusive and non-exclusive wakeups.
+ */
+
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <types.h>
+#include "../include/list.h"
+
+// Wait Entry Flags
+#define WQ_FLAG_EXCLUSIVE       (1 << 0)  // Woken one at a time
+
+// Wait Queue Entry
+// Non-exclusive entries are queued at the head and are all woken by any
+// wakeup; exclusive entries are queued at the tail and woken in FIFO order
+// up to the count passed to __wake_up().
+struct wait_queue_entry {
+    struct list_head entry;     // Link in wait_queue_head_t
+    struct thread *thread;      // Waiting thread
+    uint32_t flags;             // WQ_FLAG_*
+    volatile bool woken;        // Set by the waker before the thread runs
+};
+
+// Static initializer for a wait queue head
+#define WAIT_QUEUE_HEAD_INIT(name) { LIST_HEAD_INIT((name).head) }
+
+// Wait Queue Interface
+// Callers check their wait condition and queue themselves with interrupts
+// disabled, so a wakeup between the check and the sleep is never lost.
+void init_waitqueue_head(wait_queue_head_t *wq);
+void init_waitqueue_entry(struct wait_queue_entry *wait, struct thread *thread, uint32_t flags);
+void add_wait_queue(wait_queue_head_t *wq, struct wait_queue_entry *wait);
+void remove_wait_queue(struct wait_queue_entry *wait);
+int wait_entry_sleep(struct wait_queue_entry *wait, uint64_t timeout_ms);
+int wait_queue_sleep(wait_queue_head_t *wq, bool exclusive, uint64_t timeout_ms);
+bool wake_up_entry(struct wait_queue_entry *wait);
+uint32_t __wake_up(wait_queue_head_t *wq, uint32_t nr_exclusive);
+bool waitqueue_active(const wait_queue_head_t *wq);
+
+// Wakeup Helpers
+#define wake_up(wq)             __wake_up((wq), 1)
+#define wake_up_nr(wq, nr)      __wake_up((wq), (nr))
+#define wake_up_all(wq)         __wake_up((wq), 0)
+
+// Timeout value meaning "wait forever"
+#define WAIT_FOREVER            0
+
+#endif // WAIT_H
@@ -0,0 +1,508 @@
+/*
+ * FG-OS Work Queues
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Each online CPU has a pool of kernel worker threads that run queued work
+ * items in thread context, where they may sleep. Pools are concurrency
+ * managed: normally a single worker runs items back to back, and only when
+ * it blocks does the scheduler hook wake an idle worker to keep the
+ * worklist moving. A worker about to start work makes sure another idle
+ * worker exists, so there is always one to wake.
+ */
+
+#include "workqueue.h"
+#include "scheduler.h"
+#include "wait.h"
+#include "topology.h"
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+
+// Worker Thread
+struct worker {
+    struct list_head node;              // Entry in pool->workers
+    struct thread *task;                // Worker thread
+    struct worker_pool *pool;           // Owning pool
+    struct work_struct *current_work;   // Item being run, NULL if none
+    bool idle;                          // Waiting on pool->idle_wq
+};
+
+// Per-CPU Worker Pool
+struct worker_pool {
+    uint32_t cpu;                       // CPU the workers are bound to
+    spinlock_t lock;                    // Protects worklist, workers and counts
+    struct list_head worklist;          // Queued work items
+    struct list_head workers;           // All workers
+    wait_queue_head_t idle_wq;          // Idle workers
+    volatile uint32_t nr_running;       // Non-idle workers not blocked
+    uint32_t nr_idle;                   // Idle workers
+    uint32_t nr_workers;                // Workers, including ones being created
+    bool online;                        // Pool has been started
+};
+
+static struct worker_pool worker_pools[MAX_CPUS];
+static struct process *kworker_process = NULL;
+
+// Flushers wait here for work items to complete
+static wait_queue_head_t flush_wq;
+
+// All work queues
+static struct list_head workqueues = LIST_HEAD_INIT(workqueues);
+static spinlock_t workqueues_lock;
+
+struct workqueue_struct *system_wq = NULL;
+
+static struct workqueue_stats stats = {0};
+
+// Forward declarations
+static struct worker_pool* get_work_pool(void);
+static int create_worker(struct worker_pool *pool);
+static void worker_thread(void *arg);
+static void worker_enter_idle(struct worker *worker);
+static void worker_leave_idle(struct worker *worker);
+static bool need_more_worker(struct worker_pool *pool);
+static bool work_is_running(struct worker_pool *pool, struct work_struct *work);
+
+/**
+ * @brief Start the worker pools of online CPUs and the system queue
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int workqueue_init(void) {
+    memset(worker_pools, 0, sizeof(worker_pools));
+    memset(&stats, 0, sizeof(stats));
+    init_waitqueue_head(&flush_wq);
+    spin_lock_init(&workqueues_lock);
+
+    kworker_process = create_process("kworker", 0);
+    if (!kworker_process) {
+        KERROR("Failed to create worker process");
+        return KERN_NOMEM;
+    }
+
+    for (cpumask_t online = cpu_online_mask; online; online &= online - 1) {
+        struct worker_pool *pool = &worker_pools[cpumask_first(online)];
+
+        pool->cpu = cpumask_first(online);
+        spin_lock_init(&pool->lock);
+        INIT_LIST_HEAD(&pool->worklist);
+        INIT_LIST_HEAD(&pool->workers);
+        init_waitqueue_head(&pool->idle_wq);
+
+        pool->nr_workers = 1;
+        if (create_worker(pool) != KERN_SUCCESS) {
+            return KERN_NOMEM;
+        }
+        pool->online = true;
+    }
+
+    system_wq = alloc_workqueue("events");
+    if (!system_wq) {
+        return KERN_NOMEM;
+    }
+
+    KINFO("Work queues initialized (%u worker pools)", cpumask_weight(cpu_online_mask));
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Create a work queue
+ *
+ * @param name Queue name
+ * @return New queue, NULL if out of memory
+ */
+struct workqueue_struct* alloc_workqueue(const char *name) {
+    struct workqueue_struct *wq = (struct workqueue_struct*)kmalloc(sizeof(struct workqueue_struct));
+    if (!wq) {
+        return NULL;
+    }
+
+    memset(wq, 0, sizeof(struct workqueue_struct));
+    strncpy(wq->name, name ? name : "wq", WQ_NAME_LEN - 1);
+
+    uint64_t flags = spin_lock_irqsave(&workqueues_lock);
+    list_add_tail(&wq->list, &workqueues);
+    spin_unlock_irqrestore(&workqueues_lock, flags);
+
+    return wq;
+}
+
+/**
+ * @brief Flush and free a work queue
+ *
+ * @param wq Queue created by alloc_workqueue()
+ */
+void destroy_workqueue(struct workqueue_struct *wq) {
+    if (!wq || wq == system_wq) {
+        return;
+    }
+
+    flush_workqueue(wq);
+
+    uint64_t flags = spin_lock_irqsave(&workqueues_lock);
+    list_del_init(&wq->list);
+    spin_unlock_irqrestore(&workqueues_lock, flags);
+
+    kfree(wq);
+}
+
+/**
+ * @brief Queue a work item on the current CPU's pool
+ *
+ * Safe from interrupt context. An item already pending is left where it is.
+ *
+ * @param wq Queue the item is accounted to
+ * @param work Work item
+ * @return true if queued, false if it was already pending
+ */
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work) {
+    if (!wq || !work || !work->func) {
+        return false;
+    }
+
+    if (__atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQ_REL)) {
+        stats.requeue_skipped++;
+        return false;
+    }
+
+    struct worker_pool *pool = get_work_pool();
+
+    uint64_t flags = spin_lock_irqsave(&pool->lock);
+    work->wq = wq;
+    work->pool = pool;
+    list_add_tail(&work->entry, &pool->worklist);
+    wq->nr_in_flight++;
+    stats.queued++;
+    bool wake = need_more_worker(pool) && pool->nr_idle;
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    if (wake) {
+        wake_up(&pool->idle_wq);
+    }
+    return true;
+}
+
+/**
+ * @brief Queue a work item on the system queue
+ *
+ * @param work Work item
+ * @return true if queued, false if it was already pending
+ */
+bool schedule_work(struct work_struct *work) {
+    return queue_work(system_wq, work);
+}
+
+/**
+ * @brief Remove a pending work item before it starts
+ *
+ * @param work Work item
+ * @return true if the item was pending and will not run
+ */
+bool cancel_work(struct work_struct *work) {
+    struct worker_pool *pool = work ? work->pool : NULL;
+    if (!pool) {
+        return false;
+    }
+
+    bool cancelled = false;
+    uint64_t flags = spin_lock_irqsave(&pool->lock);
+    if (work->pending && !list_empty(&work->entry)) {
+        list_del_init(&work->entry);
+        work->pending = 0;
+        work->wq->nr_in_flight--;
+        cancelled = true;
+    }
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    if (cancelled && waitqueue_active(&flush_wq)) {
+        wake_up_all(&flush_wq);
+    }
+    return cancelled;
+}
+
+/**
+ * @brief Wait until a work item is neither pending nor running
+ *
+ * Must be called from thread context.
+ *
+ * @param work Work item
+ */
+void flush_work(struct work_struct *work) {
+    struct worker_pool *pool = work ? work->pool : NULL;
+    if (!pool) {
+        return;
+    }
+
+    // A work function flushing itself would wait forever
+    struct thread *self = get_current_thread();
+    if (self && self->worker && self->worker->current_work == work) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&pool->lock);
+    while (work->pending || work_is_running(pool, work)) {
+        spin_unlock(&pool->lock);
+        wait_queue_sleep(&flush_wq, false, WAIT_FOREVER);
+        spin_lock(&pool->lock);
+    }
+    spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+/**
+ * @brief Wait until every item queued on a queue has run
+ *
+ * Must be called from thread context.
+ *
+ * @param wq Work queue
+ */
+void flush_workqueue(struct workqueue_struct *wq) {
+    if (!wq) {
+        return;
+    }
+
+    uint64_t flags = interrupts_disable();
+    while (__atomic_load_n(&wq->nr_in_flight, __ATOMIC_ACQUIRE)) {
+        wait_queue_sleep(&flush_wq, false, WAIT_FOREVER);
+    }
+    interrupts_restore(flags);
+}
+
+/**
+ * @brief Check whether the caller runs in a worker thread
+ *
+ * @return true inside a work function
+ */
+bool current_is_workqueue_worker(void) {
+    struct thread *self = get_current_thread();
+    return self && self->worker;
+}
+
+/**
+ * @brief Get work queue statistics
+ *
+ * @return Pointer to work queue statistics
+ */
+const struct workqueue_stats* workqueue_get_stats(void) {
+    return &stats;
+}
+
+/**
+ * @brief Print worker pools, queues and statistics
+ */
+void print_workqueue_status(void) {
+    printf("\n=== Work Queues ===\n");
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        struct worker_pool *pool = &worker_pools[cpu];
+        if (!pool->online) {
+            continue;
+        }
+        printf("Pool CPU %u: %u workers (%u idle, %u running), %s\n",
+               cpu, pool->nr_workers, pool->nr_idle, pool->nr_running,
+               list_empty(&pool->worklist) ? "idle" : "work pending");
+    }
+
+    uint64_t flags = spin_lock_irqsave(&workqueues_lock);
+    struct workqueue_struct *wq;
+    list_for_each_entry(wq, &workqueues, list) {
+        printf("Queue %-16s in flight %u\n", wq->name, wq->nr_in_flight);
+    }
+    spin_unlock_irqrestore(&workqueues_lock, flags);
+
+    printf("Queued: %llu, executed: %llu, already pending: %llu\n",
+           stats.queued, stats.executed, stats.requeue_skipped);
+    printf("Workers created: %llu, concurrency wakeups: %llu\n",
+           stats.workers_created, stats.concurrency_wakeups);
+}
+
+/**
+ * @brief A worker is about to block (interrupts disabled)
+ *
+ * Wakes an idle worker if the last running one blocks with work queued.
+ *
+ * @param thread Worker thread leaving the CPU
+ */
+void wq_worker_sleeping(struct thread *thread) {
+    struct worker *worker = thread->worker;
+    if (!worker || worker->idle) {
+        return;
+    }
+
+    struct worker_pool *pool = worker->pool;
+    if (__atomic_sub_fetch(&pool->nr_running, 1, __ATOMIC_ACQ_REL) == 0 &&
+        !list_empty(&pool->worklist) && pool->nr_idle) {
+        stats.concurrency_wakeups++;
+        wake_up(&pool->idle_wq);
+    }
+}
+
+/**
+ * @brief A blocked worker became runnable again (interrupts disabled)
+ *
+ * @param thread Worker thread being woken
+ */
+void wq_worker_waking_up(struct thread *thread) {
+    struct worker *worker = thread->worker;
+    if (!worker || worker->idle) {
+        return;
+    }
+
+    __atomic_add_fetch(&worker->pool->nr_running, 1, __ATOMIC_ACQ_REL);
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Get the pool for work queued by this CPU
+ */
+static struct worker_pool* get_work_pool(void) {
+    struct worker_pool *pool = &worker_pools[smp_processor_id()];
+    if (!pool->online) {
+        pool = &worker_pools[cpumask_first(cpu_online_mask)];
+    }
+    return pool;
+}
+
+/**
+ * @brief Start a worker thread bound to the pool's CPU
+ *
+ * The caller has already counted the worker in pool->nr_workers.
+ */
+static int create_worker(struct worker_pool *pool) {
+    struct worker *worker = (struct worker*)kmalloc(sizeof(struct worker));
+    struct thread *task = worker ? create_thread(kworker_process->pid, worker_thread, worker) : NULL;
+
+    if (!task) {
+        if (worker) {
+            kfree(worker);
+        }
+        uint64_t flags = spin_lock_irqsave(&pool->lock);
+        pool->nr_workers--;
+        spin_unlock_irqrestore(&pool->lock, flags);
+        KERROR("Failed to create worker for CPU %u", pool->cpu);
+        return KERN_NOMEM;
+    }
+
+    worker->task = task;
+    worker->pool = pool;
+    worker->current_work = NULL;
+    worker->idle = true;
+    task->worker = worker;
+    set_thread_affinity(task->tid, CPU_MASK_CPU(pool->cpu));
+
+    uint64_t flags = spin_lock_irqsave(&pool->lock);
+    list_add_tail(&worker->node, &pool->workers);
+    pool->nr_idle++;
+    stats.workers_created++;
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    scheduler_add_thread(task);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Worker thread body
+ *
+ * @param arg Worker
+ */
+static void worker_thread(void *arg) {
+    struct worker *worker = (struct worker*)arg;
+    struct worker_pool *pool = worker->pool;
+
+    uint64_t flags = spin_lock_irqsave(&pool->lock);
+    for (;;) {
+        if (!need_more_worker(pool)) {
+            if (!worker->idle) {
+                worker_enter_idle(worker);
+            }
+            spin_unlock(&pool->lock);
+            wait_queue_sleep(&pool->idle_wq, true, WAIT_FOREVER);
+            spin_lock(&pool->lock);
+            continue;
+        }
+
+        if (worker->idle) {
+            worker_leave_idle(worker);
+        }
+
+        // Keep an idle worker in reserve for when this one blocks
+        if (pool->nr_idle == 0 && pool->nr_workers < WQ_MAX_WORKERS) {
+            pool->nr_workers++;
+            spin_unlock_irqrestore(&pool->lock, flags);
+            create_worker(pool);
+            flags = spin_lock_irqsave(&pool->lock);
+        }
+
+        // Run items back to back unless another worker got going meanwhile
+        while (!list_empty(&pool->worklist)) {
+            struct work_struct *work = list_first_entry(&pool->worklist, struct work_struct, entry);
+            struct workqueue_struct *wq = work->wq;
+
+            list_del_init(&work->entry);
+            work->pending = 0;
+            worker->current_work = work;
+            spin_unlock_irqrestore(&pool->lock, flags);
+
+            // The item may free itself; do not touch it after this call
+            work->func(work);
+
+            flags = spin_lock_irqsave(&pool->lock);
+            worker->current_work = NULL;
+            wq->nr_in_flight--;
+            stats.executed++;
+
+            if (waitqueue_active(&flush_wq)) {
+                wake_up_all(&flush_wq);
+            }
+
+            if (pool->nr_running > 1) {
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Mark a worker idle (pool->lock held)
+ */
+static void worker_enter_idle(struct worker *worker) {
+    struct worker_pool *pool = worker->pool;
+
+    worker->idle = true;
+    pool->nr_idle++;
+    __atomic_sub_fetch(&pool->nr_running, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Mark a worker running (pool->lock held)
+ */
+static void worker_leave_idle(struct worker *worker) {
+    struct worker_pool *pool = worker->pool;
+
+    worker->idle = false;
+    pool->nr_idle--;
+    __atomic_add_fetch(&pool->nr_running, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Check whether queued work has no running worker (pool->lock held)
+ */
+static bool need_more_worker(struct worker_pool *pool) {
+    return !list_empty(&pool->worklist) && pool->nr_running == 0;
+}
+
+/**
+ * @brief Check whether a worker of the pool is running an item (pool->lock held)
+ */
+static bool work_is_running(struct worker_pool *pool, struct work_struct *work) {
+    struct worker *worker;
+    list_for_each_entry(worker, &pool->workers, node) {
+        if (worker->current_work == work) {
+            return true;
+        }
+    }
+    return false;
+}
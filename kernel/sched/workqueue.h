@@ -0,0 +1,84 @@
+/*
+ * FG-OS Work Queue Header
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Deferred work run in kernel thread context by per-CPU worker pools.
+ */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <types.h>
+#include "../include/list.h"
+
+struct work_struct;
+struct workqueue_struct;
+
+typedef void (*work_func_t)(struct work_struct *work);
+
+// Work Item
+struct work_struct {
+    struct list_head entry;         // Entry in the pool worklist
+    work_func_t func;               // Function run by a worker
+    volatile uint32_t pending;      // Queued and not yet started
+    struct workqueue_struct *wq;    // Queue of the last queue_work()
+    struct worker_pool *pool;       // Pool of the last queue_work()
+};
+
+// Static initializer for a work item
+#define WORK_INIT(name, fn) { LIST_HEAD_INIT((name).entry), (fn), 0, NULL, NULL }
+
+static inline void INIT_WORK(struct work_struct *work, work_func_t func) {
+    INIT_LIST_HEAD(&work->entry);
+    work->func = func;
+    work->pending = 0;
+    work->wq = NULL;
+    work->pool = NULL;
+}
+
+// Pool Limits
+#define WQ_MAX_WORKERS          8   // Workers per CPU pool
+#define WQ_NAME_LEN             16
+
+// Work Queue
+// Queues share the per-CPU worker pools; a queue only tracks its own
+// in-flight items so it can be flushed on its own.
+struct workqueue_struct {
+    char name[WQ_NAME_LEN];
+    volatile uint32_t nr_in_flight; // Queued or running items
+    struct list_head list;          // Entry in the list of all queues
+};
+
+// Work Queue Statistics
+struct workqueue_stats {
+    uint64_t queued;                // Items queued
+    uint64_t executed;              // Items run
+    uint64_t requeue_skipped;       // queue_work() on an already pending item
+    uint64_t workers_created;       // Worker threads started
+    uint64_t concurrency_wakeups;   // Idle workers woken because one blocked
+};
+
+// System-wide queue for work with no queue of its own
+extern struct workqueue_struct *system_wq;
+
+// Work Queue Interface
+int workqueue_init(void);
+struct workqueue_struct* alloc_workqueue(const char *name);
+void destroy_workqueue(struct workqueue_struct *wq);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool schedule_work(struct work_struct *work);
+bool cancel_work(struct work_struct *work);
+void flush_work(struct work_struct *work);
+void flush_workqueue(struct workqueue_struct *wq);
+bool current_is_workqueue_worker(void);
+const struct workqueue_stats* workqueue_get_stats(void);
+void print_workqueue_status(void);
+
+// Scheduler Hooks (concurrency management)
+void wq_worker_sleeping(struct thread *thread);
+void wq_worker_waking_up(struct thread *thread);
+
+#endif // WORKQUEUE_H
@@ -15,9 +15,14 @@
 #include "kernel.h"
 #include "boot.h"
 #include "panic.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "syscall.h"
+#include "vdso.h"
 #include "../mm/memory.h"
 #include "../sched/scheduler.h"
 #include "../interrupt/interrupt.h"
+#include "../arch/x86_64/fpu.h"
 #include "../drivers/device.h"
 #include "../hal/hal.h"
 
@@ -196,6 +201,24 @@ static int init_subsystems(void) {
         return KERN_ERROR;
     }
     
+    KINFO("  → Initializing FPU/SIMD state management...");
+    if (fpu_init() != KERN_SUCCESS) {
+        KERROR("Failed to initialize FPU");
+        return KERN_ERROR;
+    }
+    
+    KINFO("  → Initializing System Call Interface...");
+    if (syscall_init() != KERN_SUCCESS) {
+        KERROR("Failed to initialize System Call Interface");
+        return KERN_ERROR;
+    }
+    
+    KINFO("  → Initializing vDSO...");
+    if (vdso_init() != KERN_SUCCESS) {
+        KERROR("Failed to initialize vDSO");
+        return KERN_ERROR;
+    }
+    
     KINFO("  → Interrupt system: OK");
     
     // Phase 8: Initialize device framework
@@ -410,20 +433,29 @@ void kernel_main(void) {
         }
     }
     
+#ifdef CONFIG_SCHED_BENCH
+    // Context switch latency, without and with lazy FPU state transfer
+    KINFO("");
+    KINFO("=== Context Switch Benchmark ===");
+    struct sched_bench_result bench;
+    sched_bench_pingpong(1000, false, &bench);
+    sched_bench_pingpong(1000, true, &bench);
+#endif
+    lockstat_dump();
+    
     // Final status
     KINFO("");
     KINFO("=== Final System Status ===");
     interrupt_dump_status();
+    rcu_dump_status();
     
     KINFO("");
     KINFO("Phase 7 - Interrupt Handling System demonstration completed!");
     KINFO("Next phase: Phase 8 - Device Drivers Framework");
     
-    // Infinite loop with halt instruction
+    // Idle loop - the periodic tick is stopped while halted
     KINFO("Entering idle loop...");
-    while (1) {
-        halt();  // Wait for interrupts
-    }
+    scheduler_idle();
 }
 
 /**
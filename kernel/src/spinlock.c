@@ -0,0 +1,449 @@
+/**
+ * @file spinlock.c
+ * @brief Ticket and MCS spinlock implementation for FG-OS
+ *
+ * Ticket lock: lock->next hands out tickets with xadd and lock->owner is
+ * the ticket being served. Only the holder writes owner, so unlock is a
+ * plain release store. MCS lock: waiters queue behind lock->tail and each
+ * spins on its own node until the predecessor hands the lock over.
+ *
+ * With CONFIG_LOCKSTAT, wait time is measured from the first failed
+ * attempt and hold time from acquisition to release, both in TSC cycles.
+ *
+ * @author Faiz Nasir
+ * @company FGCompany Official
+ * @version 1.0.0
+ * @date 2024
+ * @copyright © 2024 FGCompany Official. All rights reserved.
+ */
+
+#include "kernel.h"
+#include "spinlock.h"
+#include "../arch/x86_64/arch.h"
+#include "../interrupt/idt.h"
+
+// Ticket arithmetic on the combined 32-bit lock word
+#define TICKET_SHIFT            16
+#define TICKET_ONE              (1U << TICKET_SHIFT)
+#define TICKET_OWNER(word)      ((uint16_t)(word))
+#define TICKET_NEXT(word)       ((uint16_t)((word) >> TICKET_SHIFT))
+
+#ifdef CONFIG_LOCKSTAT
+// Registered lock classes, newest first
+static struct lock_class *lock_classes = NULL;
+#endif
+
+// Forward declarations
+static inline void cpu_relax(void);
+#ifdef CONFIG_LOCKSTAT
+static void lockstat_register(struct lock_class *lock_class);
+static void lockstat_acquired(struct lock_class *lock_class, uint64_t wait_start);
+static void lockstat_released(struct lock_class *lock_class, uint64_t acquired_at);
+static void lockstat_max(uint64_t *max, uint64_t value);
+#endif
+
+/**
+ * @brief Initialize a ticket spinlock
+ *
+ * Use spin_lock_init(), which supplies the lock class of the call site.
+ *
+ * @param lock Lock to initialize
+ * @param lock_class Statistics class, NULL without CONFIG_LOCKSTAT
+ */
+void __spin_lock_init(spinlock_t *lock, struct lock_class *lock_class) {
+    lock->lock = 0;
+    lock->cpu = 0;
+#ifdef CONFIG_LOCKSTAT
+    lock->lock_class = lock_class;
+    lock->acquired_at = 0;
+    lockstat_register(lock_class);
+#else
+    (void)lock_class;
+#endif
+}
+
+/**
+ * @brief Acquire a ticket spinlock, spinning in FIFO order
+ *
+ * @param lock Lock to acquire
+ */
+void spin_lock(spinlock_t *lock) {
+    uint32_t word = __atomic_fetch_add(&lock->lock, TICKET_ONE, __ATOMIC_ACQUIRE);
+    uint16_t ticket = TICKET_NEXT(word);
+
+#ifdef CONFIG_LOCKSTAT
+    uint64_t wait_start = 0;
+#endif
+
+    if (TICKET_OWNER(word) != ticket) {
+#ifdef CONFIG_LOCKSTAT
+        wait_start = rdtsc();
+#endif
+        while (__atomic_load_n(&lock->tickets.owner, __ATOMIC_ACQUIRE) != ticket) {
+            cpu_relax();
+        }
+    }
+
+    lock->cpu = smp_processor_id();
+#ifdef CONFIG_LOCKSTAT
+    lockstat_acquired(lock->lock_class, wait_start);
+    lock->acquired_at = rdtsc();
+#endif
+}
+
+/**
+ * @brief Try to acquire a ticket spinlock without spinning
+ *
+ * @param lock Lock to acquire
+ * @return true if acquired
+ */
+bool spin_trylock(spinlock_t *lock) {
+    uint32_t word = __atomic_load_n(&lock->lock, __ATOMIC_RELAXED);
+
+    if (TICKET_OWNER(word) != TICKET_NEXT(word)) {
+        return false;
+    }
+
+    if (!__atomic_compare_exchange_n(&lock->lock, &word, word + TICKET_ONE, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    lock->cpu = smp_processor_id();
+#ifdef CONFIG_LOCKSTAT
+    lockstat_acquired(lock->lock_class, 0);
+    lock->acquired_at = rdtsc();
+#endif
+    return true;
+}
+
+/**
+ * @brief Release a ticket spinlock to the next waiter
+ *
+ * @param lock Lock to release
+ */
+void spin_unlock(spinlock_t *lock) {
+#ifdef CONFIG_LOCKSTAT
+    lockstat_released(lock->lock_class, lock->acquired_at);
+#endif
+
+    // Only the holder advances owner; a 16-bit store cannot disturb next
+    uint16_t owner = lock->tickets.owner;
+    __atomic_store_n(&lock->tickets.owner, (uint16_t)(owner + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Check whether a ticket spinlock is held
+ *
+ * @param lock Lock to check
+ * @return true if locked
+ */
+bool spin_is_locked(const spinlock_t *lock) {
+    uint32_t word = __atomic_load_n(&lock->lock, __ATOMIC_RELAXED);
+    return TICKET_OWNER(word) != TICKET_NEXT(word);
+}
+
+/**
+ * @brief Check whether other CPUs are queued on a ticket spinlock
+ *
+ * @param lock Lock to check
+ * @return true if at least one waiter is spinning
+ */
+bool spin_is_contended(const spinlock_t *lock) {
+    uint32_t word = __atomic_load_n(&lock->lock, __ATOMIC_RELAXED);
+    return (uint16_t)(TICKET_NEXT(word) - TICKET_OWNER(word)) > 1;
+}
+
+/**
+ * @brief Disable local interrupts and acquire a ticket spinlock
+ *
+ * @param lock Lock to acquire
+ * @return Previous interrupt state for spin_unlock_irqrestore()
+ */
+uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    uint64_t flags = interrupts_disable_caller(__builtin_return_address(0));
+    spin_lock(lock);
+    return flags;
+}
+
+/**
+ * @brief Release a ticket spinlock and restore local interrupts
+ *
+ * @param lock Lock to release
+ * @param flags Interrupt state from spin_lock_irqsave()
+ */
+void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    spin_unlock(lock);
+    interrupts_restore_caller(flags, __builtin_return_address(0));
+}
+
+/**
+ * @brief Initialize an MCS spinlock
+ *
+ * Use mcs_lock_init(), which supplies the lock class of the call site.
+ *
+ * @param lock Lock to initialize
+ * @param lock_class Statistics class, NULL without CONFIG_LOCKSTAT
+ */
+void __mcs_lock_init(mcs_lock_t *lock, struct lock_class *lock_class) {
+    lock->tail = NULL;
+#ifdef CONFIG_LOCKSTAT
+    lock->lock_class = lock_class;
+    lock->acquired_at = 0;
+    lockstat_register(lock_class);
+#else
+    (void)lock_class;
+#endif
+}
+
+/**
+ * @brief Acquire an MCS spinlock
+ *
+ * @param lock Lock to acquire
+ * @param node Queue node owned by the caller until mcs_spin_unlock()
+ */
+void mcs_spin_lock(mcs_lock_t *lock, struct mcs_node *node) {
+    node->next = NULL;
+    node->locked = 0;
+
+    struct mcs_node *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+
+#ifdef CONFIG_LOCKSTAT
+    uint64_t wait_start = 0;
+#endif
+
+    if (prev) {
+#ifdef CONFIG_LOCKSTAT
+        wait_start = rdtsc();
+#endif
+        // Link behind the predecessor, then spin on our own node only
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+    }
+
+#ifdef CONFIG_LOCKSTAT
+    lockstat_acquired(lock->lock_class, wait_start);
+    lock->acquired_at = rdtsc();
+#endif
+}
+
+/**
+ * @brief Try to acquire an MCS spinlock without queueing
+ *
+ * @param lock Lock to acquire
+ * @param node Queue node owned by the caller if acquired
+ * @return true if acquired
+ */
+bool mcs_spin_trylock(mcs_lock_t *lock, struct mcs_node *node) {
+    struct mcs_node *expected = NULL;
+
+    node->next = NULL;
+    node->locked = 0;
+
+    if (!__atomic_compare_exchange_n(&lock->tail, &expected, node, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+#ifdef CONFIG_LOCKSTAT
+    lockstat_acquired(lock->lock_class, 0);
+    lock->acquired_at = rdtsc();
+#endif
+    return true;
+}
+
+/**
+ * @brief Release an MCS spinlock to the next queued waiter
+ *
+ * @param lock Lock to release
+ * @param node Queue node passed to the matching lock call
+ */
+void mcs_spin_unlock(mcs_lock_t *lock, struct mcs_node *node) {
+#ifdef CONFIG_LOCKSTAT
+    lockstat_released(lock->lock_class, lock->acquired_at);
+#endif
+
+    struct mcs_node *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+    if (!next) {
+        // No known successor: free the lock unless someone is mid-enqueue
+        struct mcs_node *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+
+    __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Check whether an MCS spinlock is held
+ *
+ * @param lock Lock to check
+ * @return true if locked
+ */
+bool mcs_is_locked(const mcs_lock_t *lock) {
+    return __atomic_load_n(&lock->tail, __ATOMIC_RELAXED) != NULL;
+}
+
+/**
+ * @brief Disable local interrupts and acquire an MCS spinlock
+ *
+ * @param lock Lock to acquire
+ * @param node Queue node owned by the caller until the matching unlock
+ * @return Previous interrupt state for mcs_spin_unlock_irqrestore()
+ */
+uint64_t mcs_spin_lock_irqsave(mcs_lock_t *lock, struct mcs_node *node) {
+    uint64_t flags = interrupts_disable_caller(__builtin_return_address(0));
+    mcs_spin_lock(lock, node);
+    return flags;
+}
+
+/**
+ * @brief Release an MCS spinlock and restore local interrupts
+ *
+ * @param lock Lock to release
+ * @param node Queue node passed to the matching lock call
+ * @param flags Interrupt state from mcs_spin_lock_irqsave()
+ */
+void mcs_spin_unlock_irqrestore(mcs_lock_t *lock, struct mcs_node *node, uint64_t flags) {
+    mcs_spin_unlock(lock, node);
+    interrupts_restore_caller(flags, __builtin_return_address(0));
+}
+
+/**
+ * @brief Clear the statistics of every lock class
+ */
+void lockstat_reset(void) {
+#ifdef CONFIG_LOCKSTAT
+    for (struct lock_class *c = lock_classes; c; c = c->next) {
+        c->acquisitions = 0;
+        c->contentions = 0;
+        c->wait_cycles = 0;
+        c->max_wait_cycles = 0;
+        c->hold_cycles = 0;
+        c->max_hold_cycles = 0;
+    }
+#endif
+}
+
+/**
+ * @brief Print per-class lock statistics
+ */
+void lockstat_dump(void) {
+#ifdef CONFIG_LOCKSTAT
+    KINFO("Lock statistics (TSC cycles):");
+    KINFO("  %-24s %10s %10s %12s %12s %12s %12s", "class", "acquired", "contended",
+          "wait-avg", "wait-max", "hold-avg", "hold-max");
+
+    for (struct lock_class *c = lock_classes; c; c = c->next) {
+        if (!c->acquisitions) {
+            continue;
+        }
+
+        KINFO("  %-24s %10llu %10llu %12llu %12llu %12llu %12llu", c->name,
+              c->acquisitions, c->contentions,
+              c->contentions ? c->wait_cycles / c->contentions : 0, c->max_wait_cycles,
+              c->hold_cycles / c->acquisitions, c->max_hold_cycles);
+    }
+#else
+    KINFO("Lock statistics not available (kernel built without CONFIG_LOCKSTAT)");
+#endif
+}
+
+/**
+ * @brief Get the most recently registered lock class
+ *
+ * @return First class of the list linked by ->next, NULL if none
+ */
+const struct lock_class* lockstat_first_class(void) {
+#ifdef CONFIG_LOCKSTAT
+    return __atomic_load_n(&lock_classes, __ATOMIC_ACQUIRE);
+#else
+    return NULL;
+#endif
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Spin-wait hint for the CPU
+ */
+static inline void cpu_relax(void) {
+    __asm__ __volatile__("pause" ::: "memory");
+}
+
+#ifdef CONFIG_LOCKSTAT
+/**
+ * @brief Link a lock class into the class list on first use
+ *
+ * @param lock_class Class to register
+ */
+static void lockstat_register(struct lock_class *lock_class) {
+    if (!lock_class || __atomic_exchange_n(&lock_class->registered, true, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    struct lock_class *head = __atomic_load_n(&lock_classes, __ATOMIC_RELAXED);
+    do {
+        lock_class->next = head;
+    } while (!__atomic_compare_exchange_n(&lock_classes, &head, lock_class, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Account an acquisition
+ *
+ * Classes are shared by many locks, so counters are updated atomically.
+ *
+ * @param lock_class Class of the acquired lock, may be NULL
+ * @param wait_start TSC when waiting began, 0 if uncontended
+ */
+static void lockstat_acquired(struct lock_class *lock_class, uint64_t wait_start) {
+    if (!lock_class) {
+        return;
+    }
+
+    __atomic_fetch_add(&lock_class->acquisitions, 1, __ATOMIC_RELAXED);
+
+    if (wait_start) {
+        uint64_t waited = rdtsc() - wait_start;
+        __atomic_fetch_add(&lock_class->contentions, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lock_class->wait_cycles, waited, __ATOMIC_RELAXED);
+        lockstat_max(&lock_class->max_wait_cycles, waited);
+    }
+}
+
+/**
+ * @brief Account a release
+ *
+ * @param lock_class Class of the released lock, may be NULL
+ * @param acquired_at TSC at acquisition
+ */
+static void lockstat_released(struct lock_class *lock_class, uint64_t acquired_at) {
+    if (!lock_class) {
+        return;
+    }
+
+    uint64_t held = rdtsc() - acquired_at;
+    __atomic_fetch_add(&lock_class->hold_cycles, held, __ATOMIC_RELAXED);
+    lockstat_max(&lock_class->max_hold_cycles, held);
+}
+
+/**
+ * @brief Atomically raise a maximum
+ */
+static void lockstat_max(uint64_t *max, uint64_t value) {
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(max, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+#endif
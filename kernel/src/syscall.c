@@ -0,0 +1,344 @@
+/*
+ * FG-OS System Call Dispatch
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * System calls enter through SYSCALL (syscall_entry.S) or the legacy
+ * INT 0x80 gate and are dispatched through one bounds-checked table of
+ * struct syscall_entry. Arguments follow the x86_64 system call ABI: the
+ * number in rax, arguments in rdi, rsi, rdx, r10, r8 and r9, the result
+ * in rax. Before returning to the caller a pending reschedule is honoured,
+ * as on the return from an interrupt.
+ */
+
+#include "../include/kernel.h"
+#include "../include/syscall.h"
+#include "../include/syscall_trace.h"
+#include "../sched/scheduler.h"
+#include "../arch/x86_64/arch.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/clocksource.h"
+
+// The assembly trampoline addresses these fields by fixed offset
+_Static_assert(offsetof(struct syscall_cpu, kernel_rsp) == 0, "syscall_entry.S layout");
+_Static_assert(offsetof(struct syscall_cpu, user_rsp) == 8, "syscall_entry.S layout");
+_Static_assert(sizeof(struct syscall_frame) == 80, "syscall_entry.S layout");
+_Static_assert(offsetof(struct syscall_frame, rip) == 56, "syscall_entry.S layout");
+_Static_assert(offsetof(struct syscall_frame, rflags) == 64, "syscall_entry.S layout");
+_Static_assert(offsetof(struct syscall_frame, rsp) == 72, "syscall_entry.S layout");
+_Static_assert(GDT_USER_CODE == 0x23 && GDT_USER_DATA == 0x1B, "syscall_entry.S selectors");
+
+// Cast for handlers taking fewer than six arguments; unused argument
+// registers are simply ignored under the SysV calling convention
+#define SYSCALL_FN(fn)  ((syscall_handler_t)(void (*)(void))(fn))
+
+// System call table, indexed by number
+static struct syscall_entry syscall_table[SYSCALL_TABLE_SIZE] = {
+    [SYS_GETPID]            = { SYSCALL_FN(sys_getpid), "getpid", 0, 0 },
+    [SYS_SLEEP]             = { SYSCALL_FN(sys_sleep), "sleep", 1, SYSCALL_FLAG_INTERRUPTIBLE },
+    [SYS_YIELD]             = { SYSCALL_FN(sys_yield), "yield", 0, 0 },
+    [SYS_SCHED_SETAFFINITY] = { SYSCALL_FN(sys_sched_setaffinity), "sched_setaffinity", 3, 0 },
+    [SYS_SCHED_GETAFFINITY] = { SYSCALL_FN(sys_sched_getaffinity), "sched_getaffinity", 3, 0 },
+    [SYS_SCHED_SETISOLATED] = { SYSCALL_FN(sys_sched_setisolated), "sched_setisolated", 2, SYSCALL_FLAG_PRIVILEGED },
+    [SYS_IRQ_SETAFFINITY]   = { SYSCALL_FN(sys_irq_setaffinity), "irq_setaffinity", 3, SYSCALL_FLAG_PRIVILEGED },
+    [SYS_MUTEX_INIT]        = { SYSCALL_FN(sys_mutex_init), "mutex_init", 2, 0 },
+    [SYS_MUTEX_LOCK]        = { SYSCALL_FN(sys_mutex_lock), "mutex_lock", 1, SYSCALL_FLAG_INTERRUPTIBLE },
+    [SYS_MUTEX_UNLOCK]      = { SYSCALL_FN(sys_mutex_unlock), "mutex_unlock", 1, 0 },
+    [SYS_MUTEX_DESTROY]     = { SYSCALL_FN(sys_mutex_destroy), "mutex_destroy", 1, 0 },
+    [SYS_FUTEX]             = { SYSCALL_FN(sys_futex), "futex", 4, SYSCALL_FLAG_INTERRUPTIBLE },
+    [SYS_GETTIME]           = { SYSCALL_FN(sys_gettime), "gettime", 2, 0 },
+    [SYS_SETTIME]           = { SYSCALL_FN(sys_settime), "settime", 2, SYSCALL_FLAG_PRIVILEGED },
+    [SYS_GETRUSAGE]         = { SYSCALL_FN(sys_getrusage), "getrusage", 3, 0 },
+    [SYS_GETLOADSTATS]      = { SYSCALL_FN(sys_getloadstats), "getloadstats", 2, 0 },
+    [SYS_IO_URING_SETUP]    = { SYSCALL_FN(sys_io_uring_setup), "io_uring_setup", 2, 0 },
+    [SYS_IO_URING_ENTER]    = { SYSCALL_FN(sys_io_uring_enter), "io_uring_enter", 4, SYSCALL_FLAG_INTERRUPTIBLE },
+    [SYS_IO_URING_REGISTER] = { SYSCALL_FN(sys_io_uring_register), "io_uring_register", 4, 0 },
+    [SYS_FG_PERF]           = { SYSCALL_FN(sys_fg_perf), "fg_perf", 3, SYSCALL_FLAG_PRIVILEGED },
+};
+
+// Per-CPU entry state, installed as the kernel GS base
+static struct syscall_cpu syscall_cpus[MAX_CPUS];
+static bool syscall_enabled = false;
+
+// Internal function declarations
+static int64_t syscall_invoke(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                              uint64_t arg4, uint64_t arg5, uint64_t arg6, bool from_user);
+static void syscall_interrupt(uint8_t vector, uint64_t error_code, struct cpu_state *context);
+
+/**
+ * @brief Initialize the system call interface on the boot CPU
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int syscall_init(void) {
+    KINFO("Initializing system call interface...");
+
+    // INT 0x80 stays available for callers that cannot use SYSCALL
+    if (idt_register_handler(INT_SYSCALL, syscall_interrupt) != 0) {
+        KERROR("Failed to install INT 0x80 system call gate");
+        return KERN_ERROR;
+    }
+
+    syscall_trace_init();
+    syscall_cpu_init(smp_processor_id());
+    syscall_enabled = true;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < SYSCALL_TABLE_SIZE; i++) {
+        if (syscall_table[i].handler) {
+            count++;
+        }
+    }
+
+    KINFO("System call interface initialized: SYSCALL/SYSRET, %u calls registered", count);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Program the SYSCALL MSRs of the calling CPU
+ *
+ * Run by every CPU as it comes online.
+ *
+ * @param cpu Calling CPU
+ */
+void syscall_cpu_init(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return;
+    }
+
+    struct syscall_cpu *sc = &syscall_cpus[cpu];
+    sc->cpu = cpu;
+
+    // SYSCALL loads CS/SS from STAR[47:32]; SYSRET loads SS = STAR[63:48] + 8, CS = + 16
+    uint64_t star = ((uint64_t)(GDT_USER_DATA - 8) << 48) | ((uint64_t)GDT_KERNEL_CODE << 32);
+    wrmsr(MSR_STAR, star);
+    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+    wrmsr(MSR_SFMASK, RFLAGS_IF | RFLAGS_TF | RFLAGS_DF | RFLAGS_NT | RFLAGS_AC);
+
+    // The kernel runs with GS on its per-CPU area; SWAPGS exchanges it with the user base
+    wrmsr(MSR_GS_BASE, (uint64_t)sc);
+    wrmsr(MSR_KERNEL_GS_BASE, 0);
+
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SCE);
+
+    syscall_trace_cpu_init(cpu);
+}
+
+/**
+ * @brief Set the stack SYSCALL switches to on this CPU
+ *
+ * Called on every switch to a thread.
+ *
+ * @param stack_top Top of the incoming thread's kernel stack
+ */
+void syscall_set_kernel_stack(uint64_t stack_top) {
+    syscall_cpus[smp_processor_id()].kernel_rsp = stack_top & ~0xFULL;
+}
+
+/**
+ * @brief C part of the SYSCALL entry
+ *
+ * Runs with interrupts enabled on the thread's kernel stack.
+ *
+ * @param frame Saved caller registers; rax receives the result
+ * @param from_user Entered from ring 3
+ */
+void syscall_handler(struct syscall_frame *frame, bool from_user) {
+    frame->rax = (uint64_t)syscall_invoke(frame->rax, frame->rdi, frame->rsi, frame->rdx,
+                                          frame->r10, frame->r8, frame->r9, from_user);
+
+    // A wakeup or slice expiry during the call takes effect before returning
+    preempt_schedule_irq();
+}
+
+/**
+ * @brief Dispatch a system call from kernel code
+ *
+ * In-kernel callers are trusted with privileged calls.
+ *
+ * @return System call result
+ */
+int64_t syscall_dispatch(uint64_t syscall_num, uint64_t arg1, uint64_t arg2,
+                        uint64_t arg3, uint64_t arg4, uint64_t arg5, uint64_t arg6) {
+    return syscall_invoke(syscall_num, arg1, arg2, arg3, arg4, arg5, arg6, false);
+}
+
+/**
+ * @brief Register a system call handler
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int register_syscall(uint64_t num, syscall_handler_t handler,
+                     const char *name, uint8_t arg_count, uint8_t flags) {
+    if (num >= SYSCALL_TABLE_SIZE || !handler || arg_count > SYSCALL_MAX_ARGS) {
+        return KERN_INVALID;
+    }
+
+    if (syscall_table[num].handler) {
+        return KERN_EXISTS;
+    }
+
+    syscall_table[num].name = name;
+    syscall_table[num].arg_count = arg_count;
+    syscall_table[num].flags = flags;
+    __atomic_store_n(&syscall_table[num].handler, handler, __ATOMIC_RELEASE);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Remove a system call handler
+ *
+ * @param num System call number
+ */
+void unregister_syscall(uint64_t num) {
+    if (num < SYSCALL_TABLE_SIZE) {
+        __atomic_store_n(&syscall_table[num].handler, NULL, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Get the name of a system call
+ *
+ * @param num System call number
+ * @return Name from the table, "unknown" if unassigned
+ */
+const char* syscall_name(uint64_t num) {
+    if (num >= SYSCALL_TABLE_SIZE || !syscall_table[num].name) {
+        return "unknown";
+    }
+    return syscall_table[num].name;
+}
+
+/**
+ * @brief Measure the null system call round trip
+ *
+ * Issues SYSCALL with SYS_GETPID from kernel mode, which runs the entry
+ * trampoline and table dispatch but neither SWAPGS/stack switch nor
+ * SYSRET, and compares it with calling the table directly.
+ *
+ * @param iterations Calls per method
+ * @param result Receives the measurement
+ * @return 0 on success, negative error code on failure
+ */
+int syscall_bench_null(uint32_t iterations, struct syscall_bench_result *result) {
+    if (!result || iterations == 0) {
+        return KERN_INVALID;
+    }
+
+    if (!syscall_enabled) {
+        return KERN_BUSY;
+    }
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        int64_t ret;
+        __asm__ __volatile__("syscall"
+                             : "=a"(ret)
+                             : "a"((uint64_t)SYS_GETPID)
+                             : "rcx", "r11", "memory");
+        (void)ret;
+    }
+    uint64_t syscall_total = rdtsc() - start;
+
+    start = rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        syscall_dispatch(SYS_GETPID, 0, 0, 0, 0, 0, 0);
+    }
+    uint64_t dispatch_total = rdtsc() - start;
+
+    result->iterations = iterations;
+    result->syscall_cycles = syscall_total / iterations;
+    result->dispatch_cycles = dispatch_total / iterations;
+
+    uint64_t tsc_khz = clocksource_tsc_khz();
+    result->syscall_ns = tsc_khz ? syscall_total * 1000000ULL / tsc_khz / iterations : 0;
+
+    KINFO("Null syscall: %llu cycles (%llu ns) via SYSCALL, %llu cycles via table",
+          result->syscall_cycles, result->syscall_ns, result->dispatch_cycles);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_GETPID handler
+ *
+ * @return Caller's process ID, 0 for kernel context
+ */
+int64_t sys_getpid(void) {
+    struct process *proc = get_current_process();
+    return proc ? proc->pid : 0;
+}
+
+/**
+ * @brief SYS_SLEEP handler
+ *
+ * @param milliseconds Time to sleep
+ * @return 0
+ */
+int64_t sys_sleep(uint64_t milliseconds) {
+    sleep(milliseconds);
+    return SYSCALL_SUCCESS;
+}
+
+/**
+ * @brief SYS_YIELD handler
+ *
+ * @return 0
+ */
+int64_t sys_yield(void) {
+    yield();
+    return SYSCALL_SUCCESS;
+}
+
+// Internal functions
+
+/**
+ * @brief Look up and run a system call
+ */
+static int64_t syscall_invoke(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                              uint64_t arg4, uint64_t arg5, uint64_t arg6, bool from_user) {
+    if (num >= SYSCALL_TABLE_SIZE) {
+        return SYSCALL_INVALID;
+    }
+
+    const struct syscall_entry *entry = &syscall_table[num];
+    syscall_handler_t handler = __atomic_load_n(&entry->handler, __ATOMIC_ACQUIRE);
+    if (!handler) {
+        return SYSCALL_INVALID;
+    }
+
+    // One load decides whether this call is timed; denied calls count as errors
+    uint32_t trace = __atomic_load_n(&syscall_trace_flags, __ATOMIC_RELAXED);
+    uint64_t start = trace ? ktime_get_ns() : 0;
+
+    int64_t ret;
+    if ((entry->flags & SYSCALL_FLAG_PRIVILEGED) && from_user) {
+        ret = SYSCALL_DENIED;
+    } else {
+        ret = handler(arg1, arg2, arg3, arg4, arg5, arg6);
+    }
+
+    if (trace) {
+        const uint64_t args[6] = { arg1, arg2, arg3, arg4, arg5, arg6 };
+        syscall_trace_exit(num, args, ret, start);
+    }
+    return ret;
+}
+
+/**
+ * @brief INT 0x80 gate
+ *
+ * Same register convention as SYSCALL.
+ */
+static void syscall_interrupt(uint8_t vector, uint64_t error_code, struct cpu_state *context) {
+    (void)vector; (void)error_code;
+
+    if (!context) {
+        return;
+    }
+
+    context->rax = (uint64_t)syscall_invoke(context->rax, context->rdi, context->rsi, context->rdx,
+                                            context->r10, context->r8, context->r9,
+                                            (context->cs & 3) != 0);
+}
@@ -0,0 +1,408 @@
+/*
+ * FG-OS System Call Tracing
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * syscall_invoke() times each call while syscall_trace_flags is non-zero
+ * and reports it here. Counters are per CPU and only written by their CPU
+ * with interrupts disabled, so the hot path takes no lock and shares no
+ * cache line; readers sum the CPUs without stopping them. Events of traced
+ * processes go to one ring under a spinlock, which only traced callers
+ * contend on.
+ */
+
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/syscall.h"
+#include "../include/syscall_trace.h"
+#include "../sched/scheduler.h"
+#include "../mm/memory.h"
+#include "../interrupt/idt.h"
+#include "../interrupt/clocksource.h"
+#include "../fs/procfs.h"
+
+// Counters of One CPU
+struct syscall_cpu_stats {
+    struct syscall_stats calls[SYSCALL_TABLE_SIZE];
+};
+
+// Event Ring
+struct syscall_trace_ring {
+    struct syscall_event events[SYSCALL_TRACE_EVENTS];
+    uint64_t head;              // Sequence number of the next event written
+    uint64_t tail;              // Sequence number of the next event read
+    uint64_t overwritten;       // Events lost to a full ring
+};
+
+// Counters are on from boot; event streaming starts with the first traced process
+volatile uint32_t syscall_trace_flags = SYSCALL_TRACE_STATS;
+
+static struct syscall_cpu_stats *cpu_stats[MAX_CPUS];
+static struct syscall_trace_ring *trace_ring = NULL;
+static spinlock_t trace_lock = {0};         // Event ring and traced_processes
+static uint32_t traced_processes = 0;
+
+// Events shown by /proc/syscalls/trace (the file is one page)
+#define PROC_TRACE_EVENTS       24
+
+// Internal function declarations
+static uint32_t syscall_hist_bucket(uint64_t ns);
+static void syscall_trace_event(uint64_t num, const uint64_t *args, int64_t ret,
+                                uint64_t start_ns, uint64_t duration_ns);
+static void proc_show_syscall_stats(proc_buffer_t *buffer);
+static void proc_show_syscall_latency(proc_buffer_t *buffer);
+static void proc_show_syscall_trace(proc_buffer_t *buffer);
+
+/**
+ * @brief Allocate the event ring and register the /proc files
+ */
+void syscall_trace_init(void) {
+    spin_lock_init(&trace_lock);
+
+    trace_ring = (struct syscall_trace_ring*)kcalloc(1, sizeof(struct syscall_trace_ring));
+    if (!trace_ring) {
+        KERROR("System call tracing: no memory for the event ring");
+    }
+
+    proc_create("syscalls/stats", proc_show_syscall_stats);
+    proc_create("syscalls/latency", proc_show_syscall_latency);
+    proc_create("syscalls/trace", proc_show_syscall_trace);
+}
+
+/**
+ * @brief Allocate the counters of a CPU
+ *
+ * Run by every CPU as it comes online; calls on a CPU without counters
+ * are not counted.
+ *
+ * @param cpu Calling CPU
+ */
+void syscall_trace_cpu_init(uint32_t cpu) {
+    if (cpu >= MAX_CPUS || cpu_stats[cpu]) {
+        return;
+    }
+
+    struct syscall_cpu_stats *stats = (struct syscall_cpu_stats*)kcalloc(1, sizeof(struct syscall_cpu_stats));
+    if (!stats) {
+        KERROR("System call tracing: no counters for CPU %u", cpu);
+        return;
+    }
+    __atomic_store_n(&cpu_stats[cpu], stats, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Account a finished call
+ *
+ * Called by syscall_invoke() when syscall_trace_flags was set at entry.
+ *
+ * @param num System call number (in range)
+ * @param args The six argument registers
+ * @param ret Result
+ * @param start_ns ktime_get_ns() at entry
+ */
+void syscall_trace_exit(uint64_t num, const uint64_t *args, int64_t ret, uint64_t start_ns) {
+    uint64_t duration = ktime_get_ns() - start_ns;
+    uint32_t flags = __atomic_load_n(&syscall_trace_flags, __ATOMIC_RELAXED);
+
+    if (flags & SYSCALL_TRACE_STATS) {
+        uint64_t irq = interrupts_disable();
+        struct syscall_cpu_stats *stats = cpu_stats[smp_processor_id()];
+        if (stats) {
+            struct syscall_stats *s = &stats->calls[num];
+            s->calls++;
+            if (ret < 0) {
+                s->errors++;
+            }
+            s->total_ns += duration;
+            if (duration > s->max_ns) {
+                s->max_ns = duration;
+            }
+            s->hist[syscall_hist_bucket(duration)]++;
+        }
+        interrupts_restore(irq);
+    }
+
+    if (flags & SYSCALL_TRACE_EVENTS_ON) {
+        struct process *proc = get_current_process();
+        if (proc && (proc->trace_flags & PROC_TRACE_SYSCALLS)) {
+            syscall_trace_event(num, args, ret, start_ns, duration);
+        }
+    }
+}
+
+/**
+ * @brief Turn the per-syscall counters on or off
+ *
+ * @return 0
+ */
+int syscall_trace_enable(bool on) {
+    if (on) {
+        __atomic_fetch_or(&syscall_trace_flags, SYSCALL_TRACE_STATS, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&syscall_trace_flags, ~SYSCALL_TRACE_STATS, __ATOMIC_RELAXED);
+    }
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Start or stop streaming a process's calls into the event ring
+ *
+ * @param pid Process ID, 0 for the caller
+ * @param on Trace or stop tracing
+ * @return 0 on success, negative error code on failure
+ */
+int syscall_trace_process(uint32_t pid, bool on) {
+    struct process *proc = pid ? get_process(pid) : get_current_process();
+    if (!proc) {
+        return KERN_NOTFOUND;
+    }
+    if (!trace_ring) {
+        return KERN_NOMEM;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    bool traced = proc->trace_flags & PROC_TRACE_SYSCALLS;
+    if (on && !traced) {
+        proc->trace_flags |= PROC_TRACE_SYSCALLS;
+        traced_processes++;
+    } else if (!on && traced) {
+        proc->trace_flags &= ~PROC_TRACE_SYSCALLS;
+        traced_processes--;
+    }
+
+    if (traced_processes) {
+        __atomic_fetch_or(&syscall_trace_flags, SYSCALL_TRACE_EVENTS_ON, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&syscall_trace_flags, ~SYSCALL_TRACE_EVENTS_ON, __ATOMIC_RELAXED);
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Sum the counters of a system call over all CPUs
+ *
+ * @param num System call number
+ * @param stats Receives the sums
+ * @return 0 on success, negative error code on failure
+ */
+int syscall_get_stats(uint64_t num, struct syscall_stats *stats) {
+    if (num >= SYSCALL_TABLE_SIZE || !stats) {
+        return KERN_INVALID;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        struct syscall_cpu_stats *cs = __atomic_load_n(&cpu_stats[cpu], __ATOMIC_ACQUIRE);
+        if (!cs) {
+            continue;
+        }
+
+        const struct syscall_stats *s = &cs->calls[num];
+        stats->calls += s->calls;
+        stats->errors += s->errors;
+        stats->total_ns += s->total_ns;
+        if (s->max_ns > stats->max_ns) {
+            stats->max_ns = s->max_ns;
+        }
+        for (uint32_t i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+            stats->hist[i] += s->hist[i];
+        }
+    }
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Clear all counters and drop buffered events
+ *
+ * Counters of calls finishing concurrently may survive the reset.
+ */
+void syscall_trace_reset(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        struct syscall_cpu_stats *cs = __atomic_load_n(&cpu_stats[cpu], __ATOMIC_ACQUIRE);
+        if (cs) {
+            memset(cs, 0, sizeof(*cs));
+        }
+    }
+
+    if (trace_ring) {
+        uint64_t flags = spin_lock_irqsave(&trace_lock);
+        trace_ring->tail = trace_ring->head;
+        trace_ring->overwritten = 0;
+        spin_unlock_irqrestore(&trace_lock, flags);
+    }
+}
+
+/**
+ * @brief Consume buffered events, oldest first
+ *
+ * @param events Receives the events
+ * @param max Capacity of events
+ * @return Number of events copied
+ */
+uint32_t syscall_trace_read(struct syscall_event *events, uint32_t max) {
+    if (!trace_ring || !events) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    while (count < max && trace_ring->tail != trace_ring->head) {
+        events[count++] = trace_ring->events[trace_ring->tail % SYSCALL_TRACE_EVENTS];
+        trace_ring->tail++;
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return count;
+}
+
+/**
+ * @brief SYS_FG_PERF handler
+ *
+ * @param op FG_PERF_*
+ * @return Operation result, negative error code on failure
+ */
+int64_t sys_fg_perf(uint64_t op, uint64_t arg1, uint64_t arg2) {
+    switch (op) {
+        case FG_PERF_SYSCALL_STATS:
+            if (!arg2) {
+                return KERN_INVALID;
+            }
+            return syscall_get_stats(arg1, (struct syscall_stats*)arg2);
+
+        case FG_PERF_SYSCALL_RESET:
+            syscall_trace_reset();
+            return KERN_SUCCESS;
+
+        case FG_PERF_SYSCALL_ENABLE:
+            return syscall_trace_enable(arg1 != 0);
+
+        case FG_PERF_TRACE_PROCESS:
+            if (arg1 > UINT32_MAX) {
+                return KERN_INVALID;
+            }
+            return syscall_trace_process((uint32_t)arg1, arg2 != 0);
+
+        case FG_PERF_TRACE_READ:
+            if (!arg1 || arg2 > UINT32_MAX) {
+                return KERN_INVALID;
+            }
+            return syscall_trace_read((struct syscall_event*)arg1, (uint32_t)arg2);
+
+        default:
+            return KERN_INVALID;
+    }
+}
+
+// Internal functions
+
+/**
+ * @brief Histogram bucket of a duration: floor(log2(ns)), clamped
+ */
+static uint32_t syscall_hist_bucket(uint64_t ns) {
+    if (ns < 2) {
+        return 0;
+    }
+    uint32_t bucket = 63 - (uint32_t)__builtin_clzll(ns);
+    return bucket < SYSCALL_HIST_BUCKETS ? bucket : SYSCALL_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief Append an event, overwriting the oldest when the ring is full
+ */
+static void syscall_trace_event(uint64_t num, const uint64_t *args, int64_t ret,
+                                uint64_t start_ns, uint64_t duration_ns) {
+    struct process *proc = get_current_process();
+    struct thread *thread = get_current_thread();
+
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    if (trace_ring->head - trace_ring->tail == SYSCALL_TRACE_EVENTS) {
+        trace_ring->tail++;
+        trace_ring->overwritten++;
+    }
+
+    struct syscall_event *ev = &trace_ring->events[trace_ring->head % SYSCALL_TRACE_EVENTS];
+    ev->seq = trace_ring->head++;
+    ev->timestamp_ns = start_ns;
+    ev->duration_ns = duration_ns;
+    ev->pid = proc ? proc->pid : 0;
+    ev->tid = thread ? thread->tid : 0;
+    ev->num = (uint16_t)num;
+    ev->cpu = (uint16_t)smp_processor_id();
+    ev->reserved = 0;
+    memcpy(ev->args, args, sizeof(ev->args));
+    ev->ret = ret;
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+/**
+ * @brief /proc/syscalls/stats: calls, errors and time of each used call
+ */
+static void proc_show_syscall_stats(proc_buffer_t *buffer) {
+    proc_printf(buffer, "%-4s %-20s %12s %10s %14s %10s %10s\n",
+                "num", "name", "calls", "errors", "total_us", "avg_ns", "max_ns");
+
+    for (uint64_t num = 0; num < SYSCALL_TABLE_SIZE; num++) {
+        struct syscall_stats s;
+        if (syscall_get_stats(num, &s) != KERN_SUCCESS || s.calls == 0) {
+            continue;
+        }
+        proc_printf(buffer, "%-4llu %-20s %12llu %10llu %14llu %10llu %10llu\n",
+                    num, syscall_name(num), s.calls, s.errors, s.total_ns / NSEC_PER_USEC,
+                    s.total_ns / s.calls, s.max_ns);
+    }
+}
+
+/**
+ * @brief /proc/syscalls/latency: non-empty histogram buckets of each used call
+ */
+static void proc_show_syscall_latency(proc_buffer_t *buffer) {
+    for (uint64_t num = 0; num < SYSCALL_TABLE_SIZE; num++) {
+        struct syscall_stats s;
+        if (syscall_get_stats(num, &s) != KERN_SUCCESS || s.calls == 0) {
+            continue;
+        }
+
+        proc_printf(buffer, "%s:", syscall_name(num));
+        for (uint32_t i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+            if (s.hist[i]) {
+                proc_printf(buffer, " %llu:%llu", 1ULL << i, s.hist[i]);
+            }
+        }
+        proc_printf(buffer, "\n");
+    }
+}
+
+/**
+ * @brief /proc/syscalls/trace: most recent events without consuming them
+ */
+static void proc_show_syscall_trace(proc_buffer_t *buffer) {
+    static struct syscall_event recent[PROC_TRACE_EVENTS];
+    static spinlock_t recent_lock = {0};
+    uint64_t overwritten = 0;
+    uint32_t count = 0;
+
+    if (!trace_ring) {
+        return;
+    }
+
+    uint64_t rflags = spin_lock_irqsave(&recent_lock);
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    uint64_t first = trace_ring->head - trace_ring->tail > PROC_TRACE_EVENTS
+                   ? trace_ring->head - PROC_TRACE_EVENTS : trace_ring->tail;
+    for (uint64_t seq = first; seq != trace_ring->head; seq++) {
+        recent[count++] = trace_ring->events[seq % SYSCALL_TRACE_EVENTS];
+    }
+    overwritten = trace_ring->overwritten;
+    spin_unlock_irqrestore(&trace_lock, flags);
+
+    proc_printf(buffer, "# overwritten %llu\n", overwritten);
+    for (uint32_t i = 0; i < count; i++) {
+        const struct syscall_event *ev = &recent[i];
+        proc_printf(buffer, "%llu %u/%u cpu%u %s(0x%llx, 0x%llx, 0x%llx) = %lld <%llu ns>\n",
+                    ev->timestamp_ns, ev->pid, ev->tid, ev->cpu, syscall_name(ev->num),
+                    ev->args[0], ev->args[1], ev->args[2], ev->ret, ev->duration_ns);
+    }
+    spin_unlock_irqrestore(&recent_lock, rflags);
+}
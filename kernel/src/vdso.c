@@ -0,0 +1,434 @@
+/*
+ * FG-OS Virtual Dynamic Shared Object
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Kernel side of the vDSO. The linker script places the vvar page and the
+ * image (ELF headers from .vdso.elf, then the code in src/vdso_user.c)
+ * in one page-aligned .vdso section; its pages are mapped user-readable
+ * at VDSO_BASE in the same order, so the image's RIP-relative references
+ * to the vvar page are valid at either address. The ELF headers and the
+ * dynamic symbol table are filled in at boot from the link-time layout.
+ *
+ * Writers update the vvar page inside a sequence count: readers retry if
+ * the count was odd or changed while they read.
+ */
+
+#include "../include/kernel.h"
+#include "../include/spinlock.h"
+#include "../include/vdso.h"
+#include "../include/syscall.h"
+#include "../mm/memory.h"
+#include "../arch/x86_64/arch.h"
+#include "../interrupt/clocksource.h"
+#include "../sched/topology.h"
+
+// Minimal ELF64 definitions for the image
+#define ELF_CLASS64             2
+#define ELF_DATA2LSB            1
+#define ELF_VERSION_CURRENT     1
+#define ELF_OSABI_NONE          0
+#define ELF_ET_DYN              3
+#define ELF_EM_X86_64           62
+#define ELF_PT_LOAD             1
+#define ELF_PT_DYNAMIC          2
+#define ELF_PF_X                (1 << 0)
+#define ELF_PF_R                (1 << 2)
+#define ELF_DT_NULL             0
+#define ELF_DT_HASH             4
+#define ELF_DT_STRTAB           5
+#define ELF_DT_SYMTAB           6
+#define ELF_DT_STRSZ            10
+#define ELF_DT_SYMENT           11
+#define ELF_STB_GLOBAL          1
+#define ELF_STT_FUNC            2
+#define ELF_SHN_TEXT            1       // Any defined index; the image has no section headers
+
+typedef struct {
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf64_ehdr_t;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} elf64_phdr_t;
+
+typedef struct {
+    int64_t  d_tag;
+    uint64_t d_val;
+} elf64_dyn_t;
+
+typedef struct {
+    uint32_t st_name;
+    uint8_t  st_info;
+    uint8_t  st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+} elf64_sym_t;
+
+// Exported entry points
+static const struct {
+    const char *name;
+    const void *address;
+} vdso_symbols[] = {
+    { "__vdso_clock_gettime", (const void *)__vdso_clock_gettime },
+    { "__vdso_getcpu",        (const void *)__vdso_getcpu },
+    { "__vdso_time",          (const void *)__vdso_time },
+};
+
+#define VDSO_NR_SYMBOLS     (sizeof(vdso_symbols) / sizeof(vdso_symbols[0]))
+#define VDSO_STRTAB_SIZE    64
+
+// ELF headers at the start of the image
+struct vdso_elf {
+    elf64_ehdr_t ehdr;
+    elf64_phdr_t phdr[2];
+    elf64_dyn_t  dyn[6];
+    uint32_t     hash[2 + 1 + VDSO_NR_SYMBOLS + 1];     // nbucket, nchain, bucket, chain
+    elf64_sym_t  sym[VDSO_NR_SYMBOLS + 1];
+    char         strtab[VDSO_STRTAB_SIZE];
+};
+
+// The vvar page, read by src/vdso_user.c through a hidden RIP-relative reference
+struct vdso_data vdso_vvar __attribute__((section(".vdso.vvar"), aligned(PAGE_SIZE)));
+
+static struct vdso_elf vdso_elf __attribute__((section(".vdso.elf"), aligned(16)));
+
+// Section bounds from linker.ld
+extern char __vdso_start[], __vdso_image_start[], __vdso_end[];
+
+static struct vdso_stats vdso_stats;
+static spinlock_t vdso_lock = {0};          // Serializes vvar writers
+static bool vdso_mapped = false;
+
+// Internal function declarations
+static void vdso_build_image(void);
+static uint32_t vdso_detect_getcpu(void);
+static uint64_t vdso_write_begin(void);
+static void vdso_write_end(uint64_t flags);
+
+/**
+ * @brief Build and map the vDSO
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int vdso_init(void) {
+    KINFO("Initializing vDSO...");
+
+    if ((uint64_t)(__vdso_image_start - __vdso_start) != VDSO_IMAGE_OFFSET) {
+        KERROR("vDSO: vvar page must directly precede the image");
+        return KERN_ERROR;
+    }
+
+    vdso_build_image();
+    vdso_vvar.getcpu_mode = vdso_detect_getcpu();
+    vdso_update_clock();
+    vdso_cpu_init(smp_processor_id());
+
+    // Same page order as the kernel view; user mappings are read-only
+    uint64_t size = (uint64_t)(__vdso_end - __vdso_start);
+    for (uint64_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        uint64_t phys = vmm_get_physical((uint64_t)__vdso_start + offset);
+        if (!phys || vmm_map_page(VDSO_BASE + offset, phys, PTE_PRESENT | PTE_USER) != 0) {
+            KERROR("vDSO: failed to map page at offset 0x%llx", offset);
+            return KERN_NOMEM;
+        }
+    }
+    vdso_mapped = true;
+
+    KINFO("vDSO mapped at 0x%016llx: %u byte image, clock %s, getcpu %s",
+          VDSO_BASE, vdso_stats.image_size,
+          vdso_vvar.clock_mode == VDSO_CLOCKMODE_TSC ? "TSC" : "syscall",
+          vdso_vvar.getcpu_mode == VDSO_GETCPU_RDPID ? "RDPID" :
+          vdso_vvar.getcpu_mode == VDSO_GETCPU_RDTSCP ? "RDTSCP" : "unavailable");
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Store the calling CPU's number for RDTSCP/RDPID
+ *
+ * Run by every CPU as it comes online.
+ *
+ * @param cpu Calling CPU
+ */
+void vdso_cpu_init(uint32_t cpu) {
+    if (cpu >= MAX_CPUS || vdso_vvar.getcpu_mode == VDSO_GETCPU_NONE) {
+        return;
+    }
+
+    uint64_t node = cpu_get_topology(cpu)->node;
+    wrmsr(MSR_TSC_AUX, (node << VDSO_CPU_BITS) | (cpu & VDSO_CPU_MASK));
+}
+
+/**
+ * @brief Publish the current clock source parameters
+ *
+ * User space can scale the TSC itself only when the TSC backs the clock;
+ * with the HPET or the tick it falls back to SYS_GETTIME.
+ */
+void vdso_update_clock(void) {
+    const clocksource_t *cs = clocksource_get();
+
+    uint64_t flags = vdso_write_begin();
+    if (cs->type == CLOCKSOURCE_TSC) {
+        vdso_vvar.clock_mode = VDSO_CLOCKMODE_TSC;
+        vdso_vvar.cycle_last = cs->base_cycles;
+        vdso_vvar.base_ns = cs->base_ns;
+        vdso_vvar.mult = cs->mult;
+        vdso_vvar.shift = cs->shift;
+    } else {
+        vdso_vvar.clock_mode = VDSO_CLOCKMODE_NONE;
+    }
+    vdso_write_end(flags);
+}
+
+/**
+ * @brief Get the user address of the vvar page
+ *
+ * @return VDSO_BASE, 0 before the vDSO is mapped
+ */
+uint64_t vdso_base(void) {
+    return vdso_mapped ? VDSO_BASE : 0;
+}
+
+/**
+ * @brief Get vDSO statistics
+ *
+ * @return Pointer to the statistics
+ */
+const struct vdso_stats* vdso_get_stats(void) {
+    return &vdso_stats;
+}
+
+/**
+ * @brief Dump vDSO state for debugging
+ */
+void vdso_dump_status(void) {
+    printf("=== vDSO ===\n");
+    printf("Base: 0x%016llx (%s)\n", VDSO_BASE, vdso_mapped ? "mapped" : "not mapped");
+    printf("Image: %u bytes, %u symbols\n", vdso_stats.image_size, vdso_stats.symbols);
+    printf("Clock mode: %u, getcpu mode: %u, updates: %llu\n",
+           vdso_vvar.clock_mode, vdso_vvar.getcpu_mode, vdso_stats.clock_updates);
+    printf("Realtime offset: %lld ns\n", vdso_vvar.realtime_offset_ns);
+}
+
+/**
+ * @brief SYS_GETTIME handler
+ *
+ * @param clock_id CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME
+ * @param uaddr User address of a struct timespec
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_gettime(uint64_t clock_id, uint64_t uaddr) {
+    if (!uaddr) {
+        return KERN_INVALID;
+    }
+
+    uint64_t ns = ktime_get_ns();
+    switch (clock_id) {
+        case CLOCK_REALTIME:
+            ns += vdso_vvar.realtime_offset_ns;
+            break;
+        case CLOCK_MONOTONIC:
+        case CLOCK_BOOTTIME:
+            break;
+        default:
+            return KERN_INVALID;
+    }
+
+    struct timespec *ts = (struct timespec *)uaddr;
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief SYS_SETTIME handler
+ *
+ * Only the wall clock can be set; it moves relative to CLOCK_MONOTONIC.
+ *
+ * @param clock_id CLOCK_REALTIME
+ * @param uaddr User address of a struct timespec
+ * @return 0 on success, negative error code on failure
+ */
+int64_t sys_settime(uint64_t clock_id, uint64_t uaddr) {
+    if (clock_id != CLOCK_REALTIME || !uaddr) {
+        return KERN_INVALID;
+    }
+
+    // One copy: the user could change the value between the check and its use
+    struct timespec ts = *(const struct timespec *)uaddr;
+
+    // tv_nsec is added on top, so tv_sec must stay below the quotient
+    if (ts.tv_sec < 0 || ts.tv_sec >= INT64_MAX / (int64_t)NSEC_PER_SEC ||
+        ts.tv_nsec < 0 || ts.tv_nsec >= (int64_t)NSEC_PER_SEC) {
+        return KERN_INVALID;
+    }
+
+    int64_t realtime = ts.tv_sec * (int64_t)NSEC_PER_SEC + ts.tv_nsec;
+
+    uint64_t flags = vdso_write_begin();
+    vdso_vvar.realtime_offset_ns = realtime - (int64_t)ktime_get_ns();
+    vdso_write_end(flags);
+    return KERN_SUCCESS;
+}
+
+// Internal functions
+
+/**
+ * @brief Fill in the ELF headers and dynamic symbol table
+ *
+ * Addresses in the image are offsets from its first byte, as for any
+ * position-independent shared object.
+ */
+static void vdso_build_image(void) {
+    struct vdso_elf *elf = &vdso_elf;
+    uint64_t image = (uint64_t)__vdso_image_start;
+    uint64_t image_size = (uint64_t)(__vdso_end - __vdso_image_start);
+    memset(elf, 0, sizeof(*elf));
+
+    elf64_ehdr_t *eh = &elf->ehdr;
+    eh->e_ident[0] = 0x7F;
+    eh->e_ident[1] = 'E';
+    eh->e_ident[2] = 'L';
+    eh->e_ident[3] = 'F';
+    eh->e_ident[4] = ELF_CLASS64;
+    eh->e_ident[5] = ELF_DATA2LSB;
+    eh->e_ident[6] = ELF_VERSION_CURRENT;
+    eh->e_ident[7] = ELF_OSABI_NONE;
+    eh->e_type = ELF_ET_DYN;
+    eh->e_machine = ELF_EM_X86_64;
+    eh->e_version = ELF_VERSION_CURRENT;
+    eh->e_phoff = offsetof(struct vdso_elf, phdr);
+    eh->e_ehsize = sizeof(elf64_ehdr_t);
+    eh->e_phentsize = sizeof(elf64_phdr_t);
+    eh->e_phnum = 2;
+
+    elf->phdr[0].p_type = ELF_PT_LOAD;
+    elf->phdr[0].p_flags = ELF_PF_R | ELF_PF_X;
+    elf->phdr[0].p_filesz = image_size;
+    elf->phdr[0].p_memsz = image_size;
+    elf->phdr[0].p_align = PAGE_SIZE;
+
+    elf->phdr[1].p_type = ELF_PT_DYNAMIC;
+    elf->phdr[1].p_flags = ELF_PF_R;
+    elf->phdr[1].p_offset = offsetof(struct vdso_elf, dyn);
+    elf->phdr[1].p_vaddr = offsetof(struct vdso_elf, dyn);
+    elf->phdr[1].p_paddr = offsetof(struct vdso_elf, dyn);
+    elf->phdr[1].p_filesz = sizeof(elf->dyn);
+    elf->phdr[1].p_memsz = sizeof(elf->dyn);
+    elf->phdr[1].p_align = 8;
+
+    elf->dyn[0] = (elf64_dyn_t){ ELF_DT_HASH, offsetof(struct vdso_elf, hash) };
+    elf->dyn[1] = (elf64_dyn_t){ ELF_DT_SYMTAB, offsetof(struct vdso_elf, sym) };
+    elf->dyn[2] = (elf64_dyn_t){ ELF_DT_STRTAB, offsetof(struct vdso_elf, strtab) };
+    elf->dyn[3] = (elf64_dyn_t){ ELF_DT_STRSZ, VDSO_STRTAB_SIZE };
+    elf->dyn[4] = (elf64_dyn_t){ ELF_DT_SYMENT, sizeof(elf64_sym_t) };
+    elf->dyn[5] = (elf64_dyn_t){ ELF_DT_NULL, 0 };
+
+    // One hash bucket chaining every symbol: lookups are a short linear scan
+    uint32_t nsyms = VDSO_NR_SYMBOLS + 1;
+    elf->hash[0] = 1;
+    elf->hash[1] = nsyms;
+    elf->hash[2] = 1;
+    uint32_t *chain = &elf->hash[3];
+    for (uint32_t i = 1; i < nsyms; i++) {
+        chain[i] = (i + 1 < nsyms) ? i + 1 : 0;
+    }
+
+    uint32_t str = 1;       // strtab[0] is the empty name
+    for (uint32_t i = 0; i < VDSO_NR_SYMBOLS; i++) {
+        elf64_sym_t *sym = &elf->sym[i + 1];
+        const char *name = vdso_symbols[i].name;
+        size_t len = 0;
+        while (name[len]) {
+            len++;
+        }
+        if (str + len + 1 > VDSO_STRTAB_SIZE) {
+            KERROR("vDSO: string table too small");
+            break;
+        }
+        memcpy(&elf->strtab[str], name, len + 1);
+
+        sym->st_name = str;
+        sym->st_info = (ELF_STB_GLOBAL << 4) | ELF_STT_FUNC;
+        sym->st_shndx = ELF_SHN_TEXT;
+        sym->st_value = (uint64_t)vdso_symbols[i].address - image;
+        str += len + 1;
+        vdso_stats.symbols++;
+    }
+
+    vdso_stats.image_size = (uint32_t)image_size;
+}
+
+/**
+ * @brief Choose the fastest instruction that returns TSC_AUX
+ *
+ * @return VDSO_GETCPU_* mode
+ */
+static uint32_t vdso_detect_getcpu(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+        cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        if (ecx & (1U << 22)) {
+            return VDSO_GETCPU_RDPID;
+        }
+    }
+
+    cpuid_count(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000001) {
+        cpuid_count(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        if (edx & (1U << 27)) {
+            return VDSO_GETCPU_RDTSCP;
+        }
+    }
+
+    return VDSO_GETCPU_NONE;
+}
+
+/**
+ * @brief Enter a vvar update; readers spin or retry until vdso_write_end()
+ *
+ * @return Interrupt state for vdso_write_end()
+ */
+static uint64_t vdso_write_begin(void) {
+    uint64_t flags = spin_lock_irqsave(&vdso_lock);
+    __atomic_store_n(&vdso_vvar.seq, vdso_vvar.seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return flags;
+}
+
+/**
+ * @brief Leave a vvar update
+ *
+ * @param flags Value returned by vdso_write_begin()
+ */
+static void vdso_write_end(uint64_t flags) {
+    __atomic_store_n(&vdso_vvar.seq, vdso_vvar.seq + 1, __ATOMIC_RELEASE);
+    vdso_stats.clock_updates++;
+    spin_unlock_irqrestore(&vdso_lock, flags);
+}
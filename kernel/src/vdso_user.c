@@ -0,0 +1,171 @@
+/*
+ * FG-OS vDSO Entry Points
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Code in this file runs in user mode from the read-only vDSO mapping.
+ * It is built with -fPIC and lives in .vdso.text, directly after the ELF
+ * headers, so it must be self-contained: every helper is inlined, the
+ * only data it touches is the vvar page (reached RIP-relative), and it
+ * calls nothing in the kernel. When the fast path cannot be used it
+ * issues the equivalent system call.
+ */
+
+#include "../include/vdso.h"
+#include "../include/syscall.h"
+
+#define __vdso_text     __attribute__((section(".vdso.text")))
+#define __vdso_inline   static inline __attribute__((always_inline))
+
+#define VDSO_NSEC_PER_SEC   1000000000ULL
+
+// Defined in src/vdso.c; hidden so the reference is RIP-relative rather than through a GOT
+extern struct vdso_data vdso_vvar __attribute__((visibility("hidden")));
+
+/**
+ * @brief Start reading the vvar page
+ *
+ * @return Sequence count to pass to vdso_read_retry()
+ */
+__vdso_inline uint32_t vdso_read_begin(const struct vdso_data *vd) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&vd->seq, __ATOMIC_ACQUIRE)) & 1) {
+        __asm__ __volatile__("pause");
+    }
+    return seq;
+}
+
+/**
+ * @brief Check whether the kernel updated the vvar page during the read
+ */
+__vdso_inline bool vdso_read_retry(const struct vdso_data *vd, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&vd->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/**
+ * @brief Read the TSC after all earlier loads have completed
+ */
+__vdso_inline uint64_t vdso_rdtsc_ordered(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief System call with two arguments
+ */
+__vdso_inline int64_t vdso_syscall2(uint64_t num, uint64_t arg1, uint64_t arg2) {
+    int64_t ret;
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(num), "D"(arg1), "S"(arg2)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+/**
+ * @brief Read a clock in nanoseconds from the vvar page
+ *
+ * @return true on success, false if the system call must be used
+ */
+__vdso_inline bool vdso_read_clock(uint32_t clock_id, uint64_t *ns) {
+    const struct vdso_data *vd = &vdso_vvar;
+    uint64_t now;
+    int64_t offset;
+    uint32_t seq;
+
+    do {
+        seq = vdso_read_begin(vd);
+        if (vd->clock_mode != VDSO_CLOCKMODE_TSC) {
+            return false;
+        }
+
+        uint64_t cycles = vdso_rdtsc_ordered();
+        uint64_t delta = cycles > vd->cycle_last ? cycles - vd->cycle_last : 0;
+        now = vd->base_ns + (uint64_t)(((unsigned __int128)delta * vd->mult) >> vd->shift);
+        offset = vd->realtime_offset_ns;
+    } while (vdso_read_retry(vd, seq));
+
+    *ns = clock_id == CLOCK_REALTIME ? now + offset : now;
+    return true;
+}
+
+/**
+ * @brief clock_gettime() without entering the kernel
+ *
+ * @param clock_id CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME
+ * @param ts Receives the time
+ * @return 0 on success, negative error code on failure
+ */
+__vdso_text int __vdso_clock_gettime(uint32_t clock_id, struct timespec *ts) {
+    uint64_t ns;
+
+    if ((clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC && clock_id != CLOCK_BOOTTIME) ||
+        !vdso_read_clock(clock_id, &ns)) {
+        return (int)vdso_syscall2(SYS_GETTIME, clock_id, (uint64_t)ts);
+    }
+
+    ts->tv_sec = ns / VDSO_NSEC_PER_SEC;
+    ts->tv_nsec = ns % VDSO_NSEC_PER_SEC;
+    return 0;
+}
+
+/**
+ * @brief Get the current CPU and NUMA node without entering the kernel
+ *
+ * The result may be stale as soon as it is returned if the thread migrates.
+ *
+ * @param cpu Receives the CPU number, may be NULL
+ * @param node Receives the node number, may be NULL
+ * @return 0 on success, negative error code if the CPU cannot tell
+ */
+__vdso_text int __vdso_getcpu(uint32_t *cpu, uint32_t *node) {
+    uint64_t aux;
+
+    switch (vdso_vvar.getcpu_mode) {
+        case VDSO_GETCPU_RDPID:
+            __asm__ __volatile__("rdpid %0" : "=r"(aux));
+            break;
+        case VDSO_GETCPU_RDTSCP: {
+            uint32_t ecx;
+            __asm__ __volatile__("rdtscp" : "=c"(ecx) :: "eax", "edx");
+            aux = ecx;
+            break;
+        }
+        default:
+            return SYSCALL_INVALID;
+    }
+
+    if (cpu) {
+        *cpu = (uint32_t)aux & VDSO_CPU_MASK;
+    }
+    if (node) {
+        *node = (uint32_t)aux >> VDSO_CPU_BITS;
+    }
+    return 0;
+}
+
+/**
+ * @brief time() without entering the kernel
+ *
+ * @param t Also receives the result, may be NULL
+ * @return Seconds of CLOCK_REALTIME
+ */
+__vdso_text int64_t __vdso_time(int64_t *t) {
+    struct timespec ts;
+    uint64_t ns;
+
+    if (vdso_read_clock(CLOCK_REALTIME, &ns)) {
+        ts.tv_sec = ns / VDSO_NSEC_PER_SEC;
+    } else if (vdso_syscall2(SYS_GETTIME, CLOCK_REALTIME, (uint64_t)&ts) != 0) {
+        return SYSCALL_ERROR;
+    }
+
+    if (t) {
+        *t = ts.tv_sec;
+    }
+    return ts.tv_sec;
+}
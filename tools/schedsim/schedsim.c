@@ -0,0 +1,514 @@
+/*
+ * FG-OS Scheduler Simulator
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Replays a workload against kernel/sched/scheduler.c on simulated CPUs
+ * and reports, per scheduling policy, throughput, fairness (Jain's index
+ * over the share of CPU each thread got while runnable) and wakeup latency
+ * percentiles. Time advances in 1 ms scheduler ticks.
+ *
+ * A workload is one thread per line:
+ *
+ *   # arrival_ms priority run_ms sleep_ms [run_ms sleep_ms ...]
+ *   0 10 200 0
+ *   5 5 2 15 2 15 2 0
+ *
+ * Each thread runs its bursts in order, sleeping in between, and exits
+ * after the last burst (its trailing sleep is ignored). Without -t a
+ * synthetic mix of CPU-bound and interactive threads is generated; -g
+ * prints it in trace format so it can be edited and replayed.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "schedsim.h"
+
+// Scheduler policies (kernel/sched/scheduler.h)
+#define SCHED_POLICY_ROUND_ROBIN    1
+#define SCHED_POLICY_PRIORITY       2
+
+#define SIM_MAX_THREADS     4096
+#define SIM_MAX_BURSTS      256
+#define SIM_LINE_MAX        4096
+
+// Workload Thread
+struct workload_thread {
+    unsigned long long arrival;         // Arrival time (ms)
+    unsigned int priority;              // Kernel priority, lower runs first
+    unsigned int nbursts;               // Run bursts
+    unsigned int run[SIM_MAX_BURSTS];   // Burst lengths (ms)
+    unsigned int sleep[SIM_MAX_BURSTS]; // Sleep after each burst (ms)
+};
+
+// Per-thread Run State
+struct thread_run {
+    sim_thread_t *thread;
+    bool started;
+    bool finished;
+    unsigned int burst;                 // Current burst
+    unsigned int run_left;              // ms left in the current burst
+    unsigned long long cpu_ms;          // CPU time received
+    unsigned long long slept_ms;        // Time asleep between bursts
+    unsigned long long finish;          // Exit time (ms)
+};
+
+// Policy Run Results
+struct policy_result {
+    const char *name;
+    unsigned int ncpus;
+    unsigned int completed;
+    unsigned long long makespan;
+    unsigned long long busy_ms;
+    unsigned long long switches;
+    double jain;
+    unsigned long long *wake_lat;       // Wakeup latencies (ms)
+    size_t nwake;
+    size_t wake_cap;
+};
+
+static const struct {
+    const char *name;
+    int policy;
+} policies[] = {
+    // CFS and REALTIME select from the same queues as rr and priority in
+    // select_next_thread(), so they are not separate rows
+    { "rr",       SCHED_POLICY_ROUND_ROBIN },
+    { "priority", SCHED_POLICY_PRIORITY },
+};
+
+#define NR_POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+static struct workload_thread *workload;
+static unsigned int nthreads;
+static struct policy_result *current_result;
+static bool verbose = false;
+
+// Forward declarations
+static int load_trace(const char *path);
+static void generate_workload(unsigned int count, unsigned long long seed);
+static void print_workload(void);
+static int run_policy(int policy, unsigned int ncpus, unsigned int llc_size,
+                      bool preempt, unsigned long long limit, struct policy_result *result);
+static void print_result(const struct policy_result *result);
+static unsigned long long percentile(const unsigned long long *sorted, size_t count, double pct);
+static int compare_u64(const void *a, const void *b);
+static void usage(const char *prog);
+
+int main(int argc, char **argv) {
+    unsigned int ncpus = 1;
+    unsigned int llc_size = 0;
+    unsigned int count = 16;
+    unsigned long long seed = 1;
+    unsigned long long limit = 600000;
+    const char *trace = NULL;
+    const char *policy_name = "all";
+    bool preempt = true;
+    bool dump = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "-c") && val) { ncpus = (unsigned int)strtoul(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "-l") && val) { llc_size = (unsigned int)strtoul(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "-p") && val) { policy_name = val; i++; }
+        else if (!strcmp(arg, "-t") && val) { trace = val; i++; }
+        else if (!strcmp(arg, "-n") && val) { count = (unsigned int)strtoul(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "-s") && val) { seed = strtoull(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "-d") && val) { limit = strtoull(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "-N")) { preempt = false; }
+        else if (!strcmp(arg, "-g")) { dump = true; }
+        else if (!strcmp(arg, "-v")) { verbose = true; }
+        else { usage(argv[0]); return arg[1] == 'h' ? 0 : 1; }
+    }
+
+    workload = calloc(SIM_MAX_THREADS, sizeof(struct workload_thread));
+    if (!workload) {
+        fprintf(stderr, "schedsim: out of memory\n");
+        return 1;
+    }
+
+    if (trace) {
+        if (load_trace(trace) != 0) {
+            return 1;
+        }
+    } else {
+        generate_workload(count ? count : 1, seed);
+    }
+
+    if (dump) {
+        print_workload();
+        return 0;
+    }
+
+    printf("Workload: %u threads, %u CPUs (LLC size %u), preemption %s\n\n",
+           nthreads, ncpus, llc_size ? llc_size : ncpus, preempt ? "on" : "off");
+    printf("%-9s %6s %10s %9s %6s %6s %9s %8s %8s %8s %8s\n",
+           "Policy", "Done", "Makespan", "Thrpt/s", "Util%", "Jain",
+           "Switches", "Wake p50", "p90", "p99", "max");
+
+    bool matched = false;
+    for (size_t i = 0; i < NR_POLICIES; i++) {
+        if (strcmp(policy_name, "all") && strcmp(policy_name, policies[i].name)) {
+            continue;
+        }
+        matched = true;
+
+        struct policy_result result = { .name = policies[i].name };
+        if (run_policy(policies[i].policy, ncpus, llc_size, preempt, limit, &result) != 0) {
+            fprintf(stderr, "schedsim: %s: simulation failed\n", policies[i].name);
+            return 1;
+        }
+        print_result(&result);
+        free(result.wake_lat);
+    }
+
+    if (!matched) {
+        fprintf(stderr, "schedsim: unknown policy '%s'\n", policy_name);
+        return 1;
+    }
+
+    printf("\nLatencies in ms at 1 ms tick resolution.\n");
+    return 0;
+}
+
+/**
+ * @brief Record a thread being dispatched (called by the kernel side)
+ *
+ * @param id Workload thread ID
+ * @param waited_ms Time spent on the ready queue
+ * @param woken Whether it was queued by a wakeup
+ */
+void sim_note_dispatch(unsigned int id, unsigned long long waited_ms, int woken) {
+    struct policy_result *result = current_result;
+    (void)id;
+
+    if (!result || !woken) {
+        return;
+    }
+
+    if (result->nwake == result->wake_cap) {
+        size_t cap = result->wake_cap ? result->wake_cap * 2 : 1024;
+        unsigned long long *lat = realloc(result->wake_lat, cap * sizeof(*lat));
+        if (!lat) {
+            return;
+        }
+        result->wake_lat = lat;
+        result->wake_cap = cap;
+    }
+    result->wake_lat[result->nwake++] = waited_ms;
+}
+
+/**
+ * @brief Kernel log output, shown with -v
+ */
+int schedsim_printk(const char *fmt, ...) {
+    if (!verbose) {
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int ret = vprintf(fmt, args);
+    va_end(args);
+    return ret;
+}
+
+// Helper functions implementation
+
+/**
+ * @brief Simulate the workload under one policy
+ */
+static int run_policy(int policy, unsigned int ncpus, unsigned int llc_size,
+                      bool preempt, unsigned long long limit, struct policy_result *result) {
+    struct thread_run *runs = calloc(nthreads, sizeof(struct thread_run));
+    if (!runs) {
+        return -1;
+    }
+
+    if (sim_reset(ncpus, llc_size, policy, preempt) != 0) {
+        free(runs);
+        return -1;
+    }
+    current_result = result;
+
+    for (unsigned int i = 0; i < nthreads; i++) {
+        runs[i].thread = sim_thread_create(i + 1, workload[i].priority);
+        if (!runs[i].thread) {
+            free(runs);
+            return -1;
+        }
+        runs[i].run_left = workload[i].run[0];
+    }
+
+    unsigned long long now;
+    for (now = 0; now < limit && result->completed < nthreads; now++) {
+        sim_set_time(now);
+
+        for (unsigned int i = 0; i < nthreads; i++) {
+            if (!runs[i].started && workload[i].arrival <= now) {
+                runs[i].started = true;
+                sim_thread_start(runs[i].thread);
+            }
+        }
+
+        for (unsigned int cpu = 0; cpu < ncpus; cpu++) {
+            sim_set_cpu(cpu);
+
+            // The running thread used the millisecond that just ended
+            sim_thread_t *thread = now ? sim_current() : NULL;
+            if (thread) {
+                struct thread_run *run = &runs[sim_thread_id(thread) - 1];
+                const struct workload_thread *work = &workload[sim_thread_id(thread) - 1];
+
+                run->cpu_ms++;
+                result->busy_ms++;
+                if (run->run_left && --run->run_left == 0) {
+                    unsigned int sleep_ms = work->sleep[run->burst];
+                    if (++run->burst == work->nbursts) {
+                        run->finished = true;
+                        run->finish = now;
+                        result->completed++;
+                        sim_thread_exit(thread);
+                    } else {
+                        run->run_left = work->run[run->burst];
+                        if (sleep_ms) {
+                            run->slept_ms += sleep_ms;
+                            sim_thread_sleep(thread, sleep_ms);
+                        }
+                    }
+                }
+            }
+
+            sim_tick();
+            if (!sim_current()) {
+                sim_schedule();
+            }
+        }
+    }
+
+    result->ncpus = ncpus;
+    result->makespan = now;
+    result->switches = sim_context_switches();
+
+    // Jain's index over the share of CPU each thread got while runnable
+    double sum = 0.0, sum_sq = 0.0;
+    unsigned int counted = 0;
+    for (unsigned int i = 0; i < nthreads; i++) {
+        if (!runs[i].started) {
+            continue;
+        }
+        unsigned long long end = runs[i].finished ? runs[i].finish : now;
+        unsigned long long alive = end > workload[i].arrival ? end - workload[i].arrival : 0;
+        unsigned long long runnable = alive > runs[i].slept_ms ? alive - runs[i].slept_ms : 1;
+        double share = (double)runs[i].cpu_ms / (double)runnable;
+        sum += share;
+        sum_sq += share * share;
+        counted++;
+    }
+    result->jain = sum_sq > 0.0 ? (sum * sum) / (counted * sum_sq) : 1.0;
+
+    // Threads still queued or running are abandoned with the scheduler state
+    for (unsigned int i = 0; i < nthreads; i++) {
+        if (runs[i].finished || !runs[i].started) {
+            sim_thread_destroy(runs[i].thread);
+        }
+    }
+
+    current_result = NULL;
+    free(runs);
+    return 0;
+}
+
+/**
+ * @brief Print one policy's results row
+ */
+static void print_result(const struct policy_result *result) {
+    double seconds = result->makespan / 1000.0;
+    unsigned long long ncpu_ms = result->makespan * result->ncpus;
+
+    qsort(result->wake_lat, result->nwake, sizeof(unsigned long long), compare_u64);
+
+    printf("%-9s %6u %8llums %9.2f %6.1f %6.3f %9llu %8llu %8llu %8llu %8llu\n",
+           result->name, result->completed, result->makespan,
+           seconds > 0.0 ? result->completed / seconds : 0.0,
+           ncpu_ms ? 100.0 * result->busy_ms / ncpu_ms : 0.0,
+           result->jain, result->switches,
+           percentile(result->wake_lat, result->nwake, 50.0),
+           percentile(result->wake_lat, result->nwake, 90.0),
+           percentile(result->wake_lat, result->nwake, 99.0),
+           result->nwake ? result->wake_lat[result->nwake - 1] : 0ULL);
+}
+
+/**
+ * @brief Nearest-rank percentile of a sorted array
+ */
+static unsigned long long percentile(const unsigned long long *sorted, size_t count, double pct) {
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t rank = (size_t)((pct / 100.0) * count + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+static int compare_u64(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Load a workload trace
+ */
+static int load_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    char line[SIM_LINE_MAX];
+    unsigned int lineno = 0;
+    nthreads = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        lineno++;
+
+        char *cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') {
+            cursor++;
+        }
+        if (*cursor == '#' || *cursor == '\n' || *cursor == '\0') {
+            continue;
+        }
+
+        if (nthreads == SIM_MAX_THREADS) {
+            fprintf(stderr, "%s:%u: more than %u threads\n", path, lineno, SIM_MAX_THREADS);
+            fclose(file);
+            return -1;
+        }
+
+        struct workload_thread *work = &workload[nthreads];
+        char *end;
+        work->arrival = strtoull(cursor, &end, 0);
+        cursor = end;
+        work->priority = (unsigned int)strtoul(cursor, &end, 0);
+        if (end == cursor) {
+            fprintf(stderr, "%s:%u: expected arrival and priority\n", path, lineno);
+            fclose(file);
+            return -1;
+        }
+        cursor = end;
+
+        work->nbursts = 0;
+        for (;;) {
+            unsigned long run = strtoul(cursor, &end, 0);
+            if (end == cursor) {
+                break;
+            }
+            cursor = end;
+            unsigned long sleep_ms = strtoul(cursor, &end, 0);
+            cursor = end;
+
+            if (work->nbursts == SIM_MAX_BURSTS) {
+                fprintf(stderr, "%s:%u: more than %u bursts\n", path, lineno, SIM_MAX_BURSTS);
+                fclose(file);
+                return -1;
+            }
+            if (run == 0) {
+                continue;
+            }
+            work->run[work->nbursts] = (unsigned int)run;
+            work->sleep[work->nbursts] = (unsigned int)sleep_ms;
+            work->nbursts++;
+        }
+
+        if (work->nbursts == 0) {
+            fprintf(stderr, "%s:%u: thread has no run bursts\n", path, lineno);
+            fclose(file);
+            return -1;
+        }
+        nthreads++;
+    }
+
+    fclose(file);
+    if (nthreads == 0) {
+        fprintf(stderr, "%s: no threads\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Generate a mix of CPU-bound and interactive threads
+ *
+ * One thread in four is a long CPU-bound batch job at a lower priority;
+ * the rest alternate short bursts with sleeps at a higher priority.
+ */
+static void generate_workload(unsigned int count, unsigned long long seed) {
+    unsigned long long state = seed ? seed : 1;
+#define NEXT_RAND(lo, hi) \
+    (state ^= state << 13, state ^= state >> 7, state ^= state << 17, \
+     (unsigned int)((lo) + state % ((hi) - (lo) + 1)))
+
+    nthreads = count < SIM_MAX_THREADS ? count : SIM_MAX_THREADS;
+    for (unsigned int i = 0; i < nthreads; i++) {
+        struct workload_thread *work = &workload[i];
+
+        work->arrival = NEXT_RAND(0, 100);
+        if (i % 4 == 0) {
+            work->priority = 15;
+            work->nbursts = 1;
+            work->run[0] = NEXT_RAND(200, 1000);
+            work->sleep[0] = 0;
+        } else {
+            work->priority = 5;
+            work->nbursts = NEXT_RAND(10, 50);
+            for (unsigned int b = 0; b < work->nbursts; b++) {
+                work->run[b] = NEXT_RAND(1, 5);
+                work->sleep[b] = NEXT_RAND(5, 30);
+            }
+        }
+    }
+#undef NEXT_RAND
+}
+
+/**
+ * @brief Print the workload in trace format
+ */
+static void print_workload(void) {
+    printf("# arrival_ms priority run_ms sleep_ms [run_ms sleep_ms ...]\n");
+    for (unsigned int i = 0; i < nthreads; i++) {
+        printf("%llu %u", workload[i].arrival, workload[i].priority);
+        for (unsigned int b = 0; b < workload[i].nbursts; b++) {
+            printf(" %u %u", workload[i].run[b], workload[i].sleep[b]);
+        }
+        printf("\n");
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -t FILE   Replay a workload trace (default: synthetic)\n"
+            "  -n N      Synthetic threads (default 16)\n"
+            "  -s SEED   Synthetic workload seed (default 1)\n"
+            "  -g        Print the workload as a trace and exit\n"
+            "  -c N      Simulated CPUs (default 1)\n"
+            "  -l N      CPUs per last-level cache (default: all)\n"
+            "  -p NAME   Policy: rr, priority or all (default)\n"
+            "  -N        Disable time-slice preemption\n"
+            "  -d MS     Stop after MS simulated milliseconds (default 600000)\n"
+            "  -v        Show kernel log output\n",
+            prog);
+}
@@ -0,0 +1,38 @@
+/*
+ * FG-OS Scheduler Simulator Interface
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Boundary between the host-side driver and the kernel scheduler built
+ * against simulated CPUs and a simulated clock. Only plain C types cross
+ * it, because the two sides are compiled against different headers.
+ */
+
+#ifndef SCHEDSIM_H
+#define SCHEDSIM_H
+
+// Opaque simulated thread (a struct thread on the kernel side)
+typedef struct sim_thread sim_thread_t;
+
+// Kernel side (sim_kernel.c)
+int sim_reset(unsigned int ncpus, unsigned int llc_size, int policy, int preempt);
+sim_thread_t* sim_thread_create(unsigned int id, unsigned int priority);
+void sim_thread_destroy(sim_thread_t *thread);
+void sim_thread_start(sim_thread_t *thread);
+void sim_thread_sleep(sim_thread_t *thread, unsigned long long ms);
+void sim_thread_exit(sim_thread_t *thread);
+unsigned int sim_thread_id(const sim_thread_t *thread);
+void sim_set_cpu(unsigned int cpu);
+void sim_set_time(unsigned long long ms);
+sim_thread_t* sim_current(void);
+void sim_tick(void);
+void sim_schedule(void);
+unsigned long long sim_context_switches(void);
+
+// Driver side (schedsim.c), called by the kernel side
+void sim_note_dispatch(unsigned int id, unsigned long long waited_ms, int woken);
+int schedsim_printk(const char *fmt, ...);
+
+#endif // SCHEDSIM_H
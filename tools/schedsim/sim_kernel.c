@@ -0,0 +1,373 @@
+/*
+ * FG-OS Scheduler Simulator Kernel Environment
+ * Phase 6: Process Management System
+ *
+ * Developed by: Faiz Nasir
+ * Company: FGCompany Official
+ *
+ * Supplies what kernel/sched/scheduler.c expects from the rest of the
+ * kernel, backed by simulated CPUs and a millisecond clock owned by the
+ * driver. Context switches only change the current thread of the
+ * simulated CPU: the driver, not a thread body, decides what a running
+ * thread does next. Locks and interrupt masking are no-ops because the
+ * driver steps one CPU at a time. The idle loop never runs, so wakeup
+ * placement does not see which CPUs are idle.
+ */
+
+#include <types.h>
+#include "../../kernel/include/kernel.h"
+#include "../../kernel/include/list.h"
+#include "../../kernel/include/spinlock.h"
+#include "../../kernel/sched/scheduler.h"
+#include "schedsim.h"
+
+// Host allocator
+void* calloc(size_t count, size_t size);
+void free(void *ptr);
+
+// Simulated thread: the kernel thread plus what the driver measures
+struct sim_thread {
+    struct thread thread;
+    unsigned int id;            // Workload thread ID
+    bool queued;                // On the ready queue since enqueued_at
+    uint64_t enqueued_at;       // Simulated time of the last enqueue
+};
+
+// Simulated machine
+static uint32_t sim_cpu = 0;
+static uint32_t sim_ncpus = 1;
+static uint32_t sim_llc_size = 1;
+static uint64_t sim_now = 0;
+static struct thread *sim_running[MAX_CPUS];
+static struct process sim_process;
+
+// CPU sets normally owned by topology.c
+cpumask_t cpu_online_mask = 0;
+cpumask_t cpu_isolated_mask = 0;
+
+// RCU reader nesting normally owned by rcu.c
+volatile uint32_t rcu_read_nesting[MAX_CPUS];
+
+static struct sim_thread* to_sim(struct thread *thread) {
+    return container_of(thread, struct sim_thread, thread);
+}
+
+/**
+ * @brief Reset the scheduler onto a fresh simulated machine
+ *
+ * @param ncpus Simulated CPUs
+ * @param llc_size CPUs per last-level cache domain
+ * @param policy SCHED_POLICY_*
+ * @param preempt Enable time-slice preemption
+ * @return 0 on success, negative error code on failure
+ */
+int sim_reset(unsigned int ncpus, unsigned int llc_size, int policy, int preempt) {
+    if (ncpus == 0 || ncpus > MAX_CPUS) {
+        return KERN_INVALID;
+    }
+
+    sim_ncpus = ncpus;
+    sim_llc_size = llc_size ? llc_size : ncpus;
+    sim_cpu = 0;
+    sim_now = 0;
+    memset(sim_running, 0, sizeof(sim_running));
+    memset(&sim_process, 0, sizeof(sim_process));
+    sim_process.priority = PRIORITY_NORMAL;
+    sim_process.time_slice = TIME_SLICE_DEFAULT;
+
+    cpu_online_mask = ncpus == MAX_CPUS ? CPU_MASK_ALL : CPU_MASK_CPU(ncpus) - 1;
+    cpu_isolated_mask = CPU_MASK_NONE;
+
+    if (scheduler_init() != KERN_SUCCESS) {
+        return KERN_ERROR;
+    }
+    if (scheduler_set_policy((uint8_t)policy) != KERN_SUCCESS) {
+        return KERN_INVALID;
+    }
+    scheduler_enable(preempt != 0);
+    return KERN_SUCCESS;
+}
+
+/**
+ * @brief Create a simulated thread, not yet runnable
+ *
+ * @param id Workload thread ID
+ * @param priority Priority (PRIORITY_HIGH .. PRIORITY_IDLE)
+ * @return Simulated thread, NULL if out of memory
+ */
+sim_thread_t* sim_thread_create(unsigned int id, unsigned int priority) {
+    struct sim_thread *sim = (struct sim_thread*)calloc(1, sizeof(struct sim_thread));
+    if (!sim) {
+        return NULL;
+    }
+
+    struct thread *thread = &sim->thread;
+    sim->id = id;
+    thread->tid = id;
+    thread->state = THREAD_STATE_NEW;
+    thread->process = &sim_process;
+    thread->priority = (uint8_t)(priority < PRIORITY_LEVELS ? priority : PRIORITY_IDLE);
+    thread->prio = thread->priority;
+    thread->time_slice = TIME_SLICE_DEFAULT;
+    thread->remaining_time = thread->time_slice;
+    thread->cpus_allowed = CPU_MASK_ALL;
+    thread->cpu = sim_cpu;
+    INIT_LIST_HEAD(&thread->pi_waiters);
+    return sim;
+}
+
+/**
+ * @brief Free a simulated thread that is no longer queued or running
+ */
+void sim_thread_destroy(sim_thread_t *sim) {
+    free(sim);
+}
+
+/**
+ * @brief Make a new thread runnable
+ */
+void sim_thread_start(sim_thread_t *sim) {
+    scheduler_add_thread(&sim->thread);
+}
+
+/**
+ * @brief Put the running thread to sleep and schedule
+ *
+ * @param sim Thread running on the current simulated CPU
+ * @param ms Sleep duration
+ */
+void sim_thread_sleep(sim_thread_t *sim, unsigned long long ms) {
+    sim->thread.sleep_until = sim_now + ms;
+    sim->thread.state = THREAD_STATE_SLEEPING;
+    yield();
+}
+
+/**
+ * @brief Terminate the running thread and schedule
+ */
+void sim_thread_exit(sim_thread_t *sim) {
+    sim->thread.state = THREAD_STATE_TERMINATED;
+    schedule();
+}
+
+/**
+ * @brief Get the workload ID of a simulated thread
+ */
+unsigned int sim_thread_id(const sim_thread_t *sim) {
+    return sim->id;
+}
+
+/**
+ * @brief Select the simulated CPU subsequent calls run on
+ */
+void sim_set_cpu(unsigned int cpu) {
+    sim_cpu = cpu < sim_ncpus ? cpu : 0;
+}
+
+/**
+ * @brief Advance the simulated clock
+ */
+void sim_set_time(unsigned long long ms) {
+    sim_now = ms;
+}
+
+/**
+ * @brief Get the thread running on the current simulated CPU
+ */
+sim_thread_t* sim_current(void) {
+    struct thread *thread = sim_running[sim_cpu];
+    return thread ? to_sim(thread) : NULL;
+}
+
+/**
+ * @brief Deliver a timer tick to the current simulated CPU
+ *
+ * Returning from the timer interrupt is where a pending reschedule from
+ * the tick or from wakeups takes effect.
+ */
+void sim_tick(void) {
+    scheduler_tick();
+    preempt_schedule_irq();
+}
+
+/**
+ * @brief Run the scheduler on the current simulated CPU
+ */
+void sim_schedule(void) {
+    schedule();
+}
+
+/**
+ * @brief Get the scheduler's context switch count
+ */
+unsigned long long sim_context_switches(void) {
+    return get_scheduler_stats()->context_switches;
+}
+
+// Kernel interfaces used by scheduler.c
+
+uint32_t smp_processor_id(void) {
+    return sim_cpu;
+}
+
+uint64_t get_system_time(void) {
+    return sim_now;
+}
+
+struct thread* get_current_thread(void) {
+    return sim_running[sim_cpu];
+}
+
+void set_current_thread(struct thread *thread) {
+    sim_running[sim_cpu] = thread;
+}
+
+void set_current_process(struct process *proc) {
+    (void)proc;
+}
+
+void cputime_init(void) {
+}
+
+void cputime_enqueue(struct thread *thread) {
+    struct sim_thread *sim = to_sim(thread);
+    sim->queued = true;
+    sim->enqueued_at = sim_now;
+}
+
+void cputime_switch(struct thread *prev, struct thread *next) {
+    (void)prev;
+    if (!next) {
+        return;
+    }
+
+    // woken_at is still set for a thread queued by a wakeup
+    struct sim_thread *sim = to_sim(next);
+    if (sim->queued) {
+        sim_note_dispatch(sim->id, sim_now - sim->enqueued_at, next->woken_at != 0);
+        sim->queued = false;
+    }
+}
+
+uint64_t cputime_cycles_to_ns(uint64_t cycles) {
+    return cycles;
+}
+
+void pressure_init(void) {
+}
+
+void pressure_tick(void) {
+}
+
+void psi_enqueue(struct thread *thread) {
+    (void)thread;
+}
+
+void psi_dequeue(struct thread *thread) {
+    (void)thread;
+}
+
+void psi_sched_switch(struct thread *prev, struct thread *next) {
+    (void)prev; (void)next;
+}
+
+uint32_t psi_nr_sleeping(void) {
+    return 0;
+}
+
+void print_pressure_status(void) {
+}
+
+void switch_to_asm(uint64_t *prev_rsp, uint64_t next_rsp) {
+    (void)prev_rsp; (void)next_rsp;
+}
+
+void fpu_switch(struct fpu *prev, struct fpu *next) {
+    (void)prev; (void)next;
+}
+
+void topology_init(void) {
+}
+
+cpumask_t cpu_llc_mask(uint32_t cpu) {
+    uint32_t first = cpu - cpu % sim_llc_size;
+    cpumask_t mask = CPU_MASK_NONE;
+    for (uint32_t other = first; other < first + sim_llc_size && other < sim_ncpus; other++) {
+        mask |= CPU_MASK_CPU(other);
+    }
+    return mask;
+}
+
+bool cpus_share_cache(uint32_t cpu_a, uint32_t cpu_b) {
+    return cpu_a < sim_ncpus && cpu_b < sim_ncpus &&
+           cpu_a / sim_llc_size == cpu_b / sim_llc_size;
+}
+
+void __spin_lock_init(spinlock_t *lock, struct lock_class *lock_class) {
+    (void)lock_class;
+    memset(lock, 0, sizeof(*lock));
+}
+
+uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    (void)lock;
+    return 0;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    (void)lock; (void)flags;
+}
+
+uint64_t interrupts_disable(void) {
+    return 0;
+}
+
+void interrupts_restore(uint64_t state) {
+    (void)state;
+}
+
+void futex_init(void) {
+}
+
+void rcu_init(void) {
+}
+
+void rcu_note_context_switch(void) {
+}
+
+void rcu_idle_enter(void) {
+}
+
+void rcu_idle_exit(void) {
+}
+
+void tick_nohz_kick(void) {
+}
+
+void tick_nohz_idle_enter(void) {
+}
+
+void tick_nohz_idle_exit(void) {
+}
+
+void do_softirq(void) {
+}
+
+bool in_interrupt(void) {
+    return false;
+}
+
+uint32_t local_softirq_pending(void) {
+    return 0;
+}
+
+int workqueue_init(void) {
+    return KERN_SUCCESS;
+}
+
+void wq_worker_sleeping(struct thread *thread) {
+    (void)thread;
+}
+
+void wq_worker_waking_up(struct thread *thread) {
+    (void)thread;
+}